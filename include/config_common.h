@@ -3,16 +3,39 @@
 // ============================
 // MQTT Broker Host & Port
 // ============================
+// Defaults: the active values live in ConfigStore ("set mqtt_host=...").
 #define MQTT_HOST       "192.168.0.20"
 #define MQTT_PORT       1883
 
+// Persistent session: stable client ID (from MAC), cleanSession=false and
+// QoS 1 command subscription, so commands sent while asleep are queued by the
+// broker and drained after the next connect.
+#define MQTT_PERSISTENT_SESSION 1
+#define MAILBOX_DRAIN_MAX_MS    1500   // upper bound for the drain phase
+#define MAILBOX_QUIET_MS        300    // drain ends after this long without a command
+
+// TLS transport (build with -DENABLE_MQTT_TLS): set MQTT_PORT to the broker's
+// TLS port (usually 8883) and define MQTT_CA_CERT (PEM) in config_secrets.h.
+// The negotiated session is cached in RTC memory for abbreviated handshakes;
+// it includes the broker certificate, so size the cache to fit it.
+#define TLS_SESSION_CACHE_SIZE   1536
+#define TLS_HANDSHAKE_TIMEOUT_MS 8000
+
+// PubSubClient packet buffer (fixed header + topic + payload).
+// The library default of 256 bytes is too small for status payloads.
+#define MQTT_BUFFER_SIZE 768
+
 // ============================
-// RTC Pins for I2C
+// I2C Bus (shared, see I2CBus)
 // ============================
 
 #define I2C_SDA_PIN 21
 #define I2C_SCL_PIN 22
-#define I2C_FREQ_HZ 100000
+#define I2C_FREQ_HZ 400000        // fast mode; lowered to the slowest registered device
+#define I2C_TIMEOUT_MS 20         // per transaction
+#define I2C_MAX_DEVICES 4         // devices with their own error counters
+
+#define DS3231_I2C_ADDR 0x68
 
 // ============================
 // DHT22 Sensor
@@ -41,6 +64,10 @@
 #define HA_TEMP_CONFIG_TOPIC  "homeassistant/sensor/esp32_greenhouse_temperature/config"
 #define HA_HUM_CONFIG_TOPIC   "homeassistant/sensor/esp32_greenhouse_humidity/config"
 
+// Discovery configs are retained: resend after power-on, then every N wakes
+// (in case the broker lost its retained store)
+#define HA_CONFIG_REFRESH_WAKES 288
+
 
 // ============================
 // MQTT Topics
@@ -54,6 +81,9 @@
 #define MQTT_TOPIC_LWT    "test/esp32/status"
 #define MQTT_TOPIC_CMD    "test/esp32/cmd"
 #define MQTT_TOPIC_STATUS "test/esp32/status"
+#define MQTT_TOPIC_HISTORY "test/esp32/history"
+#define MQTT_TOPIC_OTA_REQ  "test/esp32/ota/req"    // chunk requests (JSON)
+#define MQTT_TOPIC_OTA_DATA "test/esp32/ota/data"   // chunks (binary, subscribed)
 
 // ============================
 // Greenhouse-specific MQTT Topics
@@ -75,9 +105,214 @@
 // Set INPUT_ACTIVE_LOW to 1 for active-low inputs, 0 for active-high
 #define INPUT_ACTIVE_LOW 1
 #define INPUT_PIN_COUNT  2
-static const uint8_t INPUT_PINS[INPUT_PIN_COUNT] = { 0, 27 };
+static constexpr uint8_t INPUT_PINS[INPUT_PIN_COUNT] = { 0, 27 };
+
+// Per-input mode:
+//   INPUT_MODE_EVENT - debounced edges published as events (Interrupts)
+//   INPUT_MODE_PULSE - edges counted by the ULP, awake and asleep (PulseCounter)
+// Pulse inputs must be RTC-capable GPIOs (0, 2, 4, 12-15, 25-27, 32-39).
+#define INPUT_MODE_EVENT 0
+#define INPUT_MODE_PULSE 1
+static constexpr uint8_t INPUT_PIN_MODES[INPUT_PIN_COUNT] = { INPUT_MODE_EVENT, INPUT_MODE_EVENT };
+
+// Pulse inputs: units per counted pulse and rate time base (seconds).
+// e.g. rain gauge  = 0.2794 mm/tip, 3600 -> mm/h
+//      flow meter  = 1/450 L/pulse,   60 -> L/min
+static const float    PULSE_UNITS_PER_COUNT[INPUT_PIN_COUNT] = { 0.0f, 0.2794f };
+static const uint32_t PULSE_RATE_PER_SECONDS[INPUT_PIN_COUNT] = { 0, 3600 };
+
+// Wake from deep sleep when an event input changes level (EXT0/EXT1).
+// Input wakes take a short path: publish the change only, then sleep again.
+// With INPUT_ACTIVE_LOW at most two event inputs can wake the device (both
+// idle high, and only EXT0 and a one-pin EXT1 wake on a falling level).
+#define INPUT_WAKE_ENABLED            1
+#define INPUT_WAKE_CONNECT_TIMEOUT_MS 8000
+
+// ULP sampling period for pulse inputs, and the number of consecutive equal
+// samples a new level needs before it counts. Bounce shorter than
+// PULSE_DEBOUNCE_SAMPLES x period (6 ms) is ignored; pulses and gaps must each
+// last that long, which limits counting to ~83 Hz. Hall-effect flow meters do
+// not bounce: 1 sample allows up to 250 Hz.
+#define PULSE_SAMPLE_PERIOD_US 2000
+#define PULSE_DEBOUNCE_SAMPLES 3
+
+// ============================
+// Local Time (daily min/max rollover, see Calendar)
+// ============================
+// Zone = standard offset from UTC + DST rule; transitions are precomputed
+// at compile time. Defaults keep the reset at 10:00 UTC.
+#define TZ_DST_NONE 0
+#define TZ_DST_EU   1   // last Sun of Mar -> last Sun of Oct, 01:00 UTC
+#define TZ_DST_US   2   // 2nd Sun of Mar -> 1st Sun of Nov, 02:00 local
+// The zone may also come from build_flags (the host test envs, see test/README)
+#ifndef TZ_STD_OFFSET_MIN
+#define TZ_STD_OFFSET_MIN   0             // e.g. 60 = CET, -300 = EST
+#endif
+#ifndef TZ_DST_RULE
+#define TZ_DST_RULE         TZ_DST_NONE
+#endif
+#define MINMAX_ROLLOVER_MIN (10 * 60)     // local time of the daily reset (minutes)
+
+// ============================
+// Reading History (RTC memory)
+// ============================
+// Readings kept across deep sleep for on-demand replay ("history" command).
+// Each record is 8 bytes of RTC slow memory.
+#define HISTORY_CAPACITY        240
+#define HISTORY_CHUNKS_PER_LOOP 1    // chunks sent per ConnectionManager::loop()
+#define HISTORY_CHUNK_MAX_BYTES 2048 // record bytes per chunk (streamed, not buffered)
+
+// ============================
+// Wake Trace (build flag ENABLE_WAKE_TRACE)
+// ============================
+// Inputs of the last TRACE_CAPACITY wakes ("trace" command), 24 bytes each,
+// plus the last TRACE_COMMAND_SLOTS commands received, all in RTC slow memory.
+#define TRACE_CAPACITY      32
+#define TRACE_COMMAND_SLOTS 8
+#define TRACE_COMMAND_LEN   40   // longer commands are cut
+
+// ============================
+// Dual-core Pipeline (build flag ENABLE_PIPELINE)
+// ============================
+// Network task on PRO_CPU, sensing/encoding task on APP_CPU, joined by an
+// outbox of encoded messages in one shared buffer: each takes its topic and
+// payload length plus up to 10 bytes. A first wake (boot, discovery, status
+// near MQTT_BUFFER_SIZE, min/max, alarm, logs) needs about 3 KB.
+#define PIPELINE_OUTBOX_BYTES     4096  // power of two
+#define PIPELINE_NET_STACK        8192
+#define PIPELINE_SENSE_STACK      6144
+#define PIPELINE_ENQUEUE_WAIT_MS  500
+
+// ============================
+// MQTT-SN Transport (build flag ENABLE_MQTTSN)
+// ============================
+// Telemetry as QoS -1 datagrams to an MQTT-SN gateway (no TCP, no CONNECT),
+// alarms as QoS 1, commands buffered by the gateway for the sleeping client.
+#define MQTTSN_GATEWAY_HOST     "192.168.0.20"
+#define MQTTSN_GATEWAY_PORT     10000
+#define MQTTSN_LOCAL_PORT       10000
+#define MQTTSN_ACK_TIMEOUT_MS   500
+#define MQTTSN_RETRIES          3
+#define MQTTSN_KEEPALIVE_S      60
+#define MQTTSN_SLEEP_DURATION_S 3600   // must exceed the wake interval
+
+// Predefined topic IDs (must match the gateway's predefined topic list)
+#define MQTTSN_TOPIC_ID_BOOT           1
+#define MQTTSN_TOPIC_ID_LOG            2
+#define MQTTSN_TOPIC_ID_EVENTS         3
+#define MQTTSN_TOPIC_ID_RESP           4
+#define MQTTSN_TOPIC_ID_CMD            5
+#define MQTTSN_TOPIC_ID_STATUS         6
+#define MQTTSN_TOPIC_ID_HISTORY        7
+#define MQTTSN_TOPIC_ID_HA_AVAIL       8
+#define MQTTSN_TOPIC_ID_HA_STATE       9
+#define MQTTSN_TOPIC_ID_HA_TEMP_CONFIG 10
+#define MQTTSN_TOPIC_ID_HA_HUM_CONFIG  11
 
 // ============================
 // Heartbeat Configuration
 // ============================
-#define HEARTBEAT_INTERVAL_MS 60000  // 60 seconds
+#define HEARTBEAT_INTERVAL_MS 60000  // 60 seconds (continuous mode)
+
+// ============================
+// Connect Policy (cross-wake backoff, learned deadlines)
+// ============================
+// While the AP or broker is down, wakes skip the radio (1, 2, 4, ... wakes)
+// and keep their readings for replay. WiFi association and MQTT connect each
+// get a deadline learned from past connects instead of only the flat timeout.
+#define CONNECT_BACKOFF_MAX_SKIPS  16     // wakes: 80 min at DEFAULT_SLEEP_MINUTES (5), scales with sleep_min
+#define CONNECT_LEARN_MIN_SAMPLES  8      // connects before a phase deadline applies
+#define CONNECT_DEADLINE_PERCENT   95
+#define CONNECT_DEADLINE_MARGIN_MS 500
+#define CONNECT_DEADLINE_MIN_MS    1000
+
+// ============================
+// Health Counters (failure counts in status)
+// ============================
+// Counters since power-on ride along with every Nth status message (and the
+// first after power-on); "health" on the command topic returns them at once.
+#define HEALTH_PUBLISH_EVERY 12   // status messages: 1 h at DEFAULT_SLEEP_MINUTES (5), longer on low battery
+
+// ============================
+// Energy Model (battery-life projection)
+// ============================
+// Average current per wake phase (mA). Measure once per board/firmware with a
+// power analyser; the defaults are typical ESP32 devkit figures.
+#define ENERGY_MA_BOOT        40.0f
+#define ENERGY_MA_SENSOR      60.0f    // WiFi is already starting in the background
+#define ENERGY_MA_WIFI_ASSOC  120.0f
+#define ENERGY_MA_MQTT        110.0f   // TCP/TLS + MQTT connect
+#define ENERGY_MA_TX          130.0f
+#define ENERGY_MA_FLUSH       100.0f
+#define ENERGY_MA_SLEEP       0.15f    // board total in deep sleep (RTC, DHT, regulator)
+#define BATTERY_CAPACITY_MAH  2500.0f
+
+// ============================
+// Battery Monitor + Power Policy
+// ============================
+// Battery via a resistor divider on an ADC1 pin (ADC2 is unusable with WiFi).
+// Set BATTERY_MONITOR_ENABLED to 0 on boards without the divider (no shedding).
+#define BATTERY_MONITOR_ENABLED 1
+#define BATTERY_ADC_PIN       35
+#define BATTERY_DIVIDER_RATIO 2.0f     // Vbat / Vpin (e.g. 100k/100k)
+#define BATTERY_SAMPLES       16       // conversions averaged per reading
+
+// Load-shedding thresholds (single Li-ion cell), see PowerPolicy
+#define POWER_CONSERVE_MV      3600    // longer interval, no logs/discovery
+#define POWER_LOW_MV           3450    // batch readings, uplink every N wakes
+#define POWER_CRITICAL_MV      3300    // alarm-only
+#define POWER_HYSTERESIS_MV    80      // recovery margin above a threshold
+#define POWER_LOW_UPLINK_EVERY 4
+
+// ============================
+// Runtime Configuration (ConfigStore)
+// ============================
+// Defaults for a node without stored configuration; changed at runtime with
+// "set key=value" (applied on the next wake).
+#define DEFAULT_TEMP_LOW_C     1.0f
+#define DEFAULT_TEMP_HIGH_C    30.0f
+#define DEFAULT_SLEEP_MINUTES  5
+#define CONFIG_TRIAL_CONNECTS  3     // failed connects before a broker change is rolled back
+
+// ============================
+// OTA Update (chunked over MQTT, across wakes)
+// ============================
+// A chunk is one MQTT message, so it must fit MQTT_BUFFER_SIZE with its topic.
+#define OTA_CHUNK_SIZE        512
+#define OTA_CHUNKS_PER_WAKE   32      // bounds the energy spent per wake
+#define OTA_CHUNK_TIMEOUT_MS  1000    // re-request after this long
+#define OTA_CHUNK_RETRIES     3       // per wake, then continue next wake
+#define OTA_WAKE_WINDOW_MS    8000    // max time per wake spent on OTA
+#define OTA_TRIAL_WAKES       3       // connected wakes for a new image to publish status
+#define OTA_TRIAL_BOOTS       3       // resets of a new image before it publishes status
+
+// ============================
+// Time Service (DS3231 disciplined by SNTP)
+// ============================
+// One SNTP query every TIME_SYNC_INTERVAL_DAYS while WiFi is up; the measured
+// drift is trimmed with the DS3231 aging offset in between.
+#define NTP_SERVER              "pool.ntp.org"
+#define TIME_NTP_LOCAL_PORT     2390
+#define TIME_SNTP_TIMEOUT_MS    1500
+#define TIME_SYNC_INTERVAL_DAYS 7
+#define TIME_SYNC_RETRY_MIN     15      // minutes after a failed sync, doubled per failure
+#define TIME_SYNC_RETRY_MAX     1440    // minutes, cap of the retry backoff
+#define TIME_DRIFT_MIN_HOURS    24      // shorter intervals are too noisy for ppm
+#define TIME_MAX_DRIFT_PPM      100.0f  // larger errors mean the clock was reset
+#define RTC_AGING_PPM_PER_LSB   0.1f    // DS3231 at 25 C
+
+// ============================
+// Wake Watchdog
+// ============================
+// Hard ceiling on awake time per battery wake; the node is forced into deep
+// sleep when it is exceeded and the stuck phase is reported on the next uplink.
+#define WAKE_BUDGET_MS        30000   // > connect timeout + TLS handshake + mailbox drain
+#define WAKE_TWDT_MARGIN_S    10      // task watchdog backup, on top of the budget
+#define WAKE_FALLBACK_SLEEP_S 300     // if the expire handler returns
+
+// ============================
+// Continuous (mains) Mode
+// ============================
+// Selected at runtime with "mode=continuous" / "mode=battery" (persisted in NVS).
+#define CONTINUOUS_CPU_MHZ     80     // lowest clock that keeps WiFi running
+#define CONTINUOUS_MAX_IDLE_MS 1000   // max block between loop passes (input events)
@@ -0,0 +1,52 @@
+#pragma once
+
+// ============================
+// Deployment Profiles
+// ============================
+// Selected per PlatformIO environment with one -DPROFILE_* build flag. Each
+// profile lists the optional modules it is built with; main.cpp composes only
+// those (std::conditional_t / if constexpr), so modules left out cost no code,
+// static constructors or init calls. Needs C++17 (see platformio.ini).
+//
+//   battery-sensor  greenhouse node on battery: DHT22 + RTC, HA discovery
+//   mains-hub       powered node: event inputs, pulse counters, LED, HA
+//   bench           desk board: event inputs + LED, no HA discovery
+//
+// Features that are also runtime settings (battery/continuous mode, power
+// policy) stay runtime settings; a profile only removes code.
+
+struct BatterySensorProfile {
+  static constexpr const char* name = "battery-sensor";
+  static constexpr bool eventInputs = false;   // Interrupts + input wake
+  static constexpr bool pulseInputs = false;   // PulseCounter (ULP)
+  static constexpr bool ledCommands = false;   // "led=on|off|toggle"
+  static constexpr bool haDiscovery = true;    // Home Assistant discovery/state
+};
+
+struct MainsHubProfile {
+  static constexpr const char* name = "mains-hub";
+  static constexpr bool eventInputs = true;
+  static constexpr bool pulseInputs = true;
+  static constexpr bool ledCommands = true;
+  static constexpr bool haDiscovery = true;
+};
+
+struct BenchProfile {
+  static constexpr const char* name = "bench";
+  static constexpr bool eventInputs = true;
+  static constexpr bool pulseInputs = false;
+  static constexpr bool ledCommands = true;
+  static constexpr bool haDiscovery = false;   // keep bench boards out of HA
+};
+
+#if defined(PROFILE_MAINS_HUB) && defined(PROFILE_BENCH)
+#error "Select one deployment profile"
+#endif
+
+#if defined(PROFILE_MAINS_HUB)
+using Profile = MainsHubProfile;
+#elif defined(PROFILE_BENCH)
+using Profile = BenchProfile;
+#else
+using Profile = BatterySensorProfile;
+#endif
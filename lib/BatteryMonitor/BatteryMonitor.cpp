@@ -0,0 +1,65 @@
+#include "BatteryMonitor.h"
+#include <config_common.h>
+
+// Used only when the chip has no eFuse calibration
+static const uint32_t DEFAULT_VREF_MV = 1100;
+
+// ============================
+// Public: begin()
+// ============================
+void BatteryMonitor::begin() {
+  int channel = digitalPinToAnalogChannel(BATTERY_ADC_PIN);
+  if (channel < 0 || channel >= ADC1_CHANNEL_MAX) {
+    Serial.printf("[Batt] Pin %d is not an ADC1 input (ADC2 is unusable with WiFi)\n", BATTERY_ADC_PIN);
+    return;
+  }
+  adcChannel = (adc1_channel_t)channel;
+
+  adc1_config_width(ADC_WIDTH_BIT_12);
+  adc1_config_channel_atten(adcChannel, ADC_ATTEN_DB_11);
+
+  calSource = esp_adc_cal_characterize(ADC_UNIT_1, ADC_ATTEN_DB_11, ADC_WIDTH_BIT_12,
+                                       DEFAULT_VREF_MV, &adcChars);
+  initialized = true;
+
+  Serial.printf("[Batt] Pin %d (ADC1 ch%d), calibration=%s\n",
+                BATTERY_ADC_PIN, channel, calibrationName());
+}
+
+// ============================
+// Public: readMillivolts()
+// ============================
+uint16_t BatteryMonitor::readMillivolts() {
+  if (!initialized) {
+    return 0;
+  }
+
+  // Trimmed mean: drop the lowest and highest conversion
+  uint32_t sum = 0;
+  int minRaw = INT32_MAX;
+  int maxRaw = -1;
+  for (uint8_t i = 0; i < BATTERY_SAMPLES; i++) {
+    int raw = adc1_get_raw(adcChannel);
+    if (raw < 0) {
+      return 0;
+    }
+    sum += raw;
+    minRaw = min(minRaw, raw);
+    maxRaw = max(maxRaw, raw);
+  }
+  uint32_t raw = (sum - minRaw - maxRaw) / (BATTERY_SAMPLES - 2);
+
+  uint32_t pinMv = esp_adc_cal_raw_to_voltage(raw, &adcChars);
+  return (uint16_t)lroundf(pinMv * BATTERY_DIVIDER_RATIO);
+}
+
+// ============================
+// Public: calibrationName()
+// ============================
+const char* BatteryMonitor::calibrationName() const {
+  switch (calSource) {
+    case ESP_ADC_CAL_VAL_EFUSE_TP:   return "efuse_tp";
+    case ESP_ADC_CAL_VAL_EFUSE_VREF: return "efuse_vref";
+    default:                         return "default";
+  }
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <Arduino.h>
+#include <driver/adc.h>
+#include <esp_adc_cal.h>
+
+/**
+ * @class BatteryMonitor
+ * @brief Battery voltage through a resistor divider on an ADC1 input.
+ * 
+ * Readings are calibrated with the eFuse Vref (or two-point values when
+ * burned) via esp_adc_cal, and averaged over BATTERY_SAMPLES conversions
+ * with the lowest and highest dropped.
+ * 
+ * Read before WiFi is started: radio TX bursts pull the supply down and
+ * couple noise into the ADC, so the value would read low and jittery.
+ */
+class BatteryMonitor {
+public:
+  /**
+   * @brief Configure the ADC channel and load the calibration.
+   */
+  void begin();
+
+  /**
+   * @brief Battery voltage in millivolts (after the divider), 0 on error.
+   */
+  uint16_t readMillivolts();
+
+  /**
+   * @brief Calibration source name ("efuse_tp", "efuse_vref", "default").
+   */
+  const char* calibrationName() const;
+
+private:
+  adc1_channel_t adcChannel = ADC1_CHANNEL_0;
+  esp_adc_cal_characteristics_t adcChars;
+  esp_adc_cal_value_t calSource = ESP_ADC_CAL_VAL_DEFAULT_VREF;
+  bool initialized = false;
+};
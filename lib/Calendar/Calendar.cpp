@@ -0,0 +1,103 @@
+#include "Calendar.h"
+#include <stddef.h>
+#include <config_common.h>
+
+static const int32_t SECONDS_PER_DAY = 86400;
+static const int32_t STD_OFFSET_S = TZ_STD_OFFSET_MIN * 60;
+static const int32_t DST_SHIFT_S = 3600;
+
+// ============================
+// DST transitions (compile time)
+// ============================
+static constexpr int YEARS = Calendar::LAST_YEAR - Calendar::FIRST_YEAR + 1;
+static constexpr size_t TRANSITIONS = (TZ_DST_RULE == TZ_DST_NONE) ? 0 : 2 * YEARS;
+
+// Sorted UTC instants; DST is in effect after an odd number of them
+struct DstTable {
+  uint32_t at[TRANSITIONS > 0 ? TRANSITIONS : 1];
+};
+
+static constexpr int32_t lastSunday(int y, int m, int lastDay) {
+  int32_t d = Calendar::daysFromCivil(y, m, lastDay);
+  return d - Calendar::weekday(d);
+}
+
+static constexpr int32_t nthSunday(int y, int m, int n) {
+  int32_t first = Calendar::daysFromCivil(y, m, 1);
+  return first + (7 - Calendar::weekday(first)) % 7 + 7 * (n - 1);
+}
+
+static constexpr DstTable buildDstTable() {
+  DstTable table{};
+  for (int i = 0; i < (int)TRANSITIONS / 2; i++) {
+    int y = Calendar::FIRST_YEAR + i;
+    int64_t start = 0;
+    int64_t end = 0;
+    if (TZ_DST_RULE == TZ_DST_EU) {
+      // Last Sunday of March / October, 01:00 UTC
+      start = (int64_t)lastSunday(y, 3, 31) * SECONDS_PER_DAY + 3600;
+      end = (int64_t)lastSunday(y, 10, 31) * SECONDS_PER_DAY + 3600;
+    } else {
+      // Second Sunday of March / first Sunday of November, 02:00 local
+      start = (int64_t)nthSunday(y, 3, 2) * SECONDS_PER_DAY + 7200 - STD_OFFSET_S;
+      end = (int64_t)nthSunday(y, 11, 1) * SECONDS_PER_DAY + 7200 - STD_OFFSET_S - DST_SHIFT_S;
+    }
+    table.at[2 * i] = (uint32_t)start;
+    table.at[2 * i + 1] = (uint32_t)end;
+  }
+  return table;
+}
+
+static constexpr DstTable DST_TABLE = buildDstTable();
+
+static constexpr bool isSorted(const DstTable& table) {
+  for (size_t i = 1; i < TRANSITIONS; i++) {
+    if (table.at[i] <= table.at[i - 1]) {
+      return false;
+    }
+  }
+  return true;
+}
+static_assert(isSorted(DST_TABLE), "DST transitions must be strictly increasing");
+static_assert(TZ_DST_RULE != TZ_DST_EU ||
+              DST_TABLE.at[0] == 1585443600UL,   // 2020-03-29 01:00 UTC
+              "EU DST rule");
+
+// Number of transitions at or before t (branchless binary search)
+static size_t transitionsUpTo(int64_t t) {
+  if (TRANSITIONS == 0) {
+    return 0;
+  }
+  const uint32_t* base = DST_TABLE.at;
+  size_t n = TRANSITIONS;
+  while (n > 1) {
+    size_t half = n / 2;
+    base = ((int64_t)base[half] <= t) ? base + half : base;
+    n -= half;
+  }
+  return (size_t)(base - DST_TABLE.at) + ((int64_t)*base <= t);
+}
+
+// ============================
+// Public
+// ============================
+bool Calendar::isDst(time_t t) {
+  return (transitionsUpTo((int64_t)t) & 1) != 0;
+}
+
+int32_t Calendar::utcOffset(time_t t) {
+  return STD_OFFSET_S + (isDst(t) ? DST_SHIFT_S : 0);
+}
+
+int32_t Calendar::localDay(time_t t) {
+  return (int32_t)floorDiv((int64_t)t + utcOffset(t), SECONDS_PER_DAY);
+}
+
+int32_t Calendar::rolloverDay(time_t t) {
+  return (int32_t)floorDiv((int64_t)t + utcOffset(t) - MINMAX_ROLLOVER_MIN * 60, SECONDS_PER_DAY);
+}
+
+int Calendar::yyyymmdd(int32_t days) {
+  Date d = civilFromDays(days);
+  return d.year * 10000 + d.month * 100 + d.day;
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <stdint.h>
+#include <time.h>
+
+/**
+ * @class Calendar
+ * @brief Integer civil-date arithmetic and local time for a configured zone.
+ *
+ * Replaces gmtime()/localtime() on the wake path: no tm struct, no locks, no
+ * allocation, and no TZ string parsing.
+ * - daysFromCivil()/civilFromDays() convert between dates and days since
+ *   1970-01-01 (proleptic Gregorian, H. Hinnant's algorithms).
+ * - The zone is a standard offset (TZ_STD_OFFSET_MIN) plus a DST rule
+ *   (TZ_DST_RULE). Its DST transitions for FIRST_YEAR..LAST_YEAR are
+ *   computed at compile time into a sorted table of UTC instants. A lookup
+ *   is a branchless binary search over that table.
+ * - rolloverDay() numbers days that start at MINMAX_ROLLOVER_MIN local
+ *   time, e.g. 10:00 every day regardless of DST.
+ *
+ * Outside the table's years, standard time is assumed.
+ * Host-compilable (no Arduino dependency).
+ */
+class Calendar {
+public:
+  static const int FIRST_YEAR = 2020;
+  static const int LAST_YEAR = 2099;
+
+  struct Date {
+    int16_t year;
+    uint8_t month;     // 1..12
+    uint8_t day;       // 1..31
+  };
+
+  /**
+   * @brief Days since 1970-01-01 for a proleptic Gregorian date.
+   */
+  static constexpr int32_t daysFromCivil(int y, int m, int d) {
+    y -= m <= 2;
+    int32_t era = (y >= 0 ? y : y - 399) / 400;
+    uint32_t yoe = (uint32_t)(y - era * 400);
+    uint32_t doy = (153 * (uint32_t)(m + (m > 2 ? -3 : 9)) + 2) / 5 + (uint32_t)d - 1;
+    uint32_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + (int32_t)doe - 719468;
+  }
+
+  /**
+   * @brief Date of a day number (inverse of daysFromCivil()).
+   */
+  static constexpr Date civilFromDays(int32_t z) {
+    z += 719468;
+    int32_t era = (z >= 0 ? z : z - 146096) / 146097;
+    uint32_t doe = (uint32_t)(z - era * 146097);
+    uint32_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    uint32_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    uint32_t mp = (5 * doy + 2) / 153;
+    uint32_t d = doy - (153 * mp + 2) / 5 + 1;
+    uint32_t m = mp < 10 ? mp + 3 : mp - 9;
+    int32_t y = (int32_t)yoe + era * 400 + (m <= 2);
+    return Date{ (int16_t)y, (uint8_t)m, (uint8_t)d };
+  }
+
+  /**
+   * @brief Day of the week, 0 = Sunday.
+   */
+  static constexpr int weekday(int32_t days) {
+    return (int)((days % 7 + 11) % 7);   // 1970-01-01 was a Thursday
+  }
+
+  /**
+   * @brief Floor division (rounds toward minus infinity).
+   */
+  static constexpr int64_t floorDiv(int64_t a, int64_t b) {
+    return a / b - ((a % b != 0) && ((a < 0) != (b < 0)));
+  }
+
+  /**
+   * @brief Offset of local time from UTC at a UTC instant (seconds).
+   */
+  static int32_t utcOffset(time_t t);
+
+  /**
+   * @brief True if DST is in effect at a UTC instant.
+   */
+  static bool isDst(time_t t);
+
+  /**
+   * @brief Local day number (days since 1970-01-01 in local time).
+   */
+  static int32_t localDay(time_t t);
+
+  /**
+   * @brief Day number whose days start at MINMAX_ROLLOVER_MIN local time.
+   *
+   * The date of the day a rollover happened on is civilFromDays() of it.
+   */
+  static int32_t rolloverDay(time_t t);
+
+  /**
+   * @brief Date as yyyymmdd (e.g. 20260122).
+   */
+  static int yyyymmdd(int32_t days);
+};
@@ -1,8 +1,15 @@
 #include "Comms.h"
 #include <ConnectionManager.h>
+#include <HealthCounters.h>
+#include <Pipeline.h>
+#include <TrafficStats.h>
 #include <config_common.h>
 #include <config.h>
 
+#if defined(ENABLE_MQTTSN) && defined(ENABLE_PIPELINE)
+#error "ENABLE_MQTTSN and ENABLE_PIPELINE cannot be combined (the outbox drains over TCP)"
+#endif
+
 void Comms::begin(ConnectionManager& cm) {
   _cm = &cm;
   _mqtt = cm.getMqttClient();
@@ -10,9 +17,43 @@ void Comms::begin(ConnectionManager& cm) {
   Serial.println("[Comms] Initialized");
 }
 
+bool Comms::connected() const {
+#ifdef ENABLE_MQTTSN
+  return _cm != nullptr && _cm->mqttConnected();
+#endif
+  if (_pipeline && !_pipeline->onNetworkTask()) {
+    return _pipeline->connected();
+  }
+  return _mqtt != nullptr && _mqtt->connected();
+}
+
+void Comms::setPipeline(Pipeline* pipeline) {
+  _pipeline = pipeline;
+}
+
 bool Comms::publishRaw(const char* topic, const char* payload, bool retained) {
+  // Sensing task: hand over to the network task, sent once MQTT is up
+  if (_pipeline && !_pipeline->onNetworkTask()) {
+    if (!_pipeline->enqueue(topic, payload, retained)) {
+      HealthCounters::increment(HealthCounters::Counter::PublishFail);
+      return false;
+    }
+    return true;
+  }
+
+#ifdef ENABLE_MQTTSN
+  // Telemetry: QoS -1, a single datagram without a connection
+  if (!_cm->getSnClient()->publish(topic, (const uint8_t*)payload, strlen(payload), -1, retained)) {
+    HealthCounters::increment(HealthCounters::Counter::PublishFail);
+    return false;
+  }
+  TrafficStats::countPublish(topic, strlen(payload));
+  return true;
+#endif
+
   if (_mqtt == nullptr) {
     Serial.println("[Comms] publishRaw failed: mqtt client is null");
+    HealthCounters::increment(HealthCounters::Counter::PublishFail);
     return false;
   }
 
@@ -22,6 +63,11 @@ bool Comms::publishRaw(const char* topic, const char* payload, bool retained) {
   }
 
   bool ok = _mqtt->publish(topic, payload, retained);
+  if (ok) {
+    TrafficStats::countPublish(topic, strlen(payload));
+  } else {
+    HealthCounters::increment(HealthCounters::Counter::PublishFail);
+  }
   return ok;
 }
 
@@ -45,6 +91,132 @@ bool Comms::publishStatus(const char* payload) {
   return publishRaw(MQTT_TOPIC_STATUS, payload, false);
 }
 
+bool Comms::publishHistory(const char* payload) {
+  return publishRaw(MQTT_TOPIC_HISTORY, payload, false);
+}
+
+bool Comms::publishOtaRequest(const char* payload) {
+  return publishRaw(MQTT_TOPIC_OTA_REQ, payload, false);
+}
+
+bool Comms::publishAlarm(const char* json) {
+#ifdef ENABLE_MQTTSN
+  if (!_cm->getSnClient()->publish(MQTT_TOPIC_EVENTS, (const uint8_t*)json, strlen(json), 1, false)) {
+    return false;
+  }
+  TrafficStats::countPublish(MQTT_TOPIC_EVENTS, strlen(json));
+  return true;
+#else
+  return publishRaw(MQTT_TOPIC_EVENTS, json, false);
+#endif
+}
+
+size_t Comms::maxPayloadSize(const char* topic) const {
+  if (_mqtt == nullptr) {
+    return 0;
+  }
+
+  // PUBLISH packet = fixed header + 2-byte topic length + topic + payload
+  size_t overhead = MQTT_MAX_HEADER_SIZE + 2 + strlen(topic);
+  size_t bufferSize = _mqtt->getBufferSize();
+  return (bufferSize > overhead) ? bufferSize - overhead : 0;
+}
+
+// ============================================================================
+// Streaming publish
+// ============================================================================
+
+bool Comms::beginPublish(const char* topic, size_t length, bool retained) {
+#ifdef ENABLE_MQTTSN
+  // A datagram is sent whole: no streaming over MQTT-SN
+  Serial.println("[Comms] beginPublish: not available over MQTT-SN");
+  return false;
+#endif
+
+  // The outbox stores whole payloads; streaming needs the socket owner
+  if (_pipeline && !_pipeline->onNetworkTask()) {
+    Serial.println("[Comms] beginPublish: not available off the network task");
+    return false;
+  }
+
+  if (_mqtt == nullptr || !_mqtt->connected()) {
+    return false;
+  }
+
+  if (_streaming) {
+    Serial.println("[Comms] beginPublish: previous stream not ended");
+    return false;
+  }
+
+  if (!_mqtt->beginPublish(topic, length, retained)) {
+    return false;
+  }
+
+  _streaming = true;
+  _streamTopic = topic;
+  _streamLength = length;
+  _streamRemaining = length;
+  return true;
+}
+
+size_t Comms::write(uint8_t b) {
+  return write(&b, 1);
+}
+
+size_t Comms::write(const uint8_t* data, size_t length) {
+  if (!_streaming) {
+    return 0;
+  }
+
+  // Never send more than announced in the PUBLISH header
+  if (length > _streamRemaining) {
+    length = _streamRemaining;
+  }
+
+  size_t written = _mqtt->write(data, length);
+  _streamRemaining -= written;
+  return written;
+}
+
+bool Comms::endPublish() {
+  if (!_streaming) {
+    return false;
+  }
+  _streaming = false;
+
+  if (_streamRemaining != 0) {
+    // Broker still expects payload bytes: the session is out of sync
+    Serial.printf("[Comms] Stream short by %u bytes, dropping connection\n",
+                  (unsigned)_streamRemaining);
+    _streamRemaining = 0;
+    _mqtt->disconnect();
+    return false;
+  }
+
+  if (_mqtt->endPublish() != 1) {
+    return false;
+  }
+  TrafficStats::countPublish(_streamTopic, _streamLength);
+  return true;
+}
+
+// Constant payloads: stream when this task owns MQTT, otherwise queue
+bool Comms::publishConst(const char* topic, const char* payload, bool retained) {
+#ifdef ENABLE_MQTTSN
+  return publishRaw(topic, payload, retained);
+#endif
+  if (_pipeline && !_pipeline->onNetworkTask()) {
+    return publishRaw(topic, payload, retained);
+  }
+
+  size_t length = strlen(payload);
+  if (!beginPublish(topic, length, retained)) {
+    return false;
+  }
+  write((const uint8_t*)payload, length);
+  return endPublish();
+}
+
 // ============================================================================
 // Home Assistant
 // ============================================================================
@@ -84,17 +256,16 @@ bool Comms::publishHAConfig(bool retained) {
     "\"payload_not_available\":\"offline\""
     "}";
 
-  bool ok1 = publishRaw(HA_TEMP_CONFIG_TOPIC, tempConfig, retained);
-  bool ok2 = publishRaw(HA_HUM_CONFIG_TOPIC, humConfig, retained);
+  // Discovery documents are close to the packet buffer size: stream them
+  bool ok1 = publishConst(HA_TEMP_CONFIG_TOPIC, tempConfig, retained);
+  bool ok2 = publishConst(HA_HUM_CONFIG_TOPIC, humConfig, retained);
 
   Serial.printf("[Comms] HA config published: temp=%d hum=%d\n", ok1 ? 1 : 0, ok2 ? 1 : 0);
   return ok1 && ok2;
 }
 
 bool Comms::publishEventJson(const char* json, bool retained) {
-  if (!_mqtt) return false;
-  if (!_mqtt->connected()) return false;
-  return _mqtt->publish(MQTT_TOPIC_EVENTS, json, retained);
+  return publishRaw(MQTT_TOPIC_EVENTS, json, retained);
 }
 
 
@@ -4,17 +4,46 @@
 #include <PubSubClient.h>
 
 class ConnectionManager;
+class Pipeline;
 
-class Comms {
+// Comms is a Print while a streaming publish is open, so encoders can
+// print() payload fragments straight into the MQTT socket.
+class Comms : public Print {
 public:
   void begin(ConnectionManager& cm);
 
+  // True when the MQTT session is up (publishes can succeed)
+  bool connected() const;
+
+  // Route publishes from tasks other than the network task through the
+  // pipeline outbox (see Pipeline). nullptr = publish directly.
+  void setPipeline(Pipeline* pipeline);
+
   bool publishBoot(const char* payload);
   bool publishLog(const char* payload);
   bool publishEvents(const char* payload);
   bool publishResp(const char* payload);
   bool publishStatus(const char* payload);
   bool publishEventJson(const char* json, bool retained = false);
+  bool publishHistory(const char* payload);
+  bool publishOtaRequest(const char* payload);
+
+  // Alarms: delivery confirmed where the transport supports it
+  // (QoS 1 over MQTT-SN, otherwise same as publishEventJson)
+  bool publishAlarm(const char* json);
+
+  // Largest payload that fits the MQTT client's packet buffer for this topic
+  size_t maxPayloadSize(const char* topic) const;
+
+  // Streaming publish: the payload goes straight to the socket in fragments,
+  // so it is neither copied nor limited by the MQTT packet buffer. Exactly
+  // `length` bytes must be written before endPublish(). Needs the task that
+  // owns MQTT: returns false when called through the pipeline outbox.
+  bool beginPublish(const char* topic, size_t length, bool retained = false);
+  size_t write(uint8_t b) override;
+  size_t write(const uint8_t* data, size_t length) override;
+  using Print::write;
+  bool endPublish();
 
 
   // Home Assistant Discovery + State
@@ -25,6 +54,13 @@ public:
 private:
   ConnectionManager* _cm = nullptr;
   PubSubClient* _mqtt = nullptr;
+  Pipeline* _pipeline = nullptr;
+
+  bool _streaming = false;
+  const char* _streamTopic = nullptr;
+  size_t _streamLength = 0;
+  size_t _streamRemaining = 0;     // Bytes still owed to the open publish
 
   bool publishRaw(const char* topic, const char* payload, bool retained = false);
+  bool publishConst(const char* topic, const char* payload, bool retained);
 };
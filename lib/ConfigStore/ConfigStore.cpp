@@ -0,0 +1,382 @@
+#include "ConfigStore.h"
+#include <Preferences.h>
+#include <rom/crc.h>
+#include <config_common.h>
+
+static const char* PREFS_NAMESPACE = "config";
+static const char* KEY_VERSION = "ver";
+static const char* KEY_ACTIVE = "cfg";
+static const char* KEY_STAGED = "staged";
+static const char* KEY_PREVIOUS = "prev";     // restored if a broker change fails
+
+// Before schema v1 only the power mode was persisted, by RuntimeMode
+static const char* LEGACY_NAMESPACE = "runtime";
+static const char* LEGACY_KEY_MODE = "mode";
+
+static const uint32_t CACHE_MAGIC = 0x43464731;   // "CFG1"
+
+static const float TEMP_MIN_C = -40.0f;           // DHT22 range
+static const float TEMP_MAX_C = 80.0f;
+static const uint16_t SLEEP_MAX_MINUTES = 1440;
+
+// RTC memory (survives deep sleep, lost on power cycle)
+struct Cache {
+  uint32_t magic;
+  uint8_t staged;            // a change waits in NVS for the next wake
+  uint8_t onTrial;           // broker change not confirmed by a connect yet
+  uint8_t failedConnects;    // while on trial
+  uint8_t reserved;
+  ConfigStore::Config active;
+  ConfigStore::Config previous;
+  uint32_t crc;
+};
+
+RTC_DATA_ATTR static Cache rtc_cfg;
+
+static uint32_t cacheCrc() {
+  return crc32_le(0, (const uint8_t*)&rtc_cfg, offsetof(Cache, crc));
+}
+
+// Fields are only appended: a blob from an older schema is a prefix of
+// Config, the fields it lacks keep their value in cfg (defaults)
+static bool readBlob(Preferences& prefs, const char* key, ConfigStore::Config& cfg) {
+  size_t len = prefs.getBytesLength(key);
+  if (len == 0 || len > sizeof(cfg)) {
+    return false;
+  }
+  return prefs.getBytes(key, &cfg, len) == len;
+}
+
+// ============================
+// Public: begin()
+// ============================
+void ConfigStore::begin() {
+  // Cold boot (RTC memory cleared) or corrupted cache: NVS is the truth
+  if (rtc_cfg.magic != CACHE_MAGIC || rtc_cfg.crc != cacheCrc()) {
+    loadFromNvs();
+  }
+
+  if (rtc_cfg.staged) {
+    applyStaged();
+  }
+
+  Serial.printf("[Config] v%u low=%.1f high=%.1f sleep=%u min broker=%s:%u%s\n",
+                SCHEMA_VERSION, rtc_cfg.active.lowC, rtc_cfg.active.highC,
+                rtc_cfg.active.sleepMinutes, rtc_cfg.active.mqttHost,
+                rtc_cfg.active.mqttPort, rtc_cfg.onTrial ? " (on trial)" : "");
+}
+
+const ConfigStore::Config& ConfigStore::get() {
+  return rtc_cfg.active;
+}
+
+// ============================
+// Public: stage()
+// ============================
+const char* ConfigStore::stage(const char* assignment) {
+  const char* eq = strchr(assignment, '=');
+  if (eq == nullptr || eq == assignment || eq[1] == '\0') {
+    return "expected key=value";
+  }
+  size_t keyLen = eq - assignment;
+  const char* value = eq + 1;
+
+  // Stack on top of an earlier staged change
+  Config cfg = rtc_cfg.active;
+  if (rtc_cfg.staged) {
+    Preferences prefs;
+    if (prefs.begin(PREFS_NAMESPACE, true)) {
+      if (prefs.getBytesLength(KEY_STAGED) == sizeof(Config)) {
+        prefs.getBytes(KEY_STAGED, &cfg, sizeof(cfg));
+      }
+      prefs.end();
+    }
+  }
+
+  char* end = nullptr;
+  if (keyLen == 5 && strncmp(assignment, "low_c", keyLen) == 0) {
+    cfg.lowC = strtof(value, &end);
+  } else if (keyLen == 6 && strncmp(assignment, "high_c", keyLen) == 0) {
+    cfg.highC = strtof(value, &end);
+  } else if (keyLen == 9 && strncmp(assignment, "sleep_min", keyLen) == 0) {
+    unsigned long v = strtoul(value, &end, 10);
+    if (v == 0 || v > SLEEP_MAX_MINUTES) {
+      return "sleep_min out of range";
+    }
+    cfg.sleepMinutes = (uint16_t)v;
+  } else if (keyLen == 9 && strncmp(assignment, "mqtt_port", keyLen) == 0) {
+    unsigned long v = strtoul(value, &end, 10);
+    if (v == 0 || v > 65535) {
+      return "mqtt_port out of range";
+    }
+    cfg.mqttPort = (uint16_t)v;
+  } else if (keyLen == 9 && strncmp(assignment, "mqtt_host", keyLen) == 0) {
+    if (strlen(value) >= sizeof(cfg.mqttHost)) {
+      return "mqtt_host too long";
+    }
+    strncpy(cfg.mqttHost, value, sizeof(cfg.mqttHost));
+    end = (char*)value + strlen(value);
+  } else {
+    return "unknown key";
+  }
+
+  if (end == nullptr || end == value || *end != '\0') {
+    return "invalid value";
+  }
+
+  const char* err = validate(cfg);
+  if (err != nullptr) {
+    return err;
+  }
+
+  if (!persist(KEY_STAGED, cfg)) {
+    return "store failed";
+  }
+  rtc_cfg.staged = 1;
+  sealCache();
+
+  Serial.printf("[Config] Staged %s (applied on next wake)\n", assignment);
+  return nullptr;
+}
+
+// ============================
+// Public: setMode()
+// ============================
+bool ConfigStore::setMode(uint8_t mode) {
+  Config cfg = rtc_cfg.active;
+  cfg.mode = mode;
+  if (!persist(KEY_ACTIVE, cfg)) {
+    return false;
+  }
+  rtc_cfg.active.mode = mode;
+  sealCache();
+  return true;
+}
+
+// ============================
+// Public: reportConnect()
+// ============================
+void ConfigStore::reportConnect(bool connected) {
+  if (!rtc_cfg.onTrial) {
+    return;
+  }
+
+  if (connected) {
+    Preferences prefs;
+    if (prefs.begin(PREFS_NAMESPACE, false)) {
+      prefs.remove(KEY_PREVIOUS);
+      prefs.end();
+    }
+    rtc_cfg.onTrial = 0;
+    rtc_cfg.failedConnects = 0;
+    sealCache();
+    Serial.println("[Config] Broker change confirmed");
+    return;
+  }
+
+  rtc_cfg.failedConnects++;
+  if (rtc_cfg.failedConnects < CONFIG_TRIAL_CONNECTS) {
+    sealCache();
+    return;
+  }
+
+  // The new broker never answered: restore the previous one for the next wake
+  Config cfg = rtc_cfg.active;
+  cfg.mqttPort = rtc_cfg.previous.mqttPort;
+  memcpy(cfg.mqttHost, rtc_cfg.previous.mqttHost, sizeof(cfg.mqttHost));
+  persist(KEY_ACTIVE, cfg);
+
+  Preferences prefs;
+  if (prefs.begin(PREFS_NAMESPACE, false)) {
+    prefs.remove(KEY_PREVIOUS);
+    prefs.end();
+  }
+
+  rtc_cfg.active = cfg;
+  rtc_cfg.onTrial = 0;
+  rtc_cfg.failedConnects = 0;
+  sealCache();
+  Serial.printf("[Config] Broker change failed %u connects, rolled back to %s:%u\n",
+                CONFIG_TRIAL_CONNECTS, cfg.mqttHost, cfg.mqttPort);
+}
+
+bool ConfigStore::hasStaged() {
+  return rtc_cfg.staged != 0;
+}
+
+int ConfigStore::formatJson(char* buf, size_t len) {
+  const Config& c = rtc_cfg.active;
+  int n = snprintf(buf, len,
+                   "{\"ver\":%u,\"low_c\":%.1f,\"high_c\":%.1f,\"sleep_min\":%u,"
+                   "\"mqtt_host\":\"%s\",\"mqtt_port\":%u,\"staged\":%d,\"trial\":%d}",
+                   SCHEMA_VERSION, c.lowC, c.highC, c.sleepMinutes,
+                   c.mqttHost, c.mqttPort, rtc_cfg.staged ? 1 : 0, rtc_cfg.onTrial ? 1 : 0);
+  return (n < 0 || n >= (int)len) ? 0 : n;
+}
+
+// ============================
+// Public: schema
+// ============================
+void ConfigStore::migrate(uint16_t from, uint8_t legacyMode, Config& cfg) {
+  switch (from) {
+  case 0:
+    // v0 -> v1: everything from config_common.h, mode from RuntimeMode's key
+    cfg = defaults();
+    cfg.mode = legacyMode;
+    // fall through
+  default:
+    break;
+  }
+}
+
+ConfigStore::Config ConfigStore::defaults() {
+  Config cfg;
+  memset(&cfg, 0, sizeof(cfg));
+  cfg.lowC = DEFAULT_TEMP_LOW_C;
+  cfg.highC = DEFAULT_TEMP_HIGH_C;
+  cfg.sleepMinutes = DEFAULT_SLEEP_MINUTES;
+  cfg.mqttPort = MQTT_PORT;
+  cfg.mode = 0;
+  strncpy(cfg.mqttHost, MQTT_HOST, sizeof(cfg.mqttHost) - 1);
+  return cfg;
+}
+
+const char* ConfigStore::validate(const Config& cfg) {
+  if (!(cfg.lowC >= TEMP_MIN_C && cfg.lowC <= TEMP_MAX_C) ||
+      !(cfg.highC >= TEMP_MIN_C && cfg.highC <= TEMP_MAX_C)) {
+    return "threshold out of range";
+  }
+  if (cfg.lowC >= cfg.highC) {
+    return "low_c must be below high_c";
+  }
+  if (cfg.sleepMinutes == 0 || cfg.sleepMinutes > SLEEP_MAX_MINUTES) {
+    return "sleep_min out of range";
+  }
+  if (cfg.mqttPort == 0) {
+    return "mqtt_port out of range";
+  }
+  if (cfg.mqttHost[0] == '\0' || memchr(cfg.mqttHost, '\0', sizeof(cfg.mqttHost)) == nullptr) {
+    return "invalid mqtt_host";
+  }
+  if (cfg.mode > 1) {
+    return "invalid mode";
+  }
+  return nullptr;
+}
+
+// ============================
+// Private
+// ============================
+void ConfigStore::loadFromNvs() {
+  memset(&rtc_cfg, 0, sizeof(rtc_cfg));
+  rtc_cfg.magic = CACHE_MAGIC;
+
+  Config cfg = defaults();
+  uint16_t version = 0;
+
+  Preferences prefs;
+  if (prefs.begin(PREFS_NAMESPACE, true)) {
+    version = prefs.getUShort(KEY_VERSION, 0);
+    if (version >= 1 && version <= SCHEMA_VERSION) {
+      readBlob(prefs, KEY_ACTIVE, cfg);
+    }
+    rtc_cfg.previous = defaults();
+    if (version <= SCHEMA_VERSION && readBlob(prefs, KEY_PREVIOUS, rtc_cfg.previous)) {
+      rtc_cfg.onTrial = 1;
+    }
+    rtc_cfg.staged = prefs.isKey(KEY_STAGED) ? 1 : 0;
+    prefs.end();
+  }
+
+  if (version > SCHEMA_VERSION) {
+    // Written by newer firmware (downgrade): run on defaults, keep NVS as is
+    Serial.printf("[Config] NVS schema v%u is newer than v%u, using defaults\n",
+                  version, SCHEMA_VERSION);
+    cfg = defaults();
+  } else if (version < SCHEMA_VERSION) {
+    uint8_t legacyMode = 0;
+    if (version == 0 && prefs.begin(LEGACY_NAMESPACE, false)) {
+      legacyMode = prefs.getUChar(LEGACY_KEY_MODE, 0);
+      prefs.remove(LEGACY_KEY_MODE);
+      prefs.end();
+    }
+
+    migrate(version, legacyMode, cfg);
+    if (persist(KEY_ACTIVE, cfg)) {
+      Serial.printf("[Config] Migrated NVS schema v%u -> v%u\n", version, SCHEMA_VERSION);
+    }
+  }
+
+  const char* err = validate(cfg);
+  if (err != nullptr) {
+    Serial.printf("[Config] Stored config invalid (%s), using defaults\n", err);
+    cfg = defaults();
+  }
+
+  rtc_cfg.active = cfg;
+  sealCache();
+}
+
+void ConfigStore::applyStaged() {
+  Config cfg;
+  bool loaded = false;
+
+  Preferences prefs;
+  if (prefs.begin(PREFS_NAMESPACE, false)) {
+    if (prefs.getBytesLength(KEY_STAGED) == sizeof(Config)) {
+      loaded = prefs.getBytes(KEY_STAGED, &cfg, sizeof(cfg)) == sizeof(cfg);
+    }
+    prefs.remove(KEY_STAGED);
+    prefs.end();
+  }
+  rtc_cfg.staged = 0;
+
+  // The mode is stored immediately and may have changed since staging
+  cfg.mode = rtc_cfg.active.mode;
+
+  const char* err = loaded ? validate(cfg) : "unreadable";
+  if (err != nullptr) {
+    Serial.printf("[Config] Staged change rejected (%s), keeping current config\n", err);
+    sealCache();
+    return;
+  }
+
+  // A broker change stays on trial until the next successful connect
+  bool brokerChanged = cfg.mqttPort != rtc_cfg.active.mqttPort ||
+                       strcmp(cfg.mqttHost, rtc_cfg.active.mqttHost) != 0;
+  if (brokerChanged && !rtc_cfg.onTrial) {
+    rtc_cfg.previous = rtc_cfg.active;
+    persist(KEY_PREVIOUS, rtc_cfg.previous);
+    rtc_cfg.onTrial = 1;
+    rtc_cfg.failedConnects = 0;
+  }
+
+  if (!persist(KEY_ACTIVE, cfg)) {
+    Serial.println("[Config] Error: NVS write failed, keeping current config");
+    sealCache();
+    return;
+  }
+
+  rtc_cfg.active = cfg;
+  sealCache();
+  Serial.println("[Config] Staged change applied");
+}
+
+bool ConfigStore::persist(const char* key, const Config& cfg) {
+  Preferences prefs;
+  if (!prefs.begin(PREFS_NAMESPACE, false)) {
+    Serial.println("[Config] Error: NVS open failed");
+    return false;
+  }
+
+  bool ok = prefs.putBytes(key, &cfg, sizeof(cfg)) == sizeof(cfg);
+  if (ok && strcmp(key, KEY_ACTIVE) == 0) {
+    ok = prefs.putUShort(KEY_VERSION, SCHEMA_VERSION) == sizeof(uint16_t);
+  }
+  prefs.end();
+  return ok;
+}
+
+void ConfigStore::sealCache() {
+  rtc_cfg.crc = cacheCrc();
+}
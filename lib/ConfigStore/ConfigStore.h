@@ -0,0 +1,110 @@
+#pragma once
+
+#include <Arduino.h>
+
+/**
+ * @class ConfigStore
+ * @brief Versioned runtime configuration in NVS with an RTC-memory cache.
+ *
+ * The compile-time values in config_common.h are only the defaults. The
+ * active configuration is a typed struct:
+ * - stored in NVS (namespace "config") together with its schema version
+ * - loaded into RTC memory (CRC-checked) on cold boot; timer wakes use the
+ *   cache and do not touch NVS/flash
+ *
+ * Changes from MQTT ("set key=value") are validated and staged in NVS, then
+ * applied as a whole at the start of the next wake. A change of the broker
+ * host or port is on trial until the next MQTT connect: after
+ * CONFIG_TRIAL_CONNECTS failed connects the previous broker is restored.
+ * The power mode is the exception and is stored immediately (see RuntimeMode).
+ *
+ * Older NVS layouts are upgraded by migrate(), a pure function of the stored
+ * version and the legacy values. Since v1 the blob of an older version is
+ * read as a prefix of Config (its length is stored with it) before
+ * migrate() fills in the fields added since.
+ */
+class ConfigStore {
+public:
+  static const uint16_t SCHEMA_VERSION = 1;
+
+  // Schema v1 (NVS blob layout: only append fields, bump SCHEMA_VERSION)
+  struct Config {
+    float lowC;              // alarm below (°C)
+    float highC;             // alarm above (°C)
+    uint16_t sleepMinutes;   // wake interval before load shedding
+    uint16_t mqttPort;
+    uint8_t mode;            // RuntimeMode::Mode
+    uint8_t reserved[3];
+    char mqttHost[64];
+  };
+
+  /**
+   * @brief Make the configuration available (call early in setup()).
+   *
+   * Cold boot: load from NVS (migrating older versions). Any wake: apply a
+   * staged change.
+   */
+  static void begin();
+
+  /**
+   * @brief Active configuration (RTC cache).
+   */
+  static const Config& get();
+
+  /**
+   * @brief Validate and stage one "key=value" change for the next wake.
+   *
+   * Keys: low_c, high_c, sleep_min, mqtt_host, mqtt_port.
+   *
+   * @return nullptr if staged, else the reason for rejecting it
+   */
+  static const char* stage(const char* assignment);
+
+  /**
+   * @brief Store the power mode immediately (NVS + cache).
+   */
+  static bool setMode(uint8_t mode);
+
+  /**
+   * @brief Report the outcome of an MQTT connect attempt on this wake
+   *        (confirms or eventually rolls back a broker change). Report a
+   *        failure only if WiFi was up, so AP outages do not count.
+   */
+  static void reportConnect(bool connected);
+
+  /**
+   * @brief True while a change waits for the next wake.
+   */
+  static bool hasStaged();
+
+  /**
+   * @brief Active values as JSON for the "config" command response.
+   *
+   * @return Number of characters written
+   */
+  static int formatJson(char* buf, size_t len);
+
+  /**
+   * @brief Upgrade a configuration read from schema version `from`
+   *        (0 = before ConfigStore: only the RuntimeMode key existed).
+   *
+   * Pure: cfg holds the defaults (or the stored blob) on entry.
+   */
+  static void migrate(uint16_t from, uint8_t legacyMode, Config& cfg);
+
+  /**
+   * @brief Defaults from config_common.h.
+   */
+  static Config defaults();
+
+  /**
+   * @brief Range and consistency checks for a whole configuration.
+   */
+  static const char* validate(const Config& cfg);
+
+private:
+  static void loadFromNvs();
+  static void applyStaged();
+  static bool persist(const char* key, const Config& cfg);
+  static void sealCache();
+};
@@ -0,0 +1,118 @@
+#include "ConnectPolicy.h"
+#include <stdio.h>
+#include <config_common.h>
+
+static const uint8_t MAX_FAILURES = 16;   // keeps the backoff shift in range
+
+// ============================
+// Public: backoff
+// ============================
+bool ConnectPolicy::attempt(State& state) {
+  if (state.skipsLeft == 0) {
+    return true;
+  }
+  state.skipsLeft--;
+  if (state.offlineWakes < UINT16_MAX) {
+    state.offlineWakes++;
+  }
+  return false;
+}
+
+bool ConnectPolicy::backingOff(const State& state) {
+  return state.skipsLeft > 0;
+}
+
+void ConnectPolicy::report(State& state, bool connected) {
+  if (connected) {
+    if (state.failures > 0) {
+      state.lastOutageWakes = state.offlineWakes;
+    }
+    state.failures = 0;
+    state.skipsLeft = 0;
+    state.offlineWakes = 0;
+    return;
+  }
+
+  if (state.failures < MAX_FAILURES) {
+    state.failures++;
+  }
+  if (state.offlineWakes < UINT16_MAX) {
+    state.offlineWakes++;
+  }
+
+  // First failure: retry on the next wake (without deadlines); then 1, 2, 4, ...
+  uint32_t skips = state.failures >= 2 ? (1UL << (state.failures - 2)) : 0;
+  state.skipsLeft = (uint8_t)(skips < CONNECT_BACKOFF_MAX_SKIPS ? skips : CONNECT_BACKOFF_MAX_SKIPS);
+}
+
+// ============================
+// Public: deadlines
+// ============================
+void ConnectPolicy::recordWifi(State& state, uint32_t elapsedMs) {
+  record(state.wifiHist, elapsedMs);
+}
+
+void ConnectPolicy::recordMqtt(State& state, uint32_t elapsedMs) {
+  record(state.mqttHist, elapsedMs);
+}
+
+ConnectPolicy::Deadlines ConnectPolicy::deadlines(const State& state) {
+  Deadlines d;
+  if (state.failures > 0) {
+    d.wifiMs = 0;
+    d.mqttMs = 0;
+    return d;
+  }
+  d.wifiMs = deadlineFor(state.wifiHist);
+  d.mqttMs = deadlineFor(state.mqttHist);
+  return d;
+}
+
+int ConnectPolicy::formatStatusFields(const State& state, char* buf, size_t len) {
+  Deadlines d = deadlines(state);
+  return snprintf(buf, len, "\"conn\":{\"wifi_dl\":%lu,\"mqtt_dl\":%lu,\"outage\":%u}",
+                  (unsigned long)d.wifiMs, (unsigned long)d.mqttMs, state.lastOutageWakes);
+}
+
+// ============================
+// Private: histograms
+// ============================
+void ConnectPolicy::record(uint16_t* hist, uint32_t elapsedMs) {
+  uint8_t bucket = 0;
+  while (bucket < LATENCY_BUCKETS - 1 && (elapsedMs >> (bucket + 1)) != 0) {
+    bucket++;
+  }
+
+  // Halve all buckets before one saturates: keeps the shape, favours recent wakes
+  if (hist[bucket] == UINT16_MAX) {
+    for (uint8_t i = 0; i < LATENCY_BUCKETS; i++) {
+      hist[i] >>= 1;
+    }
+  }
+  hist[bucket]++;
+}
+
+uint32_t ConnectPolicy::deadlineFor(const uint16_t* hist) {
+  uint32_t total = 0;
+  for (uint8_t i = 0; i < LATENCY_BUCKETS; i++) {
+    total += hist[i];
+  }
+  if (total < CONNECT_LEARN_MIN_SAMPLES) {
+    return 0;
+  }
+
+  // Upper bound of the smallest bucket whose cumulative count reaches the percentile
+  uint32_t target = (total * CONNECT_DEADLINE_PERCENT + 99) / 100;
+  uint32_t cumulative = 0;
+  uint32_t bound = 1UL << LATENCY_BUCKETS;
+  for (uint8_t i = 0; i < LATENCY_BUCKETS; i++) {
+    cumulative += hist[i];
+    if (cumulative >= target) {
+      bound = 1UL << (i + 1);
+      break;
+    }
+  }
+
+  uint32_t deadline = bound + CONNECT_DEADLINE_MARGIN_MS;
+  return deadline > CONNECT_DEADLINE_MIN_MS ? deadline : CONNECT_DEADLINE_MIN_MS;
+}
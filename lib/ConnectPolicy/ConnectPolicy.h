@@ -0,0 +1,90 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * @class ConnectPolicy
+ * @brief Cross-wake connect backoff and learned connect deadlines (pure
+ *        logic, no hardware).
+ *
+ * Backoff: after a wake fails to reach the broker, the next wake retries
+ * with the full timeout. Each further failure doubles the number of wakes
+ * that skip the radio (1, 2, 4, ... up to CONNECT_BACKOFF_MAX_SKIPS).
+ * Readings are still taken and kept in ReadingHistory on skipped wakes.
+ * They are replayed on the next uplink. Alarms are not subject to backoff
+ * (the caller connects for them regardless).
+ *
+ * Deadlines: WiFi association (radio start to IP) and MQTT connect (IP to
+ * CONNACK) times of successful connects go into log2 histograms (bucket i =
+ * [2^i, 2^(i+1)) ms, as in TrafficStats). Once a phase has
+ * CONNECT_LEARN_MIN_SAMPLES samples, its deadline is the upper bound of its
+ * CONNECT_DEADLINE_PERCENT percentile bucket plus CONNECT_DEADLINE_MARGIN_MS.
+ * A wake that is past the deadline gives up instead of spending the whole
+ * flat timeout. The wake after a failure uses no deadlines, so one slow
+ * connect does not start a backoff.
+ *
+ * State is a POD kept by the caller (in RTC memory); all zeros is a valid
+ * initial state.
+ */
+class ConnectPolicy {
+public:
+  static const uint8_t LATENCY_BUCKETS = 16;   // up to 65 s
+
+  struct State {
+    uint8_t failures;                      // consecutive failed connects
+    uint8_t skipsLeft;                     // wakes left without radio
+    uint16_t offlineWakes;                 // wakes without uplink in the current outage
+    uint16_t lastOutageWakes;              // same, for the last outage that ended
+    uint16_t wifiHist[LATENCY_BUCKETS];    // association times
+    uint16_t mqttHist[LATENCY_BUCKETS];    // CONNACK times
+  };
+
+  struct Deadlines {
+    uint32_t wifiMs;   // 0 = none (only the caller's overall timeout)
+    uint32_t mqttMs;
+  };
+
+  /**
+   * @brief Whether this wake may use the radio. A false return uses up one
+   *        backoff wake.
+   */
+  static bool attempt(State& state);
+
+  /**
+   * @brief True while wakes are being skipped (does not change the state).
+   */
+  static bool backingOff(const State& state);
+
+  /**
+   * @brief Result of a connect attempt (starts, extends or ends the backoff).
+   */
+  static void report(State& state, bool connected);
+
+  /**
+   * @brief Record the time from radio start to WiFi connected.
+   */
+  static void recordWifi(State& state, uint32_t elapsedMs);
+
+  /**
+   * @brief Record the time from WiFi connected to MQTT connected.
+   */
+  static void recordMqtt(State& state, uint32_t elapsedMs);
+
+  /**
+   * @brief Per-phase deadlines for this wake.
+   */
+  static Deadlines deadlines(const State& state);
+
+  /**
+   * @brief Format status payload fields (no surrounding braces):
+   *        "conn":{"wifi_dl":2548,"mqtt_dl":1524,"outage":12}
+   *
+   * @return Number of characters written
+   */
+  static int formatStatusFields(const State& state, char* buf, size_t len);
+
+private:
+  static void record(uint16_t* hist, uint32_t elapsedMs);
+  static uint32_t deadlineFor(const uint16_t* hist);
+};
@@ -1,5 +1,14 @@
 #include "ConnectionManager.h"
 #include <Comms.h>
+#include <HistoryReplay.h>
+#include <OtaUpdater.h>
+#include <RuntimeMode.h>
+#include <ConfigStore.h>
+#include <HealthCounters.h>
+#include <TrafficStats.h>
+#include <WakeTrace.h>
+#include <profile.h>
+#include <lwip/sockets.h>
 
 // Singleton instance
 ConnectionManager* ConnectionManager::instance = nullptr;
@@ -14,14 +23,21 @@ void mqttMessageCallback(char* topic, byte* payload, unsigned int length) {
 // ============================
 // Constructor
 // ============================
+#ifdef ENABLE_MQTT_TLS
+ConnectionManager::ConnectionManager() 
+  : tlsClient(espClient), mqttClient(tlsClient) {
+  tlsClient.setCACert(MQTT_CA_CERT);
+#else
 ConnectionManager::ConnectionManager() 
   : mqttClient(espClient) {
-  // Initialize MQTT client with broker details
-  mqttClient.setServer(MQTT_HOST, MQTT_PORT);
+#endif
+  mqttClient.setBufferSize(MQTT_BUFFER_SIZE);
   
   // Initialize LED pin
-  pinMode(LED_PIN, OUTPUT);
-  digitalWrite(LED_PIN, LOW);
+  if constexpr (Profile::ledCommands) {
+    pinMode(LED_PIN, OUTPUT);
+    digitalWrite(LED_PIN, LOW);
+  }
   ledState = false;
 }
 
@@ -34,7 +50,22 @@ void ConnectionManager::begin() {
   Serial.println("\n[CM] ConnectionManager initialized");
   
   instance = this;  // Set singleton instance
+
+  // Broker from the runtime configuration (string lives in RTC memory)
+  const ConfigStore::Config& cfg = ConfigStore::get();
+  mqttClient.setServer(cfg.mqttHost, cfg.mqttPort);
   mqttClient.setCallback(mqttMessageCallback);  // Set MQTT message callback
+
+  // Client ID from the factory MAC: stable across wakes, so the broker can
+  // keep the session (and queued commands) for this node
+  uint64_t mac = ESP.getEfuseMac();
+  snprintf(clientId, sizeof(clientId), "%s-%04X%08X",
+           DEVICE_NAME, (unsigned)(uint16_t)(mac >> 32), (unsigned)(uint32_t)mac);
+  Serial.printf("[CM] MQTT client ID: %s\n", clientId);
+
+#ifdef ENABLE_MQTTSN
+  snClient.begin(clientId, mqttMessageCallback);
+#endif
   
   setupWiFi();
 }
@@ -52,17 +83,49 @@ void ConnectionManager::loop() {
     }
   }
 
+  // Time to WiFi up on this wake (recorded once)
+  if (wifiConnected()) {
+    WakeTrace::linkUp(WakeTrace::Link::Wifi);
+  }
+
+#ifdef ENABLE_MQTTSN
+  // MQTT-SN is connectionless: only the gateway address is needed
+  if (snClient.ready()) {
+    WakeTrace::linkUp(WakeTrace::Link::Mqtt);
+  }
+  if (wifiConnected() && !snClient.ready()) {
+    unsigned long now = millis();
+    if (!mqttAttempted || now - lastMqttAttempt >= MQTT_RETRY_INTERVAL) {
+      mqttAttempted = true;
+      lastMqttAttempt = now;
+      snClient.resolveGateway();
+    }
+  }
+  return;
+#endif
+
   // Handle MQTT (only if WiFi is connected)
   if (wifiConnected()) {
     if (!mqttClient.connected()) {
       unsigned long now = millis();
-      if (now - lastMqttAttempt >= MQTT_RETRY_INTERVAL) {
+      if (!mqttAttempted || now - lastMqttAttempt >= MQTT_RETRY_INTERVAL) {
+        mqttAttempted = true;
         lastMqttAttempt = now;
         reconnectMqtt();
       }
     } else {
       // Service MQTT client (handle incoming messages, keep-alive)
       mqttClient.loop();
+
+      // Stream any pending history replay chunks
+      if (historyPtr && historyPtr->active()) {
+        historyPtr->loop();
+      }
+
+      // Request the next firmware chunk
+      if (otaPtr && otaPtr->active()) {
+        otaPtr->loop();
+      }
     }
   }
 }
@@ -78,7 +141,11 @@ bool ConnectionManager::wifiConnected() const {
 // Public: mqttConnected()
 // ============================
 bool ConnectionManager::mqttConnected() {
+#ifdef ENABLE_MQTTSN
+  return wifiConnected() && snClient.ready();
+#else
   return mqttClient.connected();
+#endif
 }
 
 // ============================
@@ -101,6 +168,79 @@ bool ConnectionManager::mqttJustConnected() {
   return justConnected;
 }
 
+// ============================
+// Public: drainMailbox()
+// ============================
+uint16_t ConnectionManager::drainMailbox(uint32_t maxMs, uint32_t quietMs) {
+  uint16_t startCount = commandCount;
+  uint32_t startMs = millis();
+
+#ifdef ENABLE_MQTTSN
+  // Gateway delivers everything it buffered before PINGRESP
+  (void)quietMs;
+  snClient.checkMailbox(maxMs);
+#else
+  uint16_t lastCount = commandCount;
+  uint32_t lastActivityMs = startMs;
+
+  while (mqttClient.connected() && millis() - startMs < maxMs) {
+    mqttClient.loop();
+
+    if (commandCount != lastCount) {
+      lastCount = commandCount;
+      lastActivityMs = millis();
+    } else if (millis() - lastActivityMs >= quietMs) {
+      break;
+    }
+    delay(1);
+  }
+#endif
+
+  uint16_t drained = commandCount - startCount;
+  Serial.printf("[CM] Mailbox drained: %u command(s) in %lu ms\n",
+                drained, (unsigned long)(millis() - startMs));
+  return drained;
+}
+
+// ============================
+// Public: getCommandCount()
+// ============================
+uint16_t ConnectionManager::getCommandCount() const {
+  return commandCount;
+}
+
+// ============================
+// Public: waitForTraffic()
+// ============================
+bool ConnectionManager::waitForTraffic(uint32_t timeoutMs) {
+  // Bytes already buffered by WiFiClient never show up in select()
+  if (espClient.connected() && espClient.available() > 0) {
+    return true;
+  }
+#ifdef ENABLE_MQTT_TLS
+  // Nor do records mbedTLS has already decrypted
+  if (tlsClient.available() > 0) {
+    return true;
+  }
+#endif
+
+  int fd = espClient.fd();
+  if (!mqttClient.connected() || fd < 0) {
+    delay(timeoutMs);
+    return false;
+  }
+
+  fd_set readSet;
+  FD_ZERO(&readSet);
+  FD_SET(fd, &readSet);
+
+  struct timeval tv;
+  tv.tv_sec = timeoutMs / 1000;
+  tv.tv_usec = (timeoutMs % 1000) * 1000;
+
+  return select(fd + 1, &readSet, nullptr, nullptr, &tv) > 0;
+}
+
 // ============================
 // Public: publish()
 // ============================
@@ -161,57 +301,43 @@ void ConnectionManager::reconnectMqtt() {
     return;
   }
 
-  Serial.print("[CM] Attempting MQTT connection to ");
-  Serial.println(MQTT_HOST);
+  Serial.printf("[CM] Attempting MQTT connection to %s:%u\n",
+                ConfigStore::get().mqttHost, ConfigStore::get().mqttPort);
 
-  // Construct client ID
-  String clientId = DEVICE_NAME;
-  clientId += "-";
-  clientId += random(0xffff);
-
-  // Attempt connection with credentials and LWT
-  bool connected = false;
-  
   // Use LWT to publish offline/online state
   // When device disconnects, broker will publish "offline" to the LWT topic
   const char* lwt_topic = MQTT_TOPIC_STATUS;
   const char* lwt_payload = "offline";
-  
+
+  // Credentials are optional
+  const char* user = nullptr;
+  const char* pass = nullptr;
   #ifdef MQTT_USERNAME
     if (strlen(MQTT_USERNAME) > 0) {
-      connected = mqttClient.connect(
-        clientId.c_str(),
-        MQTT_USERNAME,
-        MQTT_PASSWORD,
-        lwt_topic,
-        0,  // QoS
-        true,  // retain
-        lwt_payload
-      );
-    } else {
-      connected = mqttClient.connect(
-        clientId.c_str(),
-        lwt_topic,
-        0,  // QoS
-        true,  // retain
-        lwt_payload
-      );
+      user = MQTT_USERNAME;
+      pass = MQTT_PASSWORD;
     }
-  #else
-    connected = mqttClient.connect(
-      clientId.c_str(),
-      lwt_topic,
-      0,  // QoS
-      true,  // retain
-      lwt_payload
-    );
   #endif
 
+  // Attempt connection with credentials and LWT
+  bool connected = mqttClient.connect(
+    clientId,
+    user,
+    pass,
+    lwt_topic,
+    0,  // QoS
+    true,  // retain
+    lwt_payload,
+    !MQTT_PERSISTENT_SESSION  // cleanSession
+  );
+
   if (connected) {
     onMqttConnect();
   } else {
     Serial.print("[CM] MQTT connection failed, rc=");
     Serial.println(mqttClient.state());
+    HealthCounters::increment(HealthCounters::Counter::MqttConnectFail);
+    HealthCounters::set(HealthCounters::Gauge::MqttRc, mqttClient.state());
   }
 }
 
@@ -220,14 +346,26 @@ void ConnectionManager::reconnectMqtt() {
 // ============================
 void ConnectionManager::onMqttConnect() {
   Serial.println("[CM] MQTT connected!");
+
+  // millis() restarts on every wake: this is the wake-to-connected latency
+  TrafficStats::recordConnect(millis());
+  WakeTrace::linkUp(WakeTrace::Link::Mqtt);
+  HealthCounters::set(HealthCounters::Gauge::WifiRssi, WiFi.RSSI());
   
   // Publish "online" status to indicate successful connection
   // (overrides the LWT "offline" message set at connection time)
-  mqttClient.publish(MQTT_TOPIC_STATUS, "online", true);
+  if (mqttClient.publish(MQTT_TOPIC_STATUS, "online", true)) {
+    TrafficStats::countPublish(MQTT_TOPIC_STATUS, strlen("online"));
+  }
   
-  // Subscribe to command topic
-  mqttClient.subscribe(MQTT_TOPIC_CMD);
+  // Subscribe to command topic (QoS 1: queued by the broker while asleep)
+  mqttClient.subscribe(MQTT_TOPIC_CMD, MQTT_PERSISTENT_SESSION ? 1 : 0);
   Serial.printf("[CM] Subscribed to: %s\n", MQTT_TOPIC_CMD);
+
+  // Firmware chunks only while a transfer is running (answers are immediate)
+  if (otaPtr && otaPtr->active()) {
+    mqttClient.subscribe(MQTT_TOPIC_OTA_DATA, 0);
+  }
   
   // Boot message is now published by Comms module
 }
@@ -246,10 +384,32 @@ void ConnectionManager::setComms(Comms* comms) {
   commsPtr = comms;
 }
 
+// ============================
+// Public: setHistoryReplay()
+// ============================
+void ConnectionManager::setHistoryReplay(HistoryReplay* replay) {
+  historyPtr = replay;
+}
+
+// ============================
+// Public: setOtaUpdater()
+// ============================
+void ConnectionManager::setOtaUpdater(OtaUpdater* ota) {
+  otaPtr = ota;
+}
+
 // ============================
 // Private: handleMqttMessage()
 // ============================
 void ConnectionManager::handleMqttMessage(const char* topic, byte* payload, unsigned int length) {
+  // Firmware chunks are binary: hand over as is
+  if (strcmp(topic, MQTT_TOPIC_OTA_DATA) == 0) {
+    if (otaPtr) {
+      otaPtr->onChunk(payload, length);
+    }
+    return;
+  }
+
   // Cap length to prevent overflow
   const unsigned int MAX_PAYLOAD = 256;
   unsigned int safeLength = (length > MAX_PAYLOAD) ? MAX_PAYLOAD : length;
@@ -269,6 +429,8 @@ void ConnectionManager::handleMqttMessage(const char* topic, byte* payload, unsi
   }
   
   Serial.printf("[CM] Received message on %s: %s\n", topic, cmdStr);
+  commandCount++;
+  WakeTrace::command(cmdStr);
   
   // Handle the command
   handleCommand(cmdStr);
@@ -279,6 +441,12 @@ PubSubClient* ConnectionManager::getMqttClient() {
   return &mqttClient;
 }
 
+#ifdef ENABLE_MQTTSN
+MqttSnClient* ConnectionManager::getSnClient() {
+  return &snClient;
+}
+#endif
+
 
 // ============================
 // Private: handleCommand()
@@ -299,35 +467,183 @@ void ConnectionManager::handleCommand(const char* cmdStr) {
     return;
   }
   
-  // Command: "led=on"
+  // Command: "led=on" / "led=off" / "led=toggle" (profiles with an LED only)
+  if constexpr (Profile::ledCommands) {
+    if (handleLedCommand(cmdStr)) {
+      return;
+    }
+  }
+  
+  // Command: "mode=battery" / "mode=continuous" -> persisted power mode
+  if (strcmp(cmdStr, "mode=battery") == 0 || strcmp(cmdStr, "mode=continuous") == 0) {
+    RuntimeMode::Mode mode = (strcmp(cmdStr, "mode=continuous") == 0)
+      ? RuntimeMode::Mode::Continuous
+      : RuntimeMode::Mode::Battery;
+    bool ok = RuntimeMode::set(mode);
+    if (commsPtr) {
+      commsPtr->publishResp(ok ? (mode == RuntimeMode::Mode::Continuous ? "mode: continuous" : "mode: battery")
+                               : "mode: store failed");
+    }
+    return;
+  }
+
+  // Command: "set <key>=<value>" -> staged, applied on the next wake
+  if (strncmp(cmdStr, "set ", 4) == 0) {
+    const char* err = ConfigStore::stage(cmdStr + 4);
+    if (commsPtr) {
+      char resp[96];
+      snprintf(resp, sizeof(resp), "set: %s", err ? err : "staged for next wake");
+      commsPtr->publishResp(resp);
+    }
+    return;
+  }
+
+  // Command: "config" -> active runtime configuration as JSON
+  if (strcmp(cmdStr, "config") == 0 || strcmp(cmdStr, "get_config") == 0) {
+    if (commsPtr) {
+      char resp[192];
+      if (ConfigStore::formatJson(resp, sizeof(resp)) > 0) {
+        commsPtr->publishResp(resp);
+      }
+    }
+    return;
+  }
+
+  // Command: "ota size=<bytes> crc=<crc32 hex>" / "ota abort" -> firmware update
+  if (strncmp(cmdStr, "ota", 3) == 0 && (cmdStr[3] == ' ' || cmdStr[3] == '\0')) {
+    if (otaPtr == nullptr) {
+      if (commsPtr) commsPtr->publishResp("ota: rejected");
+      return;
+    }
+
+    if (strcmp(cmdStr, "ota abort") == 0) {
+      otaPtr->abort();
+      if (commsPtr) commsPtr->publishResp("ota: aborted");
+      return;
+    }
+
+    unsigned long size = 0;
+    unsigned long crc = 0;
+    const char* p = strstr(cmdStr, "size=");
+    if (p) size = strtoul(p + 5, nullptr, 10);
+    p = strstr(cmdStr, "crc=");
+    if (p) crc = strtoul(p + 4, nullptr, 16);
+
+    const char* err = otaPtr->start((uint32_t)size, (uint32_t)crc);
+    if (err == nullptr) {
+      mqttClient.subscribe(MQTT_TOPIC_OTA_DATA, 0);
+    }
+    if (commsPtr) {
+      char resp[64];
+      snprintf(resp, sizeof(resp), "ota: %s", err ? err : "started");
+      commsPtr->publishResp(resp);
+    }
+    return;
+  }
+
+  // Command: "trace" / "trace clear" -> recorded wake inputs (ENABLE_WAKE_TRACE)
+  if (strcmp(cmdStr, "trace") == 0 || strcmp(cmdStr, "trace clear") == 0) {
+    if (commsPtr == nullptr) {
+      return;
+    }
+#ifdef ENABLE_WAKE_TRACE
+    if (cmdStr[5] == ' ') {
+      WakeTrace::clear();
+      commsPtr->publishResp("trace: cleared");
+    } else {
+      char resp[32];
+      snprintf(resp, sizeof(resp), "trace: %u wakes", WakeTrace::publish(*commsPtr));
+      commsPtr->publishResp(resp);
+    }
+#else
+    commsPtr->publishResp("trace: not built in");
+#endif
+    return;
+  }
+
+  // Command: "health" / "health clear" -> failure counters since power-on
+  if (strcmp(cmdStr, "health") == 0 || strcmp(cmdStr, "health clear") == 0) {
+    if (commsPtr == nullptr) {
+      return;
+    }
+    if (cmdStr[6] == ' ') {
+      HealthCounters::clear();
+      commsPtr->publishResp("health: cleared");
+    } else {
+      char resp[HealthCounters::FIELDS_SIZE + 2];
+      resp[0] = '{';
+      int n = HealthCounters::formatStatusFields(resp + 1, sizeof(resp) - 2);
+      resp[n + 1] = '}';
+      resp[n + 2] = '\0';
+      commsPtr->publishResp(resp);
+    }
+    return;
+  }
+
+  // Command: "history since=<epoch> [skip=<n>] until=<epoch>" -> stream stored readings
+  if (strncmp(cmdStr, "history", 7) == 0 && (cmdStr[7] == ' ' || cmdStr[7] == '\0')) {
+#ifdef ENABLE_MQTTSN
+    // Chunks are streamed with beginPublish(), which has no datagram transport
+    Serial.printf("[CM] History command refused: %s\n", cmdStr);
+    if (commsPtr) commsPtr->publishResp("history: not available over MQTT-SN");
+    return;
+#else
+    unsigned long since = 0;
+    unsigned long until = 0xFFFFFFFFUL;
+    unsigned long skip = 0;
+
+    const char* p = strstr(cmdStr, "since=");
+    if (p) since = strtoul(p + 6, nullptr, 10);
+    p = strstr(cmdStr, "skip=");
+    if (p) skip = strtoul(p + 5, nullptr, 10);
+    p = strstr(cmdStr, "until=");
+    if (p) until = strtoul(p + 6, nullptr, 10);
+
+    if (historyPtr == nullptr || since > until || skip > 0xFFFF) {
+      Serial.printf("[CM] History command rejected: %s\n", cmdStr);
+      if (commsPtr) commsPtr->publishResp("history: rejected");
+      return;
+    }
+
+    historyPtr->start((uint32_t)since, (uint32_t)until, (uint16_t)skip);
+    if (commsPtr) commsPtr->publishResp("history: started");
+    return;
+#endif
+  }
+
+  // Unknown command - log it
+  Serial.printf("[CM] Unknown command: %s\n", cmdStr);
+  if (commsPtr) {
+    String logMsg = "[CMD] Unknown command: ";
+    logMsg += cmdStr;
+    commsPtr->publishLog(logMsg.c_str());
+  }
+}
+
+// ============================
+// Private: handleLedCommand()
+// ============================
+bool ConnectionManager::handleLedCommand(const char* cmdStr) {
   if (strcmp(cmdStr, "led=on") == 0) {
     digitalWrite(LED_PIN, HIGH);
     ledState = true;
     Serial.println("[CM] LED turned ON");
-    return;
+    return true;
   }
-  
-  // Command: "led=off"
+
   if (strcmp(cmdStr, "led=off") == 0) {
     digitalWrite(LED_PIN, LOW);
     ledState = false;
     Serial.println("[CM] LED turned OFF");
-    return;
+    return true;
   }
-  
-  // Command: "led=toggle"
+
   if (strcmp(cmdStr, "led=toggle") == 0) {
     ledState = !ledState;
     digitalWrite(LED_PIN, ledState ? HIGH : LOW);
     Serial.printf("[CM] LED toggled to %s\n", ledState ? "ON" : "OFF");
-    return;
-  }
-  
-  // Unknown command - log it
-  Serial.printf("[CM] Unknown command: %s\n", cmdStr);
-  if (commsPtr) {
-    String logMsg = "[CMD] Unknown command: ";
-    logMsg += cmdStr;
-    commsPtr->publishLog(logMsg.c_str());
+    return true;
   }
+
+  return false;
 }
@@ -3,10 +3,18 @@
 #include <Arduino.h>
 #include <WiFi.h>
 #include <PubSubClient.h>
+#ifdef ENABLE_MQTT_TLS
+#include <TlsClient.h>
+#endif
+#ifdef ENABLE_MQTTSN
+#include <MqttSnClient.h>
+#endif
 #include "../../include/config.h"
 
-// Forward declaration
+// Forward declarations
 class Comms;
+class HistoryReplay;
+class OtaUpdater;
 
 /**
  * @class ConnectionManager
@@ -23,6 +31,9 @@ public:
   ConnectionManager();
 
   PubSubClient* getMqttClient();
+#ifdef ENABLE_MQTTSN
+  MqttSnClient* getSnClient();
+#endif
 
   /**
    * @brief Set up WiFi and MQTT clients with credentials from config.h.
@@ -76,6 +87,36 @@ public:
    */
   bool mqttJustConnected();
 
+  /**
+   * @brief Handle commands the broker queued while the node was asleep.
+   * 
+   * Services the MQTT client until no command has arrived for quietMs, or
+   * maxMs has passed. With a persistent session the broker delivers queued
+   * QoS 1 commands right after CONNACK.
+   * 
+   * @param maxMs Upper bound for the whole drain phase.
+   * @param quietMs Drain ends after this long without a command.
+   * @return Number of commands handled during the drain.
+   */
+  uint16_t drainMailbox(uint32_t maxMs, uint32_t quietMs);
+
+  /**
+   * @brief Number of commands handled since boot/wake.
+   */
+  uint16_t getCommandCount() const;
+
+  /**
+   * @brief Block until MQTT data arrives or the timeout expires.
+   * 
+   * Used between scheduler jobs in continuous mode instead of a busy poll:
+   * the task sleeps in select() on the MQTT socket, so inbound commands are
+   * handled as soon as they arrive. Falls back to delay() while disconnected.
+   * 
+   * @param timeoutMs Maximum time to wait.
+   * @return true if data is ready to be read.
+   */
+  bool waitForTraffic(uint32_t timeoutMs);
+
   /**
    * @brief Publish a message to a topic.
    * 
@@ -92,6 +133,24 @@ public:
    */
   void setComms(Comms* commsPtr);
 
+  /**
+   * @brief Set HistoryReplay reference for the "history" command.
+   * 
+   * The replay is serviced from loop() while MQTT is connected.
+   * 
+   * @param replay Pointer to HistoryReplay instance.
+   */
+  void setHistoryReplay(HistoryReplay* replay);
+
+  /**
+   * @brief Set OtaUpdater reference for the "ota" command and chunk topic.
+   * 
+   * Chunk requests are sent from loop() while MQTT is connected.
+   * 
+   * @param ota Pointer to OtaUpdater instance.
+   */
+  void setOtaUpdater(OtaUpdater* ota);
+
   /**
    * @brief Get singleton instance for MQTT callbacks.
    */
@@ -108,17 +167,29 @@ public:
 
 private:
   WiFiClient espClient;
+#ifdef ENABLE_MQTT_TLS
+  TlsClient tlsClient;           // TLS over espClient
+#endif
+#ifdef ENABLE_MQTTSN
+  MqttSnClient snClient;         // Replaces the TCP session for publishes/commands
+#endif
   PubSubClient mqttClient;
   Comms* commsPtr = nullptr;
+  HistoryReplay* historyPtr = nullptr;
+  OtaUpdater* otaPtr = nullptr;
 
   bool lastWiFiConnected = false;
   bool lastMqttConnected = false;
 
   unsigned long lastWiFiAttempt = 0;
   unsigned long lastMqttAttempt = 0;
+  bool mqttAttempted = false;    // first attempt of a wake goes out as soon as WiFi is up
   const unsigned long WIFI_RETRY_INTERVAL = 5000;  // ms
   const unsigned long MQTT_RETRY_INTERVAL = 3000;  // ms
 
+  char clientId[48];             // Stable per device (DEVICE_NAME-<MAC>)
+  uint16_t commandCount = 0;
+
   static ConnectionManager* instance;
   volatile bool ledState = false;  // Track LED state for toggle
 
@@ -127,4 +198,5 @@ private:
   void reconnectMqtt();
   void onMqttConnect();
   void handleCommand(const char* cmdStr);
+  bool handleLedCommand(const char* cmdStr);
 };
@@ -0,0 +1,145 @@
+#include "EnergyModel.h"
+#include <sys/time.h>
+#include <config_common.h>
+
+static const uint8_t PHASES = (uint8_t)EnergyModel::Phase::Count;
+
+// Average current per phase (mA), indexed by Phase
+static const float PHASE_MA[PHASES] = {
+  ENERGY_MA_BOOT,
+  ENERGY_MA_SENSOR,
+  ENERGY_MA_WIFI_ASSOC,
+  ENERGY_MA_MQTT,
+  ENERGY_MA_TX,
+  ENERGY_MA_FLUSH
+};
+
+static const double MS_PER_HOUR = 3600.0 * 1000.0;
+
+// RTC memory (survives deep sleep, lost on power cycle)
+RTC_DATA_ATTR static double rtc_energy_mah = 0.0;        // Charge used since power-on
+RTC_DATA_ATTR static double rtc_energy_hours = 0.0;      // Time covered (awake + asleep)
+RTC_DATA_ATTR static int64_t rtc_sleep_start_us = 0;     // 0 = no sleep to account
+RTC_DATA_ATTR static uint32_t rtc_last_phase_ms[PHASES];
+RTC_DATA_ATTR static float rtc_last_wake_mah = 0.0f;
+
+// Current wake
+static EnergyModel::Phase currentPhase = EnergyModel::Phase::Boot;
+static uint32_t phaseStartMs = 0;
+static uint32_t phaseMs[PHASES];
+static double wakeMah = 0.0;
+
+static int64_t systemTimeUs() {
+  struct timeval tv;
+  gettimeofday(&tv, nullptr);
+  return (int64_t)tv.tv_sec * 1000000LL + tv.tv_usec;
+}
+
+// ============================
+// Public: beginWake()
+// ============================
+void EnergyModel::beginWake() {
+  // Charge the sleep that just ended
+  if (rtc_sleep_start_us > 0) {
+    int64_t sleptUs = systemTimeUs() - rtc_sleep_start_us;
+    if (sleptUs > 0) {
+      double hours = sleptUs / (MS_PER_HOUR * 1000.0);
+      rtc_energy_mah += ENERGY_MA_SLEEP * hours;
+      rtc_energy_hours += hours;
+    }
+    rtc_sleep_start_us = 0;
+  }
+
+  // millis() starts at 0 on every wake
+  currentPhase = Phase::Boot;
+  phaseStartMs = 0;
+  wakeMah = 0.0;
+  memset(phaseMs, 0, sizeof(phaseMs));
+}
+
+// ============================
+// Public: mark()
+// ============================
+void EnergyModel::mark(Phase phase) {
+  if (phase == currentPhase || phase >= Phase::Count) {
+    return;
+  }
+
+  uint32_t now = millis();
+  charge(currentPhase, now - phaseStartMs);
+  currentPhase = phase;
+  phaseStartMs = now;
+}
+
+// ============================
+// Public: endWake()
+// ============================
+void EnergyModel::endWake() {
+  charge(currentPhase, millis() - phaseStartMs);
+
+  memcpy(rtc_last_phase_ms, phaseMs, sizeof(rtc_last_phase_ms));
+  rtc_last_wake_mah = (float)wakeMah;
+  rtc_sleep_start_us = systemTimeUs();
+
+  Serial.printf("[Energy] Wake used %.4f mAh, %.2f mAh/day, %.0f days left\n",
+                wakeMah, mAhPerDay(), daysRemaining());
+}
+
+// ============================
+// Public: mAhPerDay()
+// ============================
+float EnergyModel::mAhPerDay() {
+  if (rtc_energy_hours <= 0.0) {
+    return 0.0f;
+  }
+  return (float)(rtc_energy_mah / rtc_energy_hours * 24.0);
+}
+
+// ============================
+// Public: daysRemaining()
+// ============================
+float EnergyModel::daysRemaining() {
+  float perDay = mAhPerDay();
+  if (perDay <= 0.0f) {
+    return -1.0f;
+  }
+
+  double left = BATTERY_CAPACITY_MAH - rtc_energy_mah;
+  return (left > 0.0) ? (float)(left / perDay) : 0.0f;
+}
+
+// ============================
+// Public: formatStatusFields()
+// ============================
+int EnergyModel::formatStatusFields(char* buf, size_t len) {
+  uint32_t wakeMs = 0;
+  for (uint8_t i = 0; i < PHASES; i++) {
+    wakeMs += rtc_last_phase_ms[i];
+  }
+
+  int used = snprintf(buf, len,
+                      "\"energy\":{\"wake_ms\":%lu,\"wake_mah\":%.4f,\"mah_day\":%.2f,"
+                      "\"days_left\":%.0f,\"phase_ms\":[",
+                      (unsigned long)wakeMs, rtc_last_wake_mah, mAhPerDay(), daysRemaining());
+  for (uint8_t i = 0; i < PHASES && used < (int)len; i++) {
+    used += snprintf(buf + used, len - used, "%s%lu",
+                     i > 0 ? "," : "", (unsigned long)rtc_last_phase_ms[i]);
+  }
+  if (used < (int)len) {
+    used += snprintf(buf + used, len - used, "]}");
+  }
+  return used;
+}
+
+// ============================
+// Private: charge()
+// ============================
+void EnergyModel::charge(Phase phase, uint32_t ms) {
+  uint8_t i = (uint8_t)phase;
+  double mah = PHASE_MA[i] * (ms / MS_PER_HOUR);
+
+  phaseMs[i] += ms;
+  wakeMah += mah;
+  rtc_energy_mah += mah;
+  rtc_energy_hours += ms / MS_PER_HOUR;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <Arduino.h>
+
+/**
+ * @class EnergyModel
+ * @brief Per-wake energy accounting and battery-life projection.
+ * 
+ * The wake is split into consecutive wall-clock phases (boot, sensor, WiFi
+ * association, MQTT/TLS connect, TX, flush) marked from main. Each phase is
+ * charged at its configured average current (ENERGY_MA_*); deep sleep is
+ * charged at ENERGY_MA_SLEEP for the time actually slept (system time, so
+ * early input wakes are accounted correctly).
+ * 
+ * Totals since power-on (assumed battery insertion) live in RTC memory and
+ * give the average consumption in mAh/day and the projected days remaining
+ * for BATTERY_CAPACITY_MAH.
+ * 
+ * Phases overlap in reality (WiFi associates while sensors are read); the
+ * configured currents are the averages measured for each slice as marked.
+ */
+class EnergyModel {
+public:
+  enum class Phase : uint8_t {
+    Boot = 0,
+    Sensor,
+    WifiAssoc,
+    Mqtt,
+    Tx,
+    Flush,
+    Count
+  };
+
+  /**
+   * @brief Start accounting a wake (call first in setup()).
+   * 
+   * Charges the deep sleep that just ended and opens the Boot phase.
+   */
+  static void beginWake();
+
+  /**
+   * @brief Close the current phase and open the given one.
+   * 
+   * Marking the current phase again is a no-op.
+   */
+  static void mark(Phase phase);
+
+  /**
+   * @brief Close the wake right before deep sleep.
+   * 
+   * Charges the open phase and stores the sleep start time.
+   */
+  static void endWake();
+
+  /**
+   * @brief Average consumption since power-on in mAh per day (0 if unknown).
+   */
+  static float mAhPerDay();
+
+  /**
+   * @brief Projected days until BATTERY_CAPACITY_MAH is used up (-1 if unknown).
+   */
+  static float daysRemaining();
+
+  /**
+   * @brief Format status payload fields for the last completed wake
+   *        (no surrounding braces):
+   *        "energy":{"wake_ms":2310,"wake_mah":0.071,"mah_day":3.12,
+   *                  "days_left":779,"phase_ms":[120,40,1350,410,300,90]}
+   * 
+   * @return Number of characters written
+   */
+  static int formatStatusFields(char* buf, size_t len);
+
+private:
+  static void charge(Phase phase, uint32_t ms);
+};
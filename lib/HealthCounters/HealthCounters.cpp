@@ -0,0 +1,149 @@
+#include "HealthCounters.h"
+#include <config_common.h>
+
+static const uint8_t COUNTERS = (uint8_t)HealthCounters::Counter::COUNT;
+static const uint8_t GAUGES = (uint8_t)HealthCounters::Gauge::COUNT;
+
+// Payload names, in enum order
+static constexpr const char* COUNTER_NAMES[] = {
+  "pub_fail", "dht_nan", "mqtt_fail", "link_timeout", "rtc_fail", "edge_drop"
+};
+static constexpr const char* GAUGE_NAMES[] = { "mqtt_rc", "rssi" };
+static_assert(sizeof(COUNTER_NAMES) / sizeof(COUNTER_NAMES[0]) == COUNTERS, "one name per counter");
+static_assert(sizeof(GAUGE_NAMES) / sizeof(GAUGE_NAMES[0]) == GAUGES, "one name per gauge");
+
+// Longest formatted fields: every counter at UINT32_MAX, every gauge at INT32_MIN
+static constexpr size_t nameLength(const char* s) {
+  size_t n = 0;
+  while (s[n] != '\0') {
+    n++;
+  }
+  return n;
+}
+
+static constexpr size_t fieldsMaxLength() {
+  size_t n = sizeof("\"health\":{}") - 1;
+  for (const char* name : COUNTER_NAMES) {
+    n += 1 + nameLength(name) + 3 + 10;   // ,"name":4294967295
+  }
+  for (const char* name : GAUGE_NAMES) {
+    n += 1 + nameLength(name) + 3 + 11;   // ,"name":-2147483648
+  }
+  return n;
+}
+static_assert(fieldsMaxLength() < HealthCounters::FIELDS_SIZE, "FIELDS_SIZE too small for all counters");
+
+// RTC memory (survives deep sleep, lost on power cycle)
+RTC_DATA_ATTR static uint32_t rtc_health_counters[COUNTERS];
+RTC_DATA_ATTR static int32_t rtc_health_gauges[GAUGES];
+RTC_DATA_ATTR static uint8_t rtc_health_gauges_set = 0;      // bit per gauge
+RTC_DATA_ATTR static uint16_t rtc_health_since_sent = 0;     // status messages without counters
+RTC_DATA_ATTR static bool rtc_health_sent = false;
+
+// std::atomic is not used: its S32C1I compare-and-set is only guaranteed on
+// internal SRAM, not RTC slow memory. A spinlock (in DRAM) works from ISRs and
+// from both cores.
+static portMUX_TYPE healthMux = portMUX_INITIALIZER_UNLOCKED;
+
+// ============================
+// Public: increment() / set()
+// ============================
+void IRAM_ATTR HealthCounters::increment(Counter c) {
+  uint8_t i = (uint8_t)c;
+  if (i >= COUNTERS) {
+    return;
+  }
+  portENTER_CRITICAL_SAFE(&healthMux);
+  if (rtc_health_counters[i] != UINT32_MAX) {
+    rtc_health_counters[i]++;
+  }
+  portEXIT_CRITICAL_SAFE(&healthMux);
+}
+
+void IRAM_ATTR HealthCounters::set(Gauge g, int32_t value) {
+  uint8_t i = (uint8_t)g;
+  if (i >= GAUGES) {
+    return;
+  }
+  portENTER_CRITICAL_SAFE(&healthMux);
+  rtc_health_gauges[i] = value;
+  rtc_health_gauges_set |= (uint8_t)(1 << i);
+  portEXIT_CRITICAL_SAFE(&healthMux);
+}
+
+uint32_t HealthCounters::get(Counter c) {
+  uint8_t i = (uint8_t)c;
+  return i < COUNTERS ? rtc_health_counters[i] : 0;
+}
+
+// ============================
+// Public: due() / statusSent()
+// ============================
+bool HealthCounters::due() {
+  return !rtc_health_sent || rtc_health_since_sent + 1 >= HEALTH_PUBLISH_EVERY;
+}
+
+void HealthCounters::statusSent(bool included) {
+  if (included) {
+    rtc_health_sent = true;
+    rtc_health_since_sent = 0;
+  } else if (rtc_health_since_sent < UINT16_MAX) {
+    rtc_health_since_sent++;
+  }
+}
+
+// ============================
+// Public: formatStatusFields()
+// ============================
+int HealthCounters::formatStatusFields(char* buf, size_t len) {
+  if (len == 0) {
+    return 0;
+  }
+
+  // Consistent snapshot, formatted outside the critical section
+  uint32_t counters[COUNTERS];
+  int32_t gauges[GAUGES];
+  uint8_t gaugesSet;
+  portENTER_CRITICAL_SAFE(&healthMux);
+  memcpy(counters, rtc_health_counters, sizeof(counters));
+  memcpy(gauges, rtc_health_gauges, sizeof(gauges));
+  gaugesSet = rtc_health_gauges_set;
+  portEXIT_CRITICAL_SAFE(&healthMux);
+
+  int used = snprintf(buf, len, "\"health\":{");
+  bool first = true;
+  for (uint8_t i = 0; i < COUNTERS && used > 0 && used < (int)len; i++) {
+    if (counters[i] == 0) {
+      continue;
+    }
+    used += snprintf(buf + used, len - used, "%s\"%s\":%lu",
+                     first ? "" : ",", COUNTER_NAMES[i], (unsigned long)counters[i]);
+    first = false;
+  }
+  for (uint8_t i = 0; i < GAUGES && used > 0 && used < (int)len; i++) {
+    if ((gaugesSet & (1 << i)) == 0) {
+      continue;
+    }
+    used += snprintf(buf + used, len - used, "%s\"%s\":%ld",
+                     first ? "" : ",", GAUGE_NAMES[i], (long)gauges[i]);
+    first = false;
+  }
+  if (used > 0 && used < (int)len) {
+    used += snprintf(buf + used, len - used, "}");
+  }
+
+  // Never return cut-off JSON
+  if (used < 0 || used >= (int)len) {
+    buf[0] = '\0';
+    return 0;
+  }
+  return used;
+}
+
+void HealthCounters::clear() {
+  portENTER_CRITICAL_SAFE(&healthMux);
+  memset(rtc_health_counters, 0, sizeof(rtc_health_counters));
+  memset(rtc_health_gauges, 0, sizeof(rtc_health_gauges));
+  rtc_health_gauges_set = 0;
+  portEXIT_CRITICAL_SAFE(&healthMux);
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <Arduino.h>
+
+/**
+ * @class HealthCounters
+ * @brief Fixed registry of failure counters and gauges, kept in RTC memory.
+ *
+ * Failures that used to reach Serial only (publish errors, DHT NaNs, MQTT
+ * connect rc, RTC faults, dropped input edges) are counted here since
+ * power-on and published in a message of their own (status topic) after
+ * every HEALTH_PUBLISH_EVERY status messages, so degrading nodes show up
+ * broker-side without a serial console. A message of its own: the status
+ * payload has no guaranteed room left for them.
+ *
+ * Slots are an enum: no registration, no allocation, and the payload names
+ * are fixed. increment() and set() may be called from any task or ISR.
+ */
+class HealthCounters {
+public:
+  enum class Counter : uint8_t {
+    PublishFail,       // Comms::publishRaw() failed
+    DhtFail,           // DHT22 read returned NaN
+    MqttConnectFail,   // MQTT CONNECT refused or timed out
+    LinkTimeout,       // wake gave up waiting for WiFi/MQTT
+    RtcFail,           // DS3231 not found, or time read failed
+    EdgeDrop,          // input edge or debounced event lost (queue full)
+    COUNT
+  };
+
+  enum class Gauge : uint8_t {
+    MqttRc,            // PubSubClient state() of the last failed connect
+    WifiRssi,          // dBm at the last MQTT connect
+    COUNT
+  };
+
+  // Buffer size that holds formatStatusFields() with every slot at its
+  // longest value (checked at compile time)
+  static const size_t FIELDS_SIZE = 192;
+
+  /**
+   * @brief Add one to a counter (saturates at UINT32_MAX). ISR-safe.
+   */
+  static void IRAM_ATTR increment(Counter c);
+
+  /**
+   * @brief Set a gauge to its latest value. ISR-safe.
+   */
+  static void IRAM_ATTR set(Gauge g, int32_t value);
+
+  static uint32_t get(Counter c);
+
+  /**
+   * @brief True if the counters should be published on this wake (with the
+   *        first status message after power-on, then every
+   *        HEALTH_PUBLISH_EVERY).
+   */
+  static bool due();
+
+  /**
+   * @brief Call after a status message was published.
+   *
+   * @param included true if the counters were published with it
+   */
+  static void statusSent(bool included);
+
+  /**
+   * @brief Format the counters as JSON fields (no surrounding braces);
+   *        counters that are still 0 and gauges never set are left out:
+   *        "health":{"pub_fail":3,"dht_nan":1,"mqtt_rc":-2,"rssi":-71}
+   *
+   * @param len FIELDS_SIZE always fits
+   * @return Number of characters written
+   */
+  static int formatStatusFields(char* buf, size_t len);
+
+  /**
+   * @brief Reset all counters and gauges.
+   */
+  static void clear();
+};
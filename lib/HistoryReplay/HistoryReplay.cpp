@@ -0,0 +1,220 @@
+#include "HistoryReplay.h"
+#include <Comms.h>
+#include <ReadingHistory.h>
+#include <config_common.h>
+
+// Transfer state in RTC memory (survives deep sleep, lost on power cycle)
+struct ReplayState {
+  bool active;
+  uint32_t since;
+  uint32_t until;
+  uint32_t resume;   // First epoch not yet delivered
+  uint16_t skip;     // Records on 'resume' already delivered
+  uint16_t seq;      // Chunk sequence number
+  bool queued;       // Range to replay once this transfer is done
+  uint32_t queuedSince;
+  uint32_t queuedUntil;
+};
+
+RTC_DATA_ATTR static ReplayState rtc_replay = {};
+
+// ============================
+// Public: begin()
+// ============================
+void HistoryReplay::begin(Comms& comms) {
+  commsPtr = &comms;
+
+  if (rtc_replay.active) {
+    Serial.printf("[Hist] Resuming replay from epoch=%lu (seq=%u)\n",
+                  (unsigned long)rtc_replay.resume, rtc_replay.seq);
+  }
+}
+
+// ============================
+// Public: start()
+// ============================
+void HistoryReplay::start(uint32_t since, uint32_t until, uint16_t skip) {
+  rtc_replay.active = true;
+  rtc_replay.since = since;
+  rtc_replay.until = until;
+  rtc_replay.resume = since;
+  rtc_replay.skip = skip;
+  rtc_replay.seq = 0;
+
+  Serial.printf("[Hist] Replay requested: since=%lu until=%lu (%u records stored)\n",
+                (unsigned long)since, (unsigned long)until, ReadingHistory::count());
+}
+
+// ============================
+// Public: enqueue()
+// ============================
+void HistoryReplay::enqueue(uint32_t since, uint32_t until) {
+  if (!rtc_replay.active) {
+    start(since, until);
+    return;
+  }
+
+  // Already part of the transfer in progress (e.g. the same batch range
+  // again after another wake that could not connect)
+  if (since >= rtc_replay.since && until <= rtc_replay.until) {
+    return;
+  }
+
+  if (rtc_replay.queued) {
+    rtc_replay.queuedSince = min(rtc_replay.queuedSince, since);
+    rtc_replay.queuedUntil = max(rtc_replay.queuedUntil, until);
+  } else {
+    rtc_replay.queued = true;
+    rtc_replay.queuedSince = since;
+    rtc_replay.queuedUntil = until;
+  }
+  Serial.printf("[Hist] Replay since=%lu queued behind the active transfer\n",
+                (unsigned long)rtc_replay.queuedSince);
+}
+
+// ============================
+// Public: active()
+// ============================
+bool HistoryReplay::active() const {
+  return rtc_replay.active;
+}
+
+// ============================
+// Public: loop()
+// ============================
+void HistoryReplay::loop() {
+  for (uint8_t i = 0; i < HISTORY_CHUNKS_PER_LOOP && rtc_replay.active; i++) {
+    if (!publishNextChunk()) {
+      return;  // Retry on next loop (or next wake)
+    }
+  }
+}
+
+// ============================
+// Private: publishNextChunk()
+// ============================
+bool HistoryReplay::publishNextChunk() {
+  if (commsPtr == nullptr) {
+    return false;
+  }
+
+  // Pass 1: select the records for this chunk and measure them
+  uint16_t n = ReadingHistory::count();
+  uint16_t last = 0;
+  size_t recordBytes = 0;
+  uint32_t lastEpoch = 0;
+  uint16_t onLastEpoch = 0;   // records of this chunk on lastEpoch
+  bool any = false;
+  bool more = false;
+  uint16_t skip = rtc_replay.skip;
+  char item[40];
+
+  for (uint16_t i = 0; i < n; i++) {
+    ReadingHistory::Record rec;
+    if (!ReadingHistory::get(i, rec)) {
+      break;
+    }
+    if (!selected(rec, skip)) {
+      continue;
+    }
+
+    int len = formatRecord(item, sizeof(item), rec, recordBytes > 0);
+    if (recordBytes + len > HISTORY_CHUNK_MAX_BYTES) {
+      more = true;
+      break;
+    }
+    last = i + 1;
+    recordBytes += len;
+    onLastEpoch = (any && rec.epoch == lastEpoch) ? onLastEpoch + 1 : 1;
+    lastEpoch = rec.epoch;
+    any = true;
+  }
+
+  if (more && !any) {
+    Serial.println("[Hist] HISTORY_CHUNK_MAX_BYTES too small for a single record");
+    rtc_replay.active = false;
+    return false;
+  }
+
+  // Resume token: first epoch not fully delivered, and how much of it was
+  uint32_t resume = rtc_replay.resume;
+  uint16_t resumeSkip = rtc_replay.skip;
+  if (any) {
+    resumeSkip = (lastEpoch == rtc_replay.resume) ? rtc_replay.skip + onLastEpoch : onLastEpoch;
+    resume = lastEpoch;
+  }
+
+  char head[112];
+  int headLen = snprintf(head, sizeof(head),
+                         "{\"seq\":%u,\"since\":%lu,\"until\":%lu,\"resume\":%lu,\"skip\":%u,\"done\":%d,\"r\":[",
+                         rtc_replay.seq,
+                         (unsigned long)rtc_replay.since,
+                         (unsigned long)rtc_replay.until,
+                         (unsigned long)resume,
+                         resumeSkip,
+                         more ? 0 : 1);
+  static const char TAIL[] = "]}";
+
+  // Pass 2: stream envelope and records straight into the socket
+  if (!commsPtr->beginPublish(MQTT_TOPIC_HISTORY, headLen + recordBytes + sizeof(TAIL) - 1, false)) {
+    return false;
+  }
+
+  commsPtr->write((const uint8_t*)head, headLen);
+  bool firstItem = true;
+  skip = rtc_replay.skip;
+  for (uint16_t i = 0; i < last; i++) {
+    ReadingHistory::Record rec;
+    if (!ReadingHistory::get(i, rec) || !selected(rec, skip)) {
+      continue;
+    }
+    int len = formatRecord(item, sizeof(item), rec, !firstItem);
+    commsPtr->write((const uint8_t*)item, len);
+    firstItem = false;
+  }
+  commsPtr->write((const uint8_t*)TAIL, sizeof(TAIL) - 1);
+
+  if (!commsPtr->endPublish()) {
+    return false;
+  }
+
+  rtc_replay.resume = resume;
+  rtc_replay.skip = resumeSkip;
+  rtc_replay.seq++;
+
+  if (!more) {
+    Serial.printf("[Hist] Replay complete (%u chunks)\n", rtc_replay.seq);
+    rtc_replay.active = false;
+
+    // Range queued while this transfer ran (batch uplink)
+    if (rtc_replay.queued) {
+      rtc_replay.queued = false;
+      start(rtc_replay.queuedSince, rtc_replay.queuedUntil);
+    }
+  }
+  return true;
+}
+
+// ============================
+// Private: selected()
+// ============================
+bool HistoryReplay::selected(const ReadingHistory::Record& rec, uint16_t& skip) {
+  if (rec.epoch < rtc_replay.resume || rec.epoch > rtc_replay.until) {
+    return false;
+  }
+  // Records on the resume epoch that an earlier chunk already delivered
+  if (rec.epoch == rtc_replay.resume && skip > 0) {
+    skip--;
+    return false;
+  }
+  return true;
+}
+
+// ============================
+// Private: formatRecord()
+// ============================
+int HistoryReplay::formatRecord(char* buf, size_t len, const ReadingHistory::Record& rec, bool comma) {
+  return snprintf(buf, len, "%s[%lu,%d,%u]",
+                  comma ? "," : "",
+                  (unsigned long)rec.epoch, rec.temp_centi, rec.hum_centi);
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ReadingHistory.h>
+
+// Forward declaration
+class Comms;
+
+/**
+ * @class HistoryReplay
+ * @brief Streams stored readings back over MQTT in size-bounded chunks.
+ * 
+ * Started by the "history since=<epoch> until=<epoch>" command and serviced
+ * from ConnectionManager::loop() while MQTT is connected. Transfer state lives
+ * in RTC memory, so a replay cut short by deep sleep continues on the next wake.
+ * 
+ * Each chunk is published to MQTT_TOPIC_HISTORY:
+ * {
+ *   "seq": 0,
+ *   "since": 1737500000,
+ *   "until": 1737542445,
+ *   "resume": 1737521201,
+ *   "skip": 0,
+ *   "done": 0,
+ *   "r": [[1737519400,2150,4230], ...]    // [epoch, temp 0.01°C, hum 0.01%]
+ * }
+ * 
+ * "resume"/"skip" are the resume token: the epoch of the first record not yet
+ * delivered, and how many records on that epoch were already delivered (a
+ * batch wake can store several records per second). Re-sending
+ * "history since=<resume> skip=<skip> until=<until>" continues the transfer
+ * from the first record not yet delivered.
+ * Chunks are streamed straight to the socket (Comms::beginPublish), so their
+ * size is set by HISTORY_CHUNK_MAX_BYTES, not by the MQTT packet buffer.
+ */
+class HistoryReplay {
+public:
+  /**
+   * @brief Initialize HistoryReplay with a reference to Comms.
+   * 
+   * @param comms Reference to the Comms instance (must outlive HistoryReplay).
+   */
+  void begin(Comms& comms);
+
+  /**
+   * @brief Start (or restart) a replay of records in [since, until].
+   * 
+   * Replaces a transfer in progress (a new request from the user).
+   * 
+   * @param since First epoch to include
+   * @param until Last epoch to include
+   * @param skip Records on epoch 'since' to leave out (already delivered)
+   */
+  void start(uint32_t since, uint32_t until, uint16_t skip = 0);
+
+  /**
+   * @brief Start a replay, or queue it behind the transfer in progress.
+   * 
+   * For replays the firmware starts by itself (batch uplink): a user request
+   * still running is not cut short. Queued ranges are merged; a range the
+   * transfer in progress already covers is not queued again.
+   */
+  void enqueue(uint32_t since, uint32_t until);
+
+  /**
+   * @brief Check if a transfer is in progress.
+   */
+  bool active() const;
+
+  /**
+   * @brief Publish the next chunk(s) of an active transfer.
+   * 
+   * Call only while MQTT is connected. Sends at most HISTORY_CHUNKS_PER_LOOP
+   * chunks per call; leaves the state untouched if a publish fails.
+   */
+  void loop();
+
+private:
+  Comms* commsPtr = nullptr;
+
+  bool publishNextChunk();
+  static bool selected(const ReadingHistory::Record& rec, uint16_t& skip);
+  static int formatRecord(char* buf, size_t len, const ReadingHistory::Record& rec, bool comma);
+};
@@ -0,0 +1,256 @@
+#include "I2CBus.h"
+#include <Wire.h>
+#include <config_common.h>
+
+// Wire::endTransmission() results that leave the bus in doubt (vs. NACKs)
+static const uint8_t WIRE_ERR_OTHER   = 4;
+static const uint8_t WIRE_ERR_TIMEOUT = 5;
+
+static const uint8_t RECOVERY_CLOCKS = 9;          // one byte + ACK
+static const uint32_t RECOVERY_HALF_PERIOD_US = 5;  // ~100 kHz
+
+// RTC memory (survives deep sleep, lost on power cycle)
+RTC_DATA_ATTR static I2CBus::DeviceStats rtc_i2c_stats[I2C_MAX_DEVICES];
+RTC_DATA_ATTR static uint32_t rtc_i2c_recoveries = 0;
+
+static bool started = false;
+static uint32_t busHz = I2C_FREQ_HZ;
+
+// ============================
+// Public: begin()
+// ============================
+bool I2CBus::begin() {
+  if (started) {
+    return true;
+  }
+
+  // A slave reset mid-read can hold SDA low until it sees more clocks
+  if (!recover()) {
+    Serial.println("[I2C] Bus stuck (SDA low after recovery)");
+  }
+
+  if (!Wire.begin(I2C_SDA_PIN, I2C_SCL_PIN, busHz)) {
+    Serial.println("[I2C] Error: Wire.begin failed");
+    return false;
+  }
+  Wire.setTimeOut(I2C_TIMEOUT_MS);
+  started = true;
+
+  Serial.printf("[I2C] Bus initialized (SDA=%d, SCL=%d, Freq=%lu, timeout=%d ms)\n",
+                I2C_SDA_PIN, I2C_SCL_PIN, (unsigned long)busHz, I2C_TIMEOUT_MS);
+  return true;
+}
+
+// ============================
+// Public: addDevice()
+// ============================
+bool I2CBus::addDevice(uint8_t addr, uint32_t maxHz) {
+  if (!begin()) {
+    return false;
+  }
+
+  if (slot(addr) == nullptr) {
+    for (uint8_t i = 0; i < I2C_MAX_DEVICES; i++) {
+      if (rtc_i2c_stats[i].addr == 0) {
+        rtc_i2c_stats[i].addr = addr;
+        break;
+      }
+    }
+  }
+
+  // The bus runs at the slowest registered device's clock
+  if (maxHz < busHz) {
+    busHz = maxHz;
+    Wire.setClock(busHz);
+    Serial.printf("[I2C] Clock lowered to %lu Hz for 0x%02X\n", (unsigned long)busHz, addr);
+  }
+
+  return probe(addr);
+}
+
+// ============================
+// Public: transactions
+// ============================
+bool I2CBus::writeRegs(uint8_t addr, uint8_t reg, const uint8_t* data, size_t len) {
+  if (!started) {
+    return false;
+  }
+
+  Wire.beginTransmission(addr);
+  Wire.write(reg);
+  if (len > 0) {
+    Wire.write(data, len);
+  }
+  uint8_t err = Wire.endTransmission();
+
+  count(addr, err);
+  return err == 0;
+}
+
+bool I2CBus::readRegs(uint8_t addr, uint8_t reg, uint8_t* data, size_t len) {
+  if (!started || len == 0 || len > 255) {
+    return false;
+  }
+
+  // Register pointer, then repeated start (no STOP in between)
+  Wire.beginTransmission(addr);
+  Wire.write(reg);
+  uint8_t err = Wire.endTransmission(false);
+
+  if (err == 0) {
+    size_t got = Wire.requestFrom(addr, (uint8_t)len);
+    for (size_t i = 0; i < got && i < len; i++) {
+      data[i] = (uint8_t)Wire.read();
+    }
+    if (got != len) {
+      err = WIRE_ERR_TIMEOUT;
+    }
+  }
+
+  count(addr, err);
+  return err == 0;
+}
+
+bool I2CBus::writeReg(uint8_t addr, uint8_t reg, uint8_t value) {
+  return writeRegs(addr, reg, &value, 1);
+}
+
+bool I2CBus::readReg(uint8_t addr, uint8_t reg, uint8_t& value) {
+  return readRegs(addr, reg, &value, 1);
+}
+
+bool I2CBus::probe(uint8_t addr) {
+  if (!started) {
+    return false;
+  }
+  Wire.beginTransmission(addr);
+  uint8_t err = Wire.endTransmission();
+  count(addr, err);
+  return err == 0;
+}
+
+// ============================
+// Public: recover()
+// ============================
+bool I2CBus::recover() {
+  pinMode(I2C_SDA_PIN, INPUT_PULLUP);
+  pinMode(I2C_SCL_PIN, INPUT_PULLUP);
+  delayMicroseconds(RECOVERY_HALF_PERIOD_US);
+
+  if (digitalRead(I2C_SDA_PIN) == HIGH) {
+    return true;
+  }
+
+  rtc_i2c_recoveries++;
+  Serial.println("[I2C] SDA held low, clocking SCL to release the bus");
+
+  // Clock out whatever byte the slave is still sending
+  pinMode(I2C_SCL_PIN, OUTPUT_OPEN_DRAIN);
+  for (uint8_t i = 0; i < RECOVERY_CLOCKS && digitalRead(I2C_SDA_PIN) == LOW; i++) {
+    digitalWrite(I2C_SCL_PIN, LOW);
+    delayMicroseconds(RECOVERY_HALF_PERIOD_US);
+    digitalWrite(I2C_SCL_PIN, HIGH);
+    delayMicroseconds(RECOVERY_HALF_PERIOD_US);
+  }
+
+  // STOP: SDA low -> high while SCL is high
+  pinMode(I2C_SDA_PIN, OUTPUT_OPEN_DRAIN);
+  digitalWrite(I2C_SCL_PIN, LOW);
+  digitalWrite(I2C_SDA_PIN, LOW);
+  delayMicroseconds(RECOVERY_HALF_PERIOD_US);
+  digitalWrite(I2C_SCL_PIN, HIGH);
+  delayMicroseconds(RECOVERY_HALF_PERIOD_US);
+  digitalWrite(I2C_SDA_PIN, HIGH);
+  delayMicroseconds(RECOVERY_HALF_PERIOD_US);
+
+  pinMode(I2C_SDA_PIN, INPUT_PULLUP);
+  pinMode(I2C_SCL_PIN, INPUT_PULLUP);
+  return digitalRead(I2C_SDA_PIN) == HIGH;
+}
+
+// ============================
+// Public: counters
+// ============================
+const I2CBus::DeviceStats* I2CBus::getStats(uint8_t addr) {
+  return slot(addr);
+}
+
+uint32_t I2CBus::getRecoveryCount() {
+  return rtc_i2c_recoveries;
+}
+
+int I2CBus::formatStatusFields(char* buf, size_t len) {
+  if (len == 0) {
+    return 0;
+  }
+  buf[0] = '\0';
+
+  bool anyErrors = false;
+  for (uint8_t i = 0; i < I2C_MAX_DEVICES; i++) {
+    if (rtc_i2c_stats[i].addr != 0 && rtc_i2c_stats[i].errors > 0) {
+      anyErrors = true;
+    }
+  }
+  if (!anyErrors && rtc_i2c_recoveries == 0) {
+    return 0;
+  }
+
+  int used = snprintf(buf, len, "\"i2c\":{\"recov\":%lu,\"dev\":[",
+                      (unsigned long)rtc_i2c_recoveries);
+  bool first = true;
+  for (uint8_t i = 0; i < I2C_MAX_DEVICES && used > 0 && used < (int)len; i++) {
+    const DeviceStats& s = rtc_i2c_stats[i];
+    if (s.addr == 0) {
+      continue;
+    }
+    used += snprintf(buf + used, len - used, "%s{\"addr\":%u,\"ok\":%lu,\"err\":%lu,\"last\":%u}",
+                     first ? "" : ",", s.addr, (unsigned long)s.ok,
+                     (unsigned long)s.errors, s.lastError);
+    first = false;
+  }
+  if (used > 0 && used < (int)len) {
+    used += snprintf(buf + used, len - used, "]}");
+  }
+
+  // Never hand out a cut-off object
+  if (used < 0 || used >= (int)len) {
+    buf[0] = '\0';
+    return 0;
+  }
+  return used;
+}
+
+// ============================
+// Private
+// ============================
+I2CBus::DeviceStats* I2CBus::slot(uint8_t addr) {
+  for (uint8_t i = 0; i < I2C_MAX_DEVICES; i++) {
+    if (rtc_i2c_stats[i].addr == addr) {
+      return &rtc_i2c_stats[i];
+    }
+  }
+  return nullptr;
+}
+
+void I2CBus::count(uint8_t addr, uint8_t error) {
+  DeviceStats* s = slot(addr);
+  if (s != nullptr) {
+    if (error == 0) {
+      s->ok++;
+    } else {
+      s->errors++;
+      s->lastError = error;
+    }
+  }
+
+  // Timeout or bus error: the bus may be left mid-byte
+  if (error == WIRE_ERR_OTHER || error == WIRE_ERR_TIMEOUT) {
+    restart();
+  }
+}
+
+void I2CBus::restart() {
+  Wire.end();
+  started = false;
+  begin();
+}
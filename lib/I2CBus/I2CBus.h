@@ -0,0 +1,88 @@
+#pragma once
+
+#include <Arduino.h>
+
+/**
+ * @class I2CBus
+ * @brief Owner of the shared I2C bus (Wire) for all device drivers.
+ *
+ * Drivers register their address with the fastest clock they support; the
+ * bus runs at the slowest registered clock (I2C_FREQ_HZ at most, fast mode by
+ * default) so no driver reconfigures Wire behind another one's back.
+ *
+ * - Register transactions are bursts: one write of the register pointer plus
+ *   data, or a pointer write and a repeated-start read of N bytes.
+ * - Every transaction is bounded by I2C_TIMEOUT_MS.
+ * - A bus held low by a slave (reset mid-transfer) is released by clocking
+ *   SCL until SDA is high and sending a STOP, at begin() and after a bus
+ *   error or timeout.
+ * - Successes and errors are counted per device (since power-on).
+ */
+class I2CBus {
+public:
+  struct DeviceStats {
+    uint8_t addr;          // 7-bit address, 0 = free slot
+    uint8_t lastError;     // Wire error of the last failed transaction
+    uint32_t ok;
+    uint32_t errors;
+  };
+
+  /**
+   * @brief Start the bus (idempotent); recovers a stuck bus first.
+   */
+  static bool begin();
+
+  /**
+   * @brief Register a device and the fastest clock it supports.
+   *
+   * @return true if the device answers its address.
+   */
+  static bool addDevice(uint8_t addr, uint32_t maxHz);
+
+  /**
+   * @brief Write len bytes starting at register reg (one burst).
+   */
+  static bool writeRegs(uint8_t addr, uint8_t reg, const uint8_t* data, size_t len);
+
+  /**
+   * @brief Read len bytes starting at register reg (pointer write, then
+   *        repeated-start read).
+   */
+  static bool readRegs(uint8_t addr, uint8_t reg, uint8_t* data, size_t len);
+
+  static bool writeReg(uint8_t addr, uint8_t reg, uint8_t value);
+  static bool readReg(uint8_t addr, uint8_t reg, uint8_t& value);
+
+  /**
+   * @brief True if a device ACKs its address.
+   */
+  static bool probe(uint8_t addr);
+
+  /**
+   * @brief Release a stuck bus: clock SCL until SDA is high, then STOP.
+   *
+   * @return true if SDA is high afterwards.
+   */
+  static bool recover();
+
+  /**
+   * @brief Counters of a registered device (nullptr if unknown).
+   */
+  static const DeviceStats* getStats(uint8_t addr);
+
+  static uint32_t getRecoveryCount();
+
+  /**
+   * @brief Format status payload fields when any device had errors
+   *        (no surrounding braces, empty otherwise):
+   *        "i2c":{"recov":1,"dev":[{"addr":104,"ok":1520,"err":3,"last":5}]}
+   *
+   * @return Number of characters written
+   */
+  static int formatStatusFields(char* buf, size_t len);
+
+private:
+  static DeviceStats* slot(uint8_t addr);
+  static void count(uint8_t addr, uint8_t error);
+  static void restart();
+};
@@ -1,30 +1,23 @@
 #include "Interrupts.h"
 #include <Comms.h>
+#include <HealthCounters.h>
+#include <soc/gpio_struct.h>
+#include <driver/rtc_io.h>
 #include "../../include/config.h"
 
 // Singleton instance
 Interrupts* Interrupts::instance = nullptr;
 
-// Static ISR wrapper functions (for up to 8 pins)
-void IRAM_ATTR isr0() { if (Interrupts::getInstance()) Interrupts::getInstance()->handlePinChange(0); }
-void IRAM_ATTR isr1() { if (Interrupts::getInstance()) Interrupts::getInstance()->handlePinChange(1); }
-void IRAM_ATTR isr2() { if (Interrupts::getInstance()) Interrupts::getInstance()->handlePinChange(2); }
-void IRAM_ATTR isr3() { if (Interrupts::getInstance()) Interrupts::getInstance()->handlePinChange(3); }
-void IRAM_ATTR isr4() { if (Interrupts::getInstance()) Interrupts::getInstance()->handlePinChange(4); }
-void IRAM_ATTR isr5() { if (Interrupts::getInstance()) Interrupts::getInstance()->handlePinChange(5); }
-void IRAM_ATTR isr6() { if (Interrupts::getInstance()) Interrupts::getInstance()->handlePinChange(6); }
-void IRAM_ATTR isr7() { if (Interrupts::getInstance()) Interrupts::getInstance()->handlePinChange(7); }
+// Last published logical state per input (survives deep sleep)
+RTC_DATA_ATTR static bool rtc_reported_valid = false;
+RTC_DATA_ATTR static bool rtc_reported_state[8];
 
-// Array of ISR function pointers
-static void (*isrFunctions[8])() = {
-  isr0, isr1, isr2, isr3, isr4, isr5, isr6, isr7
-};
-
-// ============================
-// Public: getInstance()
-// ============================
-Interrupts* Interrupts::getInstance() {
-  return instance;
+// Read a pin straight from the GPIO input registers (digitalRead is not in IRAM)
+static inline IRAM_ATTR int readPinFromIsr(uint8_t pin) {
+  if (pin < 32) {
+    return (GPIO.in >> pin) & 0x1;
+  }
+  return (GPIO.in1.data >> (pin - 32)) & 0x1;
 }
 
 // ============================
@@ -32,20 +25,53 @@ Interrupts* Interrupts::getInstance() {
 // ============================
 void Interrupts::begin(Comms& comms) {
   commsPtr = &comms;
-  numPins = INPUT_PIN_COUNT;
+  numPins = (INPUT_PIN_COUNT < MAX_CHANNELS) ? INPUT_PIN_COUNT : MAX_CHANNELS;
   instance = this;  // Set singleton instance
-  
-  // Initialize debounce states
+
+  setupInterrupts();
+
+  // Baseline: current (already pulled) pin state, no event
   for (uint8_t i = 0; i < numPins; i++) {
     debounceStates[i].pin = INPUT_PINS[i];
-    debounceStates[i].lastStableState = getLogicalState(INPUT_PINS[i], digitalRead(INPUT_PINS[i]));
-    debounceStates[i].currentRead = debounceStates[i].lastStableState;
-    debounceStates[i].debounceStart = 0;
-    debounceStates[i].isDebouncing = false;
-    debounceStates[i].baselineCaptured = false;  // First stable state is baseline, no event
+    debounceStates[i].lastStableState = getLogicalState(digitalRead(INPUT_PINS[i]));
+    debounceStates[i].pending = false;
+    debounceStates[i].pendingLevel = debounceStates[i].lastStableState;
+    debounceStates[i].burstStartUs = 0;
+    debounceStates[i].lastEdgeUs = 0;
+    if (INPUT_PIN_MODES[i] != INPUT_MODE_EVENT) {
+      continue;  // Counted by PulseCounter
+    }
+
+    // Report changes made while asleep (or left unpublished last wake)
+    bool current = debounceStates[i].lastStableState;
+    if (rtc_reported_valid && current != rtc_reported_state[i]) {
+      PinEvent event;
+      event.channel = i;
+      event.state = current;
+      event.timestampUs = esp_timer_get_time();
+      eventQueue.push(event);
+      Serial.printf("[INT] Pin %d changed while asleep (state=%d)\n", INPUT_PINS[i], current ? 1 : 0);
+    } else {
+      rtc_reported_state[i] = current;
+      Serial.printf("[INT] Baseline for pin %d (state=%d)\n", INPUT_PINS[i], current ? 1 : 0);
+    }
   }
-  
-  setupInterrupts();
+  rtc_reported_valid = true;
+
+  // Debounce runs in the esp_timer task, independent of the main loop
+  const esp_timer_create_args_t timerArgs = {
+    .callback = &Interrupts::debounceTimerCallback,
+    .arg = this,
+    .dispatch_method = ESP_TIMER_TASK,
+    .name = "int_debounce",
+    .skip_unhandled_events = true,
+  };
+  if (esp_timer_create(&timerArgs, &debounceTimer) == ESP_OK) {
+    esp_timer_start_periodic(debounceTimer, DEBOUNCE_TICK_MS * 1000ULL);
+  } else {
+    Serial.println("[INT] ERROR: debounce timer create failed");
+  }
+
   Serial.println("[INT] Interrupts initialized");
 }
 
@@ -53,89 +79,117 @@ void Interrupts::begin(Comms& comms) {
 // Public: loop()
 // ============================
 void Interrupts::loop() {
-  processDebounce();
+  publishPinEvents();
+}
+
+// ============================
+// Public: getOverflowCount()
+// ============================
+uint32_t Interrupts::getOverflowCount() const {
+  return overflowCount.load(std::memory_order_relaxed);
 }
 
 // ============================
-// Public: handlePinChange()
+// Private: isrHandler()
 // ============================
-void Interrupts::handlePinChange(uint8_t channelIdx) {
-  // ISR: only set flag, no logging, no heap operations
-  if (channelIdx < 8) {
-    isrFlags[channelIdx] = true;
+void IRAM_ATTR Interrupts::isrHandler(void* arg) {
+  // ISR: timestamp + enqueue only, no logging, no heap operations.
+  // All GPIO ISRs are dispatched from one core, so this is the only producer.
+  Interrupts* self = instance;
+  if (self == nullptr) {
+    return;
+  }
+
+  uint8_t channel = (uint8_t)(uintptr_t)arg;
+  Edge edge;
+  edge.channel = channel;
+  edge.level = (uint8_t)readPinFromIsr(self->debounceStates[channel].pin);
+  edge.timestampUs = esp_timer_get_time();
+
+  if (!self->edgeQueue.push(edge)) {
+    self->overflowCount.fetch_add(1, std::memory_order_relaxed);
+    HealthCounters::increment(HealthCounters::Counter::EdgeDrop);
   }
 }
 
+// ============================
+// Private: debounceTimerCallback()
+// ============================
+void Interrupts::debounceTimerCallback(void* arg) {
+  static_cast<Interrupts*>(arg)->processEdges();
+}
+
 // ============================
 // Private: setupInterrupts()
 // ============================
 void Interrupts::setupInterrupts() {
   Serial.printf("[INT] Setting up %d interrupt pins\n", numPins);
-  
-  for (uint8_t i = 0; i < numPins && i < 8; i++) {
+
+  for (uint8_t i = 0; i < numPins; i++) {
     uint8_t pin = INPUT_PINS[i];
-    
-    // Configure as input with pull-up (for active-low logic)
+    debounceStates[i].pin = pin;
+    if (INPUT_PIN_MODES[i] != INPUT_MODE_EVENT) {
+      continue;  // Pulse inputs belong to the ULP (PulseCounter)
+    }
+
+    // Pads used as deep sleep wake sources come back as RTC IO
+    if (rtc_gpio_is_valid_gpio((gpio_num_t)pin)) {
+      rtc_gpio_deinit((gpio_num_t)pin);
+    }
+
+    // Both edges: the debounce needs to see releases as well as presses
 #if INPUT_ACTIVE_LOW == 1
     pinMode(pin, INPUT_PULLUP);
-    // Attach interrupt on falling edge (low pulse)
-    attachInterrupt(digitalPinToInterrupt(pin), isrFunctions[i], FALLING);
     Serial.printf("[INT] Pin %d configured as active-low with pull-up\n", pin);
 #else
     pinMode(pin, INPUT);
-    // Attach interrupt on rising edge (high pulse)
-    attachInterrupt(digitalPinToInterrupt(pin), isrFunctions[i], RISING);
     Serial.printf("[INT] Pin %d configured as active-high\n", pin);
 #endif
+    attachInterruptArg(digitalPinToInterrupt(pin), &Interrupts::isrHandler,
+                       (void*)(uintptr_t)i, CHANGE);
   }
 }
 
 // ============================
-// Private: processDebounce()
+// Private: processEdges()
 // ============================
-void Interrupts::processDebounce() {
+void Interrupts::processEdges() {
+  // Consume raw edges: each one restarts the quiet period for its channel
+  Edge edge;
+  while (edgeQueue.pop(edge)) {
+    if (edge.channel >= numPins) {
+      continue;
+    }
+    DebounceState& ds = debounceStates[edge.channel];
+    if (!ds.pending) {
+      ds.pending = true;
+      ds.burstStartUs = edge.timestampUs;
+    }
+    ds.pendingLevel = getLogicalState(edge.level);
+    ds.lastEdgeUs = edge.timestampUs;
+  }
+
+  // Settle channels that have been quiet for DEBOUNCE_MS
+  int64_t nowUs = esp_timer_get_time();
   for (uint8_t i = 0; i < numPins; i++) {
-    uint8_t pin = debounceStates[i].pin;
-    
-    // Check if ISR has flagged a change
-    if (isrFlags[i]) {
-      isrFlags[i] = false;  // Clear the flag
-      
-      // Start debounce if not already debouncing
-      if (!debounceStates[i].isDebouncing) {
-        debounceStates[i].isDebouncing = true;
-        debounceStates[i].debounceStart = millis();
-      }
+    DebounceState& ds = debounceStates[i];
+    if (!ds.pending || (nowUs - ds.lastEdgeUs) < (int64_t)DEBOUNCE_MS * 1000) {
+      continue;
+    }
+    ds.pending = false;
+
+    if (ds.pendingLevel == ds.lastStableState) {
+      continue;  // Glitch: returned to the previous state
     }
-    
-    // While debouncing, read pin state
-    if (debounceStates[i].isDebouncing) {
-      int rawState = digitalRead(pin);
-      bool logicalState = getLogicalState(pin, rawState);
-      debounceStates[i].currentRead = logicalState;
-      
-      // Check if debounce period has elapsed
-      unsigned long now = millis();
-      unsigned long elapsed = now - debounceStates[i].debounceStart;
-      
-      if (elapsed >= DEBOUNCE_MS) {
-        // Debounce complete, check if state actually changed
-        if (logicalState != debounceStates[i].lastStableState) {
-          // Stable change detected
-          debounceStates[i].lastStableState = logicalState;
-          
-          // Only publish event if baseline has already been captured
-          if (debounceStates[i].baselineCaptured) {
-            publishPinEvent(pin, logicalState);
-          } else {
-            // First stable state is baseline, just capture it
-            Serial.printf("[INT] Baseline captured for pin %d (state=%d)\n", pin, (logicalState ? 1 : 0));
-            debounceStates[i].baselineCaptured = true;
-          }
-        }
-        
-        debounceStates[i].isDebouncing = false;
-      }
+    ds.lastStableState = ds.pendingLevel;
+
+    PinEvent event;
+    event.channel = i;
+    event.state = ds.pendingLevel;
+    event.timestampUs = ds.burstStartUs;
+    if (!eventQueue.push(event)) {
+      overflowCount.fetch_add(1, std::memory_order_relaxed);
+      HealthCounters::increment(HealthCounters::Counter::EdgeDrop);
     }
   }
 }
@@ -143,10 +197,10 @@ void Interrupts::processDebounce() {
 // ============================
 // Private: getLogicalState()
 // ============================
-bool Interrupts::getLogicalState(uint8_t pin, int rawState) {
+bool Interrupts::getLogicalState(int rawState) const {
   // Apply active-low/active-high transformation
   bool logical = (rawState == LOW);  // true when pin is LOW
-  
+
 #if INPUT_ACTIVE_LOW == 1
   // Active-low: LOW means "active" (1), HIGH means "inactive" (0)
   return logical;  // true when pin is LOW
@@ -157,26 +211,51 @@ bool Interrupts::getLogicalState(uint8_t pin, int rawState) {
 }
 
 // ============================
-// Private: publishPinEvent()
+// Private: publishPinEvents()
 // ============================
-void Interrupts::publishPinEvent(uint8_t pin, bool logicalState) {
-  if (commsPtr == nullptr) {
-    Serial.println("[INT] ERROR: Comms not initialized");
+void Interrupts::publishPinEvents() {
+  if (commsPtr == nullptr || eventQueue.empty()) {
+    return;
+  }
+
+  // Keep events queued until they can actually be sent
+  if (!commsPtr->connected()) {
     return;
   }
-  
-  // Construct JSON event
-  String eventJson = "{\"pin\":";
-  eventJson += pin;
-  eventJson += ",\"state\":";
-  eventJson += (logicalState ? 1 : 0);
-  eventJson += ",\"ms\":";
-  eventJson += millis();
-  eventJson += "}";
-  
+
+  // Batch up to MAX_EVENTS_PER_PUBLISH events into one JSON payload
+  char payload[448];
+  int len = snprintf(payload, sizeof(payload),
+                     "{\"device\":\"%s\",\"type\":\"gpio\",\"events\":[", DEVICE_NAME);
+
+  // Events stay in the queue until the publish succeeded (a failed one is
+  // retried on the next loop)
+  uint8_t count = 0;
+  const PinEvent* event;
+  while (count < MAX_EVENTS_PER_PUBLISH && len < (int)sizeof(payload) - 64 &&
+         (event = eventQueue.peek(count)) != nullptr) {
+    len += snprintf(payload + len, sizeof(payload) - len,
+                    "%s{\"pin\":%d,\"state\":%d,\"us\":%lld}",
+                    count > 0 ? "," : "",
+                    debounceStates[event->channel].pin,
+                    event->state ? 1 : 0,
+                    (long long)event->timestampUs);
+    count++;
+  }
+
+  snprintf(payload + len, sizeof(payload) - len,
+           "],\"dropped\":%lu}", (unsigned long)getOverflowCount());
+
   // Publish via Comms
-  bool result = commsPtr->publishEventJson(eventJson.c_str());
+  bool result = commsPtr->publishEventJson(payload);
   if (result) {
-    Serial.printf("[INT] Published event for pin %d (state=%d)\n", pin, (logicalState ? 1 : 0));
+    for (uint8_t i = 0; i < count; i++) {
+      const PinEvent* sent = eventQueue.peek(i);
+      rtc_reported_state[sent->channel] = sent->state;
+    }
+    eventQueue.popFront(count);
+    Serial.printf("[INT] Published %d pin event(s)\n", count);
+  } else {
+    Serial.printf("[INT] Failed to publish %d pin event(s), kept for retry\n", count);
   }
 }
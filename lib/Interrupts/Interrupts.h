@@ -2,17 +2,26 @@
 
 #include <Arduino.h>
 #include <cstdint>
+#include <esp_timer.h>
+#include <SpscQueue.h>
 
 // Forward declaration
 class Comms;
 
 /**
  * @class Interrupts
- * @brief Interrupt-driven input handler with debounce.
+ * @brief Interrupt-driven input handler with timestamped, timer-driven debounce.
  * 
- * Manages edge-triggered interrupt inputs with software debounce.
- * ISRs set flags only (no logging, no heap allocation).
- * Debounce confirms stable state changes before publishing events.
+ * A single IRAM ISR pushes every edge as (channel, level, esp_timer µs) into a
+ * lock-free SPSC queue; nothing is ever coalesced into a flag. A periodic
+ * esp_timer drains that queue and debounces on the edge timestamps, so the
+ * main loop never polls digitalRead(). Confirmed changes go into a second
+ * SPSC queue and loop() publishes them in batches. Full queues bump an
+ * overflow counter that is reported with the next batch.
+ * 
+ * The last published state of each input is kept in RTC memory. begin()
+ * compares it with the current level and queues an event for any change that
+ * happened while asleep (or that could not be published before sleeping).
  */
 class Interrupts {
 public:
@@ -24,56 +33,71 @@ public:
   void begin(Comms& comms);
 
   /**
-   * @brief Service debounce state machine.
+   * @brief Publish confirmed input changes.
    * 
-   * Call regularly from main loop. Processes ISR flags and publishes
-   * events when stable state changes are confirmed.
+   * Call regularly from main loop. Sends all debounced events gathered since
+   * the last call (up to MAX_EVENTS_PER_PUBLISH per payload) once MQTT is up;
+   * events wait in the queue while disconnected.
    */
   void loop();
 
   /**
-   * @brief Get singleton instance (for ISR callbacks).
+   * @brief Number of edges or events dropped because a queue was full.
    */
-  static Interrupts* getInstance();
-
-  /**
-   * @brief ISR callback for pin change.
-   * 
-   * Called by interrupt handler. Sets flag for corresponding channel.
-   * Must be called only from ISR context.
-   * 
-   * @param channelIdx Index into INPUT_PINS array (0-based).
-   */
-  void handlePinChange(uint8_t channelIdx);
+  uint32_t getOverflowCount() const;
 
 private:
-  Comms* commsPtr = nullptr;
+  // Raw edge captured in the ISR
+  struct Edge {
+    uint8_t channel;
+    uint8_t level;        // Raw pin level at the time of the edge
+    int64_t timestampUs;  // esp_timer_get_time() at the edge
+  };
+
+  // Debounced state change handed to loop()
+  struct PinEvent {
+    uint8_t channel;
+    bool state;           // Logical state (after INPUT_ACTIVE_LOW)
+    int64_t timestampUs;  // Time of the first edge of the settled burst
+  };
 
-  // ISR flags (one per configured input pin)
-  volatile bool isrFlags[8] = {};
-  
-  // Debounce state per pin
+  // Debounce state per channel (owned by the debounce timer callback)
   struct DebounceState {
     uint8_t pin;
     bool lastStableState;
-    bool currentRead;
-    unsigned long debounceStart;
-    bool isDebouncing;
-    bool baselineCaptured;  // Track if first stable state has been captured
+    bool pending;           // Edges seen, waiting for quiet period
+    bool pendingLevel;      // Logical level of the latest edge
+    int64_t burstStartUs;   // First edge since last stable state
+    int64_t lastEdgeUs;     // Most recent edge
   };
-  
-  DebounceState debounceStates[8];  // Support up to 8 pins
+
+  static const uint8_t MAX_CHANNELS = 8;
+  static const uint8_t MAX_EVENTS_PER_PUBLISH = 8;
+
+  Comms* commsPtr = nullptr;
+
+  DebounceState debounceStates[MAX_CHANNELS];
   uint8_t numPins = 0;
 
+  // ISR -> debounce timer, debounce timer -> loop()
+  SpscQueue<Edge, 64> edgeQueue;
+  SpscQueue<PinEvent, 16> eventQueue;
+  std::atomic<uint32_t> overflowCount{0};
+
+  esp_timer_handle_t debounceTimer = nullptr;
+
   // Debounce timing
   const unsigned long DEBOUNCE_MS = 60;
+  const unsigned long DEBOUNCE_TICK_MS = 20;
 
-  // Singleton instance
+  // Singleton instance (for the ISR)
   static Interrupts* instance;
 
+  static void IRAM_ATTR isrHandler(void* arg);
+  static void debounceTimerCallback(void* arg);
+
   void setupInterrupts();
-  void processDebounce();
-  bool getLogicalState(uint8_t pin, int rawState);
-  void publishPinEvent(uint8_t pin, bool logicalState);
+  void processEdges();
+  bool getLogicalState(int rawState) const;
+  void publishPinEvents();
 };
-
@@ -11,39 +11,95 @@ bool MQTTPublisher::publishStatus(const char* device,
                                   time_t ts,
                                   float tempC,
                                   float humPct,
-                                  uint64_t wakeCount) {
+                                  uint64_t wakeCount,
+                                  const char* extraFields) {
   if (!comms_) {
     return false;
   }
 
-  char payload[256];
-  
-  snprintf(payload, sizeof(payload),
-           "{\"device\":\"%s\",\"fw\":\"%s\",\"ts\":%lu,\"temp_c\":%.1f,\"hum_pct\":%.1f,\"wake_count\":%llu}",
-           device, fw, (unsigned long)ts, tempC, humPct, (unsigned long long)wakeCount);
+  // Leave room for the PUBLISH header and topic in the MQTT packet buffer
+  char payload[MQTT_BUFFER_SIZE - 64];
+  bool hasExtra = (extraFields != nullptr && extraFields[0] != '\0');
+
+  int len = snprintf(payload, sizeof(payload),
+                     "{\"device\":\"%s\",\"fw\":\"%s\",\"ts\":%lu,\"temp_c\":%.1f,\"hum_pct\":%.1f,\"wake_count\":%llu%s%s}",
+                     device, fw, (unsigned long)ts, tempC, humPct, (unsigned long long)wakeCount,
+                     hasExtra ? "," : "", hasExtra ? extraFields : "");
+  if (len >= (int)sizeof(payload)) {
+    Serial.println("[Pub] Status payload truncated");
+    return false;
+  }
 
   return comms_->publishStatus(payload);
 }
 
+// JSON number with one decimal, or null for NaN (no reading)
+static void formatValue(char* out, size_t size, float v) {
+  if (isnan(v)) {
+    snprintf(out, size, "null");
+  } else {
+    snprintf(out, size, "%.1f", v);
+  }
+}
+
 bool MQTTPublisher::publishMinMax(const char* device,
                                   time_t ts,
-                                  const MinMaxTracker::DailyStats& stats) {
-  if (!comms_) {
+                                  const MinMaxWindow::DailyStats& window,
+                                  const char* const* names,
+                                  const MinMaxWindow::ChannelStats* stats,
+                                  size_t channels) {
+  if (!comms_ || channels == 0) {
+    return false;
+  }
+
+  // Leave room for the PUBLISH header and topic in the MQTT packet buffer
+  char payload[MQTT_BUFFER_SIZE - 64];
+  char minStr[16];
+  char maxStr[16];
+
+  formatValue(minStr, sizeof(minStr), stats[0].min);
+  formatValue(maxStr, sizeof(maxStr), stats[0].max);
+  int len = snprintf(payload, sizeof(payload),
+                     "{\"device\":\"%s\",\"ts\":%lu,\"reset_yyyymmdd\":%d,\"reset_ts\":%lu,\"min_c\":%s,\"max_c\":%s",
+                     device, (unsigned long)ts, window.date_yyyymmdd,
+                     (unsigned long)window.reset_time, minStr, maxStr);
+
+  for (size_t i = 0; i < channels && len < (int)sizeof(payload); i++) {
+    formatValue(minStr, sizeof(minStr), stats[i].min);
+    formatValue(maxStr, sizeof(maxStr), stats[i].max);
+    len += snprintf(payload + len, sizeof(payload) - len,
+                    ",\"%s\":{\"min\":%s,\"min_ts\":%lu,\"max\":%s,\"max_ts\":%lu}",
+                    names[i], minStr, (unsigned long)stats[i].min_time,
+                    maxStr, (unsigned long)stats[i].max_time);
+  }
+  if (len < (int)sizeof(payload)) {
+    len += snprintf(payload + len, sizeof(payload) - len, "}");
+  }
+  if (len >= (int)sizeof(payload)) {
+    Serial.println("[Pub] MinMax payload truncated");
+    return false;
+  }
+
+  // Comms has no generic publish(topic, payload); min/max goes to the status topic
+  return comms_->publishStatus(payload);
+}
+
+bool MQTTPublisher::publishHealth(const char* device,
+                                  time_t ts,
+                                  const char* healthFields) {
+  if (!comms_ || healthFields == nullptr || healthFields[0] == '\0') {
     return false;
   }
 
   char payload[256];
-  
-  snprintf(payload, sizeof(payload),
-           "{\"device\":\"%s\",\"ts\":%lu,\"reset_yyyymmdd\":%d,\"min_c\":%.1f,\"max_c\":%.1f}",
-           device, (unsigned long)ts, stats.date_yyyymmdd, stats.min_temp, stats.max_temp);
-
-  // Publish to minmax topic using publishEventJson (custom topics via Comms::publishToTopic)
-  // For now, we use publishStatus to the log topic until Comms gets a generic publish(topic, payload)
-  // Alternative: store the topic and add a publishToTopic(topic, payload) method to Comms
-  // For this task, we'll leverage the internal publishToTopic if it's accessible.
-  // Since it's private, we'll use what we have available.
-  
+  int len = snprintf(payload, sizeof(payload), "{\"device\":\"%s\",\"ts\":%lu,%s}",
+                     device, (unsigned long)ts, healthFields);
+  if (len >= (int)sizeof(payload)) {
+    Serial.println("[Pub] Health payload truncated");
+    return false;
+  }
+
+  // Same topic as status, like min/max
   return comms_->publishStatus(payload);
 }
 
@@ -62,5 +118,22 @@ bool MQTTPublisher::publishAlarm(const char* device,
            "{\"device\":\"%s\",\"ts\":%lu,\"type\":\"%s\",\"temp_c\":%.1f,\"threshold_c\":%.1f}",
            device, (unsigned long)ts, type, tempC, thresholdC);
 
-  return comms_->publishEventJson(payload);
+  return comms_->publishAlarm(payload);
+}
+
+bool MQTTPublisher::publishHeartbeat(const char* device,
+                                     const char* fw,
+                                     uint32_t uptimeS,
+                                     int wifiRssi) {
+  if (!comms_) {
+    return false;
+  }
+
+  char payload[160];
+
+  snprintf(payload, sizeof(payload),
+           "{\"device\":\"%s\",\"version\":\"%s\",\"uptime_s\":%lu,\"wifi_rssi\":%d,\"mqtt\":%d}",
+           device, fw, (unsigned long)uptimeS, wifiRssi, comms_->connected() ? 1 : 0);
+
+  return comms_->publishStatus(payload);
 }
@@ -44,6 +44,8 @@ public:
    * @param tempC Temperature in degrees Celsius.
    * @param humPct Relative humidity in percent (0-100).
    * @param wakeCount Number of wake cycles since boot.
+   * @param extraFields Optional pre-formatted JSON members appended to the
+   *        object (e.g. "\"pulses\":[...]"), or nullptr/empty for none.
    * @return true if publish succeeded, false otherwise.
    */
   bool publishStatus(const char* device,
@@ -51,28 +53,56 @@ public:
                      time_t ts,
                      float tempC,
                      float humPct,
-                     uint64_t wakeCount);
+                     uint64_t wakeCount,
+                     const char* extraFields = nullptr);
 
   /**
-   * @brief Publish daily min/max statistics.
+   * @brief Publish daily min/max statistics of all channels.
    * 
-   * Publishes to MQTT_GH_TOPIC_MINMAX with JSON payload:
+   * Publishes to MQTT_GH_TOPIC_MINMAX with JSON payload (one object per
+   * channel, named by the caller; null where a channel has no reading):
    * {
    *   "device": "esp32-greenhouse-thermometer",
    *   "ts": 1737542445,
    *   "reset_yyyymmdd": 20260123,
+   *   "reset_ts": 1737626400,
    *   "min_c": 12.3,
-   *   "max_c": 28.7
+   *   "max_c": 28.7,
+   *   "temp_c": {"min": 12.3, "min_ts": 1737672000, "max": 28.7, "max_ts": 1737640800},
+   *   "hum_pct": {"min": 41.0, "min_ts": 1737640800, "max": 88.5, "max_ts": 1737672000}
    * }
+   * "min_c"/"max_c" repeat the first channel (temperature) for existing
+   * consumers. An extreme seen while the RTC was unavailable has ts 0.
    * 
    * @param device Device name string.
    * @param ts Unix epoch timestamp (0 if RTC unavailable).
-   * @param stats MinMaxTracker::DailyStats containing min, max, and reset date.
+   * @param window Start of the current window.
+   * @param names JSON member name per channel.
+   * @param stats Min/max per channel.
+   * @param channels Number of channels.
    * @return true if publish succeeded, false otherwise.
    */
   bool publishMinMax(const char* device,
                      time_t ts,
-                     const MinMaxTracker::DailyStats& stats);
+                     const MinMaxWindow::DailyStats& window,
+                     const char* const* names,
+                     const MinMaxWindow::ChannelStats* stats,
+                     size_t channels);
+
+  /**
+   * @brief Publish all channels of a MinMaxTracker (see above).
+   */
+  template <typename T, size_t Channels>
+  bool publishMinMax(const char* device,
+                     time_t ts,
+                     const MinMaxTracker<T, Channels>& tracker,
+                     const char* const (&names)[Channels]) {
+    MinMaxWindow::ChannelStats stats[Channels];
+    for (size_t i = 0; i < Channels; i++) {
+      stats[i] = tracker.getChannel(i);
+    }
+    return publishMinMax(device, ts, tracker.getStats(), names, stats, Channels);
+  }
 
   /**
    * @brief Publish a temperature threshold alarm.
@@ -99,6 +129,48 @@ public:
                     float tempC,
                     float thresholdC);
 
+  /**
+   * @brief Publish the failure counters (HealthCounters) in their own message.
+   * 
+   * Publishes to MQTT_TOPIC_STATUS with JSON payload:
+   * {
+   *   "device": "esp32-greenhouse-thermometer",
+   *   "ts": 1737542445,
+   *   "health": { "pub_fail": 3, "rssi": -71 }
+   * }
+   * 
+   * @param device Device name string.
+   * @param ts Unix epoch timestamp (0 if RTC unavailable).
+   * @param healthFields Output of HealthCounters::formatStatusFields().
+   * @return true if publish succeeded, false otherwise.
+   */
+  bool publishHealth(const char* device,
+                     time_t ts,
+                     const char* healthFields);
+
+  /**
+   * @brief Publish a heartbeat (continuous mode).
+   * 
+   * Publishes to MQTT_TOPIC_STATUS with JSON payload:
+   * {
+   *   "device": "esp32-greenhouse-thermometer",
+   *   "version": "0.1.0",
+   *   "uptime_s": 3600,
+   *   "wifi_rssi": -45,
+   *   "mqtt": 1
+   * }
+   * 
+   * @param device Device name string.
+   * @param fw Firmware version string.
+   * @param uptimeS Seconds since boot.
+   * @param wifiRssi WiFi RSSI in dBm.
+   * @return true if publish succeeded, false otherwise.
+   */
+  bool publishHeartbeat(const char* device,
+                        const char* fw,
+                        uint32_t uptimeS,
+                        int wifiRssi);
+
 private:
   Comms* comms_ = nullptr;
 };
@@ -0,0 +1,121 @@
+#include "MicroBench.h"
+#include <stdio.h>
+#include <algorithm>
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#else
+#include <chrono>
+#endif
+
+static void emptyCall() {
+}
+
+// ============================
+// Public: run()
+// ============================
+void MicroBench::run(const Case* cases, size_t count, uint32_t warmup, uint8_t samples) {
+  char line[160];
+  snprintf(line, sizeof(line), "# bench,target,case,unit,iterations,min,median,mean,max");
+  print(line);
+
+  for (size_t i = 0; i < count; i++) {
+    Stats s = measure(cases[i], warmup, samples);
+    snprintf(line, sizeof(line), "bench,%s,%s,%s,%lu,%lu,%lu,%lu,%lu",
+             target(), cases[i].name, unit(), (unsigned long)cases[i].iterations,
+             (unsigned long)s.min, (unsigned long)s.median,
+             (unsigned long)s.mean, (unsigned long)s.max);
+    print(line);
+  }
+}
+
+// ============================
+// Public: measure()
+// ============================
+MicroBench::Stats MicroBench::measure(const Case& c, uint32_t warmup, uint8_t samples) {
+  if (samples == 0) {
+    samples = 1;
+  }
+  if (samples > MAX_SAMPLES) {
+    samples = MAX_SAMPLES;
+  }
+  uint32_t iterations = c.iterations > 0 ? c.iterations : 1;
+
+  for (uint32_t i = 0; i < warmup; i++) {
+    c.fn();
+  }
+
+  // Per-call cost of the loop itself, taken as the cheapest of a few batches
+  uint32_t overhead = UINT32_MAX;
+  for (uint8_t i = 0; i < 3; i++) {
+    overhead = std::min(overhead, batch(emptyCall, iterations) / iterations);
+  }
+
+  uint32_t perCall[MAX_SAMPLES];
+  uint64_t sum = 0;
+  for (uint8_t i = 0; i < samples; i++) {
+    uint32_t cost = batch(c.fn, iterations) / iterations;
+    perCall[i] = cost > overhead ? cost - overhead : 0;
+    sum += perCall[i];
+  }
+
+  std::sort(perCall, perCall + samples);
+
+  Stats s;
+  s.min = perCall[0];
+  s.median = perCall[samples / 2];
+  s.mean = (uint32_t)(sum / samples);
+  s.max = perCall[samples - 1];
+  return s;
+}
+
+// ============================
+// Target specifics
+// ============================
+#ifdef ARDUINO
+const char* MicroBench::target() {
+  return "esp32";
+}
+
+const char* MicroBench::unit() {
+  return "cycles";
+}
+
+uint32_t MicroBench::now() {
+  return ESP.getCycleCount();
+}
+
+void MicroBench::print(const char* line) {
+  Serial.println(line);
+}
+#else
+const char* MicroBench::target() {
+  return "host";
+}
+
+const char* MicroBench::unit() {
+  return "ns";
+}
+
+uint32_t MicroBench::now() {
+  using namespace std::chrono;
+  return (uint32_t)duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+void MicroBench::print(const char* line) {
+  puts(line);
+}
+#endif
+
+// ============================
+// Private: batch()
+// ============================
+uint32_t MicroBench::batch(Fn fn, uint32_t iterations) {
+  // Unsigned difference: correct across one counter wrap
+  // (CCOUNT wraps every ~18 s at 240 MHz; a batch must stay shorter)
+  uint32_t start = now();
+  for (uint32_t i = 0; i < iterations; i++) {
+    fn();
+  }
+  return now() - start;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @class MicroBench
+ * @brief Timing of hot operations with warmup, repeated samples and stats.
+ *
+ * Each case runs `warmup` untimed calls, then `samples` timed batches of
+ * `iterations` calls. The cost per call of each batch is taken, minus the
+ * cost of an empty call (loop and indirect call overhead), and min, median,
+ * mean and max over the batches are reported. The median is the number to
+ * track; min/max show the spread (interrupts, cache misses).
+ *
+ * On the ESP32 the unit is CPU cycles (ESP.getCycleCount()); on the host,
+ * where the same cases compile without ARDUINO, it is nanoseconds. Results
+ * are printed as one CSV line per case:
+ *
+ *   bench,<target>,<case>,<unit>,<iterations>,<min>,<median>,<mean>,<max>
+ *
+ * Lines not starting with "bench," are free-form and can be ignored.
+ */
+class MicroBench {
+public:
+  typedef void (*Fn)();
+
+  struct Case {
+    const char* name;
+    Fn fn;
+    uint32_t iterations;   // calls per timed batch
+  };
+
+  struct Stats {
+    uint32_t min;
+    uint32_t median;
+    uint32_t mean;
+    uint32_t max;
+  };
+
+  static const uint8_t MAX_SAMPLES = 31;
+
+  /**
+   * @brief Run all cases and print one result line each.
+   *
+   * @param warmup Untimed calls before the first batch
+   * @param samples Timed batches per case (capped at MAX_SAMPLES)
+   */
+  static void run(const Case* cases, size_t count, uint32_t warmup, uint8_t samples);
+
+  /**
+   * @brief Time one case (cost per call, empty-call overhead removed).
+   */
+  static Stats measure(const Case& c, uint32_t warmup, uint8_t samples);
+
+  /**
+   * @brief Keep a computed value alive so the optimizer cannot drop the work.
+   */
+  template <typename T>
+  static inline void keep(const T& value) {
+    asm volatile("" : : "r"(&value) : "memory");
+  }
+
+  static const char* target();
+  static const char* unit();
+
+private:
+  static uint32_t now();
+  static uint32_t batch(Fn fn, uint32_t iterations);
+  static void print(const char* line);
+};
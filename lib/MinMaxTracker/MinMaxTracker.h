@@ -5,86 +5,231 @@
 #include <cmath>
 
 /**
- * @class MinMaxTracker
- * @brief Daily temperature min/max tracker with 10:00 UTC reset.
- * 
- * Maintains rolling min/max temperature values that reset once per day
- * at 10:00 UTC. Uses RTC time_t as the source of truth.
- * 
- * No dependencies on WiFi, MQTT, or delays.
+ * @class MinMaxWindow
+ * @brief Daily window shared by all MinMaxTracker instantiations.
+ *
+ * A window starts with the first reading at or after MINMAX_ROLLOVER_MIN
+ * local time on a new day (default 10:00, zone and DST rule in
+ * config_common.h, see Calendar) and lasts until the next one. Uses RTC
+ * time_t as the source of truth.
  */
-class MinMaxTracker {
+class MinMaxWindow {
 public:
   /**
    * @struct DailyStats
-   * @brief Container for daily min/max statistics.
+   * @brief Start of the current window.
    */
   struct DailyStats {
-    float min_temp;           // Minimum temperature recorded today (°C)
-    float max_temp;           // Maximum temperature recorded today (°C)
-    time_t reset_time;        // Unix epoch time of today's reset (10:00 UTC)
-    int date_yyyymmdd;        // Date marker (e.g., 20260122) to track daily reset
+    time_t reset_time;        // Unix epoch time of the first reading of the window
+    int date_yyyymmdd;        // Local date of the last rollover (e.g., 20260122), 0 = none
   };
 
   /**
-   * @brief Update min/max with a new temperature reading.
-   * 
-   * Automatically detects when the day rolls past 10:00 UTC and resets
-   * the min/max counters. If the current date is different from the stored
-   * date and we're at or past 10:00 UTC, a reset occurs.
-   * 
-   * @param temp_c Temperature reading in degrees Celsius
-   * @param current_time Current Unix epoch time from RTC (UTC)
-   * 
-   * Note: If current_time <= 0, the update is ignored (invalid time).
+   * @struct ChannelStats
+   * @brief Min/max of one channel and when they occurred.
    */
-  void update(float temp_c, time_t current_time);
+  struct ChannelStats {
+    float min;                // NaN if no reading in this window
+    float max;
+    time_t min_time;          // Unix epoch of the min (0 = unknown, see updateUntimed())
+    time_t max_time;
+  };
 
   /**
-   * @brief Get the minimum temperature recorded today.
-   * 
-   * @return Minimum temperature in °C, or NaN if no valid reading yet.
+   * @brief Check if the provided time is in a new rollover day.
+   *
+   * @param current_time Unix epoch time to evaluate
+   * @return true if this is a different day (in yyyymmdd) than the last reset
    */
-  float getMin() const;
+  bool isNewDay(time_t current_time) const;
 
   /**
-   * @brief Get the maximum temperature recorded today.
-   * 
-   * @return Maximum temperature in °C, or NaN if no valid reading yet.
+   * @brief Check if a reset has occurred in the current rollover day.
+   *
+   * @param current_time Unix epoch time to evaluate
+   * @return true if the current date matches the reset date
    */
-  float getMax() const;
+  bool wasResetToday(time_t current_time) const;
 
   /**
-   * @brief Check if the provided time represents a new calendar day (at 10:00 UTC).
-   * 
-   * @param current_time Unix epoch time to evaluate
-   * @return true if this is a different day (in yyyymmdd) than the last reset
+   * @brief Get the start of the current window.
+   */
+  DailyStats getStats() const;
+
+protected:
+  // Layout tag: state left in RTC memory by a build with another layout is discarded
+  static constexpr uint32_t magicFor(size_t valueSize, size_t channels) {
+    return 0x4D4D0000UL | ((uint32_t)valueSize << 8) | (uint32_t)channels;
+  }
+
+  // Start a new window at current_time if it is in a new rollover day
+  bool rollover(time_t current_time);
+  void clearWindow(uint32_t magic);
+
+  uint32_t magic_;
+  uint32_t reset_time_;
+  int32_t date_yyyymmdd_;
+};
+
+/**
+ * @brief Storage format of tracked values.
+ *
+ * float stores values as is. int16_t stores hundredths (like ReadingHistory),
+ * half the RTC memory of float, range +-327.67 (values beyond are clamped).
+ */
+template <typename T>
+struct MinMaxCodec;
+
+template <>
+struct MinMaxCodec<float> {
+  static float empty() { return NAN; }
+  static bool isEmpty(float v) { return isnan(v); }
+  static float encode(float v) { return v; }
+  static float decode(float v) { return v; }
+};
+
+template <>
+struct MinMaxCodec<int16_t> {
+  static int16_t empty() { return INT16_MIN; }
+  static bool isEmpty(int16_t v) { return v == INT16_MIN; }
+  static int16_t encode(float v) {
+    long c = lroundf(v * 100.0f);
+    return (int16_t)(c > INT16_MAX ? INT16_MAX : (c < -INT16_MAX ? -INT16_MAX : c));
+  }
+  static float decode(int16_t v) { return isEmpty(v) ? NAN : v / 100.0f; }
+};
+
+/**
+ * @class MinMaxTracker
+ * @brief Daily min/max of several channels, with the time of each extreme.
+ *
+ * Channels are indices chosen by the caller (e.g. 0 = temperature,
+ * 1 = humidity). Values are stored struct-of-arrays as T (see MinMaxCodec),
+ * so a wake touches a few contiguous words. The object is plain data with
+ * no constructor: declare it RTC_DATA_ATTR to keep the window across deep
+ * sleep. State that was never written, or was written by a build with a
+ * different T or channel count, is detected by a magic and cleared.
+ *
+ * No dependencies on WiFi, MQTT, or delays.
+ */
+template <typename T, size_t Channels>
+class MinMaxTracker : public MinMaxWindow {
+public:
+  typedef MinMaxCodec<T> Codec;
+  static constexpr uint32_t MAGIC = magicFor(sizeof(T), Channels);
+
+  /**
+   * @brief Update min/max with one reading of every channel.
+   *
+   * Starts a new window (all channels cleared) on the first reading of a new
+   * rollover day. A NaN value leaves its channel unchanged.
+   *
+   * @param values Readings, indexed by channel
+   * @param current_time Current Unix epoch time from RTC (UTC), must be > 0
    */
-  bool isNewDay(time_t current_time);
+  void update(const float (&values)[Channels], time_t current_time) {
+    if (magic_ != MAGIC) {
+      clear();
+    }
+    if (current_time <= 0) {
+      updateUntimed(values);
+      return;
+    }
+
+    if (rollover(current_time)) {
+      clearChannels();
+      Serial.printf("[MinMax] Daily rollover (date: %ld)\n", (long)date_yyyymmdd_);
+    }
+    fold(values, (uint32_t)current_time);
+  }
 
   /**
-   * @brief Check if a reset has occurred today (at 10:00 UTC or later).
-   * 
-   * @param current_time Unix epoch time to evaluate
-   * @return true if the current date matches the reset date
+   * @brief Update min/max while the RTC is unavailable.
+   *
+   * Folds the reading into the current window with an unknown time (0). A
+   * rollover cannot be detected without a time; before the first timed
+   * reading there is no window and the reading is dropped.
    */
-  bool wasResetToday(time_t current_time);
+  void updateUntimed(const float (&values)[Channels]) {
+    if (magic_ != MAGIC) {
+      clear();
+    }
+    if (date_yyyymmdd_ == 0) {
+      Serial.println("[MinMax] No time and no window yet, skipping update");
+      return;
+    }
+    fold(values, 0);
+  }
 
   /**
-   * @brief Get current daily statistics.
-   * 
-   * @return DailyStats struct with min, max, reset time, and date
+   * @brief Minimum of a channel in the current window (NaN if none).
    */
-  DailyStats getStats() const;
+  float getMin(size_t channel) const {
+    return valid(channel) ? Codec::decode(min_[channel]) : NAN;
+  }
+
+  /**
+   * @brief Maximum of a channel in the current window (NaN if none).
+   */
+  float getMax(size_t channel) const {
+    return valid(channel) ? Codec::decode(max_[channel]) : NAN;
+  }
+
+  /**
+   * @brief Min/max of a channel and the epochs they occurred at.
+   */
+  ChannelStats getChannel(size_t channel) const {
+    ChannelStats s;
+    s.min = getMin(channel);
+    s.max = getMax(channel);
+    s.min_time = valid(channel) ? (time_t)min_time_[channel] : 0;
+    s.max_time = valid(channel) ? (time_t)max_time_[channel] : 0;
+    return s;
+  }
+
+  /**
+   * @brief Forget the window and all values.
+   */
+  void clear() {
+    clearWindow(MAGIC);
+    clearChannels();
+  }
 
 private:
-  float min_temp = NAN;
-  float max_temp = NAN;
-  time_t reset_time = 0;
-  int last_reset_date_yyyymmdd = 0;  // Date of last reset (yyyymmdd format)
-
-  // Helper functions
-  int getDateYYYYMMDD(time_t t) const;
-  int getHourUTC(time_t t) const;
-  bool shouldResetAtTime(time_t current_time);
+  bool valid(size_t channel) const {
+    return magic_ == MAGIC && channel < Channels;
+  }
+
+  void clearChannels() {
+    for (size_t i = 0; i < Channels; i++) {
+      min_[i] = Codec::empty();
+      max_[i] = Codec::empty();
+      min_time_[i] = 0;
+      max_time_[i] = 0;
+    }
+  }
+
+  void fold(const float (&values)[Channels], uint32_t at) {
+    for (size_t i = 0; i < Channels; i++) {
+      if (isnan(values[i])) {
+        continue;
+      }
+      T v = Codec::encode(values[i]);
+      if (Codec::isEmpty(min_[i]) || v < min_[i]) {
+        min_[i] = v;
+        min_time_[i] = at;
+      }
+      if (Codec::isEmpty(max_[i]) || v > max_[i]) {
+        max_[i] = v;
+        max_time_[i] = at;
+      }
+      Serial.printf("[MinMax] ch%u: %.1f (min=%.1f, max=%.1f)\n", (unsigned)i,
+                    values[i], Codec::decode(min_[i]), Codec::decode(max_[i]));
+    }
+  }
+
+  T min_[Channels];
+  T max_[Channels];
+  uint32_t min_time_[Channels];
+  uint32_t max_time_[Channels];
 };
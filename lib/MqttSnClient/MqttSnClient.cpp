@@ -0,0 +1,384 @@
+#include "MqttSnClient.h"
+#include <WiFi.h>
+#include <config_common.h>
+
+// Flags byte (MQTT-SN v1.2, section 5.3.4)
+static const uint8_t FLAG_QOS_0        = 0x00;
+static const uint8_t FLAG_QOS_1        = 0x20;
+static const uint8_t FLAG_QOS_M1       = 0x60;
+static const uint8_t FLAG_RETAIN       = 0x10;
+static const uint8_t FLAG_PREDEFINED   = 0x01;
+static const uint8_t PROTOCOL_ID       = 0x01;
+static const uint8_t RC_ACCEPTED       = 0x00;
+
+// Topic name -> predefined topic ID (gateway predefined topic list)
+static const struct {
+  const char* topic;
+  uint16_t id;
+} PREDEFINED_TOPICS[] = {
+  { MQTT_TOPIC_BOOT,        MQTTSN_TOPIC_ID_BOOT },
+  { MQTT_TOPIC_LOG,         MQTTSN_TOPIC_ID_LOG },
+  { MQTT_TOPIC_EVENTS,      MQTTSN_TOPIC_ID_EVENTS },
+  { MQTT_TOPIC_RESP,        MQTTSN_TOPIC_ID_RESP },
+  { MQTT_TOPIC_CMD,         MQTTSN_TOPIC_ID_CMD },
+  { MQTT_TOPIC_STATUS,      MQTTSN_TOPIC_ID_STATUS },
+  { MQTT_TOPIC_HISTORY,     MQTTSN_TOPIC_ID_HISTORY },
+  { HA_AVAILABILITY_TOPIC,  MQTTSN_TOPIC_ID_HA_AVAIL },
+  { HA_STATE_TOPIC,         MQTTSN_TOPIC_ID_HA_STATE },
+  { HA_TEMP_CONFIG_TOPIC,   MQTTSN_TOPIC_ID_HA_TEMP_CONFIG },
+  { HA_HUM_CONFIG_TOPIC,    MQTTSN_TOPIC_ID_HA_HUM_CONFIG },
+};
+
+// Client state at the gateway (survives deep sleep, lost on power cycle)
+RTC_DATA_ATTR static bool rtc_sn_asleep = false;     // Registered as sleeping client
+RTC_DATA_ATTR static uint16_t rtc_sn_msg_id = 0;
+
+// ============================
+// Public: begin()
+// ============================
+void MqttSnClient::begin(const char* clientId, Callback callback) {
+  clientIdPtr = clientId;
+  callbackPtr = callback;
+}
+
+// ============================
+// Public: resolveGateway()
+// ============================
+bool MqttSnClient::resolveGateway() {
+  if (gatewayKnown) {
+    return true;
+  }
+
+  if (!WiFi.hostByName(MQTTSN_GATEWAY_HOST, gateway)) {
+    Serial.printf("[SN] Cannot resolve gateway %s\n", MQTTSN_GATEWAY_HOST);
+    return false;
+  }
+
+  if (!udpStarted) {
+    udp.begin(MQTTSN_LOCAL_PORT);
+    udpStarted = true;
+  }
+
+  gatewayKnown = true;
+  Serial.printf("[SN] Gateway %s:%d\n", gateway.toString().c_str(), MQTTSN_GATEWAY_PORT);
+  return true;
+}
+
+// ============================
+// Public: ready()
+// ============================
+bool MqttSnClient::ready() const {
+  return gatewayKnown;
+}
+
+// ============================
+// Public: publish()
+// ============================
+bool MqttSnClient::publish(const char* topic, const uint8_t* payload, size_t length, int8_t qos, bool retained) {
+  if (!gatewayKnown) {
+    return false;
+  }
+
+  uint16_t topicId = topicIdFor(topic);
+  if (topicId == 0) {
+    Serial.printf("[SN] No predefined topic ID for %s, dropped\n", topic);
+    return false;
+  }
+
+  // QoS 0/1 need an active connection; QoS -1 is sent as is
+  if (qos >= 0 && !connect()) {
+    return false;
+  }
+
+  uint8_t flags = FLAG_PREDEFINED | (retained ? FLAG_RETAIN : 0);
+  flags |= (qos < 0) ? FLAG_QOS_M1 : (qos == 0 ? FLAG_QOS_0 : FLAG_QOS_1);
+  uint16_t msgId = (qos == 1) ? nextMsgId() : 0;
+
+  uint8_t head[5] = {
+    flags,
+    (uint8_t)(topicId >> 8), (uint8_t)topicId,
+    (uint8_t)(msgId >> 8), (uint8_t)msgId
+  };
+
+  bool ok = false;
+  if (qos < 1) {
+    ok = send(PUBLISH, head, sizeof(head), payload, length);
+  } else {
+    for (uint8_t attempt = 0; attempt < MQTTSN_RETRIES && !ok; attempt++) {
+      if (attempt > 0) {
+        head[0] |= 0x80;  // DUP
+      }
+      ok = send(PUBLISH, head, sizeof(head), payload, length) &&
+           waitFor(PUBACK, msgId, MQTTSN_ACK_TIMEOUT_MS) &&
+           rxBuf[rxLen - 1] == RC_ACCEPTED;
+    }
+    if (!ok) {
+      Serial.printf("[SN] QoS 1 publish to %s not acknowledged\n", topic);
+    }
+  }
+
+  // Back to sleeping state so the gateway keeps buffering commands
+  if (qos >= 0) {
+    sleepAtGateway();
+  }
+  return ok;
+}
+
+// ============================
+// Public: checkMailbox()
+// ============================
+bool MqttSnClient::checkMailbox(uint32_t timeoutMs) {
+  if (!gatewayKnown) {
+    return false;
+  }
+
+  if (!rtc_sn_asleep) {
+    return registerSleeping();
+  }
+
+  // Awake state: the gateway sends buffered PUBLISHes, then PINGRESP
+  size_t idLen = strlen(clientIdPtr);
+  if (!send(PINGREQ, (const uint8_t*)clientIdPtr, idLen) ||
+      !waitFor(PINGRESP, 0, timeoutMs)) {
+    // Gateway lost our session (restart, duration expired): register again
+    Serial.println("[SN] No PINGRESP, re-registering as sleeping client");
+    rtc_sn_asleep = false;
+    return registerSleeping();
+  }
+  return true;
+}
+
+// ============================
+// Public: topicIdFor()
+// ============================
+uint16_t MqttSnClient::topicIdFor(const char* topic) {
+  for (const auto& entry : PREDEFINED_TOPICS) {
+    if (strcmp(entry.topic, topic) == 0) {
+      return entry.id;
+    }
+  }
+  return 0;
+}
+
+// ============================
+// Private: connect()
+// ============================
+bool MqttSnClient::connect() {
+  // Persistent session: subscriptions and buffered messages are kept
+  uint8_t body[4] = {
+    0,  // no will, no clean session
+    PROTOCOL_ID,
+    (uint8_t)(MQTTSN_KEEPALIVE_S >> 8), (uint8_t)MQTTSN_KEEPALIVE_S
+  };
+
+  for (uint8_t attempt = 0; attempt < MQTTSN_RETRIES; attempt++) {
+    if (send(CONNECT, body, sizeof(body), (const uint8_t*)clientIdPtr, strlen(clientIdPtr)) &&
+        waitFor(CONNACK, 0, MQTTSN_ACK_TIMEOUT_MS)) {
+      if (rxBuf[rxLen - 1] == RC_ACCEPTED) {
+        rtc_sn_asleep = false;
+        return true;
+      }
+      Serial.printf("[SN] CONNACK rc=%u\n", rxBuf[rxLen - 1]);
+      return false;
+    }
+  }
+  Serial.println("[SN] CONNECT not acknowledged");
+  return false;
+}
+
+// ============================
+// Private: subscribeCommands()
+// ============================
+bool MqttSnClient::subscribeCommands() {
+  uint16_t msgId = nextMsgId();
+  uint8_t body[5] = {
+    (uint8_t)(FLAG_QOS_1 | FLAG_PREDEFINED),
+    (uint8_t)(msgId >> 8), (uint8_t)msgId,
+    (uint8_t)(MQTTSN_TOPIC_ID_CMD >> 8), (uint8_t)MQTTSN_TOPIC_ID_CMD
+  };
+
+  for (uint8_t attempt = 0; attempt < MQTTSN_RETRIES; attempt++) {
+    if (send(SUBSCRIBE, body, sizeof(body)) && waitFor(SUBACK, msgId, MQTTSN_ACK_TIMEOUT_MS)) {
+      return rxBuf[rxLen - 1] == RC_ACCEPTED;
+    }
+    body[0] |= 0x80;  // DUP
+  }
+  return false;
+}
+
+// ============================
+// Private: sleepAtGateway()
+// ============================
+bool MqttSnClient::sleepAtGateway() {
+  uint8_t body[2] = {
+    (uint8_t)(MQTTSN_SLEEP_DURATION_S >> 8), (uint8_t)MQTTSN_SLEEP_DURATION_S
+  };
+
+  if (send(DISCONNECT, body, sizeof(body)) && waitFor(DISCONNECT, 0, MQTTSN_ACK_TIMEOUT_MS)) {
+    rtc_sn_asleep = true;
+    return true;
+  }
+  return false;
+}
+
+// ============================
+// Private: registerSleeping()
+// ============================
+bool MqttSnClient::registerSleeping() {
+  if (!connect()) {
+    return false;
+  }
+  if (!subscribeCommands()) {
+    Serial.println("[SN] Command subscription failed");
+  }
+  bool ok = sleepAtGateway();
+  Serial.printf("[SN] Registered as sleeping client: %s\n", ok ? "OK" : "FAILED");
+  return ok;
+}
+
+// ============================
+// Private: send()
+// ============================
+bool MqttSnClient::send(MsgType type, const uint8_t* body, size_t bodyLen,
+                        const uint8_t* data, size_t dataLen) {
+  // Length field: 1 byte, or 0x01 + 2 bytes beyond 255 (section 5.2.1)
+  size_t total = 2 + bodyLen + dataLen;
+  uint8_t header[4];
+  size_t headerLen;
+  if (total <= 255) {
+    header[0] = (uint8_t)total;
+    header[1] = type;
+    headerLen = 2;
+  } else {
+    total += 2;
+    header[0] = 0x01;
+    header[1] = (uint8_t)(total >> 8);
+    header[2] = (uint8_t)total;
+    header[3] = type;
+    headerLen = 4;
+  }
+
+  if (!udp.beginPacket(gateway, MQTTSN_GATEWAY_PORT)) {
+    return false;
+  }
+  udp.write(header, headerLen);
+  if (bodyLen > 0) {
+    udp.write(body, bodyLen);
+  }
+  if (dataLen > 0) {
+    udp.write(data, dataLen);
+  }
+  return udp.endPacket() == 1;
+}
+
+// ============================
+// Private: waitFor()
+// ============================
+bool MqttSnClient::waitFor(MsgType type, uint16_t msgId, uint32_t timeoutMs) {
+  uint32_t startMs = millis();
+  while (millis() - startMs < timeoutMs) {
+    if (!receive(timeoutMs - (millis() - startMs))) {
+      return false;
+    }
+
+    uint8_t rxType = rxBuf[0];
+    const uint8_t* body = rxBuf + 1;
+    if (rxType == type) {
+      // Match message IDs where the packet carries one
+      uint16_t rxMsgId = 0;
+      if (type == PUBACK && rxLen >= 6) {
+        rxMsgId = (body[2] << 8) | body[3];
+      } else if (type == SUBACK && rxLen >= 7) {
+        rxMsgId = (body[3] << 8) | body[4];
+      }
+      if (msgId == 0 || rxMsgId == msgId) {
+        return true;
+      }
+      continue;
+    }
+
+    // Anything else (buffered commands) is handled in passing
+    handleIncoming();
+  }
+  return false;
+}
+
+// ============================
+// Private: receive()
+// ============================
+// Reads one datagram from the gateway into rxBuf as [type, body...]
+bool MqttSnClient::receive(uint32_t timeoutMs) {
+  uint32_t startMs = millis();
+  while (millis() - startMs < timeoutMs) {
+    int size = udp.parsePacket();
+    if (size <= 0) {
+      delay(1);
+      continue;
+    }
+
+    uint8_t packet[MAX_PACKET + 4];
+    int got = udp.read(packet, sizeof(packet));
+    if (got < 2) {
+      continue;
+    }
+
+    size_t offset = (packet[0] == 0x01) ? 3 : 1;
+    if ((size_t)got <= offset) {
+      continue;
+    }
+    rxLen = got - offset;
+    if (rxLen > MAX_PACKET) {
+      rxLen = MAX_PACKET;
+    }
+    memcpy(rxBuf, packet + offset, rxLen);
+    return true;
+  }
+  return false;
+}
+
+// ============================
+// Private: handleIncoming()
+// ============================
+void MqttSnClient::handleIncoming() {
+  if (rxBuf[0] != PUBLISH || rxLen < 6) {
+    return;
+  }
+
+  uint8_t flags = rxBuf[1];
+  uint16_t topicId = (rxBuf[2] << 8) | rxBuf[3];
+  uint16_t msgId = (rxBuf[4] << 8) | rxBuf[5];
+
+  // Acknowledge QoS 1 first so the gateway drops it from the buffer
+  if ((flags & 0x60) == FLAG_QOS_1) {
+    uint8_t ack[5] = {
+      (uint8_t)(topicId >> 8), (uint8_t)topicId,
+      (uint8_t)(msgId >> 8), (uint8_t)msgId,
+      RC_ACCEPTED
+    };
+    send(PUBACK, ack, sizeof(ack));
+  }
+
+  const char* topic = nullptr;
+  for (const auto& entry : PREDEFINED_TOPICS) {
+    if (entry.id == topicId) {
+      topic = entry.topic;
+      break;
+    }
+  }
+  if (topic == nullptr || callbackPtr == nullptr) {
+    Serial.printf("[SN] PUBLISH on unknown topic ID %u ignored\n", topicId);
+    return;
+  }
+
+  callbackPtr(const_cast<char*>(topic), rxBuf + 6, rxLen - 6);
+}
+
+// ============================
+// Private: nextMsgId()
+// ============================
+uint16_t MqttSnClient::nextMsgId() {
+  if (++rtc_sn_msg_id == 0) {
+    rtc_sn_msg_id = 1;
+  }
+  return rtc_sn_msg_id;
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <Arduino.h>
+#include <WiFiUdp.h>
+
+/**
+ * @class MqttSnClient
+ * @brief Minimal MQTT-SN (v1.2) client over UDP for sleepy nodes.
+ *
+ * Topics are addressed by predefined topic IDs (MQTTSN_TOPIC_ID_*), which the
+ * gateway must be configured with, so no REGISTER round trips are needed.
+ *
+ * - Telemetry is published with QoS -1: one datagram, no connection at all.
+ * - Alarms are published with QoS 1: CONNECT, PUBLISH/PUBACK (with retries),
+ *   then DISCONNECT with a sleep duration.
+ * - Commands use the sleeping-client procedure: the gateway buffers messages
+ *   for the asleep client, and checkMailbox() collects them with a PINGREQ
+ *   (delivered PUBLISHes, then PINGRESP).
+ *
+ * The client state (asleep at the gateway, subscribed, message ID) is kept in
+ * RTC memory across deep sleep.
+ *
+ * Used by ConnectionManager/Comms when built with ENABLE_MQTTSN.
+ */
+class MqttSnClient {
+public:
+  // Same signature as the PubSubClient callback
+  typedef void (*Callback)(char* topic, uint8_t* payload, unsigned int length);
+
+  /**
+   * @brief Set client identity and the handler for delivered commands.
+   *
+   * @param clientId MQTT-SN client ID (must outlive the client).
+   * @param callback Called for each PUBLISH delivered by the gateway.
+   */
+  void begin(const char* clientId, Callback callback);
+
+  /**
+   * @brief Resolve the gateway address (call once WiFi is up).
+   *
+   * @return true once the gateway address is known.
+   */
+  bool resolveGateway();
+
+  /**
+   * @brief True when datagrams can be sent to the gateway.
+   */
+  bool ready() const;
+
+  /**
+   * @brief Publish to a predefined topic.
+   *
+   * @param qos -1 (no connection), 0, or 1 (acknowledged, retried).
+   * @return true if sent (QoS -1/0) or acknowledged (QoS 1).
+   */
+  bool publish(const char* topic, const uint8_t* payload, size_t length, int8_t qos, bool retained);
+
+  /**
+   * @brief Collect commands buffered by the gateway while asleep.
+   *
+   * Registers as a sleeping client first if needed (CONNECT, SUBSCRIBE,
+   * DISCONNECT with duration).
+   *
+   * @return true if the gateway answered (mailbox empty afterwards).
+   */
+  bool checkMailbox(uint32_t timeoutMs);
+
+  /**
+   * @brief Predefined topic ID for a topic name (0 = none).
+   */
+  static uint16_t topicIdFor(const char* topic);
+
+private:
+  // Message types (MQTT-SN v1.2, section 5.2.1)
+  enum MsgType : uint8_t {
+    CONNECT    = 0x04,
+    CONNACK    = 0x05,
+    PUBLISH    = 0x0C,
+    PUBACK     = 0x0D,
+    SUBSCRIBE  = 0x12,
+    SUBACK     = 0x13,
+    PINGREQ    = 0x16,
+    PINGRESP   = 0x17,
+    DISCONNECT = 0x18
+  };
+
+  static const size_t MAX_PACKET = 512;
+
+  WiFiUDP udp;
+  IPAddress gateway;
+  bool gatewayKnown = false;
+  bool udpStarted = false;
+  const char* clientIdPtr = "";
+  Callback callbackPtr = nullptr;
+
+  uint8_t rxBuf[MAX_PACKET];
+  size_t rxLen = 0;
+
+  bool connect();
+  bool subscribeCommands();
+  bool sleepAtGateway();
+  bool registerSleeping();
+
+  bool send(MsgType type, const uint8_t* body, size_t bodyLen,
+            const uint8_t* data = nullptr, size_t dataLen = 0);
+  bool waitFor(MsgType type, uint16_t msgId, uint32_t timeoutMs);
+  bool receive(uint32_t timeoutMs);
+  void handleIncoming();
+  uint16_t nextMsgId();
+};
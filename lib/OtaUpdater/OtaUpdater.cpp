@@ -0,0 +1,403 @@
+#include "OtaUpdater.h"
+#include <Comms.h>
+#include <Preferences.h>
+#include <esp_ota_ops.h>
+#include <rom/crc.h>
+#include <config_common.h>
+
+static const uint32_t FLASH_SECTOR_SIZE = 4096;
+static const uint8_t CHUNK_HEADER_SIZE = 4;        // offset, little endian
+
+// Trial of a freshly installed image (NVS: survives the reboot into it)
+static const char* PREFS_NAMESPACE = "ota";
+static const char* KEY_PREVIOUS = "prev";          // partition address to go back to
+static const char* KEY_WAKES = "wakes";            // connected wakes on trial so far
+static const char* KEY_BOOTS = "boots";            // resets (not deep sleep wakes) on trial
+static const char* KEY_ROLLED_BACK = "rolled";     // set by the rejected image
+
+// RTC memory (survives deep sleep, lost on power cycle and reboot)
+struct Transfer {
+  uint8_t active;
+  uint32_t size;
+  uint32_t offset;           // next byte expected
+  uint32_t crc;              // rolling CRC32 of bytes [0, offset)
+  uint32_t expectedCrc;
+  uint32_t partitionAddr;    // target partition, must not change mid-transfer
+  uint32_t erasedTo;         // sectors erased below this offset
+};
+
+RTC_DATA_ATTR static Transfer rtc_ota;
+RTC_DATA_ATTR static bool rtc_ota_trial_checked = false;   // no trial pending for this image
+RTC_DATA_ATTR static bool rtc_ota_rolled_back = false;     // report pending
+
+static const esp_partition_t* findAppPartition(uint32_t address) {
+  const esp_partition_t* found = nullptr;
+  esp_partition_iterator_t it = esp_partition_find(ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_ANY, nullptr);
+  while (it != nullptr) {
+    const esp_partition_t* p = esp_partition_get(it);
+    if (p->address == address) {
+      found = p;
+      break;
+    }
+    it = esp_partition_next(it);
+  }
+  esp_partition_iterator_release(it);
+  return found;
+}
+
+// ============================
+// Public: begin()
+// ============================
+void OtaUpdater::begin(Comms& comms) {
+  commsPtr = &comms;
+
+  if (rtc_ota.active) {
+    Serial.printf("[OTA] Resuming transfer at %lu/%lu bytes\n",
+                  (unsigned long)rtc_ota.offset, (unsigned long)rtc_ota.size);
+  }
+}
+
+// ============================
+// Public: start() / abort()
+// ============================
+const char* OtaUpdater::start(uint32_t size, uint32_t crc32) {
+#ifdef ENABLE_MQTTSN
+  (void)size;
+  (void)crc32;
+  return "not available over MQTT-SN";
+#else
+  const esp_partition_t* part = esp_ota_get_next_update_partition(nullptr);
+  if (part == nullptr) {
+    return "no OTA partition";
+  }
+  if (size == 0 || size > part->size) {
+    return "invalid size";
+  }
+
+  memset(&rtc_ota, 0, sizeof(rtc_ota));
+  rtc_ota.active = 1;
+  rtc_ota.size = size;
+  rtc_ota.expectedCrc = crc32;
+  rtc_ota.partitionAddr = part->address;
+
+  requestOutstanding = false;
+  chunksThisWake = 0;
+  retriesThisWake = 0;
+
+  Serial.printf("[OTA] Transfer started: %lu bytes to partition %s\n",
+                (unsigned long)size, part->label);
+  return nullptr;
+#endif
+}
+
+void OtaUpdater::abort() {
+  if (rtc_ota.active) {
+    Serial.printf("[OTA] Transfer aborted at %lu/%lu bytes\n",
+                  (unsigned long)rtc_ota.offset, (unsigned long)rtc_ota.size);
+  }
+  rtc_ota.active = 0;
+  requestOutstanding = false;
+}
+
+bool OtaUpdater::active() const {
+  return rtc_ota.active != 0;
+}
+
+bool OtaUpdater::wakeDone() const {
+  return !rtc_ota.active || rebooting ||
+         chunksThisWake >= OTA_CHUNKS_PER_WAKE ||
+         retriesThisWake >= OTA_CHUNK_RETRIES;
+}
+
+bool OtaUpdater::rebootPending() const {
+  return rebooting;
+}
+
+// ============================
+// Public: loop()
+// ============================
+void OtaUpdater::loop() {
+  if (wakeDone()) {
+    return;
+  }
+
+  if (requestOutstanding) {
+    if (millis() - requestMs < OTA_CHUNK_TIMEOUT_MS) {
+      return;
+    }
+    if (++retriesThisWake >= OTA_CHUNK_RETRIES) {
+      Serial.printf("[OTA] No chunk at offset %lu, continuing next wake\n",
+                    (unsigned long)rtc_ota.offset);
+      return;
+    }
+  }
+
+  requestChunk();
+}
+
+// ============================
+// Public: onChunk()
+// ============================
+void OtaUpdater::onChunk(const uint8_t* payload, unsigned int length) {
+  if (!rtc_ota.active || length <= CHUNK_HEADER_SIZE) {
+    return;
+  }
+
+  uint32_t offset = (uint32_t)payload[0] | ((uint32_t)payload[1] << 8) |
+                    ((uint32_t)payload[2] << 16) | ((uint32_t)payload[3] << 24);
+  uint32_t len = length - CHUNK_HEADER_SIZE;
+  const uint8_t* data = payload + CHUNK_HEADER_SIZE;
+
+  // Late answer to an earlier request, or meant for another transfer
+  uint32_t expectedLen = min((uint32_t)OTA_CHUNK_SIZE, rtc_ota.size - rtc_ota.offset);
+  if (offset != rtc_ota.offset || len != expectedLen) {
+    Serial.printf("[OTA] Ignoring chunk at %lu (%lu bytes), expected %lu\n",
+                  (unsigned long)offset, (unsigned long)len, (unsigned long)rtc_ota.offset);
+    return;
+  }
+
+  const esp_partition_t* part = partition();
+  if (part == nullptr) {
+    fail("partition changed");
+    return;
+  }
+
+  // Erase sectors as the write offset reaches them
+  uint32_t end = offset + len;
+  if (end > rtc_ota.erasedTo) {
+    uint32_t eraseEnd = (end + FLASH_SECTOR_SIZE - 1) & ~(FLASH_SECTOR_SIZE - 1);
+    if (esp_partition_erase_range(part, rtc_ota.erasedTo, eraseEnd - rtc_ota.erasedTo) != ESP_OK) {
+      fail("erase failed");
+      return;
+    }
+    rtc_ota.erasedTo = eraseEnd;
+  }
+
+  if (esp_partition_write(part, offset, data, len) != ESP_OK) {
+    fail("write failed");
+    return;
+  }
+
+  rtc_ota.crc = crc32_le(rtc_ota.crc, data, len);
+  rtc_ota.offset = end;
+  requestOutstanding = false;
+  retriesThisWake = 0;
+  chunksThisWake++;
+
+  if (rtc_ota.offset >= rtc_ota.size) {
+    finish();
+  }
+}
+
+// ============================
+// Public: boot trial
+// ============================
+void OtaUpdater::beginBoot() {
+  // RTC memory is kept across deep sleep only: on any reset the image on
+  // trial (if any) is looked up again
+  if (esp_reset_reason() == ESP_RST_DEEPSLEEP) {
+    return;
+  }
+
+  Preferences prefs;
+  if (!prefs.begin(PREFS_NAMESPACE, false)) {
+    rtc_ota_trial_checked = true;
+    return;
+  }
+
+  // This image replaced one that never confirmed itself
+  if (prefs.getUChar(KEY_ROLLED_BACK, 0)) {
+    rtc_ota_rolled_back = true;
+    prefs.remove(KEY_ROLLED_BACK);
+  }
+
+  if (!prefs.isKey(KEY_PREVIOUS)) {
+    prefs.end();
+    rtc_ota_trial_checked = true;
+    return;
+  }
+
+  // The reboot into the image is the first; panics, watchdog and brownout
+  // resets before it confirms itself add to it
+  uint8_t boots = prefs.getUChar(KEY_BOOTS, 0) + 1;
+  if (boots <= OTA_TRIAL_BOOTS) {
+    prefs.putUChar(KEY_BOOTS, boots);
+    prefs.end();
+    Serial.printf("[OTA] New image on trial (boot %u of %u)\n", boots, OTA_TRIAL_BOOTS);
+    return;
+  }
+
+  Serial.printf("[OTA] New image reset %u times on trial, rolling back\n", OTA_TRIAL_BOOTS);
+  rollBack(prefs);
+}
+
+void OtaUpdater::trialWake() {
+  if (rtc_ota_trial_checked) {
+    return;
+  }
+
+  Preferences prefs;
+  if (!prefs.begin(PREFS_NAMESPACE, false)) {
+    rtc_ota_trial_checked = true;
+    return;
+  }
+
+  if (!prefs.isKey(KEY_PREVIOUS)) {
+    prefs.end();
+    rtc_ota_trial_checked = true;
+    return;
+  }
+
+  // Counted now and cleared by confirmBoot(): a wake that hangs before its
+  // status publish counts as well as one whose publish fails
+  uint8_t wakes = prefs.getUChar(KEY_WAKES, 0) + 1;
+  if (wakes <= OTA_TRIAL_WAKES) {
+    prefs.putUChar(KEY_WAKES, wakes);
+    prefs.end();
+    Serial.printf("[OTA] New image on trial (wake %u of %u)\n", wakes, OTA_TRIAL_WAKES);
+    return;
+  }
+
+  Serial.printf("[OTA] New image did not publish in %u connected wakes, rolling back\n", OTA_TRIAL_WAKES);
+  rollBack(prefs);
+}
+
+void OtaUpdater::rollBack(Preferences& prefs) {
+  uint32_t previousAddr = prefs.getUInt(KEY_PREVIOUS, 0);
+  prefs.remove(KEY_PREVIOUS);
+  prefs.remove(KEY_WAKES);
+  prefs.remove(KEY_BOOTS);
+  prefs.putUChar(KEY_ROLLED_BACK, 1);
+  prefs.end();
+  rtc_ota_trial_checked = true;
+
+  const esp_partition_t* previous = findAppPartition(previousAddr);
+  if (previous != nullptr && esp_ota_set_boot_partition(previous) == ESP_OK) {
+    Serial.flush();
+    esp_restart();
+  }
+  Serial.println("[OTA] Rollback failed, keeping this image");
+}
+
+void OtaUpdater::confirmBoot() {
+  if (rtc_ota_trial_checked) {
+    return;
+  }
+
+  Preferences prefs;
+  if (prefs.begin(PREFS_NAMESPACE, false)) {
+    if (prefs.isKey(KEY_PREVIOUS)) {
+      prefs.remove(KEY_PREVIOUS);
+      prefs.remove(KEY_WAKES);
+      prefs.remove(KEY_BOOTS);
+      Serial.println("[OTA] New image confirmed");
+    }
+    prefs.end();
+  }
+  rtc_ota_trial_checked = true;
+}
+
+// ============================
+// Public: report
+// ============================
+int OtaUpdater::formatStatusFields(char* buf, size_t len) const {
+  if (len == 0) {
+    return 0;
+  }
+  buf[0] = '\0';
+
+  int n = 0;
+  if (rtc_ota.active) {
+    n = snprintf(buf, len, "\"ota\":{\"offset\":%lu,\"size\":%lu}",
+                 (unsigned long)rtc_ota.offset, (unsigned long)rtc_ota.size);
+  } else if (rtc_ota_rolled_back) {
+    n = snprintf(buf, len, "\"ota\":{\"rolled_back\":1}");
+  }
+
+  if (n < 0 || n >= (int)len) {
+    buf[0] = '\0';
+    return 0;
+  }
+  return n;
+}
+
+void OtaUpdater::clearReport() {
+  rtc_ota_rolled_back = false;
+}
+
+// ============================
+// Private
+// ============================
+const esp_partition_t* OtaUpdater::partition() const {
+  const esp_partition_t* part = esp_ota_get_next_update_partition(nullptr);
+  return (part != nullptr && part->address == rtc_ota.partitionAddr) ? part : nullptr;
+}
+
+bool OtaUpdater::requestChunk() {
+  if (commsPtr == nullptr) {
+    return false;
+  }
+
+  uint32_t len = min((uint32_t)OTA_CHUNK_SIZE, rtc_ota.size - rtc_ota.offset);
+  char json[96];
+  snprintf(json, sizeof(json), "{\"device\":\"%s\",\"offset\":%lu,\"len\":%lu}",
+           DEVICE_NAME, (unsigned long)rtc_ota.offset, (unsigned long)len);
+
+  if (!commsPtr->publishOtaRequest(json)) {
+    return false;
+  }
+  requestOutstanding = true;
+  requestMs = millis();
+  return true;
+}
+
+void OtaUpdater::finish() {
+  if (rtc_ota.crc != rtc_ota.expectedCrc) {
+    fail("crc mismatch");
+    return;
+  }
+
+  const esp_partition_t* part = partition();
+  const esp_partition_t* running = esp_ota_get_running_partition();
+  if (part == nullptr || running == nullptr) {
+    fail("partition changed");
+    return;
+  }
+
+  // Verifies the image (header, checksum, appended SHA-256) before switching
+  if (esp_ota_set_boot_partition(part) != ESP_OK) {
+    fail("image rejected");
+    return;
+  }
+
+  // The new image has to prove itself, or the bootloader goes back here
+  Preferences prefs;
+  if (prefs.begin(PREFS_NAMESPACE, false)) {
+    prefs.putUInt(KEY_PREVIOUS, running->address);
+    prefs.putUChar(KEY_WAKES, 0);
+    prefs.putUChar(KEY_BOOTS, 0);
+    prefs.end();
+  }
+
+  rtc_ota.active = 0;
+  rebooting = true;
+  Serial.printf("[OTA] Image verified (%lu bytes), rebooting into %s\n",
+                (unsigned long)rtc_ota.size, part->label);
+  respond("ota: verified, rebooting");
+}
+
+void OtaUpdater::fail(const char* reason) {
+  Serial.printf("[OTA] Transfer failed: %s\n", reason);
+  rtc_ota.active = 0;
+  requestOutstanding = false;
+
+  char msg[64];
+  snprintf(msg, sizeof(msg), "ota: failed (%s)", reason);
+  respond(msg);
+}
+
+void OtaUpdater::respond(const char* msg) {
+  if (commsPtr) {
+    commsPtr->publishResp(msg);
+  }
+}
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <Arduino.h>
+#include <esp_partition.h>
+
+// Forward declarations
+class Comms;
+class Preferences;
+
+/**
+ * @class OtaUpdater
+ * @brief Firmware update pulled over MQTT in bounded chunks, across wakes.
+ *
+ * Started by "ota size=<bytes> crc=<crc32 hex>". Each wake requests up to
+ * OTA_CHUNKS_PER_WAKE chunks, one at a time, by publishing to
+ * MQTT_TOPIC_OTA_REQ:
+ *   {"device":"...","offset":4096,"len":512}
+ * and the update server answers on MQTT_TOPIC_OTA_DATA with the chunk as a
+ * binary payload: offset (uint32, little endian) followed by the data.
+ *
+ * - Chunks are written straight to the inactive OTA partition (sectors are
+ *   erased as the write offset reaches them).
+ * - Progress and a rolling CRC32 of the image live in RTC memory, so the
+ *   transfer continues on the next wake.
+ * - When complete, the CRC32 must match the announced one and
+ *   esp_ota_set_boot_partition() must accept the image (it verifies the
+ *   image checksum and appended SHA-256). Then the node reboots into it.
+ * - The new image is on trial (NVS) until it publishes a status message.
+ *   After OTA_TRIAL_WAKES wakes that reached the broker without one, the
+ *   previous partition is booted again. Wakes that never connect (AP or
+ *   broker down) do not count.
+ * - An image that crashes before it gets that far is caught by a boot
+ *   counter (NVS, top of setup()): after OTA_TRIAL_BOOTS resets on trial it
+ *   is rolled back too. The bootloader's own rollback
+ *   (CONFIG_BOOTLOADER_APP_ROLLBACK_ENABLE) is not used: the prebuilt
+ *   Arduino bootloader is built without it. A crash in static
+ *   initialisation, before setup(), is not covered.
+ *
+ * Serviced from ConnectionManager::loop() like HistoryReplay. Not available
+ * over MQTT-SN (no subscription for the data topic).
+ */
+class OtaUpdater {
+public:
+  /**
+   * @brief Initialize with a reference to Comms.
+   */
+  void begin(Comms& comms);
+
+  /**
+   * @brief Start (or restart) a transfer of an image of the given size.
+   *
+   * @return nullptr if started, else the reason for rejecting it
+   */
+  const char* start(uint32_t size, uint32_t crc32);
+
+  /**
+   * @brief Abandon the transfer in progress.
+   */
+  void abort();
+
+  /**
+   * @brief True while a transfer is in progress.
+   */
+  bool active() const;
+
+  /**
+   * @brief True when this wake's OTA work is done (quota used, retries
+   *        exhausted, transfer finished or none active).
+   */
+  bool wakeDone() const;
+
+  /**
+   * @brief True once a verified image is set as boot partition.
+   */
+  bool rebootPending() const;
+
+  /**
+   * @brief Request the next chunk or re-request a lost one.
+   *
+   * Call only while MQTT is connected.
+   */
+  void loop();
+
+  /**
+   * @brief Handle a message on MQTT_TOPIC_OTA_DATA.
+   */
+  void onChunk(const uint8_t* payload, unsigned int length);
+
+  /**
+   * @brief Boot counter of a freshly installed image: call first thing in
+   *        setup(). Rolls back and reboots after OTA_TRIAL_BOOTS resets on
+   *        trial. Does nothing on deep sleep wakes.
+   */
+  static void beginBoot();
+
+  /**
+   * @brief Trial accounting for a freshly installed image: call once MQTT is
+   *        connected on a wake that publishes status, before publishing.
+   *        Rolls back and reboots once OTA_TRIAL_WAKES such wakes passed
+   *        without confirmBoot().
+   *
+   * NVS is read until the image is confirmed (or found not on trial).
+   */
+  static void trialWake();
+
+  /**
+   * @brief The running image published its status: keep it.
+   */
+  static void confirmBoot();
+
+  /**
+   * @brief Format status payload fields (no surrounding braces, empty if
+   *        there is nothing to report):
+   *        "ota":{"offset":65536,"size":917504}   while transferring
+   *        "ota":{"rolled_back":1}               after a rollback
+   *
+   * @return Number of characters written
+   */
+  int formatStatusFields(char* buf, size_t len) const;
+
+  /**
+   * @brief Forget the rollback report once it was published.
+   */
+  static void clearReport();
+
+private:
+  Comms* commsPtr = nullptr;
+
+  // Current wake (RAM)
+  bool requestOutstanding = false;
+  uint32_t requestMs = 0;
+  uint8_t chunksThisWake = 0;
+  uint8_t retriesThisWake = 0;
+  bool rebooting = false;
+
+  const esp_partition_t* partition() const;
+  static void rollBack(Preferences& prefs);
+  bool requestChunk();
+  void finish();
+  void fail(const char* reason);
+  void respond(const char* msg);
+};
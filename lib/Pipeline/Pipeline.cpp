@@ -0,0 +1,209 @@
+#include "Pipeline.h"
+#include <ConnectionManager.h>
+#include <Comms.h>
+#include <TrafficStats.h>
+
+// ============================
+// Public: begin()
+// ============================
+void Pipeline::begin(ConnectionManager& cm, Comms& comms, Job networkHook) {
+  cmPtr = &cm;
+  hook = networkHook;
+
+  BaseType_t ok = xTaskCreatePinnedToCore(&Pipeline::networkTaskMain, "net",
+                                          PIPELINE_NET_STACK, this, 2,
+                                          &networkTask, NETWORK_CORE);
+  if (ok != pdPASS) {
+    Serial.println("[Pipe] ERROR: network task create failed");
+    return;
+  }
+
+  comms.setPipeline(this);
+  Serial.println("[Pipe] Network task started on PRO_CPU");
+}
+
+// ============================
+// Public: runSensing()
+// ============================
+bool Pipeline::runSensing(Job job) {
+  sensingJob = job;
+  sensingDone.store(false);
+
+  BaseType_t ok = xTaskCreatePinnedToCore(&Pipeline::sensingTaskMain, "sense",
+                                          PIPELINE_SENSE_STACK, this, 1,
+                                          nullptr, SENSING_CORE);
+  if (ok != pdPASS) {
+    Serial.println("[Pipe] ERROR: sensing task create failed");
+    sensingDone.store(true);
+    return false;
+  }
+  return true;
+}
+
+// ============================
+// Public: waitUntilFlushed()
+// ============================
+bool Pipeline::waitUntilFlushed(uint32_t timeoutMs) {
+  uint32_t startMs = millis();
+  while (millis() - startMs < timeoutMs) {
+    if (sensingDone.load() && mqttUp.load() && outbox.empty() && mailboxDrained.load()) {
+      return true;
+    }
+    delay(5);
+  }
+
+  Serial.printf("[Pipe] Flush timeout (sensing=%d mqtt=%d outbox_empty=%d mailbox=%d)\n",
+                sensingDone.load() ? 1 : 0, mqttUp.load() ? 1 : 0, outbox.empty() ? 1 : 0,
+                mailboxDrained.load() ? 1 : 0);
+  return false;
+}
+
+// ============================
+// Public: enqueue()
+// ============================
+bool Pipeline::enqueue(const char* topic, const char* payload, bool retained) {
+  // Single producer: nothing but the sensing job while it runs
+  if (!sensingDone.load() && xTaskGetCurrentTaskHandle() != sensingTask.load()) {
+    Serial.printf("[Pipe] ERROR: enqueue from a second producer refused: %s\n", topic);
+    return false;
+  }
+
+  size_t topicLen = strlen(topic);
+  size_t payloadLen = strlen(payload);
+  if (topicLen > MAX_TOPIC_LEN || payloadLen >= MQTT_BUFFER_SIZE) {
+    Serial.printf("[Pipe] Message too large for outbox: %s\n", topic);
+    return false;
+  }
+
+  // Encoded straight into the outbox, no staging copy
+  uint16_t len = (uint16_t)(2 + topicLen + 1 + payloadLen);
+  uint8_t* rec;
+  uint32_t startMs = millis();
+  while ((rec = outbox.reserve(len)) == nullptr) {
+    if (millis() - startMs >= PIPELINE_ENQUEUE_WAIT_MS) {
+      Serial.printf("[Pipe] Outbox full, dropped: %s\n", topic);
+      return false;
+    }
+    delay(2);
+  }
+
+  rec[0] = (uint8_t)topicLen;
+  rec[1] = retained ? 1 : 0;
+  memcpy(rec + 2, topic, topicLen + 1);
+  memcpy(rec + 3 + topicLen, payload, payloadLen);
+  outbox.commit(len);
+  return true;
+}
+
+// ============================
+// Public: onNetworkTask()
+// ============================
+bool Pipeline::onNetworkTask() const {
+  return networkTask != nullptr && xTaskGetCurrentTaskHandle() == networkTask;
+}
+
+// ============================
+// Public: waitForMailbox()
+// ============================
+uint16_t Pipeline::waitForMailbox(uint32_t timeoutMs) {
+  uint32_t startMs = millis();
+  while (!mailboxDrained.load()) {
+    if (millis() - startMs >= timeoutMs) {
+      return 0;
+    }
+    delay(5);
+  }
+  return mailboxCommands.load();
+}
+
+// ============================
+// Public: started()
+// ============================
+bool Pipeline::started() const {
+  return networkTask != nullptr;
+}
+
+// ============================
+// Public: connected()
+// ============================
+bool Pipeline::connected() const {
+  return mqttUp.load();
+}
+
+// ============================
+// Private: networkTaskMain()
+// ============================
+void Pipeline::networkTaskMain(void* arg) {
+  Pipeline* self = static_cast<Pipeline*>(arg);
+
+  for (;;) {
+    self->cmPtr->loop();
+    if (self->hook) {
+      self->hook();
+    }
+
+    bool up = self->cmPtr->mqttConnected();
+    self->mqttUp.store(up);
+    if (up) {
+      self->drainOutbox();
+
+      // Commands queued while asleep: once per wake, after the sends queued
+      // so far (status waits for the count, see waitForMailbox())
+      if (!self->mailboxDrained.load() && self->outbox.empty()) {
+        self->mailboxCommands.store(self->cmPtr->drainMailbox(MAILBOX_DRAIN_MAX_MS, MAILBOX_QUIET_MS));
+        self->mailboxDrained.store(true);
+      }
+    }
+
+    vTaskDelay(1);
+  }
+}
+
+// ============================
+// Private: sensingTaskMain()
+// ============================
+void Pipeline::sensingTaskMain(void* arg) {
+  Pipeline* self = static_cast<Pipeline*>(arg);
+  self->sensingTask.store(xTaskGetCurrentTaskHandle());
+
+  uint32_t t0 = millis();
+  if (self->sensingJob) {
+    self->sensingJob();
+  }
+  Serial.printf("[Pipe] Sensing job done in %lu ms\n", (unsigned long)(millis() - t0));
+
+  self->sensingDone.store(true);
+  self->sensingTask.store(nullptr);
+  vTaskDelete(nullptr);
+}
+
+// ============================
+// Private: drainOutbox()
+// ============================
+void Pipeline::drainOutbox() {
+  PubSubClient* mqtt = cmPtr->getMqttClient();
+
+  // Work on messages in place; release a record only once it was handed over
+  const uint8_t* rec;
+  uint16_t len;
+  while ((rec = outbox.front(len)) != nullptr) {
+    const char* topic = (const char*)rec + 2;
+    bool retained = rec[1] != 0;
+    const uint8_t* payload = rec + 3 + rec[0];
+    uint16_t length = (uint16_t)(len - 3 - rec[0]);
+
+    // Stream from the outbox: no second copy into the MQTT packet buffer
+    if (!mqtt->beginPublish(topic, length, retained)) {
+      Serial.printf("[Pipe] Publish failed, will retry: %s\n", topic);
+      return;
+    }
+    if (mqtt->write(payload, length) != length || mqtt->endPublish() != 1) {
+      // Partial PUBLISH on the wire: reconnect and resend this record
+      Serial.printf("[Pipe] Stream broken, will retry: %s\n", topic);
+      mqtt->disconnect();
+      return;
+    }
+    TrafficStats::countPublish(topic, length);
+    outbox.popFront();
+  }
+}
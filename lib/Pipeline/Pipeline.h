@@ -0,0 +1,119 @@
+#pragma once
+
+#include <Arduino.h>
+#include <atomic>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <SpscQueue.h>
+#include <config_common.h>
+
+// Forward declarations
+class ConnectionManager;
+class Comms;
+
+/**
+ * @class Pipeline
+ * @brief Dual-core wake pipeline: networking on PRO_CPU, sensing on APP_CPU.
+ * 
+ * The network task owns WiFi/MQTT (ConnectionManager::loop(), command
+ * handling, history replay) and drains an outbox of encoded messages once the
+ * broker session is up. The sensing task runs one job (read sensors, encode
+ * payloads) while association is still in progress; everything it publishes
+ * through Comms is copied into the outbox instead of touching the socket.
+ * 
+ * Once the broker session is up and the messages queued so far are sent, the
+ * network task drains the command mailbox (ConnectionManager::drainMailbox()),
+ * as the sequential path does after connecting. The sensing job waits for
+ * that drain (waitForMailbox()) before it encodes status, which reports the
+ * count; the wake is flushed only after both.
+ * 
+ * The outbox is a lock-free SPSC byte queue (one shared buffer, messages
+ * stored at their actual length): the sensing task is its only producer and
+ * the network task its only consumer.
+ */
+class Pipeline {
+public:
+  typedef void (*Job)();
+
+  /**
+   * @brief Start the network task and route Comms publishes through the outbox.
+   * 
+   * @param cm ConnectionManager (begin() already called)
+   * @param comms Comms instance to route through the outbox
+   * @param networkHook Optional function run on the network task each cycle
+   *        (e.g. Interrupts::loop wrapper), or nullptr
+   */
+  void begin(ConnectionManager& cm, Comms& comms, Job networkHook = nullptr);
+
+  /**
+   * @brief Run a job once on the sensing task (APP_CPU).
+   */
+  bool runSensing(Job job);
+
+  /**
+   * @brief Wait until the sensing job finished, the outbox is sent and the
+   *        mailbox is drained.
+   * 
+   * @param timeoutMs Upper bound for the whole wait
+   * @return true if everything was handed to the MQTT client
+   */
+  bool waitUntilFlushed(uint32_t timeoutMs);
+
+  /**
+   * @brief Wait until the network task has drained the mailbox.
+   * 
+   * @param timeoutMs Upper bound for the wait
+   * @return Commands handled by the drain (0 if it did not happen in time)
+   */
+  uint16_t waitForMailbox(uint32_t timeoutMs);
+
+  /**
+   * @brief Queue a message for the network task (sensing task only).
+   * 
+   * Waits up to PIPELINE_ENQUEUE_WAIT_MS for free space. The outbox has a
+   * single producer: while the sensing job runs, calls from other tasks are
+   * refused; after it, the task that waited for it may queue.
+   * 
+   * @return false if the message does not fit or the outbox stayed full
+   */
+  bool enqueue(const char* topic, const char* payload, bool retained);
+
+  /**
+   * @brief True when called from the network task.
+   */
+  bool onNetworkTask() const;
+
+  /**
+   * @brief True once the network task runs; from then on it alone uses cm.
+   */
+  bool started() const;
+
+  /**
+   * @brief MQTT session state as last seen by the network task.
+   */
+  bool connected() const;
+
+private:
+  static const size_t MAX_TOPIC_LEN = 63;
+
+  static const BaseType_t NETWORK_CORE = 0;  // PRO_CPU
+  static const BaseType_t SENSING_CORE = 1;  // APP_CPU
+
+  ConnectionManager* cmPtr = nullptr;
+  Job hook = nullptr;
+  Job sensingJob = nullptr;
+
+  TaskHandle_t networkTask = nullptr;
+  std::atomic<TaskHandle_t> sensingTask{nullptr};   // set by the task itself
+
+  // Record: topic length, retained flag, topic + NUL, payload
+  SpscByteQueue<PIPELINE_OUTBOX_BYTES> outbox;
+  std::atomic<bool> mqttUp{false};
+  std::atomic<bool> sensingDone{false};
+  std::atomic<bool> mailboxDrained{false};
+  std::atomic<uint16_t> mailboxCommands{0};
+
+  static void networkTaskMain(void* arg);
+  static void sensingTaskMain(void* arg);
+  void drainOutbox();
+};
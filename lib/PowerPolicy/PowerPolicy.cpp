@@ -0,0 +1,93 @@
+#include "PowerPolicy.h"
+#include <config_common.h>
+
+PowerPolicy::Level PowerPolicy::levelFor(uint16_t millivolts, uint16_t offsetMv) {
+  if (millivolts < POWER_CRITICAL_MV + offsetMv) {
+    return Level::Critical;
+  }
+  if (millivolts < POWER_LOW_MV + offsetMv) {
+    return Level::Low;
+  }
+  if (millivolts < POWER_CONSERVE_MV + offsetMv) {
+    return Level::Conserve;
+  }
+  return Level::Normal;
+}
+
+PowerPolicy::Level PowerPolicy::nextLevel(Level current, uint16_t millivolts) {
+  if (millivolts == 0) {
+    return current;
+  }
+
+  // Worse: follow immediately
+  Level worse = levelFor(millivolts, 0);
+  if (worse > current) {
+    return worse;
+  }
+
+  // Better: only once the threshold is cleared by the hysteresis
+  Level better = levelFor(millivolts, POWER_HYSTERESIS_MV);
+  return (better < current) ? better : current;
+}
+
+PowerPolicy::Actions PowerPolicy::decide(State& state, uint16_t millivolts) {
+  if (state.level > Level::Critical) {
+    state.level = Level::Normal;  // Uninitialized/corrupt RTC value
+  }
+  state.level = nextLevel(state.level, millivolts);
+
+  Actions a;
+  a.level = state.level;
+  a.batch = false;
+  a.alarmOnly = false;
+
+  switch (state.level) {
+    case Level::Normal:
+      a.intervalMultiplier = 1;
+      a.logs = true;
+      a.discovery = true;
+      a.uplink = true;
+      break;
+
+    case Level::Conserve:
+      a.intervalMultiplier = 2;
+      a.logs = false;
+      a.discovery = false;
+      a.uplink = true;
+      break;
+
+    case Level::Low:
+      a.intervalMultiplier = 4;
+      a.logs = false;
+      a.discovery = false;
+      a.uplink = (state.wakesSinceUplink + 1 >= POWER_LOW_UPLINK_EVERY);
+      a.batch = true;
+      break;
+
+    case Level::Critical:
+    default:
+      a.intervalMultiplier = 8;
+      a.logs = false;
+      a.discovery = false;
+      a.uplink = false;
+      a.alarmOnly = true;
+      break;
+  }
+
+  if (a.uplink) {
+    state.wakesSinceUplink = 0;
+  } else if (state.wakesSinceUplink < UINT8_MAX) {
+    state.wakesSinceUplink++;
+  }
+  return a;
+}
+
+const char* PowerPolicy::name(Level level) {
+  switch (level) {
+    case Level::Normal:   return "normal";
+    case Level::Conserve: return "conserve";
+    case Level::Low:      return "low";
+    case Level::Critical: return "critical";
+    default:              return "unknown";
+  }
+}
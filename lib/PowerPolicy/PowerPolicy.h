@@ -0,0 +1,67 @@
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * @class PowerPolicy
+ * @brief Battery-voltage driven load shedding (pure logic, no hardware).
+ * 
+ * Levels, from best to worst:
+ * - Normal:   every wake uplinks with logs and discovery
+ * - Conserve: longer interval, no logs, no discovery
+ * - Low:      longer interval again, uplink only every POWER_LOW_UPLINK_EVERY
+ *             wakes; readings in between are batched via history replay
+ * - Critical: alarm-only, the radio is used only for threshold alarms
+ * 
+ * Falling below a threshold moves down at once; moving back up needs the
+ * voltage to clear the threshold by POWER_HYSTERESIS_MV, so a cell that
+ * recovers slightly while resting does not flap between levels.
+ * 
+ * State is a POD kept by the caller (in RTC memory); a voltage of 0 (no
+ * reading) keeps the current level.
+ */
+class PowerPolicy {
+public:
+  enum class Level : uint8_t {
+    Normal = 0,
+    Conserve,
+    Low,
+    Critical
+  };
+
+  struct State {
+    Level level;
+    uint8_t wakesSinceUplink;
+  };
+
+  struct Actions {
+    Level level;
+    uint8_t intervalMultiplier;   // Applied to the sleep interval
+    bool logs;                    // Publish log lines
+    bool discovery;               // Publish HA discovery/availability
+    bool uplink;                  // Connect and publish this wake
+    bool batch;                   // Replay readings stored since the last uplink
+    bool alarmOnly;               // Connect only if an alarm must be sent
+  };
+
+  /**
+   * @brief Next level for a voltage, with hysteresis on the way up.
+   * 
+   * @param current Current level
+   * @param millivolts Battery voltage (0 = unknown, keeps current)
+   */
+  static Level nextLevel(Level current, uint16_t millivolts);
+
+  /**
+   * @brief Update the state for this wake and return what to do.
+   */
+  static Actions decide(State& state, uint16_t millivolts);
+
+  /**
+   * @brief Short lowercase name for a level ("normal", "conserve", ...).
+   */
+  static const char* name(Level level);
+
+private:
+  static Level levelFor(uint16_t millivolts, uint16_t offsetMv);
+};
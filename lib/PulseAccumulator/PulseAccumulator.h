@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+
+/**
+ * @struct PulseAccumulator
+ * @brief Folds a free-running hardware pulse counter into a 64-bit total
+ * and derives per-window counts from real elapsed time.
+ * 
+ * Pure logic (no Arduino/ESP-IDF dependencies), kept in RTC memory by
+ * PulseCounter. Must be zero-initialized; reset() starts a fresh total.
+ */
+struct PulseAccumulator {
+  uint64_t total;           // Pulses since reset()
+  uint32_t lastRaw;         // Last raw counter value folded in
+  uint64_t windowStart;     // total at the start of the current rate window
+  uint32_t windowEpoch;     // Epoch at the start of the current rate window (0 = none)
+
+  /**
+   * @brief Start counting from the given raw counter value.
+   */
+  void reset(uint32_t raw) {
+    total = 0;
+    lastRaw = raw;
+    windowStart = 0;
+    windowEpoch = 0;
+  }
+
+  /**
+   * @brief Add pulses counted since the last call (handles 32-bit wrap).
+   */
+  void fold(uint32_t raw) {
+    total += (uint32_t)(raw - lastRaw);
+    lastRaw = raw;
+  }
+
+  /**
+   * @brief Close the current rate window at 'epoch' and open the next one.
+   * 
+   * @param epoch Current Unix epoch (0 = unknown, window left open)
+   * @param counts Output: pulses in the closed window
+   * @param elapsedS Output: window length in seconds
+   * @return true if a complete window was closed
+   */
+  bool sample(uint32_t epoch, uint32_t& counts, uint32_t& elapsedS) {
+    if (epoch == 0) {
+      return false;  // No time base; keep accumulating into the open window
+    }
+
+    bool closed = (windowEpoch != 0 && epoch > windowEpoch);
+    if (closed) {
+      counts = (uint32_t)(total - windowStart);
+      elapsedS = epoch - windowEpoch;
+    }
+
+    windowStart = total;
+    windowEpoch = epoch;
+    return closed;
+  }
+
+  /**
+   * @brief Convert a window into a derived rate (e.g. mm/h, L/min).
+   * 
+   * @param counts Pulses in the window
+   * @param elapsedS Window length in seconds
+   * @param unitsPerCount Physical units per pulse
+   * @param ratePerSeconds Rate time base in seconds (3600 = per hour)
+   */
+  static float rate(uint32_t counts, uint32_t elapsedS, float unitsPerCount, uint32_t ratePerSeconds) {
+    if (elapsedS == 0) {
+      return 0.0f;
+    }
+    return (float)counts * unitsPerCount * (float)ratePerSeconds / (float)elapsedS;
+  }
+};
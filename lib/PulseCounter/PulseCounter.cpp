@@ -0,0 +1,231 @@
+#include "PulseCounter.h"
+#include <esp_sleep.h>
+#include <esp32/ulp.h>
+#include <driver/rtc_io.h>
+#include <soc/rtc_io_reg.h>
+#include <soc/soc.h>
+#include <config_common.h>
+
+// ULP data words live at the top of the reserved ULP area (512 bytes = 128 words),
+// above the program. Per channel: [stable level, samples at the other level,
+// count low 16 bits, count high 16 bits].
+static const uint32_t ULP_DATA_BASE = 112;
+static const uint32_t ULP_WORDS_PER_CHANNEL = 4;
+static_assert(PULSE_DEBOUNCE_SAMPLES >= 1 && PULSE_DEBOUNCE_SAMPLES < 0xFFFF,
+              "PULSE_DEBOUNCE_SAMPLES out of range");
+
+// RTC memory (survives deep sleep, lost on power cycle)
+RTC_DATA_ATTR static bool rtc_pulse_ulp_loaded = false;
+RTC_DATA_ATTR static PulseAccumulator rtc_pulse_acc[PulseCounter::MAX_CHANNELS];
+
+// ============================
+// Public: begin()
+// ============================
+void PulseCounter::begin() {
+  numChannels = 0;
+  for (uint8_t i = 0; i < INPUT_PIN_COUNT && numChannels < MAX_CHANNELS; i++) {
+    if (INPUT_PIN_MODES[i] != INPUT_MODE_PULSE) {
+      continue;
+    }
+    if (rtc_io_number_get((gpio_num_t)INPUT_PINS[i]) < 0) {
+      Serial.printf("[Pulse] Pin %d is not an RTC GPIO, skipped\n", INPUT_PINS[i]);
+      continue;
+    }
+    channels[numChannels].input = i;
+    channels[numChannels].windowValid = false;
+    numChannels++;
+  }
+
+  if (numChannels == 0) {
+    return;
+  }
+
+  // RTC IO must stay powered in deep sleep for the ULP to read the pins
+  esp_sleep_pd_config(ESP_PD_DOMAIN_RTC_PERIPH, ESP_PD_OPTION_ON);
+
+  if (rtc_pulse_ulp_loaded) {
+    Serial.printf("[Pulse] ULP running, %d channel(s)\n", numChannels);
+    return;
+  }
+
+  if (!loadUlpProgram()) {
+    Serial.println("[Pulse] ERROR: ULP program load failed");
+    return;
+  }
+
+  for (uint8_t c = 0; c < numChannels; c++) {
+    rtc_pulse_acc[c].reset(0);
+  }
+  rtc_pulse_ulp_loaded = true;
+  Serial.printf("[Pulse] ULP started, %d channel(s), period=%d us\n",
+                numChannels, PULSE_SAMPLE_PERIOD_US);
+}
+
+// ============================
+// Public: sample()
+// ============================
+void PulseCounter::sample(time_t nowEpoch) {
+  if (!rtc_pulse_ulp_loaded) {
+    return;
+  }
+
+  for (uint8_t c = 0; c < numChannels; c++) {
+    PulseAccumulator& acc = rtc_pulse_acc[c];
+    acc.fold(readUlpCounter(c));
+
+    Channel& ch = channels[c];
+    ch.windowValid = acc.sample((uint32_t)(nowEpoch > 0 ? nowEpoch : 0),
+                                ch.windowCounts, ch.windowSeconds);
+
+    Serial.printf("[Pulse] Pin %d: total=%llu\n",
+                  INPUT_PINS[ch.input], (unsigned long long)acc.total);
+  }
+}
+
+// ============================
+// Public: channelCount()
+// ============================
+uint8_t PulseCounter::channelCount() const {
+  return numChannels;
+}
+
+// ============================
+// Public: formatStatusFields()
+// ============================
+int PulseCounter::formatStatusFields(char* buf, size_t len) const {
+  if (len == 0) {
+    return 0;
+  }
+  buf[0] = '\0';
+  if (numChannels == 0 || !rtc_pulse_ulp_loaded) {
+    return 0;
+  }
+
+  int used = snprintf(buf, len, "\"pulses\":[");
+  for (uint8_t c = 0; c < numChannels && used < (int)len; c++) {
+    const Channel& ch = channels[c];
+    float rate = ch.windowValid
+      ? PulseAccumulator::rate(ch.windowCounts, ch.windowSeconds,
+                               PULSE_UNITS_PER_COUNT[ch.input],
+                               PULSE_RATE_PER_SECONDS[ch.input])
+      : 0.0f;
+
+    used += snprintf(buf + used, len - used,
+                     "%s{\"pin\":%d,\"total\":%llu,\"count\":%lu,\"rate\":%.2f}",
+                     c > 0 ? "," : "",
+                     INPUT_PINS[ch.input],
+                     (unsigned long long)rtc_pulse_acc[c].total,
+                     (unsigned long)(ch.windowValid ? ch.windowCounts : 0),
+                     rate);
+  }
+  if (used < (int)len) {
+    used += snprintf(buf + used, len - used, "]");
+  }
+  return used;
+}
+
+// ============================
+// Private: loadUlpProgram()
+// ============================
+bool PulseCounter::loadUlpProgram() {
+  // 25 instructions + 3 labels per channel, prologue/epilogue
+  // (instructions must stay below ULP_DATA_BASE)
+  static_assert(2 + 25 * MAX_CHANNELS < ULP_DATA_BASE, "ULP program overlaps its data");
+  ulp_insn_t program[2 + 25 * MAX_CHANNELS + 3 * MAX_CHANNELS];
+  size_t n = 0;
+
+  program[n++] = I_MOVI(R3, 0);  // Base address for data words
+
+  for (uint8_t c = 0; c < numChannels; c++) {
+    gpio_num_t pin = (gpio_num_t)INPUT_PINS[channels[c].input];
+    int rtcio = rtc_io_number_get(pin);
+    uint32_t base = ULP_DATA_BASE + c * ULP_WORDS_PER_CHANNEL;
+    uint32_t lblCarry = c * 3;
+    uint32_t lblSame = c * 3 + 1;
+    uint32_t lblNext = c * 3 + 2;
+
+    rtc_gpio_init(pin);
+    rtc_gpio_set_direction(pin, RTC_GPIO_MODE_INPUT_ONLY);
+#if INPUT_ACTIVE_LOW == 1
+    rtc_gpio_pulldown_dis(pin);
+    rtc_gpio_pullup_en(pin);
+#else
+    rtc_gpio_pullup_dis(pin);
+    rtc_gpio_pulldown_en(pin);
+#endif
+
+    // Seed the data words before the ULP starts
+    RTC_SLOW_MEM[base + 0] = rtc_gpio_get_level(pin) ? 1 : 0;
+    RTC_SLOW_MEM[base + 1] = 0;
+    RTC_SLOW_MEM[base + 2] = 0;
+    RTC_SLOW_MEM[base + 3] = 0;
+
+    const ulp_insn_t snippet[] = {
+      I_RD_REG(RTC_GPIO_IN_REG, RTC_GPIO_IN_NEXT_S + rtcio, RTC_GPIO_IN_NEXT_S + rtcio),  // R0 = level
+      I_LD(R1, R3, base + 0),       // R1 = stable level
+      I_SUBR(R2, R0, R1),
+      M_BXZ(lblSame),               // Unchanged (or bounced back)
+      I_MOVR(R2, R0),               // R2 = new level
+      I_LD(R0, R3, base + 1),       // One more sample at the new level
+      I_ADDI(R0, R0, 1),
+      I_ST(R0, R3, base + 1),
+      M_BL(lblNext, PULSE_DEBOUNCE_SAMPLES),   // Not settled yet
+      I_MOVI(R0, 0),
+      I_ST(R0, R3, base + 1),
+      I_ST(R2, R3, base + 0),       // Settled: new stable level
+      I_MOVR(R0, R2),
+#if INPUT_ACTIVE_LOW == 1
+      M_BGE(lblNext, 1),            // Rising edge = release, not counted
+#else
+      M_BL(lblNext, 1),             // Falling edge = release, not counted
+#endif
+      I_LD(R1, R3, base + 2),
+      I_ADDI(R1, R1, 1),
+      I_ST(R1, R3, base + 2),
+      M_BXZ(lblCarry),              // Low word wrapped
+      M_BX(lblNext),
+      M_LABEL(lblCarry),
+      I_LD(R1, R3, base + 3),
+      I_ADDI(R1, R1, 1),
+      I_ST(R1, R3, base + 3),
+      M_BX(lblNext),
+      M_LABEL(lblSame),
+      I_MOVI(R0, 0),                // Bounce: restart the count
+      I_ST(R0, R3, base + 1),
+      M_LABEL(lblNext),
+    };
+    for (size_t k = 0; k < sizeof(snippet) / sizeof(snippet[0]); k++) {
+      program[n++] = snippet[k];
+    }
+  }
+
+  program[n++] = I_HALT();
+
+  size_t size = n;
+  if (ulp_process_macros_and_load(0, program, &size) != ESP_OK) {
+    return false;
+  }
+  if (size >= ULP_DATA_BASE) {
+    return false;
+  }
+
+  ulp_set_wakeup_period(0, PULSE_SAMPLE_PERIOD_US);
+  return ulp_run(0) == ESP_OK;
+}
+
+// ============================
+// Private: readUlpCounter()
+// ============================
+uint32_t PulseCounter::readUlpCounter(uint8_t channel) const {
+  uint32_t base = ULP_DATA_BASE + channel * ULP_WORDS_PER_CHANNEL;
+  volatile uint32_t* mem = RTC_SLOW_MEM;
+
+  // The ULP may carry between the two reads; re-read until the high word is stable
+  uint32_t hi, lo;
+  do {
+    hi = mem[base + 3] & 0xFFFF;
+    lo = mem[base + 2] & 0xFFFF;
+  } while (hi != (mem[base + 3] & 0xFFFF));
+
+  return (hi << 16) | lo;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <Arduino.h>
+#include <time.h>
+#include <PulseAccumulator.h>
+
+/**
+ * @class PulseCounter
+ * @brief Counts pulses on INPUT_MODE_PULSE inputs, awake and in deep sleep.
+ * 
+ * A small ULP program samples the RTC GPIOs every PULSE_SAMPLE_PERIOD_US and
+ * counts active edges into RTC slow memory, so counting never stops across
+ * sleep/wake and there is no hand-over between peripherals. A new level is
+ * only taken after PULSE_DEBOUNCE_SAMPLES equal samples in a row, which
+ * filters reed-switch bounce. The main CPU
+ * folds the counters into 64-bit totals (RTC memory) once per wake and derives
+ * rates from real elapsed RTC time.
+ * 
+ * Up to MAX_CHANNELS pulse inputs are supported.
+ */
+class PulseCounter {
+public:
+  static const uint8_t MAX_CHANNELS = 4;
+
+  /**
+   * @brief Configure pulse inputs and start the ULP (cold boot only).
+   * 
+   * On a deep sleep wake the ULP is already running and is left untouched.
+   */
+  void begin();
+
+  /**
+   * @brief Fold ULP counters into totals and close the current rate window.
+   * 
+   * Call once per wake with the RTC epoch (0 if unavailable; the window then
+   * stays open until the next valid timestamp).
+   * 
+   * @param nowEpoch Current Unix epoch from RTC
+   */
+  void sample(time_t nowEpoch);
+
+  /**
+   * @brief Number of inputs configured as pulse counters.
+   */
+  uint8_t channelCount() const;
+
+  /**
+   * @brief Format status payload fields for all pulse inputs.
+   * 
+   * Writes e.g. "pulses":[{"pin":27,"total":42,"count":3,"rate":1.68}]
+   * (no surrounding braces). Writes an empty string when no pulse inputs exist.
+   * 
+   * @return Number of characters written
+   */
+  int formatStatusFields(char* buf, size_t len) const;
+
+private:
+  struct Channel {
+    uint8_t input;        // Index into INPUT_PINS
+    uint32_t windowCounts;
+    uint32_t windowSeconds;
+    bool windowValid;
+  };
+
+  Channel channels[MAX_CHANNELS];
+  uint8_t numChannels = 0;
+
+  bool loadUlpProgram();
+  uint32_t readUlpCounter(uint8_t channel) const;
+};
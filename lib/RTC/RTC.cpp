@@ -1,30 +1,95 @@
 #include <Arduino.h>
-#include <Wire.h>
-#include <RTClib.h>
+#include <I2CBus.h>
+#include <Calendar.h>
+#include <HealthCounters.h>
 
 #include "RTC.h"
 #include <config_common.h>
 
-static RTC_DS3231 rtc;
+// DS3231 registers
+static const uint8_t REG_TIME   = 0x00;   // seconds .. year (7 bytes, BCD)
+static const uint8_t REG_CONTROL = 0x0E;
+static const uint8_t REG_STATUS = 0x0F;
+static const uint8_t REG_AGING  = 0x10;
+static const uint8_t CONTROL_CONV = 0x20;  // force a temperature conversion
+static const uint8_t STATUS_OSF = 0x80;   // oscillator stopped: time invalid
+static const uint8_t HOUR_12H   = 0x40;
+static const uint8_t HOUR_PM    = 0x20;
+static const uint8_t MONTH_CENTURY = 0x80;
+
+static const uint32_t DS3231_MAX_HZ = 400000;
 
 // Static member definition
 bool RTC::initialized = false;
 
+static uint8_t bcdToDec(uint8_t v) { return (uint8_t)((v >> 4) * 10 + (v & 0x0F)); }
+static uint8_t decToBcd(uint8_t v) { return (uint8_t)(((v / 10) << 4) | (v % 10)); }
+
+// One burst read of the time registers
+static bool readDateTime(int& year, int& month, int& day,
+                         int& hour, int& minute, int& second) {
+  uint8_t r[7];
+  if (!I2CBus::readRegs(DS3231_I2C_ADDR, REG_TIME, r, sizeof(r))) {
+    return false;
+  }
+
+  second = bcdToDec(r[0] & 0x7F);
+  minute = bcdToDec(r[1] & 0x7F);
+  if (r[2] & HOUR_12H) {
+    hour = bcdToDec(r[2] & 0x1F) % 12 + ((r[2] & HOUR_PM) ? 12 : 0);
+  } else {
+    hour = bcdToDec(r[2] & 0x3F);
+  }
+  day = bcdToDec(r[4] & 0x3F);
+  month = bcdToDec(r[5] & 0x1F);
+  year = 2000 + bcdToDec(r[6]) + ((r[5] & MONTH_CENTURY) ? 100 : 0);
+
+  return month >= 1 && month <= 12 && day >= 1 && day <= 31;
+}
+
+// One burst write of the time registers (24h mode), then clear OSF
+static bool writeDateTime(int year, int month, int day,
+                          int hour, int minute, int second) {
+  int32_t days = Calendar::daysFromCivil(year, month, day);
+  uint8_t dow = (uint8_t)(Calendar::weekday(days) + 1);   // 1 = Sunday
+
+  uint8_t r[7] = {
+    decToBcd((uint8_t)second),
+    decToBcd((uint8_t)minute),
+    decToBcd((uint8_t)hour),
+    dow,
+    decToBcd((uint8_t)day),
+    (uint8_t)(decToBcd((uint8_t)month) | (year >= 2100 ? MONTH_CENTURY : 0)),
+    decToBcd((uint8_t)(year % 100))
+  };
+  if (!I2CBus::writeRegs(DS3231_I2C_ADDR, REG_TIME, r, sizeof(r))) {
+    return false;
+  }
+
+  uint8_t status = 0;
+  if (I2CBus::readReg(DS3231_I2C_ADDR, REG_STATUS, status) && (status & STATUS_OSF)) {
+    I2CBus::writeReg(DS3231_I2C_ADDR, REG_STATUS, status & ~STATUS_OSF);
+  }
+  return true;
+}
+
 bool RTC::begin() {
   if (initialized) {
     return true;
   }
 
-  Wire.begin(I2C_SDA_PIN, I2C_SCL_PIN, I2C_FREQ_HZ);
-  Serial.printf("[RTC] I2C initialized (SDA=%d, SCL=%d, Freq=%lu)\n",
-                I2C_SDA_PIN, I2C_SCL_PIN, (unsigned long)I2C_FREQ_HZ);
-
-  if (!rtc.begin()) {
+  if (!I2CBus::addDevice(DS3231_I2C_ADDR, DS3231_MAX_HZ)) {
     Serial.println("[RTC] Error: DS3231 not found");
+    HealthCounters::increment(HealthCounters::Counter::RtcFail);
     initialized = false;
     return false;
   }
 
+  uint8_t status = 0;
+  if (I2CBus::readReg(DS3231_I2C_ADDR, REG_STATUS, status) && (status & STATUS_OSF)) {
+    Serial.println("[RTC] Warning: oscillator was stopped, time is not valid until set");
+  }
+
   initialized = true;
   Serial.println("[RTC] Initialized successfully");
   return true;
@@ -35,12 +100,18 @@ bool RTC::getTime(time_t& t) {
     return false;
   }
 
-  DateTime now = rtc.now();
-  t = (time_t)now.unixtime();
+  int year, month, day, hour, minute, second;
+  if (!readDateTime(year, month, day, hour, minute, second)) {
+    Serial.println("[RTC] Read failed");
+    HealthCounters::increment(HealthCounters::Counter::RtcFail);
+    return false;
+  }
+
+  t = (time_t)((int64_t)Calendar::daysFromCivil(year, month, day) * 86400 +
+               hour * 3600 + minute * 60 + second);
 
   Serial.printf("[RTC] now=%04d-%02d-%02d %02d:%02d:%02d epoch=%lu\n",
-                now.year(), now.month(), now.day(),
-                now.hour(), now.minute(), now.second(),
+                year, month, day, hour, minute, second,
                 (unsigned long)t);
 
   return true;
@@ -51,8 +122,15 @@ bool RTC::setTime(time_t t) {
     return false;
   }
 
-  DateTime dt((uint32_t)t);
-  rtc.adjust(dt);
+  int64_t secs = (int64_t)t;
+  int32_t days = (int32_t)Calendar::floorDiv(secs, 86400);
+  int32_t rem = (int32_t)(secs - (int64_t)days * 86400);
+  Calendar::Date date = Calendar::civilFromDays(days);
+
+  if (!writeDateTime(date.year, date.month, date.day, rem / 3600, (rem / 60) % 60, rem % 60)) {
+    Serial.println("[RTC] Set failed: I2C write error");
+    return false;
+  }
 
   Serial.printf("[RTC] Time set to epoch=%lu\n", (unsigned long)t);
   return true;
@@ -64,14 +142,10 @@ bool RTC::getDateTime(int& year, int& month, int& day,
     return false;
   }
 
-  DateTime now = rtc.now();
-
-  year = now.year();
-  month = now.month();
-  day = now.day();
-  hour = now.hour();
-  minute = now.minute();
-  second = now.second();
+  if (!readDateTime(year, month, day, hour, minute, second)) {
+    Serial.println("[RTC] Read failed");
+    return false;
+  }
 
   Serial.printf("[RTC] Read success: %04d-%02d-%02d %02d:%02d:%02d\n",
                 year, month, day, hour, minute, second);
@@ -79,6 +153,61 @@ bool RTC::getDateTime(int& year, int& month, int& day,
   return true;
 }
 
+bool RTC::waitSecondEdge(time_t& t, uint32_t timeoutMs) {
+  if (!initialized) {
+    return false;
+  }
+
+  uint8_t first = 0;
+  if (!I2CBus::readReg(DS3231_I2C_ADDR, REG_TIME, first)) {
+    return false;
+  }
+
+  uint32_t startMs = millis();
+  uint8_t sec = first;
+  while (sec == first) {
+    if (millis() - startMs > timeoutMs) {
+      return false;
+    }
+    delay(1);
+    if (!I2CBus::readReg(DS3231_I2C_ADDR, REG_TIME, sec)) {
+      return false;
+    }
+  }
+
+  int year, month, day, hour, minute, second;
+  if (!readDateTime(year, month, day, hour, minute, second)) {
+    return false;
+  }
+  t = (time_t)((int64_t)Calendar::daysFromCivil(year, month, day) * 86400 +
+               hour * 3600 + minute * 60 + second);
+  return true;
+}
+
+bool RTC::getAgingOffset(int8_t& offset) {
+  uint8_t v = 0;
+  if (!initialized || !I2CBus::readReg(DS3231_I2C_ADDR, REG_AGING, v)) {
+    return false;
+  }
+  offset = (int8_t)v;
+  return true;
+}
+
+bool RTC::setAgingOffset(int8_t offset) {
+  if (!initialized || !I2CBus::writeReg(DS3231_I2C_ADDR, REG_AGING, (uint8_t)offset)) {
+    return false;
+  }
+
+  // The new offset takes effect at the next temperature conversion: force one
+  uint8_t control = 0;
+  if (I2CBus::readReg(DS3231_I2C_ADDR, REG_CONTROL, control)) {
+    I2CBus::writeReg(DS3231_I2C_ADDR, REG_CONTROL, control | CONTROL_CONV);
+  }
+
+  Serial.printf("[RTC] Aging offset set to %d\n", offset);
+  return true;
+}
+
 
 static int monthFromStr(const char* m) {
   if (!strncmp(m, "Jan", 3)) return 1;
@@ -117,25 +246,10 @@ bool RTC::syncToCompileTime() {
   int minute = atoi(timeStr + 3);
   int second = atoi(timeStr + 6);
 
-  // DS3231 wants year as 0-99 (2000+)
-  uint8_t yy = (uint8_t)(year - 2000);
-
   Serial.printf("[RTC] Syncing to compile time: %04d-%02d-%02d %02d:%02d:%02d\n",
                 year, month, day, hour, minute, second);
 
-  // Write registers directly to avoid library signature differences
-  auto decToBcd = [](uint8_t v) -> uint8_t { return (v / 10 * 16) + (v % 10); };
-
-  Wire.beginTransmission(0x68);
-  Wire.write(0x00);
-  Wire.write(decToBcd((uint8_t)second));
-  Wire.write(decToBcd((uint8_t)minute));
-  Wire.write(decToBcd((uint8_t)hour)); // 24h
-  Wire.write(decToBcd(1));             // day-of-week dummy
-  Wire.write(decToBcd((uint8_t)day));
-  Wire.write(decToBcd((uint8_t)month));
-  Wire.write(decToBcd(yy));
-  if (Wire.endTransmission() != 0) {
+  if (!writeDateTime(year, month, day, hour, minute, second)) {
     Serial.println("[RTC] Sync failed: I2C write error");
     return false;
   }
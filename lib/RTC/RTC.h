@@ -13,6 +13,14 @@ public:
 
   static bool syncToCompileTime(); // <-- add this                          
 
+  // Wait for the next seconds tick and return the time right after it
+  // (millisecond phase of the RTC, for drift measurement)
+  static bool waitSecondEdge(time_t& t, uint32_t timeoutMs);
+
+  // DS3231 aging offset (register 0x10, ~0.1 ppm per LSB, positive = slower)
+  static bool getAgingOffset(int8_t& offset);
+  static bool setAgingOffset(int8_t offset);
+
 private:
   static bool initialized;
 };
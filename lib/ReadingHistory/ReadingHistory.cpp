@@ -0,0 +1,38 @@
+#include "ReadingHistory.h"
+#include <config_common.h>
+
+// RTC memory (survives deep sleep, lost on power cycle)
+RTC_DATA_ATTR static ReadingHistory::Record rtc_history[HISTORY_CAPACITY];
+RTC_DATA_ATTR static uint16_t rtc_history_head = 0;   // Next slot to write
+RTC_DATA_ATTR static uint16_t rtc_history_count = 0;
+
+void ReadingHistory::append(time_t epoch, float tempC, float humPct) {
+  if (epoch <= 0) {
+    return;
+  }
+
+  Record& rec = rtc_history[rtc_history_head];
+  rec.epoch = (uint32_t)epoch;
+  rec.temp_centi = (int16_t)lroundf(tempC * 100.0f);
+  rec.hum_centi = (uint16_t)lroundf(humPct * 100.0f);
+
+  rtc_history_head = (rtc_history_head + 1) % HISTORY_CAPACITY;
+  if (rtc_history_count < HISTORY_CAPACITY) {
+    rtc_history_count++;
+  }
+}
+
+uint16_t ReadingHistory::count() {
+  return rtc_history_count;
+}
+
+bool ReadingHistory::get(uint16_t index, Record& out) {
+  if (index >= rtc_history_count) {
+    return false;
+  }
+
+  // Oldest record sits 'count' slots behind the write head
+  uint16_t slot = (rtc_history_head + HISTORY_CAPACITY - rtc_history_count + index) % HISTORY_CAPACITY;
+  out = rtc_history[slot];
+  return true;
+}
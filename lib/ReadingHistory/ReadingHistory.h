@@ -0,0 +1,48 @@
+#pragma once
+
+#include <Arduino.h>
+#include <time.h>
+
+/**
+ * @class ReadingHistory
+ * @brief Ring buffer of past readings kept in RTC memory.
+ * 
+ * Survives deep sleep (lost on power cycle). Records are stored oldest-first
+ * in compact fixed-point form so HistoryReplay can stream them back on request.
+ * Holds HISTORY_CAPACITY records; the oldest record is overwritten when full.
+ */
+class ReadingHistory {
+public:
+  /**
+   * @struct Record
+   * @brief One stored reading (8 bytes).
+   */
+  struct Record {
+    uint32_t epoch;       // Unix epoch seconds (UTC)
+    int16_t temp_centi;   // Temperature in 0.01 °C
+    uint16_t hum_centi;   // Relative humidity in 0.01 %
+  };
+
+  /**
+   * @brief Append a reading. Readings without a valid timestamp are ignored.
+   * 
+   * @param epoch Unix epoch time from RTC (must be > 0)
+   * @param tempC Temperature in degrees Celsius
+   * @param humPct Relative humidity in percent
+   */
+  static void append(time_t epoch, float tempC, float humPct);
+
+  /**
+   * @brief Number of records currently stored.
+   */
+  static uint16_t count();
+
+  /**
+   * @brief Read a record by age.
+   * 
+   * @param index 0 = oldest, count()-1 = newest
+   * @param out Output record
+   * @return true if index is valid
+   */
+  static bool get(uint16_t index, Record& out);
+};
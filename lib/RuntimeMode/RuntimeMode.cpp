@@ -0,0 +1,28 @@
+#include "RuntimeMode.h"
+#include <ConfigStore.h>
+
+// Static member definition
+RuntimeMode::Mode RuntimeMode::current = RuntimeMode::Mode::Battery;
+
+void RuntimeMode::begin() {
+  uint8_t stored = ConfigStore::get().mode;
+  current = (stored == (uint8_t)Mode::Continuous) ? Mode::Continuous : Mode::Battery;
+  Serial.printf("[Mode] Power mode: %s\n", name(current));
+}
+
+RuntimeMode::Mode RuntimeMode::get() {
+  return current;
+}
+
+bool RuntimeMode::set(Mode mode) {
+  bool ok = ConfigStore::setMode((uint8_t)mode);
+  if (ok) {
+    current = mode;
+    Serial.printf("[Mode] Power mode set to %s\n", name(mode));
+  }
+  return ok;
+}
+
+const char* RuntimeMode::name(Mode mode) {
+  return (mode == Mode::Continuous) ? "continuous" : "battery";
+}
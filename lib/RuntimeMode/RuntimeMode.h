@@ -0,0 +1,45 @@
+#pragma once
+
+#include <Arduino.h>
+
+/**
+ * @class RuntimeMode
+ * @brief Persisted power mode: deep-sleep battery cycle or always-connected.
+ * 
+ * Stored by ConfigStore (NVS) so it survives power cycles, and switched at
+ * runtime with the "mode=battery" / "mode=continuous" MQTT commands. The main
+ * flow checks it before sleeping, so a change applies at the end of the
+ * current wake (or on the next scheduler pass in continuous mode).
+ */
+class RuntimeMode {
+public:
+  enum class Mode : uint8_t {
+    Battery = 0,     // Wake, publish, deep sleep
+    Continuous = 1   // Mains powered: stay connected, modem sleep between jobs
+  };
+
+  /**
+   * @brief Load the persisted mode (defaults to Battery; after ConfigStore::begin()).
+   */
+  static void begin();
+
+  /**
+   * @brief Current mode.
+   */
+  static Mode get();
+
+  /**
+   * @brief Change and persist the mode.
+   * 
+   * @return true if stored successfully
+   */
+  static bool set(Mode mode);
+
+  /**
+   * @brief Mode name for logs and responses ("battery" / "continuous").
+   */
+  static const char* name(Mode mode);
+
+private:
+  static Mode current;
+};
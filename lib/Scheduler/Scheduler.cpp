@@ -0,0 +1,68 @@
+#include "Scheduler.h"
+
+void Scheduler::begin(Clock clock) {
+  clock_ = clock;
+  count_ = 0;
+}
+
+int8_t Scheduler::every(uint32_t periodMs, Job job, bool runNow) {
+  if (count_ >= MAX_JOBS || periodMs == 0 || job == nullptr || clock_ == nullptr) {
+    return -1;
+  }
+
+  uint32_t now = (uint32_t)clock_();
+  Slot& slot = slots_[count_];
+  slot.job = job;
+  slot.periodMs = periodMs;
+  slot.nextMs = runNow ? now : now + periodMs;
+  return (int8_t)count_++;
+}
+
+void Scheduler::setPeriod(int8_t id, uint32_t periodMs) {
+  if (id < 0 || id >= count_ || periodMs == 0) {
+    return;
+  }
+  slots_[id].periodMs = periodMs;
+  slots_[id].nextMs = (uint32_t)clock_() + periodMs;
+}
+
+uint32_t Scheduler::runDue() {
+  if (clock_ == nullptr) {
+    return IDLE_FOREVER;
+  }
+
+  for (uint8_t i = 0; i < count_; i++) {
+    Slot& slot = slots_[i];
+    uint32_t now = (uint32_t)clock_();
+    if (!reached(now, slot.nextMs)) {
+      continue;
+    }
+
+    slot.job();
+
+    // Keep the cadence, but never schedule in the past
+    slot.nextMs += slot.periodMs;
+    now = (uint32_t)clock_();
+    if (reached(now, slot.nextMs)) {
+      slot.nextMs = now + slot.periodMs;
+    }
+  }
+
+  return msUntilNext();
+}
+
+uint32_t Scheduler::msUntilNext() const {
+  if (clock_ == nullptr || count_ == 0) {
+    return IDLE_FOREVER;
+  }
+
+  uint32_t now = (uint32_t)clock_();
+  uint32_t best = IDLE_FOREVER;
+  for (uint8_t i = 0; i < count_; i++) {
+    uint32_t wait = reached(now, slots_[i].nextMs) ? 0 : slots_[i].nextMs - now;
+    if (wait < best) {
+      best = wait;
+    }
+  }
+  return best;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdint>
+
+/**
+ * @class Scheduler
+ * @brief Fixed-slot periodic job scheduler driven by an injected clock.
+ * 
+ * Used by continuous (mains) mode: the main loop runs due jobs, then blocks
+ * until the next one is due instead of polling. The clock is a plain function
+ * returning milliseconds (millis() on the device, a virtual clock in a
+ * simulation), and the scheduler never sleeps by itself.
+ * 
+ * No Arduino dependencies, no heap.
+ */
+class Scheduler {
+public:
+  typedef unsigned long (*Clock)();
+  typedef void (*Job)();
+
+  static const uint8_t MAX_JOBS = 8;
+  static const uint32_t IDLE_FOREVER = 0xFFFFFFFFUL;
+
+  /**
+   * @brief Set the time source and drop all jobs.
+   */
+  void begin(Clock clock);
+
+  /**
+   * @brief Register a periodic job.
+   * 
+   * @param periodMs Period in milliseconds (> 0)
+   * @param job Function to run
+   * @param runNow true to run on the next runDue(), false to wait one period
+   * @return Job id, or -1 if all slots are used
+   */
+  int8_t every(uint32_t periodMs, Job job, bool runNow = false);
+
+  /**
+   * @brief Change a job's period; the next run is rescheduled from now.
+   */
+  void setPeriod(int8_t id, uint32_t periodMs);
+
+  /**
+   * @brief Run every job that is due.
+   * 
+   * A job that fell behind runs once and is rescheduled from its previous due
+   * time (no burst of catch-up runs; falls back to now if more than a period late).
+   * 
+   * @return Milliseconds until the next job is due (IDLE_FOREVER if none)
+   */
+  uint32_t runDue();
+
+  /**
+   * @brief Milliseconds until the next job is due (IDLE_FOREVER if none).
+   */
+  uint32_t msUntilNext() const;
+
+private:
+  struct Slot {
+    Job job;
+    uint32_t periodMs;
+    uint32_t nextMs;
+  };
+
+  Clock clock_ = nullptr;
+  Slot slots_[MAX_JOBS] = {};
+  uint8_t count_ = 0;
+
+  // Wrap-safe "a is at or after b" for 32-bit millisecond timestamps
+  static bool reached(uint32_t now, uint32_t due) {
+    return (int32_t)(now - due) >= 0;
+  }
+};
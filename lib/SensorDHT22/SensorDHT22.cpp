@@ -1,5 +1,6 @@
 #include "SensorDHT22.h"
 #include <DHT.h>
+#include <HealthCounters.h>
 
 // DHT instance pointer (will be created in begin())
 static DHT* dhtPtr = nullptr;
@@ -39,6 +40,7 @@ bool SensorDHT22::read(float& tempC, float& humPct) {
   // Check if read was successful
   if (isnan(tempC) || isnan(humPct)) {
     Serial.println("[DHT] Read failed: NaN values");
+    HealthCounters::increment(HealthCounters::Counter::DhtFail);
     return false;
   }
 
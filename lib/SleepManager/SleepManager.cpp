@@ -1,9 +1,37 @@
 #include "SleepManager.h"
+#include <sys/time.h>
+#include <driver/rtc_io.h>
+#include <config_common.h>
+#include <profile.h>
 
 // RTC memory in slow memory bank (survives deep sleep)
 // We use a struct to access RTC slow memory
 RTC_DATA_ATTR uint64_t rtc_wake_count = 0;
 
+// Scheduled timer wake (system time in us, kept by the RTC timer across deep sleep)
+RTC_DATA_ATTR static int64_t rtc_next_timer_wake_us = 0;
+
+// Released active-low inputs idle high, and only EXT0 and a one-pin EXT1
+// (all low) can wake on a high input going low
+static constexpr uint8_t eventInputCount() {
+  uint8_t n = 0;
+  for (uint8_t i = 0; i < INPUT_PIN_COUNT; i++) {
+    if (INPUT_PIN_MODES[i] == INPUT_MODE_EVENT) {
+      n++;
+    }
+  }
+  return n;
+}
+static_assert(!(INPUT_WAKE_ENABLED && INPUT_ACTIVE_LOW == 1 && Profile::eventInputs) ||
+              eventInputCount() <= 2,
+              "Input wake: at most two active-low event inputs can wake the device");
+
+static int64_t systemTimeUs() {
+  struct timeval tv;
+  gettimeofday(&tv, nullptr);
+  return (int64_t)tv.tv_sec * 1000000LL + tv.tv_usec;
+}
+
 void SleepManager::begin(uint32_t interval_minutes_param) {
   interval_minutes = interval_minutes_param;
   
@@ -11,7 +39,7 @@ void SleepManager::begin(uint32_t interval_minutes_param) {
   wake_count = readWakeCountFromRTC();
   
   Serial.printf("[Sleep] Initialized: interval=%d min, wake_count=%llu\n", 
-                interval_minutes, wake_count);
+                interval_minutes, (unsigned long long)wake_count);
   
   // Log wake reason (cold boot vs timer wake)
   logWakeReason();
@@ -22,13 +50,21 @@ void SleepManager::sleep() {
   wake_count++;
   writeWakeCountToRTC(wake_count);
   
-  Serial.printf("[Sleep] Entering deep sleep for %d minutes (wake_count=%llu)\n",
-                interval_minutes, wake_count);
-  Serial.flush();  // Ensure all Serial output is sent before sleep
+  Serial.printf("[Sleep] Entering deep sleep (interval=%d min, wake_count=%llu)\n",
+                interval_minutes, (unsigned long long)wake_count);
   
-  // Configure timer-based wake-up
-  uint64_t sleep_us = (uint64_t)interval_minutes * 60 * 1000000ULL;
+  // Configure timer-based wake-up (keeps the schedule across input wakes)
+  uint64_t sleep_us = nextSleepDurationUs();
   esp_sleep_enable_timer_wakeup(sleep_us);
+
+#if INPUT_WAKE_ENABLED
+  // Input wakes publish event inputs: nothing to do in profiles without them
+  if constexpr (Profile::eventInputs) {
+    armInputWake();
+  }
+#endif
+
+  Serial.flush();  // Ensure all Serial output is sent before sleep
   
   // Enter deep sleep (does not return)
   esp_deep_sleep_start();
@@ -42,12 +78,81 @@ uint32_t SleepManager::getIntervalMinutes() const {
   return interval_minutes;
 }
 
+SleepManager::WakeCause SleepManager::getWakeCause() const {
+  return wake_cause;
+}
+
+uint64_t SleepManager::getWakePinMask() const {
+  return wake_pin_mask;
+}
+
+SleepManager::WakeCause SleepManager::classifyWake(esp_sleep_wakeup_cause_t cause) {
+  switch (cause) {
+  case ESP_SLEEP_WAKEUP_TIMER:
+    return WakeCause::Timer;
+  case ESP_SLEEP_WAKEUP_EXT0:
+  case ESP_SLEEP_WAKEUP_EXT1:
+    return WakeCause::Input;
+  case ESP_SLEEP_WAKEUP_UNDEFINED:
+    return WakeCause::ColdBoot;
+  default:
+    return WakeCause::Other;
+  }
+}
+
+SleepManager::InputWakePlan SleepManager::planInputWake(uint64_t eventPins, uint64_t lowPins) {
+  InputWakePlan plan = {0, ESP_EXT1_WAKEUP_ANY_HIGH, -1, 0};
+
+  // Inputs now low: any of them going high
+  plan.ext1Mask = eventPins & lowPins;
+
+  // Inputs now high: EXT0 for the first, then EXT1 on its own if still free
+  // (all low over one pin = that pin going low)
+  uint64_t high = eventPins & ~lowPins;
+  for (int pin = 0; pin < 64 && high != 0; pin++) {
+    uint64_t bit = 1ULL << pin;
+    if ((high & bit) == 0) {
+      continue;
+    }
+    high &= ~bit;
+    if (plan.ext0Pin < 0) {
+      plan.ext0Pin = pin;
+    } else if (plan.ext1Mask == 0) {
+      plan.ext1Mask = bit;
+      plan.ext1Mode = ESP_EXT1_WAKEUP_ALL_LOW;
+    } else {
+      plan.uncovered |= bit;
+    }
+  }
+  return plan;
+}
+
+uint64_t SleepManager::sleepDurationUs(WakeCause cause, int64_t nowUs, uint64_t intervalUs,
+                                       int64_t& nextTimerWakeUs) {
+  // Input wakes sleep only for what is left of the current timer interval
+  if (cause == WakeCause::Input && nextTimerWakeUs > nowUs) {
+    uint64_t remaining = (uint64_t)(nextTimerWakeUs - nowUs);
+    if (remaining <= intervalUs) {
+      return remaining;
+    }
+  }
+
+  nextTimerWakeUs = nowUs + (int64_t)intervalUs;
+  return intervalUs;
+}
+
 // ============================================================================
 // Private helper functions
 // ============================================================================
 
 void SleepManager::logWakeReason() {
   esp_sleep_wakeup_cause_t wakeup_reason = esp_sleep_get_wakeup_cause();
+  wake_cause = classifyWake(wakeup_reason);
+
+  wake_pin_mask = 0;
+  if (wakeup_reason == ESP_SLEEP_WAKEUP_EXT1) {
+    wake_pin_mask = esp_sleep_get_ext1_wakeup_status();
+  }
   
   const char* reason_str = "UNKNOWN";
   switch (wakeup_reason) {
@@ -75,6 +180,60 @@ void SleepManager::logWakeReason() {
   Serial.printf("[Sleep] Wake reason: %s\n", reason_str);
 }
 
+uint64_t SleepManager::nextSleepDurationUs() {
+  uint64_t interval_us = (uint64_t)interval_minutes * 60 * 1000000ULL;
+  return sleepDurationUs(wake_cause, systemTimeUs(), interval_us, rtc_next_timer_wake_us);
+}
+
+void SleepManager::armInputWake() {
+  // Wake on change: see planInputWake()
+  uint64_t eventPins = 0;
+  uint64_t lowPins = 0;
+
+  for (uint8_t i = 0; i < INPUT_PIN_COUNT; i++) {
+    gpio_num_t pin = (gpio_num_t)INPUT_PINS[i];
+    if (INPUT_PIN_MODES[i] != INPUT_MODE_EVENT || !rtc_gpio_is_valid_gpio(pin)) {
+      continue;
+    }
+
+    eventPins |= (1ULL << pin);
+    if (digitalRead(pin) == LOW) {
+      lowPins |= (1ULL << pin);
+    }
+#if INPUT_ACTIVE_LOW == 1
+    rtc_gpio_pulldown_dis(pin);
+    rtc_gpio_pullup_en(pin);
+#else
+    rtc_gpio_pullup_dis(pin);
+    rtc_gpio_pulldown_en(pin);
+#endif
+  }
+
+  InputWakePlan plan = planInputWake(eventPins, lowPins);
+  if (plan.uncovered != 0) {
+    Serial.printf("[Sleep] Pins 0x%llx high: no wake source left (EXT0/EXT1 in use)\n",
+                  (unsigned long long)plan.uncovered);
+  }
+  if (plan.ext1Mask == 0 && plan.ext0Pin < 0) {
+    return;
+  }
+
+  // Pull resistors and EXT wake logic live in the RTC peripheral domain
+  esp_sleep_pd_config(ESP_PD_DOMAIN_RTC_PERIPH, ESP_PD_OPTION_ON);
+
+  if (plan.ext1Mask != 0) {
+    esp_sleep_enable_ext1_wakeup(plan.ext1Mask, plan.ext1Mode);
+  }
+  if (plan.ext0Pin >= 0) {
+    esp_sleep_enable_ext0_wakeup((gpio_num_t)plan.ext0Pin, 0);
+  }
+
+  Serial.printf("[Sleep] Input wake armed: ext1=0x%llx (%s) ext0=%d\n",
+                (unsigned long long)plan.ext1Mask,
+                plan.ext1Mode == ESP_EXT1_WAKEUP_ALL_LOW ? "all low" : "any high",
+                plan.ext0Pin);
+}
+
 uint64_t SleepManager::readWakeCountFromRTC() const {
   // Read from RTC memory (persists across deep sleep)
   return rtc_wake_count;
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <Arduino.h>
+#include <esp_sleep.h>
 
 /**
  * @class SleepManager
@@ -9,10 +10,70 @@
  * Manages deep sleep intervals (default 30 minutes) with wake-up counter
  * stored in RTC memory (survives deep sleep). Logs wake reason and boot info.
  * 
+ * Event inputs (INPUT_MODE_EVENT) can also wake the device when their level
+ * changes: EXT1 (any high) for inputs currently low, EXT0 for one input
+ * currently high and, if no input is low, EXT1 (all low) for a second one.
+ * Two active-low event inputs are the most that can wake the device (both
+ * idle high); more is a compile-time error.
+ * Input wakes do not move the timer schedule: the next sleep only covers the
+ * time remaining until the scheduled timer wake.
+ * 
  * The sleep() method enters deep sleep and does NOT return.
  */
 class SleepManager {
 public:
+  /**
+   * @brief Why the current wake happened, as far as the main flow cares.
+   */
+  enum class WakeCause {
+    ColdBoot,   // Power-on / reset: full path
+    Timer,      // Scheduled wake: full path
+    Input,      // Input level change: event-only fast path
+    Other       // Anything else (ULP, touch): full path
+  };
+
+  /**
+   * @brief Map an ESP-IDF wake cause onto the main flow's wake paths.
+   * 
+   * Pure function (no hardware access).
+   */
+  static WakeCause classifyWake(esp_sleep_wakeup_cause_t cause);
+
+  /**
+   * @brief Deep sleep wake sources for event inputs at their current levels.
+   */
+  struct InputWakePlan {
+    uint64_t ext1Mask;                       // 0: EXT1 not used
+    esp_sleep_ext1_wakeup_mode_t ext1Mode;
+    int ext0Pin;                             // -1: EXT0 not used (wakes on low)
+    uint64_t uncovered;                      // Inputs no wake source is left for
+  };
+
+  /**
+   * @brief Assign EXT0/EXT1 to event inputs (bit n = GPIOn).
+   * 
+   * Pure function (no hardware access).
+   * 
+   * @param eventPins RTC-capable event inputs
+   * @param lowPins Inputs currently low (others are high)
+   */
+  static InputWakePlan planInputWake(uint64_t eventPins, uint64_t lowPins);
+
+  /**
+   * @brief Length of the next deep sleep on the timer schedule.
+   * 
+   * Input wakes sleep only for what is left until nextTimerWakeUs; any other
+   * wake (or a schedule that is missed or out of range) starts a new interval
+   * and moves nextTimerWakeUs. Pure function (no hardware access).
+   * 
+   * @param cause Classified cause of the current wake
+   * @param nowUs System time
+   * @param intervalUs Timer interval
+   * @param nextTimerWakeUs Scheduled timer wake (system time), updated
+   */
+  static uint64_t sleepDurationUs(WakeCause cause, int64_t nowUs, uint64_t intervalUs,
+                                  int64_t& nextTimerWakeUs);
+
   /**
    * @brief Initialize deep sleep scheduler.
    * 
@@ -51,9 +112,21 @@ public:
    */
   uint32_t getIntervalMinutes() const;
 
+  /**
+   * @brief Get the classified cause of the current wake.
+   */
+  WakeCause getWakeCause() const;
+
+  /**
+   * @brief Bit mask of GPIOs that caused an input wake (0 otherwise).
+   */
+  uint64_t getWakePinMask() const;
+
 private:
   uint32_t interval_minutes = 30;
   uint64_t wake_count = 0;
+  WakeCause wake_cause = WakeCause::ColdBoot;
+  uint64_t wake_pin_mask = 0;
 
   // RTC memory structure (survives deep sleep, lost on power cycle)
   // RTC_SLOW_MEM: 8KB of memory accessible across sleep cycles
@@ -61,6 +134,8 @@ private:
 
   // Helper functions
   void logWakeReason();
+  uint64_t nextSleepDurationUs();
+  void armInputWake();
   uint64_t readWakeCountFromRTC() const;
   void writeWakeCountToRTC(uint64_t count);
 };
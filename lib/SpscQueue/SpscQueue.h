@@ -0,0 +1,218 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+/**
+ * @class SpscQueue
+ * @brief Lock-free single-producer / single-consumer ring buffer.
+ * 
+ * push() may be called from exactly one context (an ISR, a timer callback or
+ * a task) and pop() from exactly one other context, on either core. No locks,
+ * no heap, no critical sections, so push() is safe to inline into IRAM ISRs.
+ * 
+ * One slot is kept free to tell full from empty, so the queue holds
+ * Capacity - 1 items. Capacity must be a power of two.
+ */
+template <typename T, uint16_t Capacity>
+class SpscQueue {
+  static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0,
+                "SpscQueue capacity must be a power of two");
+
+public:
+  /**
+   * @brief Append an item (producer side).
+   * 
+   * @return false if the queue is full (item dropped)
+   */
+  inline __attribute__((always_inline)) bool push(const T& item) {
+    uint16_t h = head.load(std::memory_order_relaxed);
+    uint16_t next = (h + 1) & MASK;
+    if (next == tail.load(std::memory_order_acquire)) {
+      return false;
+    }
+    items[h] = item;
+    head.store(next, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * @brief Remove the oldest item (consumer side).
+   * 
+   * @return false if the queue is empty
+   */
+  inline __attribute__((always_inline)) bool pop(T& out) {
+    uint16_t t = tail.load(std::memory_order_relaxed);
+    if (t == head.load(std::memory_order_acquire)) {
+      return false;
+    }
+    out = items[t];
+    tail.store((t + 1) & MASK, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * @brief Peek at the oldest item without removing it (consumer side).
+   * 
+   * Lets the consumer work on large items in place and only release the slot
+   * with popFront() once it is done with them.
+   * 
+   * @return Pointer to the oldest item, or nullptr if the queue is empty
+   */
+  T* front() {
+    return peek(0);
+  }
+
+  /**
+   * @brief Peek at the item 'offset' places after the oldest (consumer side).
+   * 
+   * @return Pointer to the item, or nullptr if the queue holds fewer items
+   */
+  T* peek(uint16_t offset) {
+    uint16_t t = tail.load(std::memory_order_relaxed);
+    uint16_t count = (head.load(std::memory_order_acquire) - t) & MASK;
+    if (offset >= count) {
+      return nullptr;
+    }
+    return &items[(t + offset) & MASK];
+  }
+
+  /**
+   * @brief Release the oldest n items, seen through front()/peek() (consumer
+   *        side). n must not exceed the number of items peeked.
+   */
+  void popFront(uint16_t n = 1) {
+    uint16_t t = tail.load(std::memory_order_relaxed);
+    tail.store((t + n) & MASK, std::memory_order_release);
+  }
+
+  /**
+   * @brief Check if the queue is empty (approximate if the producer is active).
+   */
+  bool empty() const {
+    return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+  }
+
+private:
+  static const uint16_t MASK = Capacity - 1;
+
+  T items[Capacity];
+  std::atomic<uint16_t> head{0};  // Written by producer only
+  std::atomic<uint16_t> tail{0};  // Written by consumer only
+};
+
+/**
+ * @class SpscByteQueue
+ * @brief Single-producer / single-consumer queue of variable-length records
+ *        in one shared byte buffer.
+ * 
+ * For payloads whose sizes vary widely: a fixed-slot queue has to size every
+ * slot for the largest record. Here each record takes a 4-byte header plus
+ * its length rounded up to 4 bytes. Records are contiguous; one that does
+ * not fit before the end of the buffer starts again at the front (the tail
+ * end is skipped).
+ * 
+ * Producer: reserve() space, fill it, commit(). Consumer: front(), use the
+ * record in place, popFront(). Same context rules as SpscQueue.
+ */
+template <uint16_t Capacity>
+class SpscByteQueue {
+  static_assert(Capacity >= 8 && (Capacity & (Capacity - 1)) == 0,
+                "SpscByteQueue capacity must be a power of two");
+
+public:
+  /**
+   * @brief Reserve a contiguous record of len bytes (producer side).
+   * 
+   * @return Pointer to fill before commit(), or nullptr if it does not fit now
+   */
+  uint8_t* reserve(uint16_t len) {
+    uint32_t h = head.load(std::memory_order_relaxed);
+    uint32_t t = tail.load(std::memory_order_acquire);
+    uint32_t need = recordSize(len);
+    uint32_t offset = h & MASK;
+    uint32_t skip = (Capacity - offset < need) ? Capacity - offset : 0;
+    if (need > Capacity || (h - t) + skip + need > Capacity) {
+      return nullptr;
+    }
+    if (skip > 0) {
+      writeHeader(offset, SKIP);
+      h += skip;
+    }
+    reservedAt = h;
+    return &buf[(h & MASK) + HEADER];
+  }
+
+  /**
+   * @brief Publish the record returned by reserve() (producer side).
+   * 
+   * @param len Bytes used, at most the reserved length
+   */
+  void commit(uint16_t len) {
+    writeHeader(reservedAt & MASK, len);
+    head.store(reservedAt + recordSize(len), std::memory_order_release);
+  }
+
+  /**
+   * @brief Oldest record, in place (consumer side).
+   * 
+   * @return Pointer to the record, or nullptr if the queue is empty
+   */
+  const uint8_t* front(uint16_t& len) {
+    uint32_t h = head.load(std::memory_order_acquire);
+    uint32_t t = oldest(h);
+    if (t == h) {
+      return nullptr;
+    }
+    len = readHeader(t & MASK);
+    return &buf[(t & MASK) + HEADER];
+  }
+
+  /**
+   * @brief Release the record returned by front() (consumer side).
+   */
+  void popFront() {
+    uint32_t t = oldest(head.load(std::memory_order_acquire));
+    tail.store(t + recordSize(readHeader(t & MASK)), std::memory_order_release);
+  }
+
+  /**
+   * @brief Check if the queue is empty (approximate if the producer is active).
+   */
+  bool empty() const {
+    return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+  }
+
+private:
+  static const uint32_t MASK = Capacity - 1;
+  static const uint32_t HEADER = 4;
+  static const uint16_t SKIP = 0xFFFF;   // rest of the buffer unused
+
+  alignas(4) uint8_t buf[Capacity];
+  std::atomic<uint32_t> head{0};  // Free-running byte positions; written by producer only
+  std::atomic<uint32_t> tail{0};  // Written by consumer only
+  uint32_t reservedAt = 0;        // Producer only
+
+  static uint32_t recordSize(uint16_t len) {
+    return HEADER + (((uint32_t)len + 3) & ~3u);
+  }
+
+  void writeHeader(uint32_t offset, uint16_t len) {
+    buf[offset] = (uint8_t)len;
+    buf[offset + 1] = (uint8_t)(len >> 8);
+  }
+
+  uint16_t readHeader(uint32_t offset) const {
+    return (uint16_t)(buf[offset] | (buf[offset + 1] << 8));
+  }
+
+  // Tail position of the oldest record, past a skip marker (h: head as loaded
+  // by the caller, so both see the same records)
+  uint32_t oldest(uint32_t h) const {
+    uint32_t t = tail.load(std::memory_order_relaxed);
+    if (t != h && readHeader(t & MASK) == SKIP) {
+      t += Capacity - (t & MASK);
+    }
+    return t;
+  }
+};
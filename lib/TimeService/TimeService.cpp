@@ -0,0 +1,298 @@
+#include "TimeService.h"
+#include <WiFi.h>
+#include <WiFiUdp.h>
+#include <Preferences.h>
+#include <RTC.h>
+#include <cmath>
+#include <config_common.h>
+
+static const uint32_t NTP_UNIX_OFFSET_S = 2208988800UL;   // 1900-01-01 -> 1970-01-01
+static const uint16_t NTP_PORT = 123;
+static const size_t NTP_PACKET_SIZE = 48;
+static const uint8_t NTP_CLIENT_REQUEST = 0x23;            // LI 0, version 4, mode 3
+static const uint8_t NTP_MODE_SERVER = 4;
+
+static const time_t TIME_VALID_AFTER = 1704067200;         // 2024-01-01: clock was set
+static const uint32_t SECOND_EDGE_TIMEOUT_MS = 1100;
+static const int64_t MIN_DRIFT_INTERVAL_MS = (int64_t)TIME_DRIFT_MIN_HOURS * 3600000LL;
+static const float DRIFT_WEIGHT = 0.5f;                    // newest measurement's share
+static const uint8_t MAX_SYNC_FAILURES = 16;               // keeps the backoff shift in range
+
+static const char* PREFS_NAMESPACE = "time";
+static const char* PREFS_KEY_DRIFT = "drift";
+
+// RTC memory (survives deep sleep, lost on power cycle)
+RTC_DATA_ATTR static TimeService::DriftState rtc_drift;
+RTC_DATA_ATTR static bool rtc_drift_loaded = false;
+
+// Last sync on this wake (for the log line)
+static int64_t lastErrorMs = 0;
+
+// Wait after the given number of consecutive failures: 1, 2, 4, ... x TIME_SYNC_RETRY_MIN
+static uint32_t retryMinutes(uint8_t failures) {
+  uint32_t minutes = (uint32_t)TIME_SYNC_RETRY_MIN << (failures - 1);
+  return minutes < TIME_SYNC_RETRY_MAX ? minutes : TIME_SYNC_RETRY_MAX;
+}
+
+// ============================
+// Public: begin()
+// ============================
+void TimeService::begin() {
+  if (rtc_drift_loaded) {
+    return;
+  }
+
+  // Cold boot: the DS3231 kept running on its own battery, and so does the model
+  Preferences prefs;
+  if (prefs.begin(PREFS_NAMESPACE, true)) {
+    // Fields are only appended: older (shorter) blobs are a prefix
+    size_t len = prefs.getBytesLength(PREFS_KEY_DRIFT);
+    if (len > 0 && len <= sizeof(DriftState)) {
+      prefs.getBytes(PREFS_KEY_DRIFT, &rtc_drift, len);
+    }
+    rtc_drift.syncFailures = 0;
+    rtc_drift.lastAttempt = 0;
+    prefs.end();
+  }
+  rtc_drift_loaded = true;
+
+  if (rtc_drift.lastSyncMs != 0) {
+    Serial.printf("[Time] Drift model: %.2f ppm intrinsic, aging=%d, residual %.2f ppm\n",
+                  rtc_drift.intrinsicPpm, rtc_drift.aging, residualPpm(rtc_drift));
+  }
+}
+
+// ============================
+// Public: now()
+// ============================
+bool TimeService::now(time_t& t) {
+  time_t raw = 0;
+  if (!RTC::getTime(raw)) {
+    return false;
+  }
+  t = correct(rtc_drift, raw);
+  return true;
+}
+
+// ============================
+// Public: syncIfDue()
+// ============================
+bool TimeService::syncIfDue() {
+  time_t raw = 0;
+  if (!RTC::getTime(raw)) {
+    return false;
+  }
+
+  if (!syncDue(rtc_drift, raw)) {
+    return false;
+  }
+  bool clockSet = raw >= TIME_VALID_AFTER;
+
+  // First sync: start from whatever aging offset the module has
+  if (rtc_drift.lastSyncMs == 0) {
+    RTC::getAgingOffset(rtc_drift.aging);
+  }
+
+  // Millisecond phase of the DS3231: time right after its seconds tick
+  time_t edge = 0;
+  if (!RTC::waitSecondEdge(edge, SECOND_EDGE_TIMEOUT_MS)) {
+    Serial.println("[Time] RTC seconds tick not seen");
+    syncFailed(rtc_drift, raw);
+    return false;
+  }
+  uint32_t edgeMillis = millis();
+
+  int64_t ntpMs = 0;
+  uint32_t atMillis = 0;
+  if (!querySntp(ntpMs, atMillis)) {
+    syncFailed(rtc_drift, raw);
+    Serial.printf("[Time] SNTP query failed (%u in a row), retry in %lu min\n",
+                  rtc_drift.syncFailures, (unsigned long)retryMinutes(rtc_drift.syncFailures));
+    return false;
+  }
+  rtc_drift.syncFailures = 0;
+  rtc_drift.lastAttempt = 0;
+
+  int64_t rtcMs = (int64_t)edge * 1000 + (int32_t)(atMillis - edgeMillis);
+  lastErrorMs = rtcMs - ntpMs;
+
+  // Drift is only meaningful if the clock ran since a previous sync
+  if (clockSet) {
+    if (updateDrift(rtc_drift, ntpMs, lastErrorMs)) {
+      RTC::setAgingOffset(rtc_drift.aging);
+    }
+  } else {
+    rtc_drift.lastSyncMs = ntpMs;
+  }
+
+  // Set the clock on the next reference second boundary (the DS3231 restarts
+  // its countdown chain when the seconds register is written)
+  int64_t refMs = ntpMs + (uint32_t)(millis() - atMillis);
+  uint32_t waitMs = 1000 - (uint32_t)(refMs % 1000);
+  delay(waitMs);
+  RTC::setTime((time_t)((refMs + waitMs) / 1000));
+
+  persist();
+  Serial.printf("[Time] Synced: RTC was %lld ms off, residual %.2f ppm\n",
+                (long long)lastErrorMs, residualPpm(rtc_drift));
+  return true;
+}
+
+int TimeService::formatSyncSummary(char* buf, size_t len) {
+  int n = snprintf(buf, len, "offset_ms=%lld ppm=%.2f aging=%d",
+                   (long long)lastErrorMs, rtc_drift.intrinsicPpm, rtc_drift.aging);
+  return (n < 0 || n >= (int)len) ? 0 : n;
+}
+
+// ============================
+// Public: drift model (pure)
+// ============================
+bool TimeService::updateDrift(DriftState& state, int64_t ntpMs, int64_t errorMs) {
+  int64_t intervalMs = ntpMs - state.lastSyncMs;
+  bool measurable = state.lastSyncMs != 0 && intervalMs >= MIN_DRIFT_INTERVAL_MS;
+  state.lastSyncMs = ntpMs;
+
+  if (!measurable) {
+    return false;
+  }
+
+  // Measured with the aging offset of the whole interval in effect
+  double measuredPpm = (double)errorMs * 1e6 / (double)intervalMs;
+  if (fabs(measuredPpm) > TIME_MAX_DRIFT_PPM) {
+    return false;   // clock was reset or set by hand in between
+  }
+  float intrinsic = (float)measuredPpm + state.aging * RTC_AGING_PPM_PER_LSB;
+
+  state.intrinsicPpm = state.samples == 0
+    ? intrinsic
+    : state.intrinsicPpm + DRIFT_WEIGHT * (intrinsic - state.intrinsicPpm);
+  if (state.samples < 255) {
+    state.samples++;
+  }
+
+  // Positive aging slows the oscillator: trim a fast clock with a positive offset
+  long aging = lroundf(state.intrinsicPpm / RTC_AGING_PPM_PER_LSB);
+  aging = aging > 127 ? 127 : (aging < -127 ? -127 : aging);
+
+  bool changed = aging != state.aging;
+  state.aging = (int8_t)aging;
+  return changed;
+}
+
+bool TimeService::syncDue(const DriftState& state, time_t rtcTime) {
+  bool clockSet = rtcTime >= TIME_VALID_AFTER;
+  bool due = state.lastSyncMs == 0 || !clockSet ||
+             (int64_t)rtcTime - state.lastSyncMs / 1000 >= (int64_t)TIME_SYNC_INTERVAL_DAYS * 86400;
+  if (!due || state.syncFailures == 0) {
+    return due;
+  }
+
+  // Backing off after failures
+  int64_t sinceAttempt = (int64_t)rtcTime - (int64_t)state.lastAttempt;
+  if (sinceAttempt < 0) {
+    return true;   // clock went back (reset or set by hand)
+  }
+  return sinceAttempt >= (int64_t)retryMinutes(state.syncFailures) * 60;
+}
+
+void TimeService::syncFailed(DriftState& state, time_t rtcTime) {
+  if (state.syncFailures < MAX_SYNC_FAILURES) {
+    state.syncFailures++;
+  }
+  state.lastAttempt = (uint32_t)rtcTime;
+}
+
+float TimeService::residualPpm(const DriftState& state) {
+  if (state.samples == 0) {
+    return 0.0f;
+  }
+  return state.intrinsicPpm - state.aging * RTC_AGING_PPM_PER_LSB;
+}
+
+time_t TimeService::correct(const DriftState& state, time_t rtcTime) {
+  if (state.lastSyncMs == 0) {
+    return rtcTime;
+  }
+
+  double elapsedS = (double)rtcTime - (double)(state.lastSyncMs / 1000);
+  if (elapsedS <= 0) {
+    return rtcTime;
+  }
+
+  // A fast clock (positive ppm) is ahead by elapsed * ppm
+  double aheadS = elapsedS * residualPpm(state) / 1e6;
+  return rtcTime - (time_t)llround(aheadS);
+}
+
+// ============================
+// Private
+// ============================
+bool TimeService::querySntp(int64_t& unixMs, uint32_t& atMillis) {
+  IPAddress server;
+  if (!WiFi.hostByName(NTP_SERVER, server)) {
+    return false;
+  }
+
+  WiFiUDP udp;
+  if (!udp.begin(TIME_NTP_LOCAL_PORT)) {
+    return false;
+  }
+
+  uint8_t packet[NTP_PACKET_SIZE];
+  memset(packet, 0, sizeof(packet));
+  packet[0] = NTP_CLIENT_REQUEST;
+
+  uint32_t sentMillis = millis();
+  if (!udp.beginPacket(server, NTP_PORT)) {
+    udp.stop();
+    return false;
+  }
+  udp.write(packet, sizeof(packet));
+  if (udp.endPacket() != 1) {
+    udp.stop();
+    return false;
+  }
+
+  bool ok = false;
+  while (millis() - sentMillis < TIME_SNTP_TIMEOUT_MS) {
+    if (udp.parsePacket() < (int)NTP_PACKET_SIZE) {
+      delay(5);
+      continue;
+    }
+    uint32_t recvMillis = millis();
+    if (udp.read(packet, sizeof(packet)) < (int)NTP_PACKET_SIZE) {
+      continue;
+    }
+
+    // Server reply with a valid stratum (0 = kiss-o'-death)
+    if ((packet[0] & 0x07) != NTP_MODE_SERVER || packet[1] == 0) {
+      continue;
+    }
+
+    // Transmit timestamp: seconds and 2^-32 fractions since 1900
+    uint32_t secs = ((uint32_t)packet[40] << 24) | ((uint32_t)packet[41] << 16) |
+                    ((uint32_t)packet[42] << 8) | packet[43];
+    uint32_t frac = ((uint32_t)packet[44] << 24) | ((uint32_t)packet[45] << 16) |
+                    ((uint32_t)packet[46] << 8) | packet[47];
+
+    // Reply left the server about half a round trip ago
+    unixMs = (int64_t)(secs - NTP_UNIX_OFFSET_S) * 1000 +
+             (int64_t)(((uint64_t)frac * 1000) >> 32) +
+             (recvMillis - sentMillis) / 2;
+    atMillis = recvMillis;
+    ok = true;
+    break;
+  }
+
+  udp.stop();
+  return ok;
+}
+
+void TimeService::persist() {
+  Preferences prefs;
+  if (!prefs.begin(PREFS_NAMESPACE, false)) {
+    return;
+  }
+  prefs.putBytes(PREFS_KEY_DRIFT, &rtc_drift, sizeof(DriftState));
+  prefs.end();
+}
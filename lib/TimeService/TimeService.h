@@ -0,0 +1,96 @@
+#pragma once
+
+#include <Arduino.h>
+#include <time.h>
+
+/**
+ * @class TimeService
+ * @brief DS3231 time disciplined by rare SNTP syncs and a drift model.
+ *
+ * Wakes read the DS3231 only (now()). Every TIME_SYNC_INTERVAL_DAYS, or when
+ * the clock was never synced, syncIfDue() queries SNTP (one UDP round trip)
+ * while WiFi is up:
+ * - The DS3231's millisecond phase is found by waiting for its seconds tick,
+ *   so the clock error is measured in milliseconds, not whole seconds.
+ * - The error over the time since the previous sync gives the drift (ppm).
+ *   Its intrinsic part (at aging offset 0) is averaged over syncs.
+ * - The drift is trimmed in hardware with the DS3231 aging offset (~0.1 ppm
+ *   per LSB). now() corrects the residual below one LSB in software.
+ * - The clock is set on a second boundary, so it starts out within a few ms.
+ *
+ * A failed sync (SNTP unreachable, DS3231 tick not seen) is retried after
+ * TIME_SYNC_RETRY_MIN minutes, doubling per consecutive failure up to
+ * TIME_SYNC_RETRY_MAX, instead of on every wake.
+ *
+ * The drift model is kept in RTC memory and in NVS (written once per sync).
+ * updateDrift(), syncDue(), syncFailed() and correct() are pure.
+ */
+class TimeService {
+public:
+  struct DriftState {
+    int64_t lastSyncMs;       // Unix ms of the last sync (0 = never)
+    float intrinsicPpm;       // drift at aging offset 0, positive = RTC fast
+    uint8_t samples;          // drift measurements averaged so far
+    int8_t aging;             // aging offset in effect since the last sync
+    // Appended: a shorter blob in NVS is read as a prefix
+    uint8_t syncFailures;     // consecutive failed syncs (0 after a sync)
+    uint32_t lastAttempt;     // RTC time of the last failed sync
+  };
+
+  /**
+   * @brief Load the drift model (NVS on cold boot only).
+   */
+  static void begin();
+
+  /**
+   * @brief Current time: DS3231 corrected by the residual drift.
+   */
+  static bool now(time_t& t);
+
+  /**
+   * @brief Sync over SNTP if due (call while WiFi is connected).
+   *
+   * @return true if a sync happened on this call
+   */
+  static bool syncIfDue();
+
+  /**
+   * @brief Format the state after the last sync for a log line
+   *        ("offset_ms=-412 ppm=2.31 aging=23").
+   */
+  static int formatSyncSummary(char* buf, size_t len);
+
+  /**
+   * @brief Fold one measured clock error into the drift model.
+   *
+   * @param ntpMs Unix ms of the measurement (reference clock)
+   * @param errorMs RTC minus reference, before the clock is set again
+   * @return true if the aging offset changed
+   */
+  static bool updateDrift(DriftState& state, int64_t ntpMs, int64_t errorMs);
+
+  /**
+   * @brief Whether a sync is due at RTC time rtcTime (interval elapsed or
+   *        clock not set, and no failure backoff running).
+   */
+  static bool syncDue(const DriftState& state, time_t rtcTime);
+
+  /**
+   * @brief Record a failed sync at RTC time rtcTime (extends the backoff).
+   */
+  static void syncFailed(DriftState& state, time_t rtcTime);
+
+  /**
+   * @brief Drift not trimmed by the aging offset (ppm).
+   */
+  static float residualPpm(const DriftState& state);
+
+  /**
+   * @brief Remove the residual drift accumulated since the last sync.
+   */
+  static time_t correct(const DriftState& state, time_t rtcTime);
+
+private:
+  static bool querySntp(int64_t& unixMs, uint32_t& atMillis);
+  static void persist();
+};
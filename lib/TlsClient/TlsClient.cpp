@@ -0,0 +1,425 @@
+#include "TlsClient.h"
+#include <mbedtls/net_sockets.h>
+#include <config_common.h>
+
+// Serialized session and handshake counters in RTC memory
+// (survive deep sleep, lost on power cycle)
+RTC_DATA_ATTR static uint8_t rtc_tls_session[TLS_SESSION_CACHE_SIZE];
+RTC_DATA_ATTR static uint16_t rtc_tls_session_len = 0;
+RTC_DATA_ATTR static uint32_t rtc_tls_resumed = 0;
+RTC_DATA_ATTR static uint32_t rtc_tls_full = 0;
+
+static uint32_t lastHandshakeMs = 0;
+static bool lastResumed = false;
+
+static const char* PERS = "tls_mqtt";
+
+// ============================
+// Constructor / Destructor
+// ============================
+TlsClient::TlsClient(WiFiClient& transport)
+  : tcp(transport), handshakeTimeoutMs(TLS_HANDSHAKE_TIMEOUT_MS) {
+}
+
+TlsClient::~TlsClient() {
+  stop();
+}
+
+// ============================
+// Public: configuration
+// ============================
+void TlsClient::setCACert(const char* pem) {
+  caPem = pem;
+}
+
+void TlsClient::setHandshakeTimeout(uint32_t timeoutMs) {
+  handshakeTimeoutMs = timeoutMs;
+}
+
+// ============================
+// Public: connect()
+// ============================
+int TlsClient::connect(IPAddress ip, uint16_t port) {
+  return connectTls(nullptr, ip, false, port);
+}
+
+int TlsClient::connect(const char* host, uint16_t port) {
+  return connectTls(host, IPAddress(), true, port);
+}
+
+int TlsClient::connect(IPAddress ip, uint16_t port, int32_t timeout) {
+  (void)timeout;
+  return connect(ip, port);
+}
+
+int TlsClient::connect(const char* host, uint16_t port, int32_t timeout) {
+  (void)timeout;
+  return connect(host, port);
+}
+
+int TlsClient::connectTls(const char* host, IPAddress ip, bool byName, uint16_t port) {
+  stop();
+
+  if (caPem == nullptr) {
+    Serial.println("[TLS] No CA certificate set");
+    return 0;
+  }
+
+  // Second attempt only if the first one offered a cached session
+  for (uint8_t attempt = 0; attempt < 2; attempt++) {
+    bool tcpOk = byName ? tcp.connect(host, port) : tcp.connect(ip, port);
+    if (!tcpOk) {
+      Serial.println("[TLS] TCP connect failed");
+      return 0;
+    }
+
+    if (!setupContext(host)) {
+      tcp.stop();
+      freeContext();
+      return 0;
+    }
+
+    bool offered = rtc_tls_session_len > 0;
+    bool resumed = false;
+    if (handshake(resumed)) {
+      sessionUp = true;
+      return 1;
+    }
+
+    tcp.stop();
+    freeContext();
+
+    if (!offered) {
+      return 0;
+    }
+    Serial.println("[TLS] Handshake with cached session failed, retrying full");
+    clearSession();
+  }
+  return 0;
+}
+
+// ============================
+// Public: I/O
+// ============================
+size_t TlsClient::write(uint8_t b) {
+  return write(&b, 1);
+}
+
+size_t TlsClient::write(const uint8_t* buf, size_t size) {
+  if (!sessionUp) {
+    return 0;
+  }
+
+  size_t sent = 0;
+  uint32_t startMs = millis();
+  while (sent < size) {
+    int ret = mbedtls_ssl_write(&ssl, buf + sent, size - sent);
+    if (ret > 0) {
+      sent += ret;
+      continue;
+    }
+    if ((ret == MBEDTLS_ERR_SSL_WANT_WRITE || ret == MBEDTLS_ERR_SSL_WANT_READ) &&
+        millis() - startMs < handshakeTimeoutMs) {
+      delay(1);
+      continue;
+    }
+    Serial.printf("[TLS] Write failed: -0x%04x\n", (unsigned)-ret);
+    stop();
+    break;
+  }
+  return sent;
+}
+
+int TlsClient::available() {
+  if (!sessionUp) {
+    return 0;
+  }
+
+  int pending = (peekedByte >= 0) ? 1 : 0;
+  size_t avail = mbedtls_ssl_get_bytes_avail(&ssl);
+  if (avail == 0 && tcp.available() > 0) {
+    // Zero-length read decrypts the next record without consuming it
+    int ret = mbedtls_ssl_read(&ssl, nullptr, 0);
+    if (ret < 0 && ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) {
+      stop();
+      return pending;
+    }
+    avail = mbedtls_ssl_get_bytes_avail(&ssl);
+  }
+  return pending + (int)avail;
+}
+
+int TlsClient::read() {
+  uint8_t b;
+  return (read(&b, 1) == 1) ? b : -1;
+}
+
+int TlsClient::read(uint8_t* buf, size_t size) {
+  if (size == 0) {
+    return 0;
+  }
+
+  size_t got = 0;
+  if (peekedByte >= 0) {
+    buf[got++] = (uint8_t)peekedByte;
+    peekedByte = -1;
+    if (got == size) {
+      return got;
+    }
+  }
+
+  if (!sessionUp) {
+    return got > 0 ? (int)got : -1;
+  }
+
+  int ret = mbedtls_ssl_read(&ssl, buf + got, size - got);
+  if (ret > 0) {
+    return got + ret;
+  }
+  if (ret == 0 || (ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE)) {
+    // 0 = close_notify from the broker
+    stop();
+  }
+  return got > 0 ? (int)got : -1;
+}
+
+int TlsClient::peek() {
+  if (peekedByte < 0) {
+    uint8_t b;
+    if (sessionUp && mbedtls_ssl_read(&ssl, &b, 1) == 1) {
+      peekedByte = b;
+    }
+  }
+  return peekedByte;
+}
+
+void TlsClient::flush() {
+  tcp.flush();
+}
+
+void TlsClient::stop() {
+  if (sessionUp) {
+    mbedtls_ssl_close_notify(&ssl);
+    sessionUp = false;
+  }
+  peekedByte = -1;
+  tcp.stop();
+  freeContext();
+}
+
+uint8_t TlsClient::connected() {
+  if (!sessionUp) {
+    return 0;
+  }
+  return (tcp.connected() || peekedByte >= 0 || mbedtls_ssl_get_bytes_avail(&ssl) > 0) ? 1 : 0;
+}
+
+// ============================
+// Public: counters / cache
+// ============================
+uint32_t TlsClient::getResumedCount() {
+  return rtc_tls_resumed;
+}
+
+uint32_t TlsClient::getFullCount() {
+  return rtc_tls_full;
+}
+
+uint32_t TlsClient::getLastHandshakeMs() {
+  return lastHandshakeMs;
+}
+
+bool TlsClient::lastHandshakeResumed() {
+  return lastResumed;
+}
+
+void TlsClient::clearSession() {
+  rtc_tls_session_len = 0;
+}
+
+// ============================
+// Private: setupContext()
+// ============================
+bool TlsClient::setupContext(const char* host) {
+  mbedtls_ssl_init(&ssl);
+  mbedtls_ssl_config_init(&conf);
+  mbedtls_ctr_drbg_init(&ctrDrbg);
+  mbedtls_entropy_init(&entropy);
+  mbedtls_x509_crt_init(&caCert);
+  contextReady = true;
+
+  int ret = mbedtls_ctr_drbg_seed(&ctrDrbg, mbedtls_entropy_func, &entropy,
+                                  (const unsigned char*)PERS, strlen(PERS));
+  if (ret != 0) {
+    Serial.printf("[TLS] DRBG seed failed: -0x%04x\n", (unsigned)-ret);
+    return false;
+  }
+
+  // PEM parsing needs the terminating NUL in the length
+  ret = mbedtls_x509_crt_parse(&caCert, (const unsigned char*)caPem, strlen(caPem) + 1);
+  if (ret != 0) {
+    Serial.printf("[TLS] CA parse failed: -0x%04x\n", (unsigned)-ret);
+    return false;
+  }
+
+  ret = mbedtls_ssl_config_defaults(&conf, MBEDTLS_SSL_IS_CLIENT,
+                                    MBEDTLS_SSL_TRANSPORT_STREAM,
+                                    MBEDTLS_SSL_PRESET_DEFAULT);
+  if (ret != 0) {
+    Serial.printf("[TLS] Config failed: -0x%04x\n", (unsigned)-ret);
+    return false;
+  }
+
+  mbedtls_ssl_conf_authmode(&conf, MBEDTLS_SSL_VERIFY_REQUIRED);
+  mbedtls_ssl_conf_ca_chain(&conf, &caCert, nullptr);
+  mbedtls_ssl_conf_rng(&conf, mbedtls_ctr_drbg_random, &ctrDrbg);
+#ifdef MBEDTLS_SSL_SESSION_TICKETS
+  mbedtls_ssl_conf_session_tickets(&conf, MBEDTLS_SSL_SESSION_TICKETS_ENABLED);
+#endif
+
+  ret = mbedtls_ssl_setup(&ssl, &conf);
+  if (ret != 0) {
+    Serial.printf("[TLS] Setup failed: -0x%04x\n", (unsigned)-ret);
+    return false;
+  }
+
+  // SNI + certificate name check (skipped when connecting by IP)
+  if (host != nullptr) {
+    mbedtls_ssl_set_hostname(&ssl, host);
+  }
+
+  mbedtls_ssl_set_bio(&ssl, this, bioSend, bioRecv, nullptr);
+  return true;
+}
+
+// ============================
+// Private: freeContext()
+// ============================
+void TlsClient::freeContext() {
+  if (!contextReady) {
+    return;
+  }
+  mbedtls_ssl_free(&ssl);
+  mbedtls_ssl_config_free(&conf);
+  mbedtls_ctr_drbg_free(&ctrDrbg);
+  mbedtls_entropy_free(&entropy);
+  mbedtls_x509_crt_free(&caCert);
+  contextReady = false;
+}
+
+// ============================
+// Private: handshake()
+// ============================
+bool TlsClient::handshake(bool& resumed) {
+  unsigned char offeredMaster[48];
+  bool offered = offerCachedSession(offeredMaster);
+
+  uint32_t startMs = millis();
+  int ret;
+  while ((ret = mbedtls_ssl_handshake(&ssl)) != 0) {
+    if (ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) {
+      Serial.printf("[TLS] Handshake failed: -0x%04x\n", (unsigned)-ret);
+      return false;
+    }
+    if (millis() - startMs >= handshakeTimeoutMs) {
+      Serial.println("[TLS] Handshake timeout");
+      return false;
+    }
+    delay(1);
+  }
+  lastHandshakeMs = millis() - startMs;
+
+  // Only a resumed session keeps the cached master secret. (The session ID
+  // is no proof: with a ticket the client draws a new random ID for each
+  // ClientHello, so the cached one is never echoed.)
+  resumed = false;
+  if (offered) {
+    const mbedtls_ssl_session* current = mbedtls_ssl_get_session_pointer(&ssl);
+    resumed = current != nullptr &&
+              memcmp(current->master, offeredMaster, sizeof(offeredMaster)) == 0;
+  }
+  lastResumed = resumed;
+
+  if (resumed) {
+    rtc_tls_resumed++;
+  } else {
+    rtc_tls_full++;
+  }
+  Serial.printf("[TLS] %s handshake in %lu ms (%s, resumed=%lu full=%lu)\n",
+                resumed ? "Resumed" : "Full",
+                (unsigned long)lastHandshakeMs,
+                mbedtls_ssl_get_ciphersuite(&ssl),
+                (unsigned long)rtc_tls_resumed,
+                (unsigned long)rtc_tls_full);
+
+  // Keep the (possibly renewed) session/ticket for the next wake
+  saveSession();
+  return true;
+}
+
+// ============================
+// Private: offerCachedSession()
+// ============================
+bool TlsClient::offerCachedSession(unsigned char* offeredMaster) {
+  if (rtc_tls_session_len == 0) {
+    return false;
+  }
+
+  mbedtls_ssl_session session;
+  mbedtls_ssl_session_init(&session);
+
+  bool ok = mbedtls_ssl_session_load(&session, rtc_tls_session, rtc_tls_session_len) == 0 &&
+            mbedtls_ssl_set_session(&ssl, &session) == 0;
+  if (ok) {
+    memcpy(offeredMaster, session.master, sizeof(session.master));
+  } else {
+    Serial.println("[TLS] Cached session unusable, dropped");
+    clearSession();
+  }
+
+  mbedtls_ssl_session_free(&session);
+  return ok;
+}
+
+// ============================
+// Private: saveSession()
+// ============================
+void TlsClient::saveSession() {
+  mbedtls_ssl_session session;
+  mbedtls_ssl_session_init(&session);
+
+  size_t len = 0;
+  if (mbedtls_ssl_get_session(&ssl, &session) == 0 &&
+      mbedtls_ssl_session_save(&session, rtc_tls_session, sizeof(rtc_tls_session), &len) == 0) {
+    rtc_tls_session_len = len;
+  } else {
+    // Typically the peer certificate does not fit TLS_SESSION_CACHE_SIZE
+    Serial.printf("[TLS] Session not cached (needs %u bytes)\n", (unsigned)len);
+    rtc_tls_session_len = 0;
+  }
+
+  mbedtls_ssl_session_free(&session);
+}
+
+// ============================
+// Private: BIO callbacks (WiFiClient transport)
+// ============================
+int TlsClient::bioSend(void* ctx, const unsigned char* buf, size_t len) {
+  TlsClient* self = static_cast<TlsClient*>(ctx);
+  if (!self->tcp.connected()) {
+    return MBEDTLS_ERR_NET_CONN_RESET;
+  }
+
+  size_t written = self->tcp.write(buf, len);
+  return written > 0 ? (int)written : MBEDTLS_ERR_SSL_WANT_WRITE;
+}
+
+int TlsClient::bioRecv(void* ctx, unsigned char* buf, size_t len) {
+  TlsClient* self = static_cast<TlsClient*>(ctx);
+  if (self->tcp.available() <= 0) {
+    return self->tcp.connected() ? MBEDTLS_ERR_SSL_WANT_READ : MBEDTLS_ERR_NET_CONN_RESET;
+  }
+
+  int got = self->tcp.read(buf, len);
+  return got > 0 ? got : MBEDTLS_ERR_SSL_WANT_READ;
+}
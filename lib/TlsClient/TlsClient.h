@@ -0,0 +1,103 @@
+#pragma once
+
+#include <Arduino.h>
+#include <Client.h>
+#include <WiFiClient.h>
+
+#include <mbedtls/ssl.h>
+#include <mbedtls/entropy.h>
+#include <mbedtls/ctr_drbg.h>
+#include <mbedtls/x509_crt.h>
+
+/**
+ * @class TlsClient
+ * @brief TLS Client on top of a plain WiFiClient, with session resumption
+ *        across deep sleep.
+ *
+ * mbedTLS runs over the WiFiClient socket (the WiFiClient is the BIO). After
+ * each handshake the negotiated session (session ID and/or ticket) is
+ * serialized into RTC memory; the next connect offers it to the broker, so
+ * most wakes do an abbreviated handshake instead of a full one with
+ * certificate verification and key exchange.
+ *
+ * If a handshake with a cached session fails, the cache is dropped and one
+ * full handshake is attempted. Resumed and full handshakes are counted in RTC
+ * memory (lost on power cycle).
+ *
+ * Used by ConnectionManager when built with ENABLE_MQTT_TLS.
+ */
+class TlsClient : public Client {
+public:
+  explicit TlsClient(WiFiClient& transport);
+  ~TlsClient();
+
+  /**
+   * @brief Set the CA certificate (PEM) used to verify the broker.
+   *
+   * The string must stay valid for the lifetime of the client.
+   */
+  void setCACert(const char* pem);
+
+  /**
+   * @brief Upper bound for one TLS handshake (default TLS_HANDSHAKE_TIMEOUT_MS).
+   */
+  void setHandshakeTimeout(uint32_t timeoutMs);
+
+  // Client interface
+  int connect(IPAddress ip, uint16_t port) override;
+  int connect(const char* host, uint16_t port) override;
+  int connect(IPAddress ip, uint16_t port, int32_t timeout);
+  int connect(const char* host, uint16_t port, int32_t timeout);
+  size_t write(uint8_t b) override;
+  size_t write(const uint8_t* buf, size_t size) override;
+  int available() override;
+  int read() override;
+  int read(uint8_t* buf, size_t size) override;
+  int peek() override;
+  void flush() override;
+  void stop() override;
+  uint8_t connected() override;
+  operator bool() override { return connected(); }
+
+  /**
+   * @brief Handshake counters since power-on (RTC memory).
+   */
+  static uint32_t getResumedCount();
+  static uint32_t getFullCount();
+
+  /**
+   * @brief Duration of the last handshake in ms, and whether it was resumed.
+   */
+  static uint32_t getLastHandshakeMs();
+  static bool lastHandshakeResumed();
+
+  /**
+   * @brief Forget the cached session (next handshake is a full one).
+   */
+  static void clearSession();
+
+private:
+  WiFiClient& tcp;
+  const char* caPem = nullptr;
+  uint32_t handshakeTimeoutMs;
+
+  mbedtls_ssl_context ssl;
+  mbedtls_ssl_config conf;
+  mbedtls_ctr_drbg_context ctrDrbg;
+  mbedtls_entropy_context entropy;
+  mbedtls_x509_crt caCert;
+
+  bool contextReady = false;
+  bool sessionUp = false;
+  int peekedByte = -1;
+
+  int connectTls(const char* host, IPAddress ip, bool byName, uint16_t port);
+  bool setupContext(const char* host);
+  void freeContext();
+  bool handshake(bool& resumed);
+  bool offerCachedSession(unsigned char* offeredMaster);
+  void saveSession();
+
+  static int bioSend(void* ctx, const unsigned char* buf, size_t len);
+  static int bioRecv(void* ctx, unsigned char* buf, size_t len);
+};
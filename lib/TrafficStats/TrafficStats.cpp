@@ -0,0 +1,90 @@
+#include "TrafficStats.h"
+
+// MQTT PUBLISH overhead besides topic and payload:
+// fixed header (1 + up to 2 length bytes at our sizes) + 2-byte topic length
+static const size_t PUBLISH_OVERHEAD = 5;
+
+// RTC memory (survives deep sleep, lost on power cycle)
+RTC_DATA_ATTR static uint32_t rtc_traffic_wakes = 0;
+RTC_DATA_ATTR static uint32_t rtc_traffic_total_msgs = 0;
+RTC_DATA_ATTR static uint64_t rtc_traffic_total_bytes = 0;
+RTC_DATA_ATTR static uint16_t rtc_connect_hist[TrafficStats::LATENCY_BUCKETS];
+
+// Current wake only
+static uint16_t wakeMsgs = 0;
+static uint32_t wakeBytes = 0;
+static uint32_t wakeConnectMs = 0;
+static bool wakeConnected = false;
+
+void TrafficStats::beginWake() {
+  rtc_traffic_wakes++;
+  wakeMsgs = 0;
+  wakeBytes = 0;
+  wakeConnectMs = 0;
+  wakeConnected = false;
+}
+
+void TrafficStats::countPublish(const char* topic, size_t payloadLength) {
+  size_t bytes = PUBLISH_OVERHEAD + strlen(topic) + payloadLength;
+
+  wakeMsgs++;
+  wakeBytes += bytes;
+  rtc_traffic_total_msgs++;
+  rtc_traffic_total_bytes += bytes;
+}
+
+void TrafficStats::recordConnect(uint32_t elapsedMs) {
+  if (wakeConnected) {
+    return;
+  }
+  wakeConnected = true;
+  wakeConnectMs = elapsedMs;
+
+  uint8_t bucket = 0;
+  while (bucket < LATENCY_BUCKETS - 1 && (elapsedMs >> (bucket + 1)) != 0) {
+    bucket++;
+  }
+
+  // Halve all buckets before one saturates: keeps the shape, favours recent wakes
+  if (rtc_connect_hist[bucket] == UINT16_MAX) {
+    for (uint8_t i = 0; i < LATENCY_BUCKETS; i++) {
+      rtc_connect_hist[i] >>= 1;
+    }
+  }
+  rtc_connect_hist[bucket]++;
+}
+
+uint32_t TrafficStats::connectPercentileMs(uint8_t percent) {
+  uint32_t total = 0;
+  for (uint8_t i = 0; i < LATENCY_BUCKETS; i++) {
+    total += rtc_connect_hist[i];
+  }
+  if (total == 0) {
+    return 0;
+  }
+
+  // Smallest bucket whose cumulative count reaches the percentile
+  uint32_t target = (total * percent + 99) / 100;
+  uint32_t cumulative = 0;
+  for (uint8_t i = 0; i < LATENCY_BUCKETS; i++) {
+    cumulative += rtc_connect_hist[i];
+    if (cumulative >= target) {
+      return 1UL << (i + 1);
+    }
+  }
+  return 1UL << LATENCY_BUCKETS;
+}
+
+int TrafficStats::formatStatusFields(char* buf, size_t len) {
+  return snprintf(buf, len,
+                  "\"traffic\":{\"msgs\":%u,\"bytes\":%lu,\"wakes\":%lu,\"total_msgs\":%lu,\"total_bytes\":%llu,"
+                  "\"conn_ms\":%lu,\"conn_p50\":%lu,\"conn_p95\":%lu}",
+                  wakeMsgs,
+                  (unsigned long)wakeBytes,
+                  (unsigned long)rtc_traffic_wakes,
+                  (unsigned long)rtc_traffic_total_msgs,
+                  (unsigned long long)rtc_traffic_total_bytes,
+                  (unsigned long)wakeConnectMs,
+                  (unsigned long)connectPercentileMs(50),
+                  (unsigned long)connectPercentileMs(95));
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <Arduino.h>
+
+/**
+ * @class TrafficStats
+ * @brief Per-wake broker traffic and connect latency, kept in RTC memory.
+ * 
+ * Counts MQTT publishes and their approximate wire size (fixed header + topic
+ * + payload) for the current wake and since power-on, and records the time
+ * from wake to MQTT connected in a log2 histogram (bucket i = [2^i, 2^(i+1)) ms).
+ * Reported in the status payload so fleet-wide load (messages and bytes per
+ * node per day, connect latency percentiles) can be derived broker-side.
+ * 
+ * Not thread-safe: call from the task that owns MQTT only.
+ */
+class TrafficStats {
+public:
+  static const uint8_t LATENCY_BUCKETS = 16;   // up to 65 s
+
+  /**
+   * @brief Start a new wake (clears per-wake counters).
+   */
+  static void beginWake();
+
+  /**
+   * @brief Count one successful publish.
+   * 
+   * @param topic Topic the message went to
+   * @param payloadLength Payload size in bytes
+   */
+  static void countPublish(const char* topic, size_t payloadLength);
+
+  /**
+   * @brief Record the time from wake to MQTT connected.
+   * 
+   * Only the first connect of a wake is recorded (later reconnects in
+   * continuous mode are not wake latency).
+   */
+  static void recordConnect(uint32_t elapsedMs);
+
+  /**
+   * @brief Upper bound (ms) of the histogram bucket holding the given
+   *        percentile, 0 if nothing was recorded yet.
+   * 
+   * @param percent Percentile (1..100)
+   */
+  static uint32_t connectPercentileMs(uint8_t percent);
+
+  /**
+   * @brief Format status payload fields (no surrounding braces):
+   *        "traffic":{"msgs":5,"bytes":812,"wakes":120,"total_msgs":600,"total_bytes":97440,
+   *                   "conn_ms":1840,"conn_p50":2048,"conn_p95":4096}
+   * 
+   * @return Number of characters written
+   */
+  static int formatStatusFields(char* buf, size_t len);
+};
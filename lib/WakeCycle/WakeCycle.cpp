@@ -0,0 +1,736 @@
+#include "WakeCycle.h"
+#include <stdarg.h>
+#include <ConfigStore.h>
+#include <RuntimeMode.h>
+#include <TimeService.h>
+#include <I2CBus.h>
+#include <MinMaxTracker.h>
+#include <ReadingHistory.h>
+#include <TrafficStats.h>
+#include <HealthCounters.h>
+#include <EnergyModel.h>
+#include <ConnectPolicy.h>
+#include <WakeWatchdog.h>
+#include <WakeTrace.h>
+#ifdef ENABLE_MQTT_TLS
+#include <TlsClient.h>
+#endif
+#include <config_common.h>
+#include <profile.h>
+
+// Timing
+static const uint32_t CONNECT_TIMEOUT_MS = 15000;   // max time to wait for WiFi+MQTT (learned phase deadlines cut it short)
+static const uint32_t MQTT_FLUSH_MS      = 250;     // give MQTT time to transmit before sleep
+
+// Discovery configs are retained by the broker: resend only after power-on
+// and then once every HA_CONFIG_REFRESH_WAKES wakes (survives deep sleep)
+RTC_DATA_ATTR static uint32_t rtc_ha_config_age = 0;
+RTC_DATA_ATTR static bool rtc_ha_config_sent = false;
+
+// Daily min/max per channel (window survives deep sleep)
+enum MinMaxChannel : uint8_t { MINMAX_TEMP, MINMAX_HUM, MINMAX_CHANNELS };
+static const char* const MINMAX_NAMES[MINMAX_CHANNELS] = { "temp_c", "hum_pct" };
+#ifdef MINMAX_FIXED_POINT
+using DailyMinMax = MinMaxTracker<int16_t, MINMAX_CHANNELS>;   // 0.01 units, half the RTC memory
+#else
+using DailyMinMax = MinMaxTracker<float, MINMAX_CHANNELS>;
+#endif
+RTC_DATA_ATTR static DailyMinMax minMaxTracker;
+
+// Battery load shedding (level survives deep sleep)
+RTC_DATA_ATTR static PowerPolicy::State rtc_power;
+RTC_DATA_ATTR static uint32_t rtc_last_uplink_epoch = 0;   // last reading sent in status
+
+// Connect backoff across wakes and learned connect deadlines
+RTC_DATA_ATTR static ConnectPolicy::State rtc_connect;
+
+#ifdef ENABLE_PIPELINE
+// Pipeline jobs are plain functions: the wake they run for
+static WakeCycle* sensingCycle = nullptr;
+#endif
+
+WakeCycle::WakeCycle(const Hooks& hooks)
+  : hooks(hooks) {}
+
+// ============================
+// Public: run()
+// ============================
+WakeCycle::Outcome WakeCycle::run() {
+  outcome = Outcome{ Path::Uplink, Next::Sleep, 0, 0, 0 };
+
+  // A freshly installed image that keeps resetting goes back to the previous one
+  OtaUpdater::beginBoot();
+
+  Serial.println();
+  Serial.printf("[Wake] Boot (profile %s)\n", Profile::name);
+
+  // Runtime configuration: RTC cache, NVS only on cold boot or after "set"
+  ConfigStore::begin();
+
+  // Battery (deep sleep) or continuous (mains) operation
+  RuntimeMode::begin();
+
+  // DS3231 drift model (NVS only on cold boot)
+  TimeService::begin();
+
+  // Per-wake publish counters
+  TrafficStats::beginWake();
+
+  // Battery first, while the radio is still off; decides this wake's load
+  applyPowerPolicy();
+
+  // Start modules (WiFi is started by cm.begin() only when uplinking)
+  comms.begin(cm);
+  cm.setComms(&comms);
+
+  // Initialize MQTTPublisher
+  mqttPublisher.begin(comms);
+
+  // History replay (serviced by cm.loop() once MQTT is up)
+  historyReplay.begin(comms);
+  cm.setHistoryReplay(&historyReplay);
+
+  // Firmware update: chunks requested from cm.loop() while MQTT is up
+  ota.begin(comms);
+  cm.setOtaUpdater(&ota);
+
+  // Event and pulse inputs (profiles with inputs only)
+  if (hooks.beginInputs != nullptr) {
+    hooks.beginInputs(comms);
+  }
+
+  // Sleep manager (configured interval), longer on low battery
+  sleepMgr.begin(ConfigStore::get().sleepMinutes * power.intervalMultiplier);
+
+  // Inputs of this wake, for replaying it off the device (ENABLE_WAKE_TRACE)
+  WakeTrace::beginWake((uint32_t)sleepMgr.getWakeCount(),
+                       (uint8_t)sleepMgr.getWakeCause(), batteryMv);
+
+  // Input wake: publish the change only, no sensor read or discovery
+  if (sleepMgr.getWakeCause() == SleepManager::WakeCause::Input) {
+    outcome.path = Path::Input;
+    outcome.next = runInputWake();
+    return outcome;
+  }
+
+  // Low battery: keep the reading, radio only for alarms
+  if (!power.uplink) {
+    outcome.path = Path::Offline;
+    outcome.next = runOfflineWake();
+    return outcome;
+  }
+
+  // AP/broker unreachable on recent wakes: same, until the backoff runs out
+  // (battery mode only; continuous mode keeps retrying in cm.loop())
+  if (RuntimeMode::get() != RuntimeMode::Mode::Continuous && !ConnectPolicy::attempt(rtc_connect)) {
+    Serial.printf("[Wake] Connect backoff (%u wakes left), reading kept\n", rtc_connect.skipsLeft);
+    outcome.path = Path::Backoff;
+    outcome.next = runOfflineWake();
+    return outcome;
+  }
+
+  outcome.next = runUplinkWake();
+  return outcome;
+}
+
+// ============================
+// Public: sleep()
+// ============================
+void WakeCycle::sleep() {
+  // Also called by the wake watchdog (esp_timer task) when the budget runs out
+  WakeWatchdog::phase(WakeWatchdog::Phase::Sleep);
+  WakeTrace::endWake();
+  EnergyModel::endWake();
+
+  Serial.println("[Wake] Sleeping now...");
+  Serial.flush();
+
+  sleepMgr.sleep(); // does not return
+}
+
+// ============================
+// Public: accessors
+// ============================
+ConnectionManager& WakeCycle::getConnectionManager() {
+  return cm;
+}
+
+Comms& WakeCycle::getComms() {
+  return comms;
+}
+
+MQTTPublisher& WakeCycle::getPublisher() {
+  return mqttPublisher;
+}
+
+SleepManager& WakeCycle::getSleepManager() {
+  return sleepMgr;
+}
+
+const PowerPolicy::Actions& WakeCycle::getPower() const {
+  return power;
+}
+
+#ifdef ENABLE_PIPELINE
+Pipeline& WakeCycle::getPipeline() {
+  return pipeline;
+}
+#endif
+
+// ============================
+// Private: wake paths
+// ============================
+WakeCycle::Next WakeCycle::runUplinkWake() {
+  // Batch: send the readings kept since the last uplink along with this one
+  // (low battery, or wakes that could not connect); queued behind a user transfer.
+  // Not over MQTT-SN: history replay needs a streamed publish
+#ifndef ENABLE_MQTTSN
+  if ((power.batch || rtc_connect.failures > 0) && rtc_last_uplink_epoch > 0) {
+    historyReplay.enqueue(rtc_last_uplink_epoch + 1, 0xFFFFFFFF);
+  }
+#endif
+
+  startRadio();
+
+#ifdef ENABLE_PIPELINE
+  // Network task (PRO_CPU) associates while the sensing task (APP_CPU)
+  // reads sensors and encodes payloads into the outbox
+  // Sensing overlaps association here: both are charged as WifiAssoc
+  EnergyModel::mark(EnergyModel::Phase::WifiAssoc);
+  WakeWatchdog::phase(WakeWatchdog::Phase::Wifi);
+  pipeline.begin(cm, comms, hooks.serviceInputs);
+  sensingCycle = this;
+  pipeline.runSensing([]() {
+    sensingCycle->beginSensors();
+    sensingCycle->publishBootOnce();
+    sensingCycle->publishReadingAndStatus();
+  });
+
+  bool flushed = pipeline.waitUntilFlushed(CONNECT_TIMEOUT_MS);
+  // Broker on trial: judged only if WiFi came up (see waitForMqtt())
+  if (pipeline.connected() || cm.wifiConnected()) {
+    ConfigStore::reportConnect(pipeline.connected());
+  }
+  ConnectPolicy::report(rtc_connect, pipeline.connected());
+
+  // A freshly installed image is on trial until its status is sent
+  if (pipeline.connected()) {
+    OtaUpdater::trialWake();
+    if (flushed) {
+      OtaUpdater::confirmBoot();
+    }
+  }
+  if (!flushed) {
+    Serial.println("[Wake] Pipeline not flushed within timeout");
+    return finishWake();
+  }
+#else
+  EnergyModel::mark(EnergyModel::Phase::Sensor);
+  beginSensors();
+
+  // Wait for WiFi + MQTT (bounded)
+  if (!waitForMqtt(CONNECT_TIMEOUT_MS)) {
+    Serial.println("[Wake] MQTT not connected within timeout");
+
+    // Keep the reading for replay once the link is back
+    time_t nowEpoch = 0;
+    bool rtcOk = false;
+    float tempC = 0.0f;
+    float humPct = 0.0f;
+    takeReading(nowEpoch, rtcOk, tempC, humPct);
+    return finishWake();
+  }
+
+  EnergyModel::mark(EnergyModel::Phase::Tx);
+
+  // A freshly installed image is on trial until it publishes status
+  OtaUpdater::trialWake();
+
+  // Handle commands queued by the broker while asleep. "set" only stages a
+  // change for the next wake; replies, history and ota start on this one
+  WakeWatchdog::phase(WakeWatchdog::Phase::Mailbox);
+  wakeCommands = cm.drainMailbox(MAILBOX_DRAIN_MAX_MS, MAILBOX_QUIET_MS);
+
+  // Publish boot + reading
+  publishBootOnce();
+  publishReadingAndStatus();
+#endif
+
+  // SNTP every few days; the DS3231 keeps time in between
+  syncTimeIfDue();
+
+  // A few firmware chunks per wake while an update is running
+  serviceOta();
+
+  // Flush, then sleep (battery) or stay connected (continuous)
+  flushMqttBriefly();
+  return finishWake();
+}
+
+WakeCycle::Next WakeCycle::runInputWake() {
+  Serial.printf("[Wake] Input wake (pins=0x%llx): event-only path\n",
+                (unsigned long long)sleepMgr.getWakePinMask());
+
+  // Alarm-only, or backing off: the change stays pending in RTC until the next uplink
+  if (power.alarmOnly || ConnectPolicy::backingOff(rtc_connect)) {
+    return Next::Sleep;
+  }
+
+  startRadio();
+
+  // beginInputs() already queued the change; unpublished changes are
+  // picked up again on the next wake from the RTC-held input state.
+  if (waitForMqtt(INPUT_WAKE_CONNECT_TIMEOUT_MS)) {
+    EnergyModel::mark(EnergyModel::Phase::Tx);
+    serviceInputs();
+    flushMqttBriefly();
+  } else {
+    Serial.println("[Wake] MQTT not connected (event kept for next wake)");
+  }
+  return Next::Sleep;
+}
+
+WakeCycle::Next WakeCycle::runOfflineWake() {
+  EnergyModel::mark(EnergyModel::Phase::Sensor);
+  beginSensors();
+
+  time_t nowEpoch = 0;
+  bool rtcOk = false;
+  float tempC = 0.0f;
+  float humPct = 0.0f;
+  float thresholdC = 0.0f;
+  const char* alarm = takeReading(nowEpoch, rtcOk, tempC, humPct)
+    ? checkAlarm(tempC, thresholdC)
+    : nullptr;
+
+  // Alarms still go out (full timeout, whatever the backoff), and nothing else
+  if (alarm != nullptr) {
+    Serial.printf("[Wake] %s alarm on an offline wake, connecting\n", alarm);
+    startRadio();
+    if (waitForMqtt(CONNECT_TIMEOUT_MS, false)) {
+      EnergyModel::mark(EnergyModel::Phase::Tx);
+      mqttPublisher.publishAlarm(DEVICE_NAME, nowEpoch, alarm, tempC, thresholdC);
+      flushMqttBriefly();
+    }
+  }
+  return Next::Sleep;
+}
+
+WakeCycle::Next WakeCycle::finishWake() {
+  // Verified firmware image is set as boot partition
+  if (ota.rebootPending()) {
+    return Next::Restart;
+  }
+  if (RuntimeMode::get() == RuntimeMode::Mode::Continuous) {
+    return Next::Continuous;
+  }
+  return Next::Sleep;
+}
+
+// ============================
+// Private: helpers
+// ============================
+void WakeCycle::applyPowerPolicy() {
+  WakeWatchdog::phase(WakeWatchdog::Phase::Battery);
+
+  batteryMv = hooks.readBatteryMv != nullptr ? hooks.readBatteryMv() : 0;
+
+  // Mains powered: no load shedding
+  bool mains = RuntimeMode::get() == RuntimeMode::Mode::Continuous;
+  if (mains) {
+    rtc_power.level = PowerPolicy::Level::Normal;
+  }
+  power = PowerPolicy::decide(rtc_power, mains ? 0 : batteryMv);
+
+  Serial.printf("[Wake] Battery %u mV, power level=%s (interval x%u, uplink=%d)\n",
+                batteryMv, PowerPolicy::name(power.level),
+                power.intervalMultiplier, power.uplink ? 1 : 0);
+}
+
+void WakeCycle::beginSensors() {
+  if (hooks.beginSensors != nullptr) {
+    hooks.beginSensors();
+  }
+}
+
+void WakeCycle::serviceInputs() {
+  if (hooks.serviceInputs != nullptr) {
+    hooks.serviceInputs();
+  }
+}
+
+void WakeCycle::startRadio() {
+  outcome.radioStartMs = millis();
+  cm.begin();
+}
+
+// Bounded by timeoutMs overall, and per phase by the learned deadlines
+bool WakeCycle::waitForMqtt(uint32_t timeoutMs, bool phaseDeadlines) {
+  EnergyModel::mark(EnergyModel::Phase::WifiAssoc);
+  WakeWatchdog::phase(WakeWatchdog::Phase::Wifi);
+
+  ConnectPolicy::Deadlines deadlines = { 0, 0 };
+  if (phaseDeadlines) {
+    deadlines = ConnectPolicy::deadlines(rtc_connect);
+  }
+
+  uint32_t startMs = millis();
+  uint32_t wifiUpMs = 0;
+  while (millis() - startMs < timeoutMs) {
+    cm.loop();
+    serviceInputs();
+    delay(1);
+
+    uint32_t now = millis();
+    if (wifiUpMs == 0 && cm.wifiConnected()) {
+      wifiUpMs = now;
+      outcome.wifiUpMs = now;
+      ConnectPolicy::recordWifi(rtc_connect, now - outcome.radioStartMs);
+      EnergyModel::mark(EnergyModel::Phase::Mqtt);
+      WakeWatchdog::phase(WakeWatchdog::Phase::Mqtt);
+    }
+
+    if (cm.mqttConnected()) {
+      outcome.mqttUpMs = now;
+      ConnectPolicy::recordMqtt(rtc_connect, now - wifiUpMs);
+      ConnectPolicy::report(rtc_connect, true);
+      ConfigStore::reportConnect(true);
+      return true;
+    }
+
+    // Slower than this node ever connects: the link is down, stop paying for it
+    if (wifiUpMs == 0 && deadlines.wifiMs > 0 && now - outcome.radioStartMs >= deadlines.wifiMs) {
+      Serial.printf("[Wake] WiFi not up within learned deadline (%lu ms)\n", (unsigned long)deadlines.wifiMs);
+      break;
+    }
+    if (wifiUpMs != 0 && deadlines.mqttMs > 0 && now - wifiUpMs >= deadlines.mqttMs) {
+      Serial.printf("[Wake] MQTT not up within learned deadline (%lu ms)\n", (unsigned long)deadlines.mqttMs);
+      break;
+    }
+  }
+
+  bool connected = cm.mqttConnected();
+  if (connected) {
+    outcome.mqttUpMs = millis();
+  }
+  ConnectPolicy::report(rtc_connect, connected);
+
+  // Counts against a broker change on trial only if the broker itself was
+  // tried: an AP outage or a WiFi deadline abort says nothing about it
+  if (connected || wifiUpMs != 0) {
+    ConfigStore::reportConnect(connected);
+  }
+  if (!connected) {
+    HealthCounters::increment(HealthCounters::Counter::LinkTimeout);
+  }
+  return connected;
+}
+
+void WakeCycle::publishBootOnce() {
+  if (power.logs) {
+    String bootMsg = "{\"device\":\"";
+    bootMsg += DEVICE_NAME;
+    bootMsg += "\",\"version\":\"";
+    bootMsg += FW_VERSION;
+    bootMsg += "\",\"profile\":\"";
+    bootMsg += Profile::name;
+    bootMsg += "\",\"status\":\"online\"}";
+    comms.publishBoot(bootMsg.c_str());
+  }
+
+  if constexpr (!Profile::haDiscovery) {
+    return;
+  }
+  if (!power.discovery) {
+    return;
+  }
+
+  // Home Assistant: mark online + publish discovery config (retained)
+  comms.publishHAAvailability("online", true);
+
+  if (!rtc_ha_config_sent || ++rtc_ha_config_age >= HA_CONFIG_REFRESH_WAKES) {
+    rtc_ha_config_sent = comms.publishHAConfig(true);
+    rtc_ha_config_age = 0;
+  }
+}
+
+// Read RTC + DHT22, keep the reading (history, min/max); false if DHT failed
+bool WakeCycle::takeReading(time_t& nowEpoch, bool& rtcOk, float& tempC, float& humPct) {
+  // Read RTC time (epoch)
+  WakeWatchdog::phase(WakeWatchdog::Phase::RtcRead);
+  nowEpoch = 0;
+  rtcOk = hooks.readClock != nullptr && hooks.readClock(nowEpoch);
+
+  // Read DHT22
+  WakeWatchdog::phase(WakeWatchdog::Phase::Dht);
+  bool dhtOk = hooks.readSensor != nullptr && hooks.readSensor(tempC, humPct);
+  WakeTrace::reading(nowEpoch, rtcOk, dhtOk, tempC, humPct);
+  if (!dhtOk) {
+    return false;
+  }
+
+  // Keep the reading for on-demand history replay
+  if (rtcOk) {
+    ReadingHistory::append(nowEpoch, tempC, humPct);
+  }
+
+  // Update min/max tracker (without the RTC: into the current window, time unknown)
+  const float values[MINMAX_CHANNELS] = { tempC, humPct };
+  if (rtcOk) {
+    minMaxTracker.update(values, nowEpoch);
+  } else {
+    minMaxTracker.updateUntimed(values);
+  }
+  return true;
+}
+
+// Alarm type for a temperature ("LOW"/"HIGH"), nullptr if within thresholds
+const char* WakeCycle::checkAlarm(float tempC, float& thresholdC) {
+  const ConfigStore::Config& cfg = ConfigStore::get();
+  if (tempC < cfg.lowC) {
+    thresholdC = cfg.lowC;
+    return "LOW";
+  }
+  if (tempC > cfg.highC) {
+    thresholdC = cfg.highC;
+    return "HIGH";
+  }
+  return nullptr;
+}
+
+// ============================
+// Public: publishReadingAndStatus()
+// ============================
+void WakeCycle::publishReadingAndStatus() {
+  time_t nowEpoch = 0;
+  bool rtcOk = false;
+  float tempC = 0.0f;
+  float humPct = 0.0f;
+
+  if (!takeReading(nowEpoch, rtcOk, tempC, humPct)) {
+    comms.publishLog("[Wake] DHT22 read failed");
+    return;
+  }
+
+  WakeWatchdog::phase(WakeWatchdog::Phase::Publish);
+
+  // Home Assistant: publish sensor state (retained)
+  if constexpr (Profile::haDiscovery) {
+    comms.publishHAState(tempC, humPct, true);
+  }
+
+  // Get wake count from SleepManager
+  uint64_t wakeCount = sleepMgr.getWakeCount();
+
+  // Pulse totals and rates since the previous wake
+  char extraFields[512];
+  extraFields[0] = '\0';
+  int used = 0;
+  if (hooks.formatPulseFields != nullptr) {
+    used = hooks.formatPulseFields(rtcOk ? nowEpoch : 0, extraFields, sizeof(extraFields));
+  }
+
+  // Battery and load-shedding level
+  used = appendStatusField(extraFields, sizeof(extraFields), used,
+                           "\"battery_mv\":%u,\"power\":\"%s\"",
+                           batteryMv, PowerPolicy::name(power.level));
+
+#ifdef ENABLE_PIPELINE
+  // Sensing task: the network task drains the mailbox once MQTT is up
+  if (!mailboxCounted) {
+    wakeCommands = pipeline.waitForMailbox(CONNECT_TIMEOUT_MS);
+  }
+#endif
+
+  // Commands drained on this wake; later continuous-mode statuses send 0
+  used = appendStatusField(extraFields, sizeof(extraFields), used,
+                           "\"cmds\":%u", mailboxCounted ? 0 : wakeCommands);
+  mailboxCounted = true;
+
+  // Last completed wake's energy use and battery projection
+  char energyFields[160];
+  EnergyModel::formatStatusFields(energyFields, sizeof(energyFields));
+  used = appendStatusField(extraFields, sizeof(extraFields), used, "%s", energyFields);
+
+  // Broker load of this node: publishes so far, connect latency percentiles
+  char trafficFields[192];
+  TrafficStats::formatStatusFields(trafficFields, sizeof(trafficFields));
+  used = appendStatusField(extraFields, sizeof(extraFields), used, "%s", trafficFields);
+
+#ifdef ENABLE_MQTT_TLS
+  // Handshake cost: resumed vs full since power-on, last handshake duration
+  used = appendStatusField(extraFields, sizeof(extraFields), used,
+                           "\"tls\":{\"resumed\":%lu,\"full\":%lu,\"last_ms\":%lu}",
+                           (unsigned long)TlsClient::getResumedCount(),
+                           (unsigned long)TlsClient::getFullCount(),
+                           (unsigned long)TlsClient::getLastHandshakeMs());
+#endif
+
+  // Learned connect deadlines, length of the last outage in wakes
+  char connFields[80];
+  ConnectPolicy::formatStatusFields(rtc_connect, connFields, sizeof(connFields));
+  used = appendStatusField(extraFields, sizeof(extraFields), used, "%s", connFields);
+
+  // I2C errors and bus recoveries (only once something went wrong)
+  char i2cFields[160];
+  if (I2CBus::formatStatusFields(i2cFields, sizeof(i2cFields)) > 0) {
+    used = appendStatusField(extraFields, sizeof(extraFields), used, "%s", i2cFields);
+  }
+
+  // Firmware transfer progress, or a rejected update
+  char otaFields[64];
+  if (ota.formatStatusFields(otaFields, sizeof(otaFields)) > 0) {
+    used = appendStatusField(extraFields, sizeof(extraFields), used, "%s", otaFields);
+  }
+
+  // Phase that overran the wake budget (or reset) on an earlier wake
+  if (WakeWatchdog::hasReport()) {
+    char wdtFields[128];
+    WakeWatchdog::formatStatusFields(wdtFields, sizeof(wdtFields));
+    used = appendStatusField(extraFields, sizeof(extraFields), used, "%s", wdtFields);
+  }
+
+  // Publish status JSON
+  bool statusOk = mqttPublisher.publishStatus(
+    DEVICE_NAME,
+    FW_VERSION,
+    nowEpoch,
+    tempC,
+    humPct,
+    wakeCount,
+    extraFields
+  );
+
+  // Next batch replay starts after this reading
+  if (statusOk && rtcOk) {
+    rtc_last_uplink_epoch = (uint32_t)nowEpoch;
+  }
+  if (statusOk) {
+    // Failure counters since power-on (every HEALTH_PUBLISH_EVERY status
+    // messages), in their own message: the status payload has no room to spare
+    bool withHealth = false;
+    if (HealthCounters::due()) {
+      char healthFields[HealthCounters::FIELDS_SIZE];
+      HealthCounters::formatStatusFields(healthFields, sizeof(healthFields));
+      withHealth = mqttPublisher.publishHealth(DEVICE_NAME, nowEpoch, healthFields);
+    }
+    HealthCounters::statusSent(withHealth);
+    WakeWatchdog::clearReport();
+    OtaUpdater::clearReport();
+#ifndef ENABLE_PIPELINE
+    // Pipeline: only queued so far, confirmed once the outbox is flushed
+    OtaUpdater::confirmBoot();
+#endif
+  }
+
+  // Publish daily min/max
+  mqttPublisher.publishMinMax(
+    DEVICE_NAME,
+    nowEpoch,
+    minMaxTracker,
+    MINMAX_NAMES
+  );
+
+  // Check temperature thresholds and publish alarm if breached
+  float thresholdC = 0.0f;
+  const char* alarm = checkAlarm(tempC, thresholdC);
+  if (alarm != nullptr) {
+    mqttPublisher.publishAlarm(
+      DEVICE_NAME,
+      nowEpoch,
+      alarm,
+      tempC,
+      thresholdC
+    );
+  }
+
+  // Also publish a human-readable log line
+  if (power.logs) {
+    char logMsg[96];
+    snprintf(logMsg, sizeof(logMsg), "Temp=%.1fC Hum=%.1f%%", tempC, humPct);
+    comms.publishLog(logMsg);
+  }
+}
+
+void WakeCycle::syncTimeIfDue() {
+  if (!cm.wifiConnected() || hooks.syncClock == nullptr) {
+    return;
+  }
+  WakeWatchdog::phase(WakeWatchdog::Phase::Time);
+
+  if (hooks.syncClock() && power.logs) {
+    char summary[64];
+    char logMsg[96];
+    TimeService::formatSyncSummary(summary, sizeof(summary));
+    snprintf(logMsg, sizeof(logMsg), "[Time] SNTP sync %s", summary);
+    comms.publishLog(logMsg);
+  }
+}
+
+void WakeCycle::serviceOta() {
+  if (!ota.active()) {
+    return;
+  }
+  WakeWatchdog::phase(WakeWatchdog::Phase::Ota);
+
+  // Bounded by the chunk quota and OTA_WAKE_WINDOW_MS
+  uint32_t t0 = millis();
+  while (!ota.wakeDone() && millis() - t0 < OTA_WAKE_WINDOW_MS) {
+#ifdef ENABLE_PIPELINE
+    // The network task services the transfer
+    delay(10);
+#else
+    cm.loop();
+    serviceInputs();
+    delay(1);
+#endif
+  }
+}
+
+void WakeCycle::flushMqttBriefly() {
+  EnergyModel::mark(EnergyModel::Phase::Flush);
+  WakeWatchdog::phase(WakeWatchdog::Phase::Flush);
+
+#ifdef ENABLE_PIPELINE
+  // Once started, the network task owns cm even with MQTT down: only give
+  // it time to transmit. Input and offline wakes never start it.
+  if (pipeline.started()) {
+    if (pipeline.connected()) {
+      delay(MQTT_FLUSH_MS);
+    }
+    return;
+  }
+#endif
+  uint32_t t0 = millis();
+  while (millis() - t0 < MQTT_FLUSH_MS) {
+    cm.loop();
+    serviceInputs();
+    delay(1);
+  }
+}
+
+// Append one "key":value status field, comma-separated; returns new length
+int WakeCycle::appendStatusField(char* buf, size_t len, int used, const char* fmt, ...) {
+  if (used < 0 || (size_t)used + 1 >= len) {
+    return used;
+  }
+  if (used > 0) {
+    buf[used++] = ',';
+    buf[used] = '\0';
+  }
+
+  va_list args;
+  va_start(args, fmt);
+  int n = vsnprintf(buf + used, len - used, fmt, args);
+  va_end(args);
+
+  // Drop a field that does not fit rather than send cut-off JSON
+  if (n < 0 || (size_t)(used + n) >= len) {
+    Serial.printf("[Wake] Status field dropped (%d bytes, %d of %u used)\n",
+                  n, used, (unsigned)len);
+    int start = used > 0 ? used - 1 : used;
+    buf[start] = '\0';
+    return start;
+  }
+  return used + n;
+}
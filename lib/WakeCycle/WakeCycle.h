@@ -0,0 +1,140 @@
+#pragma once
+
+#include <Arduino.h>
+#include <time.h>
+#include <ConnectionManager.h>
+#include <Comms.h>
+#include <MQTTPublisher.h>
+#include <HistoryReplay.h>
+#include <OtaUpdater.h>
+#include <SleepManager.h>
+#include <PowerPolicy.h>
+#ifdef ENABLE_PIPELINE
+#include <Pipeline.h>
+#endif
+
+/**
+ * @class WakeCycle
+ * @brief One wake of the node, from configuration to the decision to sleep
+ *        (SPEC.md "Wake Cycle Behaviour").
+ *
+ * setup() in src/main.cpp runs it on the device; test_wake_replay and
+ * fleet_sim run the same sequence on the host. Power policy, input wake
+ * path, connect backoff, batch replay, connect with learned deadlines,
+ * mailbox, boot/HA/status/health/min-max/alarm/log messages, SNTP, OTA
+ * chunks and the flush all happen here. The caller supplies the hardware
+ * that differs between the two (Hooks), arms the wake watchdog first and
+ * acts on Outcome::next.
+ *
+ * State kept across deep sleep (min/max window, power level, connect
+ * backoff, HA discovery age, last uplink) is in RTC memory in WakeCycle.cpp.
+ * The modules (cm, comms, ...) are members: a new instance per wake on the
+ * host closes the socket like deep sleep does.
+ */
+class WakeCycle {
+public:
+  /**
+   * @brief Hardware the wake reads through (nullptr: not fitted).
+   */
+  struct Hooks {
+    uint16_t (*readBatteryMv)();                      // 0 = unknown
+    void (*beginSensors)();                           // DHT22 + RTC
+    bool (*readClock)(time_t& nowEpoch);              // RTC epoch, false if not valid
+    bool (*readSensor)(float& tempC, float& humPct);  // false if the read failed
+    bool (*syncClock)();                              // SNTP if due; true if synced
+    void (*beginInputs)(Comms& comms);                // event + pulse inputs
+    void (*serviceInputs)();                          // publish debounced events
+    int (*formatPulseFields)(time_t nowEpoch, char* buf, size_t len);
+  };
+
+  /**
+   * @brief Which way the wake went.
+   */
+  enum class Path : uint8_t {
+    Input,     // Input level change: event-only
+    Offline,   // Low battery: reading kept, radio only for an alarm
+    Backoff,   // Connect backoff: as Offline
+    Uplink     // Connected wake
+  };
+
+  /**
+   * @brief What the caller does next.
+   */
+  enum class Next : uint8_t {
+    Sleep,        // sleep()
+    Continuous,   // stay connected (RuntimeMode continuous)
+    Restart       // boot the firmware image just written
+  };
+
+  struct Outcome {
+    Path path;
+    Next next;
+    uint32_t radioStartMs;   // millis() when the radio started, 0 if it did not
+    uint32_t wifiUpMs;       // millis() when WiFi came up, 0 if it did not
+    uint32_t mqttUpMs;       // millis() when MQTT came up, 0 if it did not
+  };
+
+  explicit WakeCycle(const Hooks& hooks);
+
+  /**
+   * @brief Run the wake (setup()).
+   */
+  Outcome run();
+
+  /**
+   * @brief Read the sensors and publish reading, status, min/max, alarm and
+   *        log (also the continuous-mode sampling job).
+   */
+  void publishReadingAndStatus();
+
+  /**
+   * @brief Close the wake's accounting and enter deep sleep (does not
+   *        return). Also the wake watchdog's expire handler.
+   */
+  void sleep();
+
+  ConnectionManager& getConnectionManager();
+  Comms& getComms();
+  MQTTPublisher& getPublisher();
+  SleepManager& getSleepManager();
+  const PowerPolicy::Actions& getPower() const;
+#ifdef ENABLE_PIPELINE
+  Pipeline& getPipeline();
+#endif
+
+private:
+  Hooks hooks;
+  ConnectionManager cm;
+  Comms comms;
+  MQTTPublisher mqttPublisher;
+  HistoryReplay historyReplay;
+  OtaUpdater ota;
+  SleepManager sleepMgr;
+#ifdef ENABLE_PIPELINE
+  Pipeline pipeline;
+#endif
+
+  Outcome outcome = {};
+  PowerPolicy::Actions power = {};
+  uint16_t batteryMv = 0;
+  uint16_t wakeCommands = 0;    // Commands drained on this wake (status "cmds")
+  bool mailboxCounted = false;  // "cmds" sent in this wake's first status
+
+  void applyPowerPolicy();
+  void beginSensors();
+  bool takeReading(time_t& nowEpoch, bool& rtcOk, float& tempC, float& humPct);
+  Next runInputWake();
+  Next runOfflineWake();
+  Next runUplinkWake();
+  void startRadio();
+  bool waitForMqtt(uint32_t timeoutMs, bool phaseDeadlines = true);
+  void publishBootOnce();
+  void syncTimeIfDue();
+  void serviceOta();
+  void flushMqttBriefly();
+  void serviceInputs();
+  Next finishWake();
+
+  static const char* checkAlarm(float tempC, float& thresholdC);
+  static int appendStatusField(char* buf, size_t len, int used, const char* fmt, ...);
+};
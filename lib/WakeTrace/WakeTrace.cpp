@@ -0,0 +1,156 @@
+#include "WakeTrace.h"
+
+#ifdef ENABLE_WAKE_TRACE
+
+#include <Comms.h>
+#include <config_common.h>
+
+struct CommandSlot {
+  uint32_t seq;                       // wake the command arrived on
+  char text[TRACE_COMMAND_LEN];
+};
+
+// RTC memory (survives deep sleep, lost on power cycle)
+RTC_DATA_ATTR static WakeTrace::Record rtc_trace[TRACE_CAPACITY];
+RTC_DATA_ATTR static uint16_t rtc_trace_next = 0;     // slot for the next wake
+RTC_DATA_ATTR static uint16_t rtc_trace_count = 0;
+RTC_DATA_ATTR static CommandSlot rtc_trace_cmds[TRACE_COMMAND_SLOTS];
+RTC_DATA_ATTR static uint16_t rtc_trace_cmd_next = 0;
+
+// Record of the current wake (nullptr until beginWake())
+static WakeTrace::Record* current = nullptr;
+
+static uint16_t clampMs(uint32_t ms) {
+  return ms > 0xFFFF ? 0xFFFF : (ms == 0 ? 1 : (uint16_t)ms);
+}
+
+// ============================
+// Public: recording
+// ============================
+void WakeTrace::beginWake(uint32_t seq, uint8_t cause, uint16_t batteryMv) {
+  current = &rtc_trace[rtc_trace_next];
+  rtc_trace_next = (rtc_trace_next + 1) % TRACE_CAPACITY;
+  if (rtc_trace_count < TRACE_CAPACITY) {
+    rtc_trace_count++;
+  }
+
+  memset(current, 0, sizeof(Record));
+  current->seq = seq;
+  current->cause = cause;
+  current->batteryMv = batteryMv;
+}
+
+void WakeTrace::reading(time_t epoch, bool rtcOk, bool dhtOk, float tempC, float humPct) {
+  if (current == nullptr) {
+    return;
+  }
+  current->flags |= FLAG_READING;
+  if (rtcOk) {
+    current->flags |= FLAG_RTC_OK;
+    current->epoch = (uint32_t)epoch;
+  }
+  if (dhtOk) {
+    current->flags |= FLAG_DHT_OK;
+    current->tempCenti = (int16_t)lroundf(tempC * 100.0f);
+    current->humCenti = (uint16_t)lroundf(humPct * 100.0f);
+  }
+}
+
+void WakeTrace::linkUp(Link link) {
+  if (current == nullptr) {
+    return;
+  }
+
+  // millis() restarts on every wake: this is the time since wake start
+  uint16_t& ms = (link == Link::Wifi) ? current->wifiMs : current->mqttMs;
+  if (ms == 0) {
+    ms = clampMs(millis());
+  }
+}
+
+void WakeTrace::command(const char* cmd) {
+  if (current == nullptr || cmd == nullptr) {
+    return;
+  }
+  if (current->commands < 0xFF) {
+    current->commands++;
+  }
+
+  CommandSlot& slot = rtc_trace_cmds[rtc_trace_cmd_next];
+  rtc_trace_cmd_next = (rtc_trace_cmd_next + 1) % TRACE_COMMAND_SLOTS;
+  slot.seq = current->seq;
+  strncpy(slot.text, cmd, sizeof(slot.text) - 1);
+  slot.text[sizeof(slot.text) - 1] = '\0';
+}
+
+void WakeTrace::endWake() {
+  if (current == nullptr) {
+    return;
+  }
+  current->awakeMs = clampMs(millis());
+  current = nullptr;
+}
+
+// ============================
+// Public: publish() / clear()
+// ============================
+uint16_t WakeTrace::publish(Comms& comms) {
+  uint16_t first = (rtc_trace_next + TRACE_CAPACITY - rtc_trace_count) % TRACE_CAPACITY;
+  uint16_t sent = 0;
+  char json[320];
+
+  for (uint16_t i = 0; i < rtc_trace_count; i++) {
+    const Record& rec = rtc_trace[(first + i) % TRACE_CAPACITY];
+
+    int n = snprintf(json, sizeof(json),
+                     "{\"seq\":%lu,\"cause\":%u,\"flags\":%u,\"epoch\":%lu,\"t\":%d,\"h\":%u,"
+                     "\"mv\":%u,\"wifi_ms\":%u,\"mqtt_ms\":%u,\"awake_ms\":%u,\"cmds\":[",
+                     (unsigned long)rec.seq, rec.cause, rec.flags, (unsigned long)rec.epoch,
+                     rec.tempCenti, rec.humCenti, rec.batteryMv,
+                     rec.wifiMs, rec.mqttMs, rec.awakeMs);
+
+    // Commands still held for this wake, in arrival order (JSON-safe subset)
+    bool firstCmd = true;
+    for (uint16_t c = 0; c < TRACE_COMMAND_SLOTS; c++) {
+      const CommandSlot& slot = rtc_trace_cmds[(rtc_trace_cmd_next + c) % TRACE_COMMAND_SLOTS];
+      if (slot.text[0] == '\0' || slot.seq != rec.seq ||
+          strchr(slot.text, '"') != nullptr || strchr(slot.text, '\\') != nullptr) {
+        continue;
+      }
+      int m = snprintf(json + n, sizeof(json) - n, "%s\"%s\"", firstCmd ? "" : ",", slot.text);
+      if (m < 0 || n + m >= (int)sizeof(json) - 2) {
+        break;
+      }
+      n += m;
+      firstCmd = false;
+    }
+    json[n++] = ']';
+    json[n++] = '}';
+    json[n] = '\0';
+
+    if (!comms.publishResp(json)) {
+      break;
+    }
+    sent++;
+  }
+  return sent;
+}
+
+void WakeTrace::clear() {
+  rtc_trace_next = 0;
+  rtc_trace_count = 0;
+  memset(rtc_trace_cmds, 0, sizeof(rtc_trace_cmds));
+  rtc_trace_cmd_next = 0;
+
+  // Keep recording the current wake, as the only record
+  if (current != nullptr) {
+    Record keep = *current;
+    current = &rtc_trace[0];
+    *current = keep;
+    current->commands = 0;
+    rtc_trace_next = 1 % TRACE_CAPACITY;
+    rtc_trace_count = 1;
+  }
+}
+
+#endif
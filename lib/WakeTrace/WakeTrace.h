@@ -0,0 +1,103 @@
+#pragma once
+
+#include <Arduino.h>
+#include <time.h>
+
+// Forward declaration
+class Comms;
+
+/**
+ * @class WakeTrace
+ * @brief Recording of each wake's external inputs, kept in RTC memory.
+ *
+ * With -DENABLE_WAKE_TRACE, one record per wake holds what the wake saw from
+ * outside: wake cause, battery voltage, RTC epoch, DHT22 values, when WiFi
+ * and MQTT came up, the commands received and how long the wake lasted.
+ * Command texts go to a separate ring of slots tagged with the wake sequence.
+ * Replaying these inputs reproduces a wake sequence off the device; the
+ * format is in SPEC.md.
+ *
+ * Holds TRACE_CAPACITY wakes and TRACE_COMMAND_SLOTS commands, oldest
+ * overwritten first. Survives deep sleep, lost on power cycle. "trace"
+ * publishes it on the response topic, one message per wake.
+ *
+ * Without the flag every call compiles to nothing and no RTC memory is used.
+ */
+class WakeTrace {
+public:
+  enum class Link : uint8_t {
+    Wifi = 0,
+    Mqtt
+  };
+
+  /**
+   * @struct Record
+   * @brief Inputs of one wake (24 bytes).
+   */
+  struct Record {
+    uint32_t seq;         // wake counter (low 32 bits)
+    uint32_t epoch;       // RTC epoch of the reading (0 = no valid time)
+    int16_t tempCenti;    // DHT22 temperature in 0.01 °C
+    uint16_t humCenti;    // DHT22 humidity in 0.01 %
+    uint16_t batteryMv;
+    uint16_t wifiMs;      // wake start to WiFi up (0 = not up)
+    uint16_t mqttMs;      // wake start to MQTT up (0 = not up)
+    uint16_t awakeMs;     // wake start to sleep (0 = reset before sleeping)
+    uint8_t cause;        // SleepManager::WakeCause
+    uint8_t flags;        // FLAG_* bits
+    uint8_t commands;     // commands received
+    uint8_t reserved;
+  };
+
+  static const uint8_t FLAG_RTC_OK = 0x01;     // epoch read from the DS3231
+  static const uint8_t FLAG_DHT_OK = 0x02;     // temp/hum valid
+  static const uint8_t FLAG_READING = 0x04;    // a reading was taken
+
+#ifdef ENABLE_WAKE_TRACE
+  /**
+   * @brief Open the record for this wake (call once in setup()).
+   */
+  static void beginWake(uint32_t seq, uint8_t cause, uint16_t batteryMv);
+
+  /**
+   * @brief The sensor inputs of this wake.
+   */
+  static void reading(time_t epoch, bool rtcOk, bool dhtOk, float tempC, float humPct);
+
+  /**
+   * @brief First time a link is up on this wake (later calls are ignored).
+   */
+  static void linkUp(Link link);
+
+  /**
+   * @brief An inbound command (text kept up to TRACE_COMMAND_LEN - 1 chars).
+   */
+  static void command(const char* cmd);
+
+  /**
+   * @brief Close the record (call right before deep sleep).
+   */
+  static void endWake();
+
+  /**
+   * @brief Publish all records, oldest first, on the response topic.
+   *
+   * @return Number of records published
+   */
+  static uint16_t publish(Comms& comms);
+
+  /**
+   * @brief Forget all records and commands.
+   */
+  static void clear();
+#else
+  // Not recorded: calls compile to nothing
+  static void beginWake(uint32_t, uint8_t, uint16_t) {}
+  static void reading(time_t, bool, bool, float, float) {}
+  static void linkUp(Link) {}
+  static void command(const char*) {}
+  static void endWake() {}
+  static uint16_t publish(Comms&) { return 0; }
+  static void clear() {}
+#endif
+};
@@ -0,0 +1,189 @@
+#include "WakeWatchdog.h"
+#include <esp_timer.h>
+#include <esp_sleep.h>
+#include <esp_system.h>
+#include <esp_task_wdt.h>
+#include <config_common.h>
+
+static const uint32_t BREADCRUMB_MAGIC = 0x57445443;   // "WDTC"
+
+static const char* const PHASE_NAMES[(uint8_t)WakeWatchdog::Phase::Count] = {
+  "boot", "battery", "rtc_init", "rtc_read", "dht", "wifi",
+  "mqtt", "mailbox", "publish", "time", "ota", "flush", "sleep"
+};
+
+static const char* const KIND_NAMES[] = { "budget", "twdt", "panic" };
+
+// RTC_NOINIT: survives deep sleep and resets (watchdog, panic), not
+// initialized by the bootloader; validated by the magic and reset reason
+struct Breadcrumbs {
+  uint32_t magic;
+  uint8_t phase;            // phase the current wake is in
+  uint8_t pending;          // overrun not reported yet
+  uint8_t lastPhase;        // phase that overran
+  uint8_t lastKind;         // WakeWatchdog::Kind
+  uint32_t phaseStartMs;
+  uint32_t lastPhaseMs;     // time spent in the overrunning phase
+  uint16_t overruns;        // budget overruns since power-on
+  uint16_t resets;          // watchdog/panic resets during a wake since power-on
+};
+
+RTC_NOINIT_ATTR static Breadcrumbs crumbs;
+
+static esp_timer_handle_t budgetTimer = nullptr;
+static void (*expireHandler)() = nullptr;
+static bool twdtArmed = false;
+
+// ============================
+// Public: begin()
+// ============================
+void WakeWatchdog::begin(uint32_t budgetMs, void (*onExpire)()) {
+  esp_reset_reason_t reason = esp_reset_reason();
+
+  if (crumbs.magic != BREADCRUMB_MAGIC ||
+      reason == ESP_RST_POWERON || reason == ESP_RST_BROWNOUT) {
+    memset(&crumbs, 0, sizeof(crumbs));
+    crumbs.magic = BREADCRUMB_MAGIC;
+    crumbs.phase = (uint8_t)Phase::Sleep;
+  }
+
+  // Reset in the middle of a wake: blame the phase that was running
+  if (crumbs.phase != (uint8_t)Phase::Sleep) {
+    if (reason == ESP_RST_TASK_WDT) {
+      record(Kind::TaskWdt, 0);
+    } else if (reason == ESP_RST_PANIC || reason == ESP_RST_INT_WDT || reason == ESP_RST_WDT) {
+      record(Kind::Panic, 0);
+    }
+  }
+
+  crumbs.phase = (uint8_t)Phase::Boot;
+  crumbs.phaseStartMs = millis();
+  expireHandler = onExpire;
+
+  // Budget timer: runs in the esp_timer task, independent of the main task
+  if (budgetTimer == nullptr) {
+    const esp_timer_create_args_t timerArgs = {
+      .callback = &WakeWatchdog::onTimer,
+      .arg = nullptr,
+      .dispatch_method = ESP_TIMER_TASK,
+      .name = "wake_budget",
+      .skip_unhandled_events = true,
+    };
+    if (esp_timer_create(&timerArgs, &budgetTimer) != ESP_OK) {
+      Serial.println("[WDT] ERROR: budget timer create failed");
+      budgetTimer = nullptr;
+    }
+  }
+  if (budgetTimer != nullptr) {
+    esp_timer_start_once(budgetTimer, (uint64_t)budgetMs * 1000ULL);
+  }
+
+  // Backup: the main task is never fed, so the TWDT trips only if the
+  // budget timer did not end the wake (reconfigures the IDF default TWDT)
+  uint32_t twdtS = (budgetMs + 999) / 1000 + WAKE_TWDT_MARGIN_S;
+  if (esp_task_wdt_init(twdtS, true) == ESP_OK && esp_task_wdt_add(nullptr) == ESP_OK) {
+    twdtArmed = true;
+  } else {
+    Serial.println("[WDT] Task watchdog not armed");
+  }
+
+  if (crumbs.pending) {
+    Serial.printf("[WDT] Previous overrun: phase=%s kind=%s ms=%lu (overruns=%u resets=%u)\n",
+                  name((Phase)crumbs.lastPhase), KIND_NAMES[crumbs.lastKind],
+                  (unsigned long)crumbs.lastPhaseMs, crumbs.overruns, crumbs.resets);
+  }
+}
+
+// ============================
+// Public: phase()
+// ============================
+void WakeWatchdog::phase(Phase phase) {
+  if (crumbs.phase == (uint8_t)phase) {
+    return;
+  }
+  crumbs.phaseStartMs = millis();
+  crumbs.phase = (uint8_t)phase;
+}
+
+// ============================
+// Public: disarm()
+// ============================
+void WakeWatchdog::disarm() {
+  if (budgetTimer != nullptr) {
+    esp_timer_stop(budgetTimer);
+  }
+  if (twdtArmed) {
+    esp_task_wdt_delete(nullptr);
+    twdtArmed = false;
+  }
+}
+
+// ============================
+// Public: report
+// ============================
+bool WakeWatchdog::hasReport() {
+  return crumbs.pending != 0;
+}
+
+void WakeWatchdog::clearReport() {
+  crumbs.pending = 0;
+}
+
+int WakeWatchdog::formatStatusFields(char* buf, size_t len) {
+  if (len == 0) {
+    return 0;
+  }
+  buf[0] = '\0';
+  if (!crumbs.pending) {
+    return 0;
+  }
+
+  int n = snprintf(buf, len,
+                   "\"wdt\":{\"phase\":\"%s\",\"kind\":\"%s\",\"ms\":%lu,\"overruns\":%u,\"resets\":%u}",
+                   name((Phase)crumbs.lastPhase), KIND_NAMES[crumbs.lastKind],
+                   (unsigned long)crumbs.lastPhaseMs, crumbs.overruns, crumbs.resets);
+  if (n < 0) {
+    buf[0] = '\0';
+    return 0;
+  }
+  return n >= (int)len ? (int)len - 1 : n;
+}
+
+const char* WakeWatchdog::name(Phase phase) {
+  uint8_t i = (uint8_t)phase;
+  return i < (uint8_t)Phase::Count ? PHASE_NAMES[i] : "?";
+}
+
+// ============================
+// Private
+// ============================
+void WakeWatchdog::onTimer(void* arg) {
+  // Already on the way down
+  if (crumbs.phase == (uint8_t)Phase::Sleep) {
+    return;
+  }
+
+  record(Kind::Budget, millis() - crumbs.phaseStartMs);
+  Serial.printf("[WDT] Wake budget exceeded in phase %s after %lu ms, forcing sleep\n",
+                name((Phase)crumbs.lastPhase), (unsigned long)millis());
+
+  if (expireHandler != nullptr) {
+    expireHandler();
+  }
+
+  // Handler returned: plain timer sleep
+  esp_sleep_enable_timer_wakeup((uint64_t)WAKE_FALLBACK_SLEEP_S * 1000000ULL);
+  esp_deep_sleep_start();
+}
+
+void WakeWatchdog::record(Kind kind, uint32_t phaseMs) {
+  crumbs.lastPhase = crumbs.phase;
+  crumbs.lastKind = (uint8_t)kind;
+  crumbs.lastPhaseMs = phaseMs;
+  crumbs.pending = 1;
+  if (kind == Kind::Budget) {
+    crumbs.overruns++;
+  } else {
+    crumbs.resets++;
+  }
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <Arduino.h>
+
+/**
+ * @class WakeWatchdog
+ * @brief Hard ceiling on awake time per wake, with stuck-phase breadcrumbs.
+ *
+ * Two layers bound a battery wake:
+ * - A one-shot esp_timer (WAKE_BUDGET_MS) runs in the esp_timer task, so it
+ *   fires even while the main task is blocked in I2C, a DHT read or a TCP
+ *   connect. It records the overrun and calls the expire handler, which puts
+ *   the node into deep sleep.
+ * - The task watchdog watches the main task with WAKE_TWDT_MARGIN_S on top of
+ *   the budget. If the timer path cannot run (interrupts off, esp_timer task
+ *   starved), the TWDT panics and resets the chip.
+ *
+ * Main marks the phase it is entering. The phase is kept in RTC_NOINIT memory
+ * (survives resets as well as deep sleep), so both a budget overrun and a
+ * watchdog/panic reset are attributed to the phase that was running. The
+ * overrun is reported once in the next status message that is published.
+ *
+ * Phases are approximate with ENABLE_PIPELINE: both cores mark phases.
+ */
+class WakeWatchdog {
+public:
+  enum class Phase : uint8_t {
+    Boot = 0,
+    Battery,
+    RtcInit,
+    RtcRead,
+    Dht,
+    Wifi,
+    Mqtt,
+    Mailbox,
+    Publish,
+    Time,
+    Ota,
+    Flush,
+    Sleep,
+    Count
+  };
+
+  /**
+   * @brief Arm the wake budget (call first in setup()).
+   *
+   * Also picks up a watchdog/panic reset from the previous wake.
+   *
+   * @param budgetMs Maximum awake time for this wake
+   * @param onExpire Puts the node to sleep (called from the esp_timer task,
+   *                 must not return)
+   */
+  static void begin(uint32_t budgetMs, void (*onExpire)());
+
+  /**
+   * @brief Record the phase being entered (cheap, callable every loop pass).
+   */
+  static void phase(Phase phase);
+
+  /**
+   * @brief Stop both watchdogs (continuous mode stays awake on purpose).
+   */
+  static void disarm();
+
+  /**
+   * @brief True if an overrun has not been reported yet.
+   */
+  static bool hasReport();
+
+  /**
+   * @brief Forget the pending overrun once it was published.
+   */
+  static void clearReport();
+
+  /**
+   * @brief Format the pending overrun as status payload fields
+   *        (no surrounding braces):
+   *        "wdt":{"phase":"mqtt","kind":"budget","ms":14210,"overruns":3,"resets":0}
+   *
+   * "ms" is the time spent in the phase (0 after a reset, not known).
+   *
+   * @return Number of characters written
+   */
+  static int formatStatusFields(char* buf, size_t len);
+
+  static const char* name(Phase phase);
+
+private:
+  enum class Kind : uint8_t {
+    Budget = 0,
+    TaskWdt,
+    Panic
+  };
+
+  static void onTimer(void* arg);
+  static void record(Kind kind, uint32_t phaseMs);
+};
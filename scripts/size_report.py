@@ -0,0 +1,53 @@
+# Post-build: flash and RAM used by the firmware of this environment.
+#
+# Prints one line per build and keeps the latest numbers of every
+# environment in .pio/build/size_report.csv, so deployment profiles can be
+# compared after "pio run" (all default and listed environments).
+
+import csv
+import os
+import re
+import subprocess
+
+Import("env")
+
+
+def section_sizes(elf):
+    out = subprocess.run([env.subst("$SIZETOOL"), "-A", "-d", elf],
+                         capture_output=True, text=True, check=True).stdout
+    sizes = {}
+    for line in out.splitlines():
+        parts = line.split()
+        if len(parts) >= 2 and parts[1].isdigit():
+            sizes[parts[0]] = int(parts[1])
+    return sizes
+
+
+def total(sizes, pattern):
+    # Same section patterns PlatformIO uses for its RAM/Flash summary
+    regexp = re.compile(pattern)
+    return sum(size for name, size in sizes.items() if regexp.search(name))
+
+
+def report_size(source, target, env):
+    sizes = section_sizes(str(target[0]))
+    flash = total(sizes, env.get("SIZEPROGREGEXP"))
+    ram = total(sizes, env.get("SIZEDATAREGEXP"))
+    name = env.subst("$PIOENV")
+    print("[size] env=%s flash=%d ram=%d" % (name, flash, ram))
+
+    path = os.path.join(env.subst("$PROJECT_BUILD_DIR"), "size_report.csv")
+    rows = {}
+    if os.path.exists(path):
+        with open(path, newline="") as f:
+            rows = {row["env"]: row for row in csv.DictReader(f)}
+    rows[name] = {"env": name, "flash": flash, "ram": ram}
+
+    with open(path, "w", newline="") as f:
+        writer = csv.DictWriter(f, fieldnames=["env", "flash", "ram"])
+        writer.writeheader()
+        for key in sorted(rows):
+            writer.writerow(rows[key])
+
+
+env.AddPostAction("$BUILD_DIR/${PROGNAME}.elf", report_size)
@@ -0,0 +1,170 @@
+// Purpose: Micro-benchmark firmware (env:bench). Times the hot operations of a
+// wake on the ESP32 and prints one CSV line per case (see MicroBench).
+// The portable cases also build for the host (no ARDUINO):
+//   g++ -std=gnu++17 -O2 -Iinclude -Ilib/MicroBench -Ilib/Calendar src/bench/bench_main.cpp
+//       lib/MicroBench/MicroBench.cpp lib/Calendar/Calendar.cpp
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+#include <MicroBench.h>
+#include <Calendar.h>
+#include <config_common.h>
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#include <Client.h>
+#include <PubSubClient.h>
+#include <I2CBus.h>
+#include <RTC.h>
+#else
+#include <string>
+#endif
+
+static const uint32_t WARMUP_CALLS = 20;
+static const uint8_t SAMPLES = 15;
+
+// Inputs that change between calls, so no result can be folded at compile time
+static volatile float benchTempC = 21.37f;
+static volatile time_t benchEpoch = 1737519400;
+
+// ============================================================================
+// Portable cases
+// ============================================================================
+
+// MQTTPublisher::publishStatus(): float formatting into the status payload
+static void benchStatusSnprintf() {
+  char payload[MQTT_BUFFER_SIZE - 64];
+  int len = snprintf(payload, sizeof(payload),
+                     "{\"device\":\"%s\",\"fw\":\"%s\",\"ts\":%lu,\"temp_c\":%.1f,\"hum_pct\":%.1f,\"wake_count\":%llu}",
+                     DEVICE_NAME, FW_VERSION, (unsigned long)benchEpoch, benchTempC, 61.2f, 1234ULL);
+  MicroBench::keep(len);
+}
+
+// Former MinMaxTracker::update() day check: gmtime() for the hour and the date
+static void benchGmtimeTwice() {
+  time_t t = benchEpoch;
+  struct tm a;
+  struct tm b;
+  gmtime_r(&t, &a);
+  gmtime_r(&t, &b);
+  int v = a.tm_hour + (b.tm_year + 1900) * 10000 + (b.tm_mon + 1) * 100 + b.tm_mday;
+  MicroBench::keep(v);
+}
+
+// MinMaxTracker::update() day check: DST table lookup and integer date math
+static void benchCalendarRollover() {
+  int v = Calendar::yyyymmdd(Calendar::rolloverDay(benchEpoch));
+  MicroBench::keep(v);
+}
+
+// publishBootOnce(): boot message built by String concatenation
+static void benchBootMessage() {
+#ifdef ARDUINO
+  String bootMsg = "{\"device\":\"";
+#else
+  std::string bootMsg = "{\"device\":\"";
+#endif
+  bootMsg += DEVICE_NAME;
+  bootMsg += "\",\"version\":\"";
+  bootMsg += FW_VERSION;
+  bootMsg += "\",\"status\":\"online\"}";
+  MicroBench::keep(bootMsg);
+}
+
+// ============================================================================
+// Device cases
+// ============================================================================
+#ifdef ARDUINO
+
+// Accepts and discards everything: times PubSubClient's packet encoding only
+class NullClient : public Client {
+public:
+  int connect(IPAddress, uint16_t) override { return 1; }
+  int connect(const char*, uint16_t) override { return 1; }
+  size_t write(uint8_t) override { return 1; }
+  size_t write(const uint8_t*, size_t size) override { return size; }
+  int available() override { return 0; }
+  int read() override { return -1; }
+  int read(uint8_t*, size_t) override { return 0; }
+  int peek() override { return -1; }
+  void flush() override {}
+  void stop() override {}
+  uint8_t connected() override { return 1; }
+  operator bool() override { return true; }
+};
+
+static NullClient nullClient;
+static PubSubClient pubsub(nullClient);
+static char statusPayload[192];
+
+static void benchPubSubPublish() {
+  bool ok = pubsub.publish(MQTT_TOPIC_STATUS, statusPayload);
+  MicroBench::keep(ok);
+}
+
+// RTC::getTime(): 7-byte burst read of the DS3231 time registers
+static void benchDs3231BurstRead() {
+  uint8_t r[7];
+  bool ok = I2CBus::readRegs(DS3231_I2C_ADDR, 0x00, r, sizeof(r));
+  MicroBench::keep(ok);
+}
+
+// Same read plus BCD decode and civil-date conversion
+static void benchRtcGetTime() {
+  time_t t = 0;
+  bool ok = RTC::getTime(t);
+  MicroBench::keep(ok);
+  MicroBench::keep(t);
+}
+
+#endif
+
+static const MicroBench::Case CASES[] = {
+  { "status_snprintf", benchStatusSnprintf, 200 },
+  { "gmtime_x2", benchGmtimeTwice, 500 },
+  { "calendar_rollover", benchCalendarRollover, 500 },
+  { "boot_msg_string", benchBootMessage, 200 },
+#ifdef ARDUINO
+  { "pubsub_publish", benchPubSubPublish, 200 },
+  { "ds3231_burst_read", benchDs3231BurstRead, 20 },
+  { "rtc_get_time", benchRtcGetTime, 20 },
+#endif
+};
+
+static void runSuite() {
+  MicroBench::run(CASES, sizeof(CASES) / sizeof(CASES[0]), WARMUP_CALLS, SAMPLES);
+}
+
+#ifdef ARDUINO
+void setup() {
+  Serial.begin(115200);
+  delay(200);
+  Serial.println();
+  Serial.printf("[Bench] %s %s, CPU %lu MHz\n", DEVICE_NAME, FW_VERSION,
+                (unsigned long)getCpuFrequencyMhz());
+
+  // The DS3231 cases read the real chip; they report the failed call's cost without it
+  if (!RTC::begin()) {
+    Serial.println("[Bench] RTC not found, DS3231 cases time a failing transaction");
+  }
+
+  snprintf(statusPayload, sizeof(statusPayload),
+           "{\"device\":\"%s\",\"fw\":\"%s\",\"ts\":1737519400,\"temp_c\":21.4,\"hum_pct\":61.2,\"wake_count\":1234}",
+           DEVICE_NAME, FW_VERSION);
+  // No CONNECT needed: publish() only asks the client whether it is connected
+  pubsub.setBufferSize(MQTT_BUFFER_SIZE);
+
+  runSuite();
+  Serial.println("[Bench] Done");
+}
+
+void loop() {
+  delay(1000);
+}
+#else
+int main() {
+  runSuite();
+  return 0;
+}
+#endif
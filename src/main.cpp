@@ -5,116 +5,151 @@
 
 #include <Arduino.h>
 #include <WiFi.h>
+#include <type_traits>
 
-#include <ConnectionManager.h>
-#include <Comms.h>
+#include <WakeCycle.h>
 #include <Interrupts.h>
 #include <SensorDHT22.h>
-#include <SleepManager.h>
 #include <RTC.h>
-#include <MinMaxTracker.h>
-#include <MQTTPublisher.h>
+#include <TimeService.h>
+#include <PulseCounter.h>
+#include <Pipeline.h>
+#include <RuntimeMode.h>
+#include <Scheduler.h>
+#include <EnergyModel.h>
+#include <BatteryMonitor.h>
+#include <WakeWatchdog.h>
+#include <WakeTrace.h>
 
 #include <config.h>
+#include <profile.h>
+
+// Stand-ins for modules the deployment profile leaves out: same calls,
+// no state, no code (the real module is never referenced, so not linked)
+struct NoEventInputs {
+  void begin(Comms&) {}
+  void loop() {}
+};
+
+struct NoPulseInputs {
+  void begin() {}
+  void sample(time_t) {}
+  int formatStatusFields(char* buf, size_t len) const {
+    if (len > 0) buf[0] = '\0';
+    return 0;
+  }
+};
 
-// Global instances
-ConnectionManager cm;
-Comms comms;
-Interrupts interrupts;
+// Global instances (the wake's own modules are in WakeCycle)
+std::conditional_t<Profile::eventInputs, Interrupts, NoEventInputs> interrupts;
 SensorDHT22 dht22;
-SleepManager sleepMgr;
-MinMaxTracker minMaxTracker;
-MQTTPublisher mqttPublisher;
-
-static bool haConfigSent = false;
-
-
-// Timing
-static const uint32_t CONNECT_TIMEOUT_MS = 15000;   // max time to wait for WiFi+MQTT
-static const uint32_t MQTT_FLUSH_MS      = 250;     // give MQTT time to transmit before sleep
+std::conditional_t<Profile::pulseInputs, PulseCounter, NoPulseInputs> pulseCounter;
+BatteryMonitor battery;
+
+// Continuous (mains) mode
+static bool continuousMode = false;
+static Scheduler scheduler;
+
+// Hardware the wake reads through
+static const WakeCycle::Hooks hooks = {
+  // readBatteryMv
+  []() -> uint16_t {
+#if BATTERY_MONITOR_ENABLED
+    battery.begin();
+    return battery.readMillivolts();
+#else
+    return 0;
+#endif
+  },
+  // beginSensors
+  []() {
+    // DHT22
+    dht22.begin(DHT_PIN);
+
+    // RTC
+    WakeWatchdog::phase(WakeWatchdog::Phase::RtcInit);
+    bool rtcOk = RTC::begin();
+    if (!rtcOk) {
+      Serial.println("[MAIN] RTC begin failed (continuing without RTC)");
+    } else {
+#ifdef ENABLE_RTC_TIME_SYNC
+      RTC::syncToCompileTime();
+#endif
+    }
 
-// Temperature thresholds (Celsius)
-static const float DEFAULT_LOW_C  = 1.0f;
-static const float DEFAULT_HIGH_C = 30.0f;
+    time_t now = 0;
+    bool ok = TimeService::now(now);
+
+    Serial.printf("[MAIN] RTC getTime ok=%d now=%lu\n", ok ? 1 : 0, (unsigned long)now);
+  },
+  // readClock
+  [](time_t& nowEpoch) { return TimeService::now(nowEpoch); },
+  // readSensor
+  [](float& tempC, float& humPct) { return dht22.read(tempC, humPct); },
+  // syncClock
+  []() { return TimeService::syncIfDue(); },
+  // beginInputs: event inputs, pulse inputs (ULP keeps counting through deep sleep)
+  [](Comms& comms) {
+    interrupts.begin(comms);
+    pulseCounter.begin();
+  },
+  // serviceInputs
+  []() { interrupts.loop(); },
+  // formatPulseFields: totals and rates since the previous wake
+  [](time_t nowEpoch, char* buf, size_t len) {
+    pulseCounter.sample(nowEpoch);
+    return pulseCounter.formatStatusFields(buf, len);
+  },
+};
+
+static WakeCycle wake(hooks);
 
 // Helpers
-static void publishBootOnce();
-static void publishReadingAndStatus();
-static void flushMqttBriefly();
+static void enterContinuousMode();
+static void runContinuousPass();
+static void publishHeartbeat();
 static void goToSleepNow();
 
 void setup() {
-  Serial.begin(115200);
-  delay(200);
-
-  Serial.println();
-  Serial.println("[MAIN] Boot");
-
-  // Start modules
-  cm.begin();
-  comms.begin(cm);
-  cm.setComms(&comms);
-
-  // Initialize MQTTPublisher
-  mqttPublisher.begin(comms);
-
-  // Interrupts not really needed for this greenhouse node, but harmless:
-  interrupts.begin(comms);
+  // Charge the sleep that just ended, then account this wake by phase
+  EnergyModel::beginWake();
 
-  // DHT22
-  dht22.begin(DHT_PIN);
+  // Hard ceiling on this wake: forces deep sleep if a phase hangs
+  WakeWatchdog::begin(WAKE_BUDGET_MS, goToSleepNow);
 
-  // RTC
-  bool rtcOk = RTC::begin();
-  if (!rtcOk) {
-  Serial.println("[MAIN] RTC begin failed (continuing without RTC)");
-  } else {
-  #ifdef ENABLE_RTC_TIME_SYNC
-    RTC::syncToCompileTime();
-  #endif
-}
-
-
-  time_t now = 0;
-  bool ok = RTC::getTime(now);
-
-  Serial.printf("[MAIN] RTC getTime ok=%d now=%lu\n", ok ? 1 : 0, (unsigned long)now);
-
-
-  // Sleep manager (default 30 mins unless you override)
-  sleepMgr.begin(5);
+  Serial.begin(115200);
+  delay(200);
 
-  // Wait for WiFi + MQTT (bounded)
-  uint32_t startMs = millis();
-  while (millis() - startMs < CONNECT_TIMEOUT_MS) {
-    cm.loop();
-    interrupts.loop();
-    delay(1);
+  // Configuration, power policy, connect, mailbox, publish, flush
+  WakeCycle::Outcome outcome = wake.run();
 
-    if (cm.mqttConnected()) {
+  switch (outcome.next) {
+    case WakeCycle::Next::Restart:
+      // Verified firmware image is set as boot partition
+      Serial.println("[MAIN] Rebooting into new firmware...");
+      Serial.flush();
+      ESP.restart();
+      break;
+    case WakeCycle::Next::Continuous:
+      enterContinuousMode();
+      break;
+    case WakeCycle::Next::Sleep:
+      goToSleepNow();
       break;
-    }
   }
+}
 
-  if (!cm.mqttConnected()) {
-    Serial.println("[MAIN] MQTT not connected within timeout (sleeping anyway)");
-    goToSleepNow();
+void loop() {
+  if (continuousMode) {
+    runContinuousPass();
     return;
   }
 
-  // Publish boot + reading
-  publishBootOnce();
-  publishReadingAndStatus();
-
-  // Flush and sleep
-  flushMqttBriefly();
-  goToSleepNow();
-}
-
-void loop() {
   // We should never really get here in battery mode.
-  cm.loop();
+#ifndef ENABLE_PIPELINE
+  wake.getConnectionManager().loop();
   interrupts.loop();
+#endif
   delay(10);
 }
 
@@ -122,106 +157,52 @@ void loop() {
 // Helpers
 // ============================================================================
 
-static void publishBootOnce() {
-  
-  String bootMsg = "{\"device\":\"";
-  bootMsg += DEVICE_NAME;
-  bootMsg += "\",\"version\":\"";
-  bootMsg += FW_VERSION;
-  bootMsg += "\",\"status\":\"online\"}";
-  comms.publishBoot(bootMsg.c_str());
-
-  // Home Assistant: mark online + publish discovery config (retained)
-  comms.publishHAAvailability("online", true);
-
-  if (!haConfigSent) {
-    comms.publishHAConfig(true);
-    haConfigSent = true;
-  }
- }
+static void enterContinuousMode() {
+  Serial.println("[MAIN] Continuous mode: staying connected");
+  continuousMode = true;
 
-static void publishReadingAndStatus() {
-  // Read RTC time (epoch)
-  time_t nowEpoch = 0;
-  bool rtcOk = RTC::getTime(nowEpoch);
+  // Awake on purpose from here on
+  WakeWatchdog::disarm();
+  WakeTrace::endWake();
 
-  // Read DHT22
-  float tempC = 0.0f;
-  float humPct = 0.0f;
+  // Lowest WiFi-capable clock + modem sleep between DTIM beacons
+  setCpuFrequencyMhz(CONTINUOUS_CPU_MHZ);
+  WiFi.setSleep(true);
 
-  if (!dht22.read(tempC, humPct)) {
-    comms.publishLog("[MAIN] DHT22 read failed");
-    return;
-  }
-
-  // Home Assistant: publish sensor state (retained)
-  comms.publishHAState(tempC, humPct, true);
+  // Sampling and heartbeat run on timers, not on every loop pass
+  scheduler.begin(millis);
+  scheduler.every(wake.getSleepManager().getIntervalMinutes() * 60000UL,
+                  []() { wake.publishReadingAndStatus(); });
+  scheduler.every(HEARTBEAT_INTERVAL_MS, publishHeartbeat, true);
+}
 
-  // Update min/max tracker
-  if (rtcOk) {
-    minMaxTracker.update(tempC, nowEpoch);
-  } else {
-    // If RTC unavailable, pass current time_t as 0
-    minMaxTracker.update(tempC, 0);
+static void runContinuousPass() {
+  uint32_t waitMs = scheduler.runDue();
+  if (waitMs > CONTINUOUS_MAX_IDLE_MS) {
+    waitMs = CONTINUOUS_MAX_IDLE_MS;
   }
 
-  // Get wake count from SleepManager
-  uint64_t wakeCount = sleepMgr.getWakeCount();
-
-  // Publish status JSON
-  mqttPublisher.publishStatus(
-    DEVICE_NAME,
-    FW_VERSION,
-    nowEpoch,
-    tempC,
-    humPct,
-    wakeCount
-  );
-
-  // Publish daily min/max
-  MinMaxTracker::DailyStats stats = minMaxTracker.getStats();
-  mqttPublisher.publishMinMax(
-    DEVICE_NAME,
-    nowEpoch,
-    stats
-  );
-
-  // Check temperature thresholds and publish alarm if breached
-  if (tempC < DEFAULT_LOW_C) {
-    mqttPublisher.publishAlarm(
-      DEVICE_NAME,
-      nowEpoch,
-      "LOW",
-      tempC,
-      DEFAULT_LOW_C
-    );
-  } else if (tempC > DEFAULT_HIGH_C) {
-    mqttPublisher.publishAlarm(
-      DEVICE_NAME,
-      nowEpoch,
-      "HIGH",
-      tempC,
-      DEFAULT_HIGH_C
-    );
-  }
+#ifdef ENABLE_PIPELINE
+  // Network task owns MQTT; this task is now the outbox's only producer
+  delay(waitMs);
+#else
+  // Sleep in select() until a command arrives or the next job is due
+  ConnectionManager& cm = wake.getConnectionManager();
+  cm.waitForTraffic(waitMs);
+  cm.loop();
+  interrupts.loop();
+#endif
 
-  // Also publish a human-readable log line
-  char logMsg[96];
-  snprintf(logMsg, sizeof(logMsg), "Temp=%.1fC Hum=%.1f%%", tempC, humPct);
-  comms.publishLog(logMsg);
+  if (RuntimeMode::get() != RuntimeMode::Mode::Continuous) {
+    Serial.println("[MAIN] Battery mode selected, leaving continuous mode");
+    goToSleepNow();
+  }
 }
 
-static void flushMqttBriefly() {
-  uint32_t t0 = millis();
-  while (millis() - t0 < MQTT_FLUSH_MS) {
-    cm.loop();
-    delay(1);
-  }
+static void publishHeartbeat() {
+  wake.getPublisher().publishHeartbeat(DEVICE_NAME, FW_VERSION, millis() / 1000, WiFi.RSSI());
 }
 
 static void goToSleepNow() {
-  Serial.println("[MAIN] Sleeping now...");
-  Serial.flush();
-
-  sleepMgr.sleep(); // does not return
+  wake.sleep(); // does not return
 }
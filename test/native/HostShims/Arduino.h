@@ -0,0 +1,94 @@
+#pragma once
+
+// Host (env:native) stand-in for the Arduino-ESP32 core: the subset lib/
+// uses, backed by the simulated device in Host.h. ARDUINO is deliberately
+// left undefined (host code paths, as in MicroBench).
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+
+#include "WString.h"
+#include "Print.h"
+#include "Stream.h"
+#include "IPAddress.h"
+#include "freertos/FreeRTOS.h"
+#include "esp_system.h"
+
+// ============================
+// Attributes
+// ============================
+// RTC memory lives in named sections so Host can reset it (power cycle) and
+// swap it (one image per simulated node).
+#define RTC_DATA_ATTR   __attribute__((section("rtc_data")))
+#define RTC_NOINIT_ATTR __attribute__((section("rtc_noinit")))
+#define IRAM_ATTR
+#define DRAM_ATTR
+#define PROGMEM
+
+#define pgm_read_byte(addr)      (*(const uint8_t*)(addr))
+#define pgm_read_byte_near(addr) pgm_read_byte(addr)
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+using std::min;
+using std::max;
+
+// ============================
+// Time
+// ============================
+unsigned long millis();
+unsigned long micros();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+void yield();
+
+// ============================
+// Math
+// ============================
+inline long random(long howbig) { return howbig > 0 ? ::random() % howbig : 0; }
+
+// ============================
+// GPIO
+// ============================
+#define LOW    0x0
+#define HIGH   0x1
+#define INPUT  0x01
+#define OUTPUT 0x03
+#define INPUT_PULLUP 0x05
+#define OUTPUT_OPEN_DRAIN 0x13
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+
+// ============================
+// Serial / ESP
+// ============================
+class HardwareSerial : public Stream {
+public:
+  void begin(unsigned long baud) { (void)baud; }
+  size_t write(uint8_t b) override;
+  size_t write(const uint8_t* buf, size_t size) override;
+  int available() override { return 0; }
+  int read() override { return -1; }
+  int peek() override { return -1; }
+  void flush() override;
+};
+
+extern HardwareSerial Serial;
+
+class EspClass {
+public:
+  uint64_t getEfuseMac();
+  uint32_t getCycleCount();
+  uint32_t getFreeHeap() { return 200000; }
+  void restart();
+};
+
+extern EspClass ESP;
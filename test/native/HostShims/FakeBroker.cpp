@@ -0,0 +1,649 @@
+#include "FakeBroker.h"
+#include <lwip/sockets.h>
+#include <poll.h>
+#include <chrono>
+#include <string.h>
+
+// ============================
+// Wire format
+// ============================
+static const uint8_t CONNECT = 1;
+static const uint8_t CONNACK = 2;
+static const uint8_t PUBLISH = 3;
+static const uint8_t PUBACK = 4;
+static const uint8_t SUBSCRIBE = 8;
+static const uint8_t SUBACK = 9;
+static const uint8_t UNSUBSCRIBE = 10;
+static const uint8_t UNSUBACK = 11;
+static const uint8_t PINGREQ = 12;
+static const uint8_t PINGRESP = 13;
+static const uint8_t DISCONNECT = 14;
+
+static const uint8_t CONNACK_BAD_PROTOCOL = 1;
+
+static int64_t monotonicMs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void putString(std::string& out, const std::string& s) {
+  out += (char)(s.size() >> 8);
+  out += (char)(s.size() & 0xFF);
+  out += s;
+}
+
+// Length-prefixed string at pos (advanced); false if the body is too short
+static bool getString(const std::string& body, size_t& pos, std::string& out) {
+  if (pos + 2 > body.size()) {
+    return false;
+  }
+  size_t len = ((uint8_t)body[pos] << 8) | (uint8_t)body[pos + 1];
+  if (pos + 2 + len > body.size()) {
+    return false;
+  }
+  out = body.substr(pos + 2, len);
+  pos += 2 + len;
+  return true;
+}
+
+struct FakeBroker::Connection {
+  int fd;
+  std::string in;
+  std::string clientId;
+  bool connected = false;      // CONNECT accepted
+  bool hasWill = false;
+  Message will;
+  uint16_t keepAliveS = 0;
+  int64_t lastInMs = 0;
+};
+
+// ============================
+// Lifecycle
+// ============================
+FakeBroker::FakeBroker() {}
+
+FakeBroker::~FakeBroker() {
+  stop();
+}
+
+bool FakeBroker::start(uint16_t loopbackPort) {
+  if (running.load()) {
+    return true;
+  }
+  listenFd = socket(AF_INET, SOCK_STREAM, 0);
+  if (listenFd < 0) {
+    return false;
+  }
+  int one = 1;
+  setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(loopbackPort);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t len = sizeof(addr);
+  if (bind(listenFd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(listenFd, 128) != 0 ||
+      getsockname(listenFd, (struct sockaddr*)&addr, &len) != 0 || pipe(wakeFds) != 0) {
+    ::close(listenFd);
+    listenFd = -1;
+    return false;
+  }
+  listenPort = ntohs(addr.sin_port);
+
+  running.store(true);
+  thread = std::thread(&FakeBroker::run, this);
+  return true;
+}
+
+void FakeBroker::stop() {
+  if (!running.exchange(false)) {
+    return;
+  }
+  wake();
+  thread.join();
+
+  std::lock_guard<std::mutex> lock(mutex);
+  while (!connections.empty()) {
+    close(connections.back(), false);
+  }
+  ::close(listenFd);
+  ::close(wakeFds[0]);
+  ::close(wakeFds[1]);
+  listenFd = wakeFds[0] = wakeFds[1] = -1;
+}
+
+uint16_t FakeBroker::port() const {
+  return listenPort;
+}
+
+void FakeBroker::attach(uint32_t ip, uint16_t port) {
+  Host::attachTcp(ip, port, listenPort);
+}
+
+// ============================
+// Test side
+// ============================
+void FakeBroker::publish(const std::string& topic, const std::string& payload, uint8_t qos, bool retain) {
+  Message m = { "", topic, payload, qos, retain, Host::worldTimeUs() };
+  std::lock_guard<std::mutex> lock(mutex);
+  route(m);
+}
+
+void FakeBroker::setHook(Hook h) {
+  std::lock_guard<std::mutex> lock(mutex);
+  hook = h;
+}
+
+void FakeBroker::refuseConnections(uint8_t returnCode) {
+  std::lock_guard<std::mutex> lock(mutex);
+  refuseCode = returnCode;
+}
+
+void FakeBroker::dropClients() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    dropRequested = true;
+  }
+  wake();
+  // Done when the broker thread has handled it
+  std::unique_lock<std::mutex> lock(mutex);
+  arrived.wait_for(lock, std::chrono::seconds(2), [this] { return !dropRequested; });
+}
+
+void FakeBroker::setLogging(bool on) {
+  std::lock_guard<std::mutex> lock(mutex);
+  logging = on;
+}
+
+std::vector<FakeBroker::Message> FakeBroker::messages(const std::string& filter) const {
+  std::lock_guard<std::mutex> lock(mutex);
+  std::vector<Message> out;
+  for (const Message& m : log) {
+    if (matches(filter, m.topic)) {
+      out.push_back(m);
+    }
+  }
+  return out;
+}
+
+size_t FakeBroker::count(const std::string& filter) const {
+  std::lock_guard<std::mutex> lock(mutex);
+  size_t n = 0;
+  for (const Message& m : log) {
+    n += matches(filter, m.topic) ? 1 : 0;
+  }
+  return n;
+}
+
+bool FakeBroker::waitFor(const std::string& filter, size_t n, uint32_t timeoutMs) const {
+  std::unique_lock<std::mutex> lock(mutex);
+  return arrived.wait_for(lock, std::chrono::milliseconds(timeoutMs), [&] {
+    size_t seen = 0;
+    for (const Message& m : log) {
+      seen += matches(filter, m.topic) ? 1 : 0;
+    }
+    return seen >= n;
+  });
+}
+
+void FakeBroker::clearLog() {
+  std::lock_guard<std::mutex> lock(mutex);
+  log.clear();
+}
+
+FakeBroker::Stats FakeBroker::stats() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return counters;
+}
+
+size_t FakeBroker::clientsConnected() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  size_t n = 0;
+  for (const Connection* c : connections) {
+    n += c->connected ? 1 : 0;
+  }
+  return n;
+}
+
+bool FakeBroker::subscribed(const std::string& topic) const {
+  std::lock_guard<std::mutex> lock(mutex);
+  for (const auto& entry : sessions) {
+    if (entry.second.connection == nullptr) {
+      continue;
+    }
+    for (const auto& sub : entry.second.subscriptions) {
+      if (matches(sub.first, topic)) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+bool FakeBroker::matches(const std::string& filter, const std::string& topic) {
+  size_t f = 0;
+  size_t t = 0;
+  while (f < filter.size()) {
+    if (filter[f] == '#') {
+      return true;
+    }
+    size_t fEnd = filter.find('/', f);
+    size_t tEnd = topic.find('/', t);
+    if (fEnd == std::string::npos) fEnd = filter.size();
+    if (tEnd == std::string::npos) tEnd = topic.size();
+    if (t > topic.size()) {
+      // Topic used up: "a/#" also matches "a"
+      return filter.compare(f, std::string::npos, "#") == 0;
+    }
+    if (!(fEnd - f == 1 && filter[f] == '+') &&
+        filter.compare(f, fEnd - f, topic, t, tEnd - t) != 0) {
+      return false;
+    }
+    f = fEnd + 1;
+    t = tEnd + 1;
+    if (f > filter.size()) {
+      return t > topic.size();
+    }
+  }
+  return t > topic.size();
+}
+
+// ============================
+// Broker thread
+// ============================
+void FakeBroker::wake() {
+  if (wakeFds[1] >= 0) {
+    char b = 1;
+    (void)!::write(wakeFds[1], &b, 1);
+  }
+}
+
+void FakeBroker::run() {
+  std::vector<struct pollfd> fds;
+  std::vector<Connection*> polled;
+
+  while (running.load()) {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (dropRequested) {
+        while (!connections.empty()) {
+          close(connections.back(), true);
+        }
+        dropRequested = false;
+        arrived.notify_all();
+      }
+
+      // Keep-alive: 1.5 times the client's interval without a packet
+      int64_t now = monotonicMs();
+      for (size_t i = 0; i < connections.size();) {
+        Connection* c = connections[i];
+        if (c->keepAliveS > 0 && now - c->lastInMs > c->keepAliveS * 1500LL) {
+          close(c, true);
+        } else {
+          i++;
+        }
+      }
+
+      fds.clear();
+      polled.clear();
+      fds.push_back({ listenFd, POLLIN, 0 });
+      fds.push_back({ wakeFds[0], POLLIN, 0 });
+      for (Connection* c : connections) {
+        fds.push_back({ c->fd, POLLIN, 0 });
+        polled.push_back(c);
+      }
+    }
+
+    if (poll(fds.data(), fds.size(), 100) <= 0) {
+      continue;
+    }
+    if (fds[1].revents & POLLIN) {
+      char drain[64];
+      (void)!::read(wakeFds[0], drain, sizeof(drain));
+    }
+    if (fds[0].revents & POLLIN) {
+      accept();
+    }
+
+    std::vector<Message> forHook;
+    Hook h;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      for (size_t i = 0; i < polled.size(); i++) {
+        Connection* c = polled[i];
+        bool still = false;
+        for (Connection* d : connections) {
+          still = still || d == c;
+        }
+        if (still && (fds[i + 2].revents & (POLLIN | POLLHUP | POLLERR)) && !receive(c, forHook)) {
+          close(c, true);
+        }
+      }
+      h = hook;
+    }
+
+    // Outside the lock: the hook may publish
+    if (h) {
+      for (const Message& m : forHook) {
+        h(*this, m);
+      }
+    }
+  }
+}
+
+void FakeBroker::accept() {
+  int fd = ::accept(listenFd, nullptr, nullptr);
+  if (fd < 0) {
+    return;
+  }
+  Connection* c = new Connection();
+  c->fd = fd;
+  c->lastInMs = monotonicMs();
+  std::lock_guard<std::mutex> lock(mutex);
+  connections.push_back(c);
+}
+
+bool FakeBroker::receive(Connection* c, std::vector<Message>& forHook) {
+  char buf[4096];
+  ssize_t n = recv(c->fd, buf, sizeof(buf), MSG_DONTWAIT);
+  if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+    return false;
+  }
+  if (n < 0) {
+    return true;
+  }
+  counters.bytesIn += (uint64_t)n;
+  c->in.append(buf, (size_t)n);
+  c->lastInMs = monotonicMs();
+
+  // Whole packets: type/flags, remaining length (1-4 bytes), body
+  for (;;) {
+    size_t len = 0;
+    size_t pos = 1;
+    int shift = 0;
+    bool complete = false;
+    while (pos < c->in.size() && pos <= 4) {
+      uint8_t digit = (uint8_t)c->in[pos++];
+      len |= (size_t)(digit & 0x7F) << shift;
+      shift += 7;
+      if ((digit & 0x80) == 0) {
+        complete = true;
+        break;
+      }
+    }
+    if (!complete) {
+      return pos <= 4;   // malformed if 4 length bytes did not end it
+    }
+    if (c->in.size() < pos + len) {
+      return true;
+    }
+    uint8_t header = (uint8_t)c->in[0];
+    std::string body = c->in.substr(pos, len);
+    c->in.erase(0, pos + len);
+    if (!handlePacket(c, header >> 4, header & 0x0F, body, forHook)) {
+      return false;
+    }
+  }
+}
+
+bool FakeBroker::handlePacket(Connection* c, uint8_t type, uint8_t flags, const std::string& body,
+                              std::vector<Message>& forHook) {
+  if (!c->connected && type != CONNECT) {
+    return false;
+  }
+
+  switch (type) {
+    case CONNECT: {
+      size_t pos = 0;
+      std::string protocol;
+      if (c->connected || !getString(body, pos, protocol) || pos + 4 > body.size()) {
+        return false;
+      }
+      uint8_t level = (uint8_t)body[pos];
+      uint8_t cflags = (uint8_t)body[pos + 1];
+      c->keepAliveS = (uint16_t)(((uint8_t)body[pos + 2] << 8) | (uint8_t)body[pos + 3]);
+      pos += 4;
+
+      std::string id, willTopic, willPayload, user, pass;
+      if (!getString(body, pos, id)) {
+        return false;
+      }
+      if (cflags & 0x04) {
+        if (!getString(body, pos, willTopic) || !getString(body, pos, willPayload)) {
+          return false;
+        }
+      }
+      if ((cflags & 0x80) && !getString(body, pos, user)) return false;
+      if ((cflags & 0x40) && !getString(body, pos, pass)) return false;
+
+      uint8_t rc = (protocol != "MQTT" || level != 4) ? CONNACK_BAD_PROTOCOL : refuseCode;
+      if (rc != 0) {
+        counters.refused++;
+        send(c, CONNACK << 4, std::string("\0", 1) + (char)rc);
+        return false;
+      }
+
+      // Takeover: the older connection of this client goes
+      for (Connection* other : connections) {
+        if (other != c && other->connected && other->clientId == id) {
+          close(other, true);
+          break;
+        }
+      }
+
+      bool clean = (cflags & 0x02) != 0;
+      auto it = sessions.find(id);
+      bool present = !clean && it != sessions.end() && it->second.persistent;
+      if (!present) {
+        sessions[id] = Session();
+      }
+      Session& s = sessions[id];
+      s.persistent = !clean;
+      s.connection = c;
+
+      c->clientId = id;
+      c->connected = true;
+      c->hasWill = (cflags & 0x04) != 0;
+      if (c->hasWill) {
+        c->will = { id, willTopic, willPayload, (uint8_t)((cflags >> 3) & 0x03),
+                    (cflags & 0x20) != 0, 0 };
+      }
+      counters.connects++;
+      send(c, CONNACK << 4, std::string(1, present ? 1 : 0) + '\0');
+
+      // Mailbox: what arrived while the client was away
+      std::vector<Message> queued;
+      queued.swap(s.queued);
+      for (const Message& m : queued) {
+        deliver(c, m, 1, false);
+      }
+      return true;
+    }
+
+    case PUBLISH: {
+      size_t pos = 0;
+      Message m;
+      if (!getString(body, pos, m.topic)) {
+        return false;
+      }
+      m.qos = (flags >> 1) & 0x03;
+      m.retained = (flags & 0x01) != 0;
+      uint16_t id = 0;
+      if (m.qos > 0) {
+        if (pos + 2 > body.size()) {
+          return false;
+        }
+        id = (uint16_t)(((uint8_t)body[pos] << 8) | (uint8_t)body[pos + 1]);
+        pos += 2;
+      }
+      m.payload = body.substr(pos);
+      m.clientId = c->clientId;
+      m.atUs = Host::worldTimeUs();
+      counters.publishesIn++;
+
+      if (m.qos == 1) {
+        send(c, PUBACK << 4, std::string(1, (char)(id >> 8)) + (char)(id & 0xFF));
+      }
+      if (logging) {
+        log.push_back(m);
+        arrived.notify_all();
+      }
+      route(m);
+      forHook.push_back(m);
+      return true;
+    }
+
+    case PUBACK:
+      return true;   // QoS 1 out: fire and forget
+
+    case SUBSCRIBE:
+    case UNSUBSCRIBE: {
+      if (body.size() < 2) {
+        return false;
+      }
+      Session& s = sessions[c->clientId];
+      std::string reply = body.substr(0, 2);   // packet id
+      size_t pos = 2;
+      std::vector<std::string> added;
+      while (pos < body.size()) {
+        std::string filter;
+        if (!getString(body, pos, filter)) {
+          return false;
+        }
+        if (type == SUBSCRIBE) {
+          if (pos >= body.size()) {
+            return false;
+          }
+          uint8_t granted = (uint8_t)body[pos++] > 0 ? 1 : 0;
+          s.subscriptions[filter] = granted;
+          reply += (char)granted;
+          added.push_back(filter);
+        } else {
+          s.subscriptions.erase(filter);
+        }
+      }
+      send(c, type == SUBSCRIBE ? (SUBACK << 4) : (UNSUBACK << 4), reply);
+
+      // Retained messages for the new subscriptions
+      for (const std::string& filter : added) {
+        for (const auto& r : retainedMessages) {
+          if (matches(filter, r.first)) {
+            deliver(c, r.second, s.subscriptions[filter], true);
+          }
+        }
+      }
+      return true;
+    }
+
+    case PINGREQ:
+      send(c, PINGRESP << 4, "");
+      return true;
+
+    case DISCONNECT:
+      c->hasWill = false;
+      return false;
+
+    default:
+      return false;
+  }
+}
+
+void FakeBroker::close(Connection* c, bool publishWill) {
+  for (size_t i = 0; i < connections.size(); i++) {
+    if (connections[i] == c) {
+      connections.erase(connections.begin() + i);
+      break;
+    }
+  }
+  ::close(c->fd);
+
+  if (c->connected) {
+    auto it = sessions.find(c->clientId);
+    if (it != sessions.end() && it->second.connection == c) {
+      it->second.connection = nullptr;
+      if (!it->second.persistent) {
+        sessions.erase(it);
+      }
+    }
+    if (publishWill && c->hasWill) {
+      c->will.atUs = Host::worldTimeUs();
+      if (logging) {
+        log.push_back(c->will);
+        arrived.notify_all();
+      }
+      route(c->will);
+    }
+  }
+  delete c;
+}
+
+void FakeBroker::route(const Message& m) {
+  if (m.retained) {
+    if (m.payload.empty()) {
+      retainedMessages.erase(m.topic);
+    } else {
+      retainedMessages[m.topic] = m;
+    }
+  }
+
+  for (auto& entry : sessions) {
+    Session& s = entry.second;
+    int qos = -1;
+    for (const auto& sub : s.subscriptions) {
+      if (matches(sub.first, m.topic)) {
+        qos = std::max(qos, (int)sub.second);
+      }
+    }
+    if (qos < 0) {
+      continue;
+    }
+    uint8_t q = (uint8_t)std::min(qos, (int)m.qos);
+    if (s.connection != nullptr) {
+      deliver(s.connection, m, q, false);
+    } else if (s.persistent && q == 1) {
+      s.queued.push_back(m);
+    }
+  }
+}
+
+void FakeBroker::deliver(Connection* c, const Message& m, uint8_t qos, bool retainFlag) {
+  std::string body;
+  putString(body, m.topic);
+  if (qos > 0) {
+    uint16_t id = nextPacketId++;
+    if (nextPacketId == 0) {
+      nextPacketId = 1;
+    }
+    body += (char)(id >> 8);
+    body += (char)(id & 0xFF);
+  }
+  body += m.payload;
+  counters.publishesOut++;
+  send(c, (uint8_t)((PUBLISH << 4) | (qos << 1) | (retainFlag ? 1 : 0)), body);
+}
+
+void FakeBroker::send(Connection* c, uint8_t header, const std::string& body) {
+  std::string packet(1, (char)header);
+  size_t len = body.size();
+  do {
+    uint8_t digit = len & 0x7F;
+    len >>= 7;
+    packet += (char)(len > 0 ? (digit | 0x80) : digit);
+  } while (len > 0);
+  packet += body;
+
+  size_t sent = 0;
+  while (sent < packet.size()) {
+    ssize_t n = ::send(c->fd, packet.data() + sent, packet.size() - sent, MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      break;   // the read side notices the closed socket
+    }
+    sent += (size_t)n;
+  }
+  counters.bytesOut += sent;
+}
@@ -0,0 +1,149 @@
+#pragma once
+
+#include "Host.h"
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @class FakeBroker
+ * @brief MQTT 3.1.1 broker on a loopback socket, for host tests and tools.
+ *
+ * Serves its clients from its own thread: QoS 0 and 1 (the firmware never
+ * uses 2), retained messages, + and # filters, the last will, and
+ * persistent sessions that queue QoS 1 messages while their client sleeps.
+ * Every PUBLISH from a client is logged for the test to inspect, and a hook
+ * can answer it from the broker thread (an update server, a backend).
+ *
+ * attach() puts it on the simulated network at the address the firmware
+ * is configured with (Host::attachTcp).
+ */
+class FakeBroker {
+public:
+  struct Message {
+    std::string clientId;    // "" when published by the test
+    std::string topic;
+    std::string payload;
+    uint8_t qos;
+    bool retained;
+    int64_t atUs;            // Host world time of arrival
+  };
+
+  struct Stats {
+    uint64_t connects;       // CONNACKs accepted
+    uint64_t refused;        // CONNACKs refused
+    uint64_t publishesIn;    // PUBLISH packets from clients
+    uint64_t publishesOut;   // PUBLISH packets to clients
+    uint64_t bytesIn;        // everything read from client sockets
+    uint64_t bytesOut;       // everything written to them
+  };
+
+  typedef std::function<void(FakeBroker& broker, const Message& message)> Hook;
+
+  FakeBroker();
+  ~FakeBroker();
+
+  /**
+   * @brief Listen on 127.0.0.1 (0 = any free port) and start the thread.
+   */
+  bool start(uint16_t loopbackPort = 0);
+  void stop();
+  uint16_t port() const;
+
+  /**
+   * @brief Reachable from the device at ip:port.
+   */
+  void attach(uint32_t ip, uint16_t port);
+
+  /**
+   * @brief Publish as the backend (delivered like a client's message).
+   */
+  void publish(const std::string& topic, const std::string& payload,
+               uint8_t qos = 0, bool retain = false);
+
+  /**
+   * @brief Called on the broker thread for each PUBLISH from a client.
+   */
+  void setHook(Hook hook);
+
+  /**
+   * @brief Answer CONNECT with this return code (0 = accept again).
+   */
+  void refuseConnections(uint8_t returnCode);
+
+  /**
+   * @brief Close every client connection (wills are published).
+   */
+  void dropClients();
+
+  /**
+   * @brief Keep a log of the messages (off: counters only, for long runs).
+   */
+  void setLogging(bool on);
+
+  std::vector<Message> messages(const std::string& filter = "#") const;
+  size_t count(const std::string& filter = "#") const;
+
+  /**
+   * @brief Wait until n messages matching filter have arrived.
+   */
+  bool waitFor(const std::string& filter, size_t n, uint32_t timeoutMs) const;
+  void clearLog();
+
+  Stats stats() const;
+  size_t clientsConnected() const;
+
+  /**
+   * @brief Whether a connected client has a subscription matching topic.
+   */
+  bool subscribed(const std::string& topic) const;
+
+  /**
+   * @brief Whether a topic matches a subscription filter.
+   */
+  static bool matches(const std::string& filter, const std::string& topic);
+
+private:
+  struct Connection;
+  struct Session {
+    std::map<std::string, uint8_t> subscriptions;   // filter -> granted QoS
+    std::vector<Message> queued;                    // QoS 1 while offline
+    Connection* connection = nullptr;
+    bool persistent = false;
+  };
+
+  mutable std::mutex mutex;
+  mutable std::condition_variable arrived;
+  std::thread thread;
+  std::atomic<bool> running{false};
+  int listenFd = -1;
+  int wakeFds[2] = { -1, -1 };
+  uint16_t listenPort = 0;
+
+  std::vector<Connection*> connections;
+  std::map<std::string, Session> sessions;
+  std::map<std::string, Message> retainedMessages;
+  std::vector<Message> log;
+  bool logging = true;
+  Hook hook;
+  uint8_t refuseCode = 0;
+  bool dropRequested = false;
+  Stats counters = {};
+  uint16_t nextPacketId = 1;
+
+  void run();
+  void accept();
+  bool receive(Connection* c, std::vector<Message>& forHook);
+  bool handlePacket(Connection* c, uint8_t type, uint8_t flags, const std::string& body,
+                    std::vector<Message>& forHook);
+  void close(Connection* c, bool publishWill);
+  void route(const Message& m);
+  void deliver(Connection* c, const Message& m, uint8_t qos, bool retainFlag);
+  void send(Connection* c, uint8_t header, const std::string& body);
+  void wake();
+};
@@ -0,0 +1,211 @@
+#include "FakeDS3231.h"
+#include <Arduino.h>
+#include <time.h>
+
+static const uint8_t REG_HOURS = 0x02;
+static const uint8_t REG_MONTH = 0x05;
+static const uint8_t REG_CONTROL = 0x0E;
+static const uint8_t REG_STATUS = 0x0F;
+static const uint8_t REG_AGING = 0x10;
+static const uint8_t TIME_REGS = 7;
+static const uint8_t CONTROL_CONV = 0x20;
+static const uint8_t STATUS_OSF = 0x80;
+static const uint8_t HELD_FOR_GOOD = 255;
+static const int64_t POWER_ON_TIME_US = 946684800LL * 1000000;   // 2000-01-01
+
+static FakeDS3231* sdaHolder = nullptr;
+
+static uint8_t toBcd(int v) { return (uint8_t)(((v / 10) << 4) | (v % 10)); }
+static int fromBcd(uint8_t v) { return (v >> 4) * 10 + (v & 0x0F); }
+
+FakeDS3231::FakeDS3231(uint8_t sdaPin, uint8_t sclPin) : sda(sdaPin), scl(sclPin) {
+  memset(regs, 0, sizeof(regs));
+  regs[REG_CONTROL] = 0x1C;
+  regs[REG_STATUS] = STATUS_OSF | 0x08;
+  regs[0x11] = 25;   // 25.00 °C
+  worldAnchorUs = Host::worldTimeUs();
+  chipAnchorUs = POWER_ON_TIME_US;
+}
+
+FakeDS3231::~FakeDS3231() {
+  detach();
+  if (sdaHolder == this) {
+    Host::setPinHooks(nullptr, nullptr);
+    sdaHolder = nullptr;
+  }
+}
+
+void FakeDS3231::attach() {
+  Host::attachI2C(ADDR, this);
+}
+
+void FakeDS3231::detach() {
+  Host::attachI2C(ADDR, nullptr);
+}
+
+// ============================
+// Time
+// ============================
+// The aging offset counts from the last conversion, as on the chip
+double FakeDS3231::rate() const {
+  return 1.0 + (ppm - activeAging * 0.1) * 1e-6;
+}
+
+int64_t FakeDS3231::timeUs() const {
+  return chipAnchorUs + (int64_t)((Host::worldTimeUs() - worldAnchorUs) * rate());
+}
+
+void FakeDS3231::reanchor() {
+  chipAnchorUs = timeUs();
+  worldAnchorUs = Host::worldTimeUs();
+}
+
+void FakeDS3231::setPpm(float value) {
+  reanchor();
+  ppm = value;
+}
+
+void FakeDS3231::setTime(int64_t epochUs) {
+  chipAnchorUs = epochUs;
+  worldAnchorUs = Host::worldTimeUs();
+  regs[REG_STATUS] &= ~STATUS_OSF;
+}
+
+void FakeDS3231::use12h(bool on) {
+  hour12 = on;
+}
+
+bool FakeDS3231::oscillatorStopped() const {
+  return (regs[REG_STATUS] & STATUS_OSF) != 0;
+}
+
+uint8_t FakeDS3231::reg(uint8_t r) const {
+  return r < REGS ? regs[r] : 0;
+}
+
+uint32_t FakeDS3231::conversions() const {
+  return convCount;
+}
+
+// Time registers from the current time (the chip latches them at START)
+void FakeDS3231::latchTime() {
+  int64_t us = timeUs();
+  time_t t = (time_t)(us / 1000000 - (us % 1000000 < 0 ? 1 : 0));
+  struct tm tm;
+  gmtime_r(&t, &tm);
+
+  regs[0] = toBcd(tm.tm_sec);
+  regs[1] = toBcd(tm.tm_min);
+  if (hour12) {
+    int h = tm.tm_hour % 12 == 0 ? 12 : tm.tm_hour % 12;
+    regs[REG_HOURS] = (uint8_t)(0x40 | (tm.tm_hour >= 12 ? 0x20 : 0) | toBcd(h));
+  } else {
+    regs[REG_HOURS] = toBcd(tm.tm_hour);
+  }
+  regs[3] = (uint8_t)(tm.tm_wday + 1);
+  regs[4] = toBcd(tm.tm_mday);
+  int year = tm.tm_year + 1900;
+  regs[REG_MONTH] = (uint8_t)(toBcd(tm.tm_mon + 1) | (year >= 2100 ? 0x80 : 0));
+  regs[6] = toBcd(year % 100);
+}
+
+// Writing the seconds restarts the countdown chain: a full second to the next tick
+void FakeDS3231::timeWritten() {
+  struct tm tm;
+  memset(&tm, 0, sizeof(tm));
+  tm.tm_sec = fromBcd(regs[0] & 0x7F);
+  tm.tm_min = fromBcd(regs[1] & 0x7F);
+  uint8_t h = regs[REG_HOURS];
+  if (h & 0x40) {
+    tm.tm_hour = fromBcd(h & 0x1F) % 12 + ((h & 0x20) ? 12 : 0);
+  } else {
+    tm.tm_hour = fromBcd(h & 0x3F);
+  }
+  tm.tm_mday = fromBcd(regs[4] & 0x3F);
+  tm.tm_mon = fromBcd(regs[REG_MONTH] & 0x1F) - 1;
+  tm.tm_year = 100 + fromBcd(regs[6]) + ((regs[REG_MONTH] & 0x80) ? 100 : 0);
+
+  chipAnchorUs = (int64_t)timegm(&tm) * 1000000;
+  worldAnchorUs = Host::worldTimeUs();
+}
+
+// ============================
+// I2C
+// ============================
+bool FakeDS3231::i2cWrite(const uint8_t* data, size_t len) {
+  if (len == 0 || data[0] >= REGS) {
+    return false;
+  }
+  pointer = data[0];
+
+  bool timeTouched = false;
+  for (size_t i = 1; i < len; i++) {
+    uint8_t v = data[i];
+    if (pointer < TIME_REGS) {
+      timeTouched = true;
+      regs[pointer] = v;
+    } else if (pointer == REG_STATUS) {
+      // OSF can only be cleared; BSY is read-only
+      regs[REG_STATUS] = (uint8_t)((v & regs[REG_STATUS] & STATUS_OSF) | (v & 0x0B));
+    } else if (pointer == REG_CONTROL && (v & CONTROL_CONV)) {
+      // Conversion: applies the aging offset, done at once
+      reanchor();
+      activeAging = (int8_t)regs[REG_AGING];
+      convCount++;
+      regs[REG_CONTROL] = (uint8_t)(v & ~CONTROL_CONV);
+    } else if (pointer < 0x11) {
+      regs[pointer] = v;
+    }
+    pointer = (uint8_t)((pointer + 1) % REGS);
+  }
+
+  if (timeTouched) {
+    timeWritten();
+  }
+  return true;
+}
+
+size_t FakeDS3231::i2cRead(uint8_t* data, size_t len) {
+  latchTime();
+  for (size_t i = 0; i < len; i++) {
+    data[i] = regs[pointer];
+    pointer = (uint8_t)((pointer + 1) % REGS);
+  }
+  return len;
+}
+
+// ============================
+// Stuck bus
+// ============================
+void FakeDS3231::holdSda(uint8_t clocks) {
+  heldClocks = clocks;
+  pulses = 0;
+  lastScl = HIGH;
+  sdaHolder = this;
+  Host::setPinHooks(readPin, writePin);
+}
+
+uint32_t FakeDS3231::sclPulses() const {
+  return pulses;
+}
+
+int FakeDS3231::readPin(uint8_t pin) {
+  if (sdaHolder != nullptr && pin == sdaHolder->sda && sdaHolder->heldClocks > 0) {
+    return LOW;
+  }
+  return -1;   // not driven by the slave
+}
+
+void FakeDS3231::writePin(uint8_t pin, uint8_t value) {
+  FakeDS3231* d = sdaHolder;
+  if (d == nullptr || pin != d->scl) {
+    return;
+  }
+  if (value == HIGH && d->lastScl == LOW && d->heldClocks > 0) {
+    d->pulses++;
+    if (d->heldClocks != HELD_FOR_GOOD) {
+      d->heldClocks--;
+    }
+  }
+  d->lastScl = value;
+}
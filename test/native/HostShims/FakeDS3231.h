@@ -0,0 +1,90 @@
+#pragma once
+
+#include "Host.h"
+
+/**
+ * @class FakeDS3231
+ * @brief Simulated DS3231 on the host I2C bus.
+ *
+ * Keeps time from Host world time at a rate off by ppm (positive = fast),
+ * trimmed by the aging register (0.1 ppm per LSB, positive = slower). It is
+ * battery-backed: deep sleep and power cycles do not touch it. Registers
+ * are BCD as on the chip, with the 12-hour mode and century bit, OSF set
+ * until the time is written, and CONV completing at once.
+ *
+ * One instance at a time can hold SDA low (slave reset mid-byte) through
+ * the Host GPIO hooks, released after enough SCL clocks.
+ */
+class FakeDS3231 : public Host::I2CDevice {
+public:
+  static const uint8_t ADDR = 0x68;
+
+  FakeDS3231(uint8_t sdaPin = 21, uint8_t sclPin = 22);
+  ~FakeDS3231() override;
+
+  void attach();
+  void detach();
+
+  /**
+   * @brief Oscillator error in ppm (before the aging offset).
+   */
+  void setPpm(float ppm);
+
+  /**
+   * @brief Set the time directly (battery-backed time from before), clears OSF.
+   */
+  void setTime(int64_t epochUs);
+
+  /**
+   * @brief Current time of the chip (µs since the epoch).
+   */
+  int64_t timeUs() const;
+
+  /**
+   * @brief Keep the hour register in 12-hour mode.
+   */
+  void use12h(bool on);
+
+  bool oscillatorStopped() const;
+  uint8_t reg(uint8_t r) const;
+  uint32_t conversions() const;
+
+  /**
+   * @brief Hold SDA low until SCL has been clocked `clocks` times (255 = for good).
+   */
+  void holdSda(uint8_t clocks);
+
+  /**
+   * @brief SCL rising edges seen while SDA was held.
+   */
+  uint32_t sclPulses() const;
+
+  bool i2cWrite(const uint8_t* data, size_t len) override;
+  size_t i2cRead(uint8_t* data, size_t len) override;
+
+private:
+  static const uint8_t REGS = 0x13;
+
+  uint8_t regs[REGS];
+  uint8_t pointer = 0;
+  float ppm = 0.0f;
+  int8_t activeAging = 0;  // aging register as of the last conversion
+  bool hour12 = false;
+  uint32_t convCount = 0;
+  int64_t worldAnchorUs;   // world time when the chip time was last anchored
+  int64_t chipAnchorUs;    // chip time at that moment
+
+  uint8_t sda;
+  uint8_t scl;
+  uint8_t heldClocks = 0;
+  uint8_t lastScl = 1;
+  uint32_t pulses = 0;
+
+  double rate() const;
+  void reanchor();
+  void latchTime();
+  void timeWritten();
+
+  static int readPin(uint8_t pin);
+  static void writePin(uint8_t pin, uint8_t value);
+};
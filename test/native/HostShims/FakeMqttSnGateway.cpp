@@ -0,0 +1,287 @@
+#include "FakeMqttSnGateway.h"
+
+// Flags byte (MQTT-SN v1.2, section 5.3.4)
+static const uint8_t FLAG_DUP        = 0x80;
+static const uint8_t FLAG_QOS_MASK   = 0x60;
+static const uint8_t FLAG_QOS_1      = 0x20;
+static const uint8_t FLAG_QOS_M1     = 0x60;
+static const uint8_t FLAG_RETAIN     = 0x10;
+static const uint8_t FLAG_PREDEFINED = 0x01;
+static const uint8_t RC_ACCEPTED     = 0x00;
+static const uint8_t RC_NOT_SUPPORTED = 0x03;
+
+static uint16_t be16(const uint8_t* p) {
+  return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+FakeMqttSnGateway::FakeMqttSnGateway(uint32_t address, uint16_t udpPort)
+  : ip(address), port(udpPort) {}
+
+FakeMqttSnGateway::~FakeMqttSnGateway() {
+  detach();
+}
+
+void FakeMqttSnGateway::attach() {
+  Host::attachUdp(ip, port, this);
+}
+
+void FakeMqttSnGateway::detach() {
+  Host::attachUdp(ip, port, nullptr);
+}
+
+void FakeMqttSnGateway::setLatency(uint32_t ms) {
+  latencyMs = ms;
+}
+
+void FakeMqttSnGateway::setSilent(bool on) {
+  silent = on;
+}
+
+void FakeMqttSnGateway::dropAcks(uint32_t n) {
+  acksToDrop = n;
+}
+
+void FakeMqttSnGateway::forgetClients() {
+  clients.clear();
+}
+
+// ============================
+// Backend side
+// ============================
+void FakeMqttSnGateway::publish(uint16_t topicId, const std::string& payload) {
+  for (auto& entry : clients) {
+    Client& c = entry.second;
+    if (c.subscriptions.count(topicId) == 0) {
+      continue;
+    }
+    c.buffer.push_back(Pending{ topicId, payload });
+    if (c.state == State::Active) {
+      sendBuffered(c);
+    }
+  }
+}
+
+const std::vector<FakeMqttSnGateway::Message>& FakeMqttSnGateway::messages() const {
+  return log;
+}
+
+std::vector<FakeMqttSnGateway::Message> FakeMqttSnGateway::messages(uint16_t topicId) const {
+  std::vector<Message> out;
+  for (const Message& m : log) {
+    if (m.topicId == topicId) {
+      out.push_back(m);
+    }
+  }
+  return out;
+}
+
+void FakeMqttSnGateway::clearLog() {
+  log.clear();
+}
+
+bool FakeMqttSnGateway::asleep(const std::string& clientId) const {
+  auto it = clients.find(clientId);
+  return it != clients.end() && it->second.state == State::Asleep;
+}
+
+uint16_t FakeMqttSnGateway::sleepDurationS(const std::string& clientId) const {
+  auto it = clients.find(clientId);
+  return it != clients.end() ? it->second.sleepS : 0;
+}
+
+bool FakeMqttSnGateway::subscribed(const std::string& clientId, uint16_t topicId) const {
+  auto it = clients.find(clientId);
+  return it != clients.end() && it->second.subscriptions.count(topicId) > 0;
+}
+
+size_t FakeMqttSnGateway::buffered(const std::string& clientId) const {
+  auto it = clients.find(clientId);
+  return it != clients.end() ? it->second.buffer.size() : 0;
+}
+
+uint32_t FakeMqttSnGateway::connects() const {
+  return connectCount;
+}
+
+uint32_t FakeMqttSnGateway::datagramsIn() const {
+  return datagramCount;
+}
+
+uint32_t FakeMqttSnGateway::bytesIn() const {
+  return byteCount;
+}
+
+// ============================
+// Device side
+// ============================
+void FakeMqttSnGateway::udpReceive(uint16_t fromPort, const uint8_t* data, size_t len) {
+  if (silent || len < 2) {
+    return;
+  }
+  datagramCount++;
+  byteCount += len;
+
+  // Length field: 1 byte, or 0x01 + 2 bytes (section 5.2.1)
+  size_t offset = (data[0] == 0x01) ? 3 : 1;
+  size_t total = (data[0] == 0x01) ? (len >= 3 ? be16(data + 1) : 0) : data[0];
+  if (len <= offset || total != len) {
+    return;
+  }
+  uint8_t type = data[offset];
+  const uint8_t* body = data + offset + 1;
+  size_t bodyLen = len - offset - 1;
+
+  std::string clientId;
+  Client* c = clientOnPort(fromPort, &clientId);
+
+  switch (type) {
+    case CONNECT: {
+      if (bodyLen < 4) {
+        return;
+      }
+      std::string id((const char*)body + 4, bodyLen - 4);
+      Client& client = clients[id];
+      client.port = fromPort;
+      client.state = State::Active;
+      client.sleepS = 0;
+      connectCount++;
+      send(fromPort, CONNACK, { RC_ACCEPTED });
+      sendBuffered(client);
+      break;
+    }
+
+    case PUBLISH: {
+      if (bodyLen < 5 || (body[0] & 0x03) != FLAG_PREDEFINED) {
+        return;
+      }
+      uint8_t qosBits = body[0] & FLAG_QOS_MASK;
+      int8_t qos = (qosBits == FLAG_QOS_M1) ? -1 : (qosBits == FLAG_QOS_1 ? 1 : 0);
+      uint16_t topicId = be16(body + 1);
+      uint16_t msgId = be16(body + 3);
+      bool connected = c != nullptr && c->state == State::Active;
+
+      if (qos >= 0 && !connected) {
+        if (qos == 1) {
+          send(fromPort, PUBACK, { body[1], body[2], body[3], body[4], RC_NOT_SUPPORTED });
+        }
+        return;
+      }
+      log.push_back(Message{ qos < 0 ? "" : clientId, topicId,
+                             std::string((const char*)body + 5, bodyLen - 5), qos,
+                             (body[0] & FLAG_RETAIN) != 0, (body[0] & FLAG_DUP) != 0 });
+      if (qos == 1) {
+        if (acksToDrop > 0) {
+          acksToDrop--;
+          return;
+        }
+        send(fromPort, PUBACK, { body[1], body[2], (uint8_t)(msgId >> 8), (uint8_t)msgId, RC_ACCEPTED });
+      }
+      break;
+    }
+
+    case PUBACK: {
+      // The device acknowledged a buffered message: drop it
+      if (c == nullptr || bodyLen < 5) {
+        return;
+      }
+      uint16_t msgId = be16(body + 2);
+      for (size_t i = 0; i < c->buffer.size(); i++) {
+        if (c->buffer[i].msgId == msgId) {
+          c->buffer.erase(c->buffer.begin() + i);
+          break;
+        }
+      }
+      break;
+    }
+
+    case SUBSCRIBE: {
+      if (c == nullptr || c->state != State::Active || bodyLen < 5 ||
+          (body[0] & 0x03) != FLAG_PREDEFINED) {
+        return;
+      }
+      uint16_t topicId = be16(body + 3);
+      c->subscriptions[topicId] = true;
+      send(fromPort, SUBACK, { FLAG_QOS_1, body[3], body[4], body[1], body[2], RC_ACCEPTED });
+      break;
+    }
+
+    case PINGREQ: {
+      // A sleeping client wakes to collect its buffer (unknown ones get nothing)
+      std::string id((const char*)body, bodyLen);
+      auto it = clients.find(id);
+      if (it == clients.end() || it->second.state != State::Asleep) {
+        return;
+      }
+      it->second.port = fromPort;
+      sendBuffered(it->second);
+      send(fromPort, PINGRESP, {});
+      break;
+    }
+
+    case DISCONNECT: {
+      if (c == nullptr) {
+        return;
+      }
+      c->sleepS = (bodyLen >= 2) ? be16(body) : 0;
+      c->state = (c->sleepS > 0) ? State::Asleep : State::Disconnected;
+      send(fromPort, DISCONNECT, {});
+      break;
+    }
+
+    default:
+      break;
+  }
+}
+
+// ============================
+// Private
+// ============================
+FakeMqttSnGateway::Client* FakeMqttSnGateway::clientOnPort(uint16_t fromPort, std::string* id) {
+  for (auto& entry : clients) {
+    if (entry.second.port == fromPort) {
+      if (id != nullptr) {
+        *id = entry.first;
+      }
+      return &entry.second;
+    }
+  }
+  return nullptr;
+}
+
+// Everything not yet acknowledged, again with DUP if sent before
+void FakeMqttSnGateway::sendBuffered(Client& c) {
+  for (Pending& p : c.buffer) {
+    uint8_t flags = FLAG_QOS_1 | FLAG_PREDEFINED;
+    if (p.msgId != 0) {
+      flags |= FLAG_DUP;
+    } else {
+      p.msgId = nextMsgId++;
+      if (nextMsgId == 0) {
+        nextMsgId = 1;
+      }
+    }
+    std::vector<uint8_t> body = {
+      flags,
+      (uint8_t)(p.topicId >> 8), (uint8_t)p.topicId,
+      (uint8_t)(p.msgId >> 8), (uint8_t)p.msgId
+    };
+    body.insert(body.end(), p.payload.begin(), p.payload.end());
+    send(c.port, PUBLISH, body);
+  }
+}
+
+void FakeMqttSnGateway::send(uint16_t toPort, MsgType type, const std::vector<uint8_t>& body) {
+  std::vector<uint8_t> packet;
+  size_t total = 2 + body.size();
+  if (total <= 255) {
+    packet.push_back((uint8_t)total);
+  } else {
+    total += 2;
+    packet.push_back(0x01);
+    packet.push_back((uint8_t)(total >> 8));
+    packet.push_back((uint8_t)total);
+  }
+  packet.push_back(type);
+  packet.insert(packet.end(), body.begin(), body.end());
+  Host::udpSend(ip, port, toPort, packet.data(), packet.size(), latencyMs);
+}
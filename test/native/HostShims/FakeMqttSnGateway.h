@@ -0,0 +1,124 @@
+#pragma once
+
+#include "Host.h"
+#include <map>
+#include <string>
+#include <vector>
+
+/**
+ * @class FakeMqttSnGateway
+ * @brief Simulated MQTT-SN v1.2 gateway on the host network (Host::attachUdp).
+ *
+ * Speaks the part of the protocol MqttSnClient uses: predefined topic IDs,
+ * PUBLISH with QoS -1, 0 and 1, SUBSCRIBE, and the sleeping-client
+ * procedure (DISCONNECT with a duration, then PINGREQ to collect what was
+ * buffered). Clients are told apart by their UDP port and keep their
+ * session (subscriptions, buffered messages) until forgetClients(), like a
+ * gateway restart.
+ *
+ * Every PUBLISH from the device is logged; publish() plays the backend on
+ * the broker side of the gateway. Replies take the set latency.
+ */
+class FakeMqttSnGateway : public Host::UdpService {
+public:
+  struct Message {
+    std::string clientId;    // "" for QoS -1 (no connection)
+    uint16_t topicId;
+    std::string payload;
+    int8_t qos;              // -1, 0 or 1
+    bool retained;
+    bool dup;
+  };
+
+  FakeMqttSnGateway(uint32_t ip, uint16_t port);
+  ~FakeMqttSnGateway() override;
+
+  void attach();
+  void detach();
+
+  /**
+   * @brief Reply latency (ms).
+   */
+  void setLatency(uint32_t ms);
+
+  /**
+   * @brief Ignore everything (gateway down).
+   */
+  void setSilent(bool on);
+
+  /**
+   * @brief Leave the next n PUBACKs for the device's QoS 1 PUBLISHes unsent.
+   */
+  void dropAcks(uint32_t n);
+
+  /**
+   * @brief Forget every client session (gateway restart).
+   */
+  void forgetClients();
+
+  /**
+   * @brief Publish as the backend: QoS 1 to every subscribed client, sent
+   *        now if it is awake, otherwise buffered until its next PINGREQ.
+   */
+  void publish(uint16_t topicId, const std::string& payload);
+
+  const std::vector<Message>& messages() const;
+  std::vector<Message> messages(uint16_t topicId) const;
+  void clearLog();
+
+  bool asleep(const std::string& clientId) const;
+  uint16_t sleepDurationS(const std::string& clientId) const;
+  bool subscribed(const std::string& clientId, uint16_t topicId) const;
+  size_t buffered(const std::string& clientId) const;
+
+  uint32_t connects() const;
+  uint32_t datagramsIn() const;
+  uint32_t bytesIn() const;
+
+  void udpReceive(uint16_t fromPort, const uint8_t* data, size_t len) override;
+
+private:
+  enum MsgType : uint8_t {
+    CONNECT    = 0x04,
+    CONNACK    = 0x05,
+    PUBLISH    = 0x0C,
+    PUBACK     = 0x0D,
+    SUBSCRIBE  = 0x12,
+    SUBACK     = 0x13,
+    PINGREQ    = 0x16,
+    PINGRESP   = 0x17,
+    DISCONNECT = 0x18
+  };
+
+  enum class State { Active, Asleep, Disconnected };
+
+  struct Pending {
+    uint16_t topicId;
+    std::string payload;
+    uint16_t msgId = 0;      // 0 until sent
+  };
+
+  struct Client {
+    uint16_t port = 0;
+    State state = State::Disconnected;
+    uint16_t sleepS = 0;
+    std::map<uint16_t, bool> subscriptions;
+    std::vector<Pending> buffer;    // QoS 1 until PUBACKed
+  };
+
+  uint32_t ip;
+  uint16_t port;
+  uint32_t latencyMs = 0;
+  bool silent = false;
+  uint32_t acksToDrop = 0;
+  uint16_t nextMsgId = 1;
+  std::map<std::string, Client> clients;
+  std::vector<Message> log;
+  uint32_t connectCount = 0;
+  uint32_t datagramCount = 0;
+  uint32_t byteCount = 0;
+
+  Client* clientOnPort(uint16_t fromPort, std::string* id = nullptr);
+  void sendBuffered(Client& c);
+  void send(uint16_t toPort, MsgType type, const std::vector<uint8_t>& body);
+};
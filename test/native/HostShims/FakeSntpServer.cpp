@@ -0,0 +1,69 @@
+#include "FakeSntpServer.h"
+#include <string.h>
+
+static const uint32_t NTP_UNIX_OFFSET_S = 2208988800UL;   // 1900-01-01 -> 1970-01-01
+static const size_t NTP_PACKET_SIZE = 48;
+static const uint8_t NTP_MODE_CLIENT = 3;
+static const uint8_t NTP_SERVER_REPLY = 0x24;             // LI 0, version 4, mode 4
+
+FakeSntpServer::FakeSntpServer(uint32_t address) : ip(address) {}
+
+FakeSntpServer::~FakeSntpServer() {
+  detach();
+}
+
+void FakeSntpServer::attach() {
+  Host::attachUdp(ip, PORT, this);
+}
+
+void FakeSntpServer::detach() {
+  Host::attachUdp(ip, PORT, nullptr);
+}
+
+void FakeSntpServer::setErrorMs(int32_t ms) {
+  errorMs = ms;
+}
+
+void FakeSntpServer::setLatency(uint32_t up, uint32_t down) {
+  upMs = up;
+  downMs = down;
+}
+
+void FakeSntpServer::setStratum(uint8_t value) {
+  stratum = value;
+}
+
+void FakeSntpServer::setSilent(bool on) {
+  silent = on;
+}
+
+uint32_t FakeSntpServer::requests() const {
+  return requestCount;
+}
+
+void FakeSntpServer::udpReceive(uint16_t fromPort, const uint8_t* data, size_t len) {
+  if (len < NTP_PACKET_SIZE || (data[0] & 0x07) != NTP_MODE_CLIENT) {
+    return;
+  }
+  requestCount++;
+  if (silent) {
+    return;
+  }
+
+  // Server clock when the request arrives (answered at once)
+  int64_t serverUs = Host::worldTimeUs() + (int64_t)upMs * 1000 + (int64_t)errorMs * 1000;
+  uint32_t secs = (uint32_t)(serverUs / 1000000 + NTP_UNIX_OFFSET_S);
+  uint32_t frac = (uint32_t)(((uint64_t)(serverUs % 1000000) << 32) / 1000000);
+
+  uint8_t reply[NTP_PACKET_SIZE];
+  memset(reply, 0, sizeof(reply));
+  reply[0] = NTP_SERVER_REPLY;
+  reply[1] = stratum;
+  memcpy(reply + 24, data + 40, 8);   // originate = client's transmit timestamp
+  for (int i = 0; i < 4; i++) {
+    reply[32 + i] = reply[40 + i] = (uint8_t)(secs >> (24 - 8 * i));
+    reply[36 + i] = reply[44 + i] = (uint8_t)(frac >> (24 - 8 * i));
+  }
+
+  Host::udpSend(ip, PORT, fromPort, reply, sizeof(reply), upMs + downMs);
+}
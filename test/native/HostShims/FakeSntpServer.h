@@ -0,0 +1,50 @@
+#pragma once
+
+#include "Host.h"
+
+/**
+ * @class FakeSntpServer
+ * @brief Simulated SNTP server on the host network (Host::attachUdp).
+ *
+ * Answers client requests with its clock (Host world time plus a set error)
+ * as the transmit timestamp. The request and the reply each take their own
+ * latency, so an asymmetric path shows up in the client's estimate as it
+ * would on the device. It can also stay silent or answer with a
+ * kiss-o'-death (stratum 0).
+ */
+class FakeSntpServer : public Host::UdpService {
+public:
+  static const uint16_t PORT = 123;
+
+  explicit FakeSntpServer(uint32_t ip);
+  ~FakeSntpServer() override;
+
+  void attach();
+  void detach();
+
+  /**
+   * @brief Error of the server clock (ms, positive = ahead of world time).
+   */
+  void setErrorMs(int32_t ms);
+
+  /**
+   * @brief One-way latencies: request to the server, reply back (ms).
+   */
+  void setLatency(uint32_t upMs, uint32_t downMs);
+
+  void setStratum(uint8_t stratum);
+  void setSilent(bool on);
+
+  uint32_t requests() const;
+
+  void udpReceive(uint16_t fromPort, const uint8_t* data, size_t len) override;
+
+private:
+  uint32_t ip;
+  int32_t errorMs = 0;
+  uint32_t upMs = 0;
+  uint32_t downMs = 0;
+  uint8_t stratum = 2;
+  bool silent = false;
+  uint32_t requestCount = 0;
+};
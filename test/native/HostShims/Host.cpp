@@ -0,0 +1,464 @@
+#include "Host.h"
+#include <Arduino.h>
+#include <atomic>
+#include <stdarg.h>
+#include <sys/time.h>
+#include <driver/rtc_io.h>
+#include <esp_timer.h>
+#include <esp_task_wdt.h>
+
+// ============================
+// Clock
+// ============================
+// World time is the true UTC; system time (gettimeofday) is what the
+// firmware believes, 0 after a power cycle until it is set.
+static const int64_t US_PER_S = 1000000LL;
+static const time_t INITIAL_WORLD_TIME = 1767225600;   // 2026-01-01 00:00:00 UTC
+
+static std::atomic<bool> virtualMode{false};
+static std::atomic<int64_t> wakeMonoUs{0};        // host clock at wake start
+static std::atomic<int64_t> advancedUs{0};        // advance()/delay() this wake
+static std::atomic<int64_t> worldAtWakeUs{INITIAL_WORLD_TIME * US_PER_S};
+static std::atomic<int64_t> systemSkewUs{-INITIAL_WORLD_TIME * US_PER_S};
+static std::atomic<uint32_t> wakeCount{0};
+static std::atomic<esp_reset_reason_t> resetReason{ESP_RST_POWERON};
+
+static int64_t monotonicUs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * US_PER_S + ts.tv_nsec / 1000;
+}
+
+static int64_t wakeUs() {
+  int64_t real = virtualMode.load() ? 0 : monotonicUs() - wakeMonoUs.load();
+  return real + advancedUs.load();
+}
+
+static void clearWakeSources();
+
+static void startWake(int64_t worldUs) {
+  clearWakeSources();
+  worldAtWakeUs.store(worldUs);
+  advancedUs.store(0);
+  wakeMonoUs.store(monotonicUs());
+  wakeCount.fetch_add(1);
+}
+
+__attribute__((constructor)) static void startClock() {
+  wakeMonoUs.store(monotonicUs());
+}
+
+void Host::useVirtualClock(bool on) {
+  if (on == virtualMode.load()) {
+    return;
+  }
+  if (on) {
+    advancedUs.store(wakeUs());
+  } else {
+    wakeMonoUs.store(monotonicUs());
+  }
+  virtualMode.store(on);
+}
+
+bool Host::virtualClock() {
+  return virtualMode.load();
+}
+
+void Host::advance(uint32_t ms) {
+  advancedUs.fetch_add((int64_t)ms * 1000);
+}
+
+void Host::setTime(time_t epoch) {
+  int64_t now = wakeUs();
+  worldAtWakeUs.store((int64_t)epoch * US_PER_S - now);
+  systemSkewUs.store(0);
+}
+
+int64_t Host::worldTimeUs() {
+  return worldAtWakeUs.load() + wakeUs();
+}
+
+time_t Host::worldTime() {
+  return (time_t)(worldTimeUs() / US_PER_S);
+}
+
+uint32_t Host::wakes() {
+  return wakeCount.load();
+}
+
+unsigned long millis() {
+  return (uint32_t)(wakeUs() / 1000);
+}
+
+unsigned long micros() {
+  return (uint32_t)wakeUs();
+}
+
+static void sleepUs(uint64_t us) {
+  if (virtualMode.load()) {
+    advancedUs.fetch_add((int64_t)us);
+    return;
+  }
+  struct timespec ts;
+  ts.tv_sec = (time_t)(us / US_PER_S);
+  ts.tv_nsec = (long)(us % US_PER_S) * 1000;
+  nanosleep(&ts, nullptr);
+}
+
+void delay(uint32_t ms) {
+  sleepUs((uint64_t)ms * 1000);
+}
+
+void delayMicroseconds(uint32_t us) {
+  sleepUs(us);
+}
+
+void yield() {
+  sched_yield();
+}
+
+// The firmware's system time; the host's own clock is never touched
+int gettimeofday(struct timeval* __restrict tv, void* __restrict tz) noexcept {
+  (void)tz;
+  int64_t us = Host::worldTimeUs() + systemSkewUs.load();
+  tv->tv_sec = (time_t)(us / US_PER_S);
+  tv->tv_usec = (suseconds_t)(us % US_PER_S);
+  return 0;
+}
+
+int settimeofday(const struct timeval* tv, const struct timezone* tz) noexcept {
+  (void)tz;
+  if (tv != nullptr) {
+    int64_t us = (int64_t)tv->tv_sec * US_PER_S + tv->tv_usec;
+    systemSkewUs.store(us - Host::worldTimeUs());
+  }
+  return 0;
+}
+
+// ============================
+// RTC memory
+// ============================
+// Section bounds from the linker (absent if nothing is in RTC memory)
+extern "C" {
+extern uint8_t __start_rtc_data[] __attribute__((weak));
+extern uint8_t __stop_rtc_data[] __attribute__((weak));
+}
+
+static uint8_t* rtcInitial = nullptr;
+
+// Before any other constructor can write RTC variables
+__attribute__((constructor(101))) static void snapshotRtc() {
+  size_t size = Host::rtcSize();
+  if (size > 0) {
+    rtcInitial = (uint8_t*)malloc(size);
+    memcpy(rtcInitial, __start_rtc_data, size);
+  }
+}
+
+size_t Host::rtcSize() {
+  if (__start_rtc_data == nullptr || __stop_rtc_data == nullptr) {
+    return 0;
+  }
+  return (size_t)(__stop_rtc_data - __start_rtc_data);
+}
+
+void Host::rtcSave(uint8_t* image) {
+  memcpy(image, __start_rtc_data, rtcSize());
+}
+
+void Host::rtcLoad(const uint8_t* image) {
+  memcpy(__start_rtc_data, image, rtcSize());
+}
+
+// Partitions.cpp: the bootloader picks the boot partition
+void bootSelectedPartition();
+
+void Host::powerCycle() {
+  if (rtcInitial != nullptr) {
+    rtcLoad(rtcInitial);
+  }
+  int64_t world = worldTimeUs();
+  startWake(world);
+  systemSkewUs.store(-world);
+  resetReason.store(ESP_RST_POWERON);
+  bootSelectedPartition();
+}
+
+void Host::reset(esp_reset_reason_t reason) {
+  if (rtcInitial != nullptr) {
+    rtcLoad(rtcInitial);
+  }
+  startWake(worldTimeUs());
+  resetReason.store(reason);
+  bootSelectedPartition();
+}
+
+// ============================
+// Deep sleep
+// ============================
+static Host::WakeSources wakeSources;
+static esp_sleep_wakeup_cause_t wakeCause = ESP_SLEEP_WAKEUP_UNDEFINED;
+static uint64_t wakeExt1Status = 0;
+
+static void clearWakeSources() {
+  wakeSources = Host::WakeSources{0, -1, 0, 0, ESP_EXT1_WAKEUP_ALL_LOW};
+  wakeCause = ESP_SLEEP_WAKEUP_UNDEFINED;
+  wakeExt1Status = 0;
+}
+
+void Host::deepSleep(uint64_t us, esp_sleep_wakeup_cause_t cause, uint64_t ext1Status) {
+  startWake(worldTimeUs() + (int64_t)us);
+  resetReason.store(ESP_RST_DEEPSLEEP);
+  wakeCause = cause;
+  wakeExt1Status = cause == ESP_SLEEP_WAKEUP_EXT1 ? ext1Status : 0;
+}
+
+Host::WakeSources Host::wakeSources() {
+  return ::wakeSources;
+}
+
+esp_sleep_wakeup_cause_t esp_sleep_get_wakeup_cause() {
+  return wakeCause;
+}
+
+uint64_t esp_sleep_get_ext1_wakeup_status() {
+  return wakeExt1Status;
+}
+
+esp_err_t esp_sleep_enable_timer_wakeup(uint64_t time_in_us) {
+  wakeSources.timerUs = time_in_us;
+  return ESP_OK;
+}
+
+esp_err_t esp_sleep_enable_ext0_wakeup(gpio_num_t gpio_num, int level) {
+  wakeSources.ext0Pin = gpio_num;
+  wakeSources.ext0Level = level;
+  return ESP_OK;
+}
+
+esp_err_t esp_sleep_enable_ext1_wakeup(uint64_t mask, esp_sleep_ext1_wakeup_mode_t mode) {
+  wakeSources.ext1Mask = mask;
+  wakeSources.ext1Mode = mode;
+  return ESP_OK;
+}
+
+esp_err_t esp_sleep_pd_config(esp_sleep_pd_domain_t domain, esp_sleep_pd_option_t option) {
+  (void)domain;
+  (void)option;
+  return ESP_OK;
+}
+
+void esp_deep_sleep_start() {
+  throw Host::DeepSleep();
+}
+
+// ============================
+// Timers / task watchdog
+// ============================
+// Armed, never fired: a test that wants the expiry calls the callback
+struct esp_timer {
+  esp_timer_create_args_t args;
+  bool armed;
+};
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t* create_args, esp_timer_handle_t* out_handle) {
+  if (create_args == nullptr || out_handle == nullptr) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  *out_handle = new esp_timer{*create_args, false};
+  return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us) {
+  (void)timeout_us;
+  if (timer == nullptr) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  timer->armed = true;
+  return ESP_OK;
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period_us) {
+  return esp_timer_start_once(timer, period_us);
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer) {
+  if (timer == nullptr || !timer->armed) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  timer->armed = false;
+  return ESP_OK;
+}
+
+int64_t esp_timer_get_time() {
+  return wakeUs();
+}
+
+esp_err_t esp_task_wdt_init(uint32_t timeout_s, bool panic) {
+  (void)timeout_s;
+  (void)panic;
+  return ESP_OK;
+}
+
+esp_err_t esp_task_wdt_add(void* task_handle) {
+  (void)task_handle;
+  return ESP_OK;
+}
+
+esp_err_t esp_task_wdt_delete(void* task_handle) {
+  (void)task_handle;
+  return ESP_OK;
+}
+
+// RTC IOs of the ESP32: 0, 2, 4, 12-15, 25-27, 32-39
+bool rtc_gpio_is_valid_gpio(gpio_num_t gpio_num) {
+  return gpio_num == 0 || gpio_num == 2 || gpio_num == 4 ||
+         (gpio_num >= 12 && gpio_num <= 15) || (gpio_num >= 25 && gpio_num <= 27) ||
+         (gpio_num >= 32 && gpio_num <= 39);
+}
+
+esp_err_t rtc_gpio_pullup_en(gpio_num_t gpio_num) {
+  (void)gpio_num;
+  return ESP_OK;
+}
+
+esp_err_t rtc_gpio_pullup_dis(gpio_num_t gpio_num) {
+  (void)gpio_num;
+  return ESP_OK;
+}
+
+esp_err_t rtc_gpio_pulldown_en(gpio_num_t gpio_num) {
+  (void)gpio_num;
+  return ESP_OK;
+}
+
+esp_err_t rtc_gpio_pulldown_dis(gpio_num_t gpio_num) {
+  (void)gpio_num;
+  return ESP_OK;
+}
+
+// ============================
+// GPIO
+// ============================
+static const uint8_t PIN_COUNT = 40;
+static uint8_t pinInput[PIN_COUNT];
+static uint8_t pinWritten[PIN_COUNT];
+static Host::PinReadHook pinReadHook = nullptr;
+static Host::PinWriteHook pinWriteHook = nullptr;
+
+void Host::setPin(uint8_t pin, int level) {
+  if (pin < PIN_COUNT) {
+    pinInput[pin] = level ? HIGH : LOW;
+  }
+}
+
+int Host::pinOutput(uint8_t pin) {
+  return pin < PIN_COUNT ? pinWritten[pin] : LOW;
+}
+
+void Host::setPinHooks(PinReadHook read, PinWriteHook write) {
+  pinReadHook = read;
+  pinWriteHook = write;
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+  (void)pin;
+  (void)mode;
+}
+
+void digitalWrite(uint8_t pin, uint8_t value) {
+  if (pin < PIN_COUNT) {
+    pinWritten[pin] = value ? HIGH : LOW;
+  }
+  if (pinWriteHook != nullptr) {
+    pinWriteHook(pin, value);
+  }
+}
+
+int digitalRead(uint8_t pin) {
+  if (pinReadHook != nullptr) {
+    int level = pinReadHook(pin);
+    if (level >= 0) {
+      return level;
+    }
+  }
+  return pin < PIN_COUNT ? pinInput[pin] : LOW;
+}
+
+// ============================
+// Serial / ESP
+// ============================
+static std::atomic<bool> serialQuiet{false};
+static uint64_t efuseMac = 0x0000A4CF12345678ULL;
+
+HardwareSerial Serial;
+EspClass ESP;
+
+void Host::quiet(bool on) {
+  serialQuiet.store(on);
+}
+
+void Host::setMac(uint64_t mac) {
+  efuseMac = mac;
+}
+
+uint64_t Host::mac() {
+  return efuseMac;
+}
+
+size_t HardwareSerial::write(uint8_t b) {
+  return write(&b, 1);
+}
+
+size_t HardwareSerial::write(const uint8_t* buf, size_t size) {
+  if (!serialQuiet.load()) {
+    fwrite(buf, 1, size, stdout);
+  }
+  return size;
+}
+
+void HardwareSerial::flush() {
+  fflush(stdout);
+}
+
+size_t Print::printf(const char* format, ...) {
+  char small[256];
+  va_list args;
+  va_start(args, format);
+  int len = vsnprintf(small, sizeof(small), format, args);
+  va_end(args);
+  if (len < 0) {
+    return 0;
+  }
+  if ((size_t)len < sizeof(small)) {
+    return write((const uint8_t*)small, (size_t)len);
+  }
+
+  char* big = (char*)malloc((size_t)len + 1);
+  va_start(args, format);
+  vsnprintf(big, (size_t)len + 1, format, args);
+  va_end(args);
+  size_t n = write((const uint8_t*)big, (size_t)len);
+  free(big);
+  return n;
+}
+
+uint64_t EspClass::getEfuseMac() {
+  return efuseMac;
+}
+
+uint32_t EspClass::getCycleCount() {
+  return (uint32_t)(micros() * 240);   // 240 MHz
+}
+
+void EspClass::restart() {
+  esp_restart();
+}
+
+void esp_restart() {
+  throw Host::Restart();
+}
+
+esp_reset_reason_t esp_reset_reason() {
+  return resetReason.load();
+}
@@ -0,0 +1,260 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <time.h>
+#include "esp_system.h"
+#include "esp_sleep.h"
+
+/**
+ * @class Host
+ * @brief The simulated device behind the host shims (env:native tests).
+ *
+ * Clock: millis() counts from the start of the current wake. In real mode
+ * it follows the host's monotonic clock (network tests, where timeouts must
+ * elapse); in virtual mode it only moves with advance() and delay(), so a
+ * test controls time exactly. System time (gettimeofday) and world time (the
+ * true UTC that external clocks such as the DS3231 follow) move with it.
+ *
+ * RTC memory: RTC_DATA_ATTR variables live in one section. deepSleep()
+ * keeps it, powerCycle() puts back the values the image started with, and
+ * rtcSave()/rtcLoad() swap it so one process can run many virtual nodes.
+ * NVS (Preferences) is flash: kept by both until nvsErase(). The radio is
+ * off after either, so WiFi.begin() is needed again on every wake.
+ *
+ * Deep sleep: esp_deep_sleep_start() throws DeepSleep. The wake sources
+ * armed before it stay readable with wakeSources() until the test wakes the
+ * device with deepSleep(), giving the cause the next wake sees.
+ *
+ * Only what the lib/ modules use is simulated; test code drives the rest.
+ */
+class Host {
+public:
+  /**
+   * @brief Thrown by esp_restart()/ESP.restart() (never returns on the device).
+   */
+  struct Restart {};
+
+  /**
+   * @brief Thrown by esp_deep_sleep_start() (never returns on the device).
+   */
+  struct DeepSleep {};
+
+  // ============================
+  // Clock
+  // ============================
+  static void useVirtualClock(bool on);
+  static bool virtualClock();
+
+  /**
+   * @brief Move time forward (millis(), system and world time).
+   */
+  static void advance(uint32_t ms);
+
+  /**
+   * @brief Set world and system time (UTC).
+   */
+  static void setTime(time_t epoch);
+
+  static int64_t worldTimeUs();
+  static time_t worldTime();
+
+  /**
+   * @brief Sleep: time moves on by us, millis() starts again at 0 and RTC
+   *        memory is kept. The wake reports cause (and ext1Status for
+   *        ESP_SLEEP_WAKEUP_EXT1) to esp_sleep_get_wakeup_cause().
+   */
+  static void deepSleep(uint64_t us, esp_sleep_wakeup_cause_t cause = ESP_SLEEP_WAKEUP_TIMER,
+                        uint64_t ext1Status = 0);
+
+  /**
+   * @brief Wake sources armed with esp_sleep_enable_*() during this wake.
+   */
+  struct WakeSources {
+    uint64_t timerUs;                        // 0: not armed
+    int ext0Pin;                             // -1: not armed
+    int ext0Level;
+    uint64_t ext1Mask;                       // 0: not armed
+    esp_sleep_ext1_wakeup_mode_t ext1Mode;
+  };
+  static WakeSources wakeSources();
+
+  /**
+   * @brief Power loss and reset: RTC memory back to its initial values,
+   *        millis() starts again at 0, system time is lost (0).
+   */
+  static void powerCycle();
+
+  /**
+   * @brief Reset without power loss (after esp_restart(), a panic or a
+   *        watchdog): RTC memory back to its initial values, millis() starts
+   *        again at 0, system time is kept. The bootloader starts the boot
+   *        partition, as it does after powerCycle().
+   */
+  static void reset(esp_reset_reason_t reason = ESP_RST_SW);
+
+  /**
+   * @brief Wakes started so far (deepSleep() and powerCycle() each start one).
+   */
+  static uint32_t wakes();
+
+  // ============================
+  // RTC memory
+  // ============================
+  static size_t rtcSize();
+  static void rtcSave(uint8_t* image);
+  static void rtcLoad(const uint8_t* image);
+
+  // ============================
+  // NVS (Preferences)
+  // ============================
+  /**
+   * @brief Erase the partition (factory state).
+   */
+  static void nvsErase();
+
+  /**
+   * @brief Make writes fail, as on a full or worn partition.
+   */
+  static void nvsFailWrites(bool on);
+
+  /**
+   * @brief Preferences::begin() calls since the last erase.
+   */
+  static uint32_t nvsOpens();
+
+  // ============================
+  // Flash (OTA app partitions)
+  // ============================
+  /**
+   * @brief Factory state: the power-on image in app0, which boots; app1
+   *        erased. Read the slots with esp_partition_read().
+   */
+  static void flashReset();
+
+  /**
+   * @brief Label of the partition the device runs from.
+   */
+  static const char* runningPartition();
+
+  // ============================
+  // I2C (Wire)
+  // ============================
+  /**
+   * @brief A simulated slave on the Wire bus.
+   */
+  class I2CDevice {
+  public:
+    virtual ~I2CDevice() = default;
+
+    /**
+     * @brief A write transaction (register pointer, then data).
+     *
+     * @return false to NACK
+     */
+    virtual bool i2cWrite(const uint8_t* data, size_t len) = 0;
+
+    /**
+     * @brief A read transaction.
+     *
+     * @return Bytes supplied
+     */
+    virtual size_t i2cRead(uint8_t* data, size_t len) = 0;
+  };
+
+  /**
+   * @brief Put a device at a 7-bit address (nullptr removes it).
+   */
+  static void attachI2C(uint8_t addr, I2CDevice* device);
+
+  /**
+   * @brief Fail the next n endTransmission()/requestFrom() calls with a
+   *        Wire error code (2/3 NACK, 4 bus error, 5 timeout).
+   */
+  static void failI2C(uint8_t error, uint32_t n);
+
+  /**
+   * @brief Clock set with Wire.begin()/setClock() (0 while stopped).
+   */
+  static uint32_t i2cClock();
+
+  // ============================
+  // Network (WiFi, UDP, TCP)
+  // ============================
+  /**
+   * @brief A simulated UDP server on the network (SNTP, MQTT-SN gateway).
+   */
+  class UdpService {
+  public:
+    virtual ~UdpService() = default;
+
+    /**
+     * @brief A datagram from the device (reply with udpSend()).
+     */
+    virtual void udpReceive(uint16_t fromPort, const uint8_t* data, size_t len) = 0;
+  };
+
+  /**
+   * @brief The access point: in range or not, time WiFi.begin() takes to
+   *        associate, and the RSSI reported once connected.
+   */
+  static void setWifi(bool inRange, uint32_t associateMs = 0, int8_t rssi = -60);
+
+  /**
+   * @brief A name for WiFi.hostByName() (dotted quads need none).
+   */
+  static void addHost(const char* name, uint32_t ip);
+
+  /**
+   * @brief Put a service at ip:port (nullptr removes it).
+   */
+  static void attachUdp(uint32_t ip, uint16_t port, UdpService* service);
+
+  /**
+   * @brief Queue a datagram for the device's port, delivered after delayMs.
+   */
+  static void udpSend(uint32_t fromIp, uint16_t fromPort, uint16_t toPort,
+                      const uint8_t* data, size_t len, uint32_t delayMs);
+
+  /**
+   * @brief Lose the next n datagrams the device sends.
+   */
+  static void dropUdp(uint32_t n);
+
+  /**
+   * @brief Put a TCP server at ip:port, served by a host socket listening on
+   *        127.0.0.1:loopbackPort (0 removes it). WiFiClient reaches
+   *        127.0.0.1 itself without one.
+   */
+  static void attachTcp(uint32_t ip, uint16_t port, uint16_t loopbackPort);
+
+  // ============================
+  // GPIO / Serial / chip
+  // ============================
+  typedef int (*PinReadHook)(uint8_t pin);
+  typedef void (*PinWriteHook)(uint8_t pin, uint8_t value);
+
+  /**
+   * @brief Level seen by digitalRead() on an input pin.
+   */
+  static void setPin(uint8_t pin, int level);
+
+  /**
+   * @brief Last level written with digitalWrite().
+   */
+  static int pinOutput(uint8_t pin);
+
+  /**
+   * @brief Route GPIO through a simulated peripheral (nullptr to remove);
+   *        the read hook returns -1 for pins it does not drive.
+   */
+  static void setPinHooks(PinReadHook read, PinWriteHook write);
+
+  /**
+   * @brief Drop Serial output (fleet runs).
+   */
+  static void quiet(bool on);
+
+  static void setMac(uint64_t mac);
+  static uint64_t mac();
+};
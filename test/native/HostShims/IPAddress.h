@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include "WString.h"
+
+/**
+ * @class IPAddress
+ * @brief IPv4 address as in the ESP32 core: the first octet in the low byte
+ *        of the uint32_t (network order in memory).
+ */
+class IPAddress {
+public:
+  IPAddress() : addr(0) {}
+  IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d)
+    : addr((uint32_t)a | ((uint32_t)b << 8) | ((uint32_t)c << 16) | ((uint32_t)d << 24)) {}
+  IPAddress(uint32_t address) : addr(address) {}
+
+  operator uint32_t() const { return addr; }
+  uint8_t operator[](int index) const { return (uint8_t)(addr >> (8 * index)); }
+  bool operator==(const IPAddress& other) const { return addr == other.addr; }
+  bool operator!=(const IPAddress& other) const { return addr != other.addr; }
+
+  bool fromString(const char* s) {
+    unsigned a, b, c, d;
+    char end;
+    if (s == nullptr || sscanf(s, "%u.%u.%u.%u%c", &a, &b, &c, &d, &end) != 4 ||
+        a > 255 || b > 255 || c > 255 || d > 255) {
+      return false;
+    }
+    *this = IPAddress((uint8_t)a, (uint8_t)b, (uint8_t)c, (uint8_t)d);
+    return true;
+  }
+
+  String toString() const {
+    char buf[16];
+    snprintf(buf, sizeof(buf), "%u.%u.%u.%u", (*this)[0], (*this)[1], (*this)[2], (*this)[3]);
+    return String(buf);
+  }
+
+private:
+  uint32_t addr;
+};
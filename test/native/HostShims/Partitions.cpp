@@ -0,0 +1,176 @@
+#include "Host.h"
+#include <Arduino.h>
+#include <esp_ota_ops.h>
+#include <vector>
+
+// ============================
+// Simulated flash
+// ============================
+// The app slots of the default Arduino partition table (default.csv)
+static const uint32_t SECTOR_SIZE = 4096;
+static const uint8_t IMAGE_MAGIC = 0xE9;
+
+static const esp_partition_t appSlots[] = {
+  { nullptr, ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_APP_OTA_0, 0x10000, 0x140000, "app0", false },
+  { nullptr, ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_APP_OTA_1, 0x150000, 0x140000, "app1", false },
+};
+static const size_t SLOT_COUNT = sizeof(appSlots) / sizeof(appSlots[0]);
+
+static std::vector<uint8_t> contents[SLOT_COUNT];   // allocated (erased) on first use
+static size_t runningSlot = 0;
+static size_t bootSlot = 0;
+
+static int slotOf(const esp_partition_t* partition) {
+  for (size_t i = 0; i < SLOT_COUNT; i++) {
+    if (partition == &appSlots[i]) {
+      return (int)i;
+    }
+  }
+  return -1;
+}
+
+static std::vector<uint8_t>& flash(size_t slot) {
+  if (contents[slot].empty()) {
+    contents[slot].assign(appSlots[slot].size, 0xFF);
+    // app0 holds the image that runs at power-on (only its header byte)
+    if (slot == 0) {
+      contents[slot][0] = IMAGE_MAGIC;
+    }
+  }
+  return contents[slot];
+}
+
+// ============================
+// Host
+// ============================
+void bootSelectedPartition() {
+  runningSlot = bootSlot;
+}
+
+void Host::flashReset() {
+  for (size_t i = 0; i < SLOT_COUNT; i++) {
+    contents[i].clear();
+  }
+  runningSlot = 0;
+  bootSlot = 0;
+}
+
+const char* Host::runningPartition() {
+  return appSlots[runningSlot].label;
+}
+
+// ============================
+// esp_partition.h
+// ============================
+struct esp_partition_iterator_opaque_ {
+  size_t next;                       // slot to look at after the current one
+  const esp_partition_t* current;
+  esp_partition_type_t type;
+  esp_partition_subtype_t subtype;
+  const char* label;
+};
+
+static bool advanceIterator(esp_partition_iterator_t it) {
+  while (it->next < SLOT_COUNT) {
+    const esp_partition_t* p = &appSlots[it->next++];
+    if (p->type == it->type &&
+        (it->subtype == ESP_PARTITION_SUBTYPE_ANY || p->subtype == it->subtype) &&
+        (it->label == nullptr || strcmp(p->label, it->label) == 0)) {
+      it->current = p;
+      return true;
+    }
+  }
+  return false;
+}
+
+esp_partition_iterator_t esp_partition_find(esp_partition_type_t type, esp_partition_subtype_t subtype,
+                                            const char* label) {
+  esp_partition_iterator_t it = new esp_partition_iterator_opaque_{ 0, nullptr, type, subtype, label };
+  return esp_partition_next(it);
+}
+
+const esp_partition_t* esp_partition_get(esp_partition_iterator_t iterator) {
+  return iterator != nullptr ? iterator->current : nullptr;
+}
+
+esp_partition_iterator_t esp_partition_next(esp_partition_iterator_t iterator) {
+  if (!advanceIterator(iterator)) {
+    delete iterator;
+    return nullptr;
+  }
+  return iterator;
+}
+
+void esp_partition_iterator_release(esp_partition_iterator_t iterator) {
+  delete iterator;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t* partition, size_t offset, size_t size) {
+  int slot = slotOf(partition);
+  if (slot < 0 || offset % SECTOR_SIZE != 0 || size % SECTOR_SIZE != 0) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  if (offset + size > partition->size) {
+    return ESP_ERR_INVALID_SIZE;
+  }
+  memset(flash(slot).data() + offset, 0xFF, size);
+  return ESP_OK;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t* partition, size_t offset, const void* src, size_t size) {
+  int slot = slotOf(partition);
+  if (slot < 0 || src == nullptr) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  if (offset + size > partition->size) {
+    return ESP_ERR_INVALID_SIZE;
+  }
+  uint8_t* dst = flash(slot).data() + offset;
+  const uint8_t* bytes = static_cast<const uint8_t*>(src);
+  for (size_t i = 0; i < size; i++) {
+    dst[i] &= bytes[i];
+  }
+  return ESP_OK;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t* partition, size_t offset, void* dst, size_t size) {
+  int slot = slotOf(partition);
+  if (slot < 0 || dst == nullptr) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  if (offset + size > partition->size) {
+    return ESP_ERR_INVALID_SIZE;
+  }
+  memcpy(dst, flash(slot).data() + offset, size);
+  return ESP_OK;
+}
+
+// ============================
+// esp_ota_ops.h
+// ============================
+const esp_partition_t* esp_ota_get_next_update_partition(const esp_partition_t* start) {
+  if (start != nullptr) {
+    return nullptr;
+  }
+  return &appSlots[(runningSlot + 1) % SLOT_COUNT];
+}
+
+const esp_partition_t* esp_ota_get_running_partition() {
+  return &appSlots[runningSlot];
+}
+
+const esp_partition_t* esp_ota_get_boot_partition() {
+  return &appSlots[bootSlot];
+}
+
+esp_err_t esp_ota_set_boot_partition(const esp_partition_t* partition) {
+  int slot = slotOf(partition);
+  if (slot < 0) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  if (flash(slot)[0] != IMAGE_MAGIC) {
+    return ESP_ERR_OTA_VALIDATE_FAILED;
+  }
+  bootSlot = (size_t)slot;
+  return ESP_OK;
+}
@@ -0,0 +1,175 @@
+#include "Preferences.h"
+#include "Host.h"
+#include <string.h>
+#include <map>
+#include <string>
+#include <vector>
+
+// ============================
+// Simulated partition
+// ============================
+// NVS limits names to 15 characters; entries keep their type
+static const size_t NAME_MAX = 15;
+
+enum : uint8_t {
+  TYPE_U8 = 1,
+  TYPE_U16,
+  TYPE_U32,
+  TYPE_BLOB
+};
+
+struct Entry {
+  uint8_t type;
+  std::vector<uint8_t> data;
+};
+
+typedef std::map<std::string, Entry> Namespace;
+
+static std::map<std::string, Namespace> partition;
+static bool failWrites = false;
+static uint32_t opens = 0;
+
+void Host::nvsErase() {
+  partition.clear();
+  failWrites = false;
+  opens = 0;
+}
+
+void Host::nvsFailWrites(bool on) {
+  failWrites = on;
+}
+
+uint32_t Host::nvsOpens() {
+  return opens;
+}
+
+static bool validName(const char* name) {
+  return name != nullptr && name[0] != '\0' && strlen(name) <= NAME_MAX;
+}
+
+// ============================
+// Preferences
+// ============================
+Preferences::~Preferences() {
+  end();
+}
+
+bool Preferences::begin(const char* name, bool ro, const char* partitionLabel) {
+  (void)partitionLabel;
+  if (started || !validName(name)) {
+    return false;
+  }
+  // Opening a namespace read-only that was never written fails, as in NVS
+  if (ro && partition.find(name) == partition.end()) {
+    return false;
+  }
+  partition[name];
+  strncpy(ns, name, sizeof(ns) - 1);
+  readOnly = ro;
+  started = true;
+  opens++;
+  return true;
+}
+
+void Preferences::end() {
+  started = false;
+}
+
+bool Preferences::clear() {
+  if (!started || readOnly || failWrites) {
+    return false;
+  }
+  partition[ns].clear();
+  return true;
+}
+
+bool Preferences::remove(const char* key) {
+  if (!started || readOnly || failWrites || !validName(key)) {
+    return false;
+  }
+  return partition[ns].erase(key) > 0;
+}
+
+bool Preferences::isKey(const char* key) {
+  if (!started || !validName(key)) {
+    return false;
+  }
+  const Namespace& n = partition[ns];
+  return n.find(key) != n.end();
+}
+
+size_t Preferences::put(const char* key, uint8_t type, const void* value, size_t len) {
+  if (!started || readOnly || failWrites || !validName(key)) {
+    return 0;
+  }
+  Entry& e = partition[ns][key];
+  e.type = type;
+  e.data.assign((const uint8_t*)value, (const uint8_t*)value + len);
+  return len;
+}
+
+bool Preferences::get(const char* key, uint8_t type, void* out, size_t len) {
+  if (!started || !validName(key)) {
+    return false;
+  }
+  const Namespace& n = partition[ns];
+  auto it = n.find(key);
+  if (it == n.end() || it->second.type != type || it->second.data.size() != len) {
+    return false;
+  }
+  memcpy(out, it->second.data.data(), len);
+  return true;
+}
+
+size_t Preferences::putUChar(const char* key, uint8_t value) {
+  return put(key, TYPE_U8, &value, sizeof(value));
+}
+
+size_t Preferences::putUShort(const char* key, uint16_t value) {
+  return put(key, TYPE_U16, &value, sizeof(value));
+}
+
+size_t Preferences::putUInt(const char* key, uint32_t value) {
+  return put(key, TYPE_U32, &value, sizeof(value));
+}
+
+size_t Preferences::putBytes(const char* key, const void* value, size_t len) {
+  if (value == nullptr || len == 0) {
+    return 0;
+  }
+  return put(key, TYPE_BLOB, value, len);
+}
+
+uint8_t Preferences::getUChar(const char* key, uint8_t defaultValue) {
+  uint8_t v = defaultValue;
+  return get(key, TYPE_U8, &v, sizeof(v)) ? v : defaultValue;
+}
+
+uint16_t Preferences::getUShort(const char* key, uint16_t defaultValue) {
+  uint16_t v = defaultValue;
+  return get(key, TYPE_U16, &v, sizeof(v)) ? v : defaultValue;
+}
+
+uint32_t Preferences::getUInt(const char* key, uint32_t defaultValue) {
+  uint32_t v = defaultValue;
+  return get(key, TYPE_U32, &v, sizeof(v)) ? v : defaultValue;
+}
+
+size_t Preferences::getBytesLength(const char* key) {
+  if (!started || !validName(key)) {
+    return 0;
+  }
+  const Namespace& n = partition[ns];
+  auto it = n.find(key);
+  return (it != n.end() && it->second.type == TYPE_BLOB) ? it->second.data.size() : 0;
+}
+
+size_t Preferences::getBytes(const char* key, void* buf, size_t maxLen) {
+  size_t len = getBytesLength(key);
+  // A buffer shorter than the blob is an error, not a partial read
+  if (len == 0 || buf == nullptr || len > maxLen) {
+    return 0;
+  }
+  memcpy(buf, partition[ns][key].data.data(), len);
+  return len;
+}
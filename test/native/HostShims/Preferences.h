@@ -0,0 +1,40 @@
+#pragma once
+
+// Host stand-in for the Arduino-ESP32 Preferences library over the simulated
+// NVS partition in Host.h (kept across deep sleep and power cycles).
+// Values are typed as in NVS: reading a key as another type gives the default.
+
+#include <stdint.h>
+#include <stddef.h>
+
+class Preferences {
+public:
+  Preferences() = default;
+  ~Preferences();
+
+  bool begin(const char* name, bool readOnly = false, const char* partitionLabel = nullptr);
+  void end();
+
+  bool clear();
+  bool remove(const char* key);
+  bool isKey(const char* key);
+
+  size_t putUChar(const char* key, uint8_t value);
+  size_t putUShort(const char* key, uint16_t value);
+  size_t putUInt(const char* key, uint32_t value);
+  size_t putBytes(const char* key, const void* value, size_t len);
+
+  uint8_t getUChar(const char* key, uint8_t defaultValue = 0);
+  uint16_t getUShort(const char* key, uint16_t defaultValue = 0);
+  uint32_t getUInt(const char* key, uint32_t defaultValue = 0);
+  size_t getBytesLength(const char* key);
+  size_t getBytes(const char* key, void* buf, size_t maxLen);
+
+private:
+  char ns[16] = "";
+  bool started = false;
+  bool readOnly = false;
+
+  size_t put(const char* key, uint8_t type, const void* value, size_t len);
+  bool get(const char* key, uint8_t type, void* out, size_t len);
+};
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "Print.h"
+
+/**
+ * @class Stream
+ * @brief Arduino Stream: a Print that can also be read.
+ */
+class Stream : public Print {
+public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+
+  void setTimeout(unsigned long ms) { timeoutMs = ms; }
+
+protected:
+  unsigned long timeoutMs = 1000;
+};
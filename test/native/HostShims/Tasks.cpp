@@ -0,0 +1,54 @@
+#include <Arduino.h>
+#include <freertos/task.h>
+#include <pthread.h>
+
+// A task is a detached pthread; the handle identifies it
+struct HostTask {
+  TaskFunction_t code;
+  void* param;
+};
+
+static thread_local HostTask* currentTask = nullptr;
+static HostTask mainTask = { nullptr, nullptr };
+
+static void* taskMain(void* arg) {
+  currentTask = static_cast<HostTask*>(arg);
+  currentTask->code(currentTask->param);
+  return nullptr;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t code, const char* name, uint32_t stackDepth,
+                                   void* param, UBaseType_t priority, TaskHandle_t* created,
+                                   BaseType_t core) {
+  (void)name;
+  (void)stackDepth;
+  (void)priority;
+  (void)core;
+
+  // Never freed: a handle stays unique while a test may still compare it
+  HostTask* task = new HostTask{ code, param };
+  pthread_t thread;
+  if (pthread_create(&thread, nullptr, taskMain, task) != 0) {
+    delete task;
+    return pdFAIL;
+  }
+  pthread_detach(thread);
+  if (created != nullptr) {
+    *created = task;
+  }
+  return pdPASS;
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle() {
+  return currentTask != nullptr ? currentTask : &mainTask;
+}
+
+void vTaskDelay(TickType_t ticks) {
+  delay(ticks * portTICK_PERIOD_MS);
+}
+
+void vTaskDelete(TaskHandle_t task) {
+  if (task == nullptr || task == currentTask) {
+    pthread_exit(nullptr);
+  }
+}
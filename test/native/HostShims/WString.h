@@ -0,0 +1,25 @@
+#pragma once
+
+#include <string>
+
+/**
+ * @class String
+ * @brief Arduino String over std::string (only what lib/ uses).
+ */
+class String {
+public:
+  String(const char* s = "") : str(s ? s : "") {}
+  String(const std::string& s) : str(s) {}
+
+  String& operator+=(const char* s) { str += s ? s : ""; return *this; }
+  String& operator+=(const String& s) { str += s.str; return *this; }
+  String& operator+=(char c) { str += c; return *this; }
+  bool operator==(const char* s) const { return str == (s ? s : ""); }
+  bool operator==(const String& s) const { return str == s.str; }
+
+  const char* c_str() const { return str.c_str(); }
+  unsigned int length() const { return (unsigned int)str.size(); }
+
+private:
+  std::string str;
+};
@@ -0,0 +1,252 @@
+#include "WiFi.h"
+#include "Host.h"
+#include <atomic>
+#include <deque>
+#include <map>
+#include <string>
+
+// ============================
+// Simulated network
+// ============================
+static const IPAddress LOCAL_IP(192, 168, 1, 50);
+static const uint16_t EPHEMERAL_PORT_BASE = 49152;
+
+struct Datagram {
+  uint32_t fromIp;
+  uint16_t fromPort;
+  uint16_t toPort;
+  int64_t dueUs;           // world time of arrival
+  std::vector<uint8_t> data;
+};
+
+// The access point and the association are read from any task (Pipeline)
+static std::atomic<bool> apInRange{true};
+static std::atomic<uint32_t> associateMs{0};
+static std::atomic<int8_t> apRssi{-60};
+
+static std::map<std::string, uint32_t> hosts;
+static std::map<uint64_t, Host::UdpService*> services;
+static std::deque<Datagram> inbound;
+static uint32_t dropsLeft = 0;
+static uint16_t nextEphemeral = EPHEMERAL_PORT_BASE;
+
+static uint64_t endpoint(uint32_t ip, uint16_t port) {
+  return ((uint64_t)ip << 16) | port;
+}
+
+WiFiClass WiFi;
+
+void Host::setWifi(bool inRange, uint32_t associateTimeMs, int8_t rssi) {
+  apInRange = inRange;
+  associateMs = associateTimeMs;
+  apRssi = rssi;
+}
+
+void Host::addHost(const char* name, uint32_t ip) {
+  hosts[name] = ip;
+}
+
+void Host::attachUdp(uint32_t ip, uint16_t port, UdpService* service) {
+  if (service != nullptr) {
+    services[endpoint(ip, port)] = service;
+  } else {
+    services.erase(endpoint(ip, port));
+  }
+}
+
+void Host::udpSend(uint32_t fromIp, uint16_t fromPort, uint16_t toPort,
+                   const uint8_t* data, size_t len, uint32_t delayMs) {
+  Datagram d;
+  d.fromIp = fromIp;
+  d.fromPort = fromPort;
+  d.toPort = toPort;
+  d.dueUs = Host::worldTimeUs() + (int64_t)delayMs * 1000;
+  d.data.assign(data, data + len);
+  inbound.push_back(d);
+}
+
+void Host::dropUdp(uint32_t n) {
+  dropsLeft = n;
+}
+
+// ============================
+// WiFiClass
+// ============================
+// The radio is off after deep sleep or a reset: begin() is per wake
+static std::atomic<bool> begun{false};
+static std::atomic<uint32_t> begunWake{0};
+static std::atomic<uint32_t> associateStart{0};
+static std::atomic<bool> wasConnected{false};
+
+static bool begunThisWake() {
+  return begun && begunWake == Host::wakes();
+}
+
+bool WiFiClass::mode(wifi_mode_t m) {
+  if (m == WIFI_OFF) {
+    begun = false;
+  }
+  return true;
+}
+
+wl_status_t WiFiClass::begin(const char* ssid, const char* passphrase) {
+  (void)ssid;
+  (void)passphrase;
+  begun = true;
+  begunWake = Host::wakes();
+  associateStart = millis();
+  wasConnected = false;
+  return status();
+}
+
+bool WiFiClass::reconnect() {
+  if (!begunThisWake()) {
+    return false;
+  }
+  associateStart = millis();
+  wasConnected = false;
+  return true;
+}
+
+bool WiFiClass::disconnect(bool wifiOff) {
+  (void)wifiOff;
+  begun = false;
+  return true;
+}
+
+wl_status_t WiFiClass::status() {
+  if (!begunThisWake()) {
+    return WL_IDLE_STATUS;
+  }
+  if (!apInRange) {
+    return wasConnected ? WL_CONNECTION_LOST : WL_NO_SSID_AVAIL;
+  }
+  if (millis() - associateStart < associateMs) {
+    return WL_DISCONNECTED;
+  }
+  wasConnected = true;
+  return WL_CONNECTED;
+}
+
+bool WiFiClass::setSleep(bool enabled) {
+  (void)enabled;
+  return true;
+}
+
+int8_t WiFiClass::RSSI() {
+  return status() == WL_CONNECTED ? apRssi.load() : 0;
+}
+
+IPAddress WiFiClass::localIP() {
+  return status() == WL_CONNECTED ? LOCAL_IP : IPAddress();
+}
+
+int WiFiClass::hostByName(const char* host, IPAddress& result) {
+  if (host == nullptr || status() != WL_CONNECTED) {
+    return 0;
+  }
+  if (result.fromString(host)) {
+    return 1;
+  }
+  auto it = hosts.find(host);
+  if (it == hosts.end()) {
+    return 0;
+  }
+  result = IPAddress(it->second);
+  return 1;
+}
+
+// ============================
+// WiFiUDP
+// ============================
+uint8_t WiFiUDP::begin(uint16_t port) {
+  localPort = port;
+  return 1;
+}
+
+void WiFiUDP::stop() {
+  localPort = 0;
+  txOpen = false;
+  rx.clear();
+  rxPos = 0;
+}
+
+int WiFiUDP::beginPacket(IPAddress ip, uint16_t port) {
+  if (localPort == 0) {
+    localPort = nextEphemeral++;
+  }
+  txIp = ip;
+  txPort = port;
+  tx.clear();
+  txOpen = true;
+  return 1;
+}
+
+int WiFiUDP::endPacket() {
+  bool open = txOpen;
+  txOpen = false;
+  if (!open || WiFi.status() != WL_CONNECTED) {
+    return 0;
+  }
+
+  if (dropsLeft > 0) {
+    dropsLeft--;
+    return 1;   // sent, lost on the way
+  }
+  auto it = services.find(endpoint((uint32_t)txIp, txPort));
+  if (it != services.end()) {
+    it->second->udpReceive(localPort, tx.data(), tx.size());
+  }
+  return 1;
+}
+
+size_t WiFiUDP::write(uint8_t b) {
+  return write(&b, 1);
+}
+
+size_t WiFiUDP::write(const uint8_t* buf, size_t size) {
+  if (!txOpen) {
+    return 0;
+  }
+  tx.insert(tx.end(), buf, buf + size);
+  return size;
+}
+
+int WiFiUDP::parsePacket() {
+  rx.clear();
+  rxPos = 0;
+  if (localPort == 0) {
+    return 0;
+  }
+
+  int64_t now = Host::worldTimeUs();
+  for (auto it = inbound.begin(); it != inbound.end(); ++it) {
+    if (it->toPort == localPort && it->dueUs <= now) {
+      rx = it->data;
+      rxIp = IPAddress(it->fromIp);
+      rxPort = it->fromPort;
+      inbound.erase(it);
+      return (int)rx.size();
+    }
+  }
+  return 0;
+}
+
+int WiFiUDP::available() {
+  return (int)(rx.size() - rxPos);
+}
+
+int WiFiUDP::read() {
+  return rxPos < rx.size() ? rx[rxPos++] : -1;
+}
+
+int WiFiUDP::read(uint8_t* buf, size_t len) {
+  size_t n = std::min(len, rx.size() - rxPos);
+  memcpy(buf, rx.data() + rxPos, n);
+  rxPos += n;
+  return (int)n;
+}
+
+int WiFiUDP::peek() {
+  return rxPos < rx.size() ? rx[rxPos] : -1;
+}
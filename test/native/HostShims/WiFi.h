@@ -0,0 +1,40 @@
+#pragma once
+
+#include <Arduino.h>
+#include "WiFiClient.h"
+#include "WiFiUdp.h"
+
+// Host stand-in for the ESP32 WiFi library: one access point (Host::setWifi)
+// and the names registered with Host::addHost.
+
+typedef enum {
+  WL_IDLE_STATUS = 0,
+  WL_NO_SSID_AVAIL = 1,
+  WL_SCAN_COMPLETED = 2,
+  WL_CONNECTED = 3,
+  WL_CONNECT_FAILED = 4,
+  WL_CONNECTION_LOST = 5,
+  WL_DISCONNECTED = 6
+} wl_status_t;
+
+typedef enum {
+  WIFI_OFF = 0,
+  WIFI_STA = 1,
+  WIFI_AP = 2,
+  WIFI_AP_STA = 3
+} wifi_mode_t;
+
+class WiFiClass {
+public:
+  bool mode(wifi_mode_t m);
+  wl_status_t begin(const char* ssid, const char* passphrase = nullptr);
+  bool reconnect();
+  bool disconnect(bool wifiOff = false);
+  wl_status_t status();
+  bool setSleep(bool enabled);
+  int8_t RSSI();
+  IPAddress localIP();
+  int hostByName(const char* host, IPAddress& result);
+};
+
+extern WiFiClass WiFi;
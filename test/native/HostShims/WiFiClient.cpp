@@ -0,0 +1,168 @@
+#include "WiFiClient.h"
+#include "WiFi.h"
+#include "Host.h"
+#include <lwip/sockets.h>
+#include <map>
+
+// ============================
+// Simulated network
+// ============================
+static const IPAddress LOOPBACK(127, 0, 0, 1);
+
+static std::map<uint64_t, uint16_t> routes;   // ip:port -> loopback port
+
+static uint64_t endpoint(uint32_t ip, uint16_t port) {
+  return ((uint64_t)ip << 16) | port;
+}
+
+void Host::attachTcp(uint32_t ip, uint16_t port, uint16_t loopbackPort) {
+  if (loopbackPort != 0) {
+    routes[endpoint(ip, port)] = loopbackPort;
+  } else {
+    routes.erase(endpoint(ip, port));
+  }
+}
+
+// ============================
+// WiFiClient
+// ============================
+WiFiClient::~WiFiClient() {
+  stop();
+}
+
+int WiFiClient::connect(IPAddress ip, uint16_t port) {
+  return connect(ip, port, -1);
+}
+
+int WiFiClient::connect(IPAddress ip, uint16_t port, int32_t timeoutMs) {
+  (void)timeoutMs;   // loopback: refused or accepted at once
+  stop();
+  if (WiFi.status() != WL_CONNECTED) {
+    return 0;
+  }
+
+  uint16_t realPort = port;
+  if (ip != LOOPBACK) {
+    auto it = routes.find(endpoint((uint32_t)ip, port));
+    if (it == routes.end()) {
+      return 0;   // no host there
+    }
+    realPort = it->second;
+  }
+
+  int s = socket(AF_INET, SOCK_STREAM, 0);
+  if (s < 0) {
+    return 0;
+  }
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(realPort);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (::connect(s, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+    close(s);
+    return 0;
+  }
+  sockfd = s;
+  return 1;
+}
+
+int WiFiClient::connect(const char* host, uint16_t port) {
+  return connect(host, port, -1);
+}
+
+int WiFiClient::connect(const char* host, uint16_t port, int32_t timeoutMs) {
+  IPAddress ip;
+  if (!WiFi.hostByName(host, ip)) {
+    return 0;
+  }
+  return connect(ip, port, timeoutMs);
+}
+
+size_t WiFiClient::write(uint8_t b) {
+  return write(&b, 1);
+}
+
+size_t WiFiClient::write(const uint8_t* buf, size_t size) {
+  if (sockfd < 0) {
+    return 0;
+  }
+  size_t sent = 0;
+  while (sent < size) {
+    ssize_t n = send(sockfd, buf + sent, size - sent, MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      stop();
+      break;
+    }
+    sent += (size_t)n;
+  }
+  return sent;
+}
+
+size_t WiFiClient::fill() {
+  if (rxPos < rxLen) {
+    return rxLen - rxPos;
+  }
+  rxPos = rxLen = 0;
+  if (sockfd >= 0) {
+    ssize_t n = recv(sockfd, rx, sizeof(rx), MSG_DONTWAIT);
+    if (n > 0) {
+      rxLen = (size_t)n;
+    }
+  }
+  return rxLen;
+}
+
+int WiFiClient::available() {
+  return (int)fill();
+}
+
+int WiFiClient::read() {
+  return fill() > 0 ? rx[rxPos++] : -1;
+}
+
+int WiFiClient::read(uint8_t* buf, size_t size) {
+  size_t n = std::min(size, fill());
+  if (n == 0) {
+    return -1;
+  }
+  memcpy(buf, rx + rxPos, n);
+  rxPos += n;
+  return (int)n;
+}
+
+int WiFiClient::peek() {
+  return fill() > 0 ? rx[rxPos] : -1;
+}
+
+void WiFiClient::stop() {
+  if (sockfd >= 0) {
+    close(sockfd);
+    sockfd = -1;
+  }
+  rxPos = rxLen = 0;
+}
+
+uint8_t WiFiClient::connected() {
+  if (sockfd < 0) {
+    return 0;
+  }
+  if (rxPos < rxLen) {
+    return 1;
+  }
+  uint8_t probe;
+  ssize_t n = recv(sockfd, &probe, 1, MSG_PEEK | MSG_DONTWAIT);
+  if (n > 0 || (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))) {
+    return 1;
+  }
+  stop();   // closed by the peer, or reset
+  return 0;
+}
+
+int WiFiClient::setNoDelay(bool on) {
+  int flag = on ? 1 : 0;
+  return sockfd >= 0 ? setsockopt(sockfd, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag)) : -1;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <Arduino.h>
+#include "Client.h"
+
+/**
+ * @class WiFiClient
+ * @brief TCP client over a host socket.
+ *
+ * Connects to the servers attached with Host::attachTcp() (on the simulated
+ * network, served on loopback), or to 127.0.0.1 directly, and only while
+ * WiFi is connected. As on the ESP32, received bytes are read ahead into a
+ * buffer, where select() on fd() no longer sees them.
+ */
+class WiFiClient : public Client {
+public:
+  WiFiClient() = default;
+  ~WiFiClient() override;
+  WiFiClient(const WiFiClient&) = delete;
+  WiFiClient& operator=(const WiFiClient&) = delete;
+
+  int connect(IPAddress ip, uint16_t port) override;
+  int connect(IPAddress ip, uint16_t port, int32_t timeoutMs);
+  int connect(const char* host, uint16_t port) override;
+  int connect(const char* host, uint16_t port, int32_t timeoutMs);
+
+  using Print::write;
+  size_t write(uint8_t b) override;
+  size_t write(const uint8_t* buf, size_t size) override;
+  int available() override;
+  int read() override;
+  int read(uint8_t* buf, size_t size) override;
+  int peek() override;
+  void flush() override {}
+  void stop() override;
+  uint8_t connected() override;
+  operator bool() override { return connected(); }
+
+  int fd() const { return sockfd; }
+  int setNoDelay(bool on);
+
+private:
+  static const size_t RX_BUFFER_SIZE = 1436;   // one TCP segment, as on the ESP32
+
+  int sockfd = -1;
+  uint8_t rx[RX_BUFFER_SIZE];
+  size_t rxPos = 0;
+  size_t rxLen = 0;
+
+  size_t fill();
+};
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <Arduino.h>
+#include <vector>
+
+/**
+ * @class WiFiUDP
+ * @brief UDP socket on the simulated network: datagrams go to the
+ *        Host::UdpService at the destination, replies arrive through
+ *        Host::udpSend() once their delay has passed.
+ */
+class WiFiUDP : public Stream {
+public:
+  ~WiFiUDP() { stop(); }
+
+  uint8_t begin(uint16_t port);
+  void stop();
+
+  int beginPacket(IPAddress ip, uint16_t port);
+  int endPacket();
+  using Print::write;
+  size_t write(uint8_t b) override;
+  size_t write(const uint8_t* buf, size_t size) override;
+
+  /**
+   * @return Size of the next datagram (0 if none has arrived)
+   */
+  int parsePacket();
+  int available() override;
+  int read() override;
+  int read(uint8_t* buf, size_t len);
+  int read(char* buf, size_t len) { return read((uint8_t*)buf, len); }
+  int peek() override;
+  void flush() override {}
+
+  IPAddress remoteIP() const { return rxIp; }
+  uint16_t remotePort() const { return rxPort; }
+
+private:
+  uint16_t localPort = 0;
+  IPAddress txIp;
+  uint16_t txPort = 0;
+  bool txOpen = false;
+  std::vector<uint8_t> tx;
+  std::vector<uint8_t> rx;
+  size_t rxPos = 0;
+  IPAddress rxIp;
+  uint16_t rxPort = 0;
+};
@@ -0,0 +1,134 @@
+#include "Wire.h"
+#include "Host.h"
+
+// ============================
+// Simulated bus
+// ============================
+static const uint8_t ERR_NACK_ADDR = 2;
+static const uint8_t ERR_NACK_DATA = 3;
+static const uint8_t ERR_OTHER = 4;
+static const uint8_t ERR_TIMEOUT = 5;
+
+static Host::I2CDevice* devices[128];
+static uint8_t faultError = 0;
+static uint32_t faultsLeft = 0;
+static uint32_t clockHz = 0;
+
+TwoWire Wire;
+
+void Host::attachI2C(uint8_t addr, I2CDevice* device) {
+  devices[addr & 0x7F] = device;
+}
+
+void Host::failI2C(uint8_t error, uint32_t n) {
+  faultError = error;
+  faultsLeft = n;
+}
+
+uint32_t Host::i2cClock() {
+  return clockHz;
+}
+
+// ============================
+// TwoWire
+// ============================
+bool TwoWire::begin(int sda, int scl, uint32_t frequency) {
+  (void)scl;
+  sdaPin = sda;
+  started = true;
+  clockHz = frequency > 0 ? frequency : 100000;
+  return true;
+}
+
+bool TwoWire::end() {
+  started = false;
+  clockHz = 0;
+  return true;
+}
+
+bool TwoWire::setClock(uint32_t frequency) {
+  if (started) {
+    clockHz = frequency;
+  }
+  return started;
+}
+
+void TwoWire::setTimeOut(uint16_t timeoutMs) {
+  (void)timeoutMs;
+}
+
+// Injected fault, stopped bus or SDA held low by a slave (0 = none)
+uint8_t TwoWire::busError() {
+  if (faultsLeft > 0) {
+    faultsLeft--;
+    return faultError;
+  }
+  if (!started) {
+    return ERR_OTHER;
+  }
+  if (digitalRead((uint8_t)sdaPin) == LOW) {
+    return ERR_TIMEOUT;
+  }
+  return 0;
+}
+
+void TwoWire::beginTransmission(uint8_t address) {
+  txAddr = address;
+  txLen = 0;
+}
+
+uint8_t TwoWire::endTransmission(bool sendStop) {
+  (void)sendStop;
+  uint8_t err = busError();
+  if (err != 0) {
+    return err;
+  }
+  Host::I2CDevice* dev = devices[txAddr & 0x7F];
+  if (dev == nullptr) {
+    return ERR_NACK_ADDR;
+  }
+  // An address-only transaction (probe) is just the ACK
+  if (txLen > 0 && !dev->i2cWrite(txBuf, txLen)) {
+    return ERR_NACK_DATA;
+  }
+  return 0;
+}
+
+uint8_t TwoWire::requestFrom(uint8_t address, uint8_t size) {
+  rxLen = 0;
+  rxPos = 0;
+  Host::I2CDevice* dev = devices[address & 0x7F];
+  if (busError() != 0 || dev == nullptr) {
+    return 0;
+  }
+  rxLen = dev->i2cRead(rxBuf, size);
+  return (uint8_t)rxLen;
+}
+
+size_t TwoWire::write(uint8_t data) {
+  if (txLen >= sizeof(txBuf)) {
+    return 0;
+  }
+  txBuf[txLen++] = data;
+  return 1;
+}
+
+size_t TwoWire::write(const uint8_t* data, size_t len) {
+  size_t n = 0;
+  while (n < len && write(data[n]) == 1) {
+    n++;
+  }
+  return n;
+}
+
+int TwoWire::available() {
+  return (int)(rxLen - rxPos);
+}
+
+int TwoWire::read() {
+  return rxPos < rxLen ? rxBuf[rxPos++] : -1;
+}
+
+int TwoWire::peek() {
+  return rxPos < rxLen ? rxBuf[rxPos] : -1;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+// Host stand-in for the Arduino-ESP32 Wire library: transactions go to the
+// devices attached with Host::attachI2C(). While a slave holds SDA low (see
+// FakeDS3231::holdSda()) every transaction times out, as on the device.
+
+#include "Arduino.h"
+
+class TwoWire : public Stream {
+public:
+  bool begin(int sda, int scl, uint32_t frequency = 0);
+  bool end();
+  bool setClock(uint32_t frequency);
+  void setTimeOut(uint16_t timeoutMs);
+
+  void beginTransmission(uint8_t address);
+  uint8_t endTransmission(bool sendStop = true);
+  uint8_t requestFrom(uint8_t address, uint8_t size);
+
+  size_t write(uint8_t data) override;
+  size_t write(const uint8_t* data, size_t len) override;
+  int available() override;
+  int read() override;
+  int peek() override;
+  void flush() override {}
+
+private:
+  bool started = false;
+  int sdaPin = -1;
+  uint8_t txAddr = 0;
+  uint8_t txBuf[128];
+  size_t txLen = 0;
+  uint8_t rxBuf[256];
+  size_t rxLen = 0;
+  size_t rxPos = 0;
+
+  uint8_t busError();
+};
+
+extern TwoWire Wire;
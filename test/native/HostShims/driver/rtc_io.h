@@ -0,0 +1,12 @@
+#pragma once
+
+// Host stand-in for ESP-IDF driver/rtc_io.h: which GPIOs are RTC IOs; the
+// pull resistors are not simulated (Host::setPin() sets the level)
+
+#include "../esp_sleep.h"
+
+bool rtc_gpio_is_valid_gpio(gpio_num_t gpio_num);
+esp_err_t rtc_gpio_pullup_en(gpio_num_t gpio_num);
+esp_err_t rtc_gpio_pullup_dis(gpio_num_t gpio_num);
+esp_err_t rtc_gpio_pulldown_en(gpio_num_t gpio_num);
+esp_err_t rtc_gpio_pulldown_dis(gpio_num_t gpio_num);
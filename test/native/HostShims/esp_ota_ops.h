@@ -0,0 +1,19 @@
+#pragma once
+
+// Host stand-in for ESP-IDF esp_ota_ops.h over the simulated flash in
+// Partitions.cpp
+
+#include "esp_partition.h"
+
+/**
+ * @brief The OTA slot that is not running (start must be nullptr).
+ */
+const esp_partition_t* esp_ota_get_next_update_partition(const esp_partition_t* start);
+const esp_partition_t* esp_ota_get_running_partition();
+const esp_partition_t* esp_ota_get_boot_partition();
+
+/**
+ * @brief Boot this slot after the next restart. Of the image checks only
+ *        the header magic byte (0xE9) is simulated.
+ */
+esp_err_t esp_ota_set_boot_partition(const esp_partition_t* partition);
@@ -0,0 +1,31 @@
+#pragma once
+
+// Host stand-in for ESP-IDF esp_system.h: restart and reset reason of the
+// simulated device (Host.h)
+
+#include "esp_err.h"
+
+typedef enum {
+  ESP_RST_UNKNOWN,
+  ESP_RST_POWERON,
+  ESP_RST_EXT,
+  ESP_RST_SW,
+  ESP_RST_PANIC,
+  ESP_RST_INT_WDT,
+  ESP_RST_TASK_WDT,
+  ESP_RST_WDT,
+  ESP_RST_DEEPSLEEP,
+  ESP_RST_BROWNOUT,
+  ESP_RST_SDIO,
+} esp_reset_reason_t;
+
+/**
+ * @brief Throws Host::Restart (the test decides what boots next).
+ */
+[[noreturn]] void esp_restart();
+
+/**
+ * @brief ESP_RST_POWERON after powerCycle(), ESP_RST_DEEPSLEEP after
+ *        deepSleep(), the given reason after reset().
+ */
+esp_reset_reason_t esp_reset_reason();
@@ -0,0 +1,11 @@
+#pragma once
+
+// Host stand-in for ESP-IDF esp_task_wdt.h: accepted, never trips
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+esp_err_t esp_task_wdt_init(uint32_t timeout_s, bool panic);
+esp_err_t esp_task_wdt_add(void* task_handle);
+esp_err_t esp_task_wdt_delete(void* task_handle);
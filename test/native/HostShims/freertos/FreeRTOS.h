@@ -0,0 +1,42 @@
+#pragma once
+
+// Host (env:native) FreeRTOS subset: tasks are pthreads, ticks are
+// milliseconds, critical sections are spinlocks.
+
+#include <stdint.h>
+#include <sched.h>
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdFALSE 0
+#define pdTRUE  1
+#define pdFAIL  0
+#define pdPASS  1
+#define portMAX_DELAY      0xFFFFFFFFUL
+#define portTICK_PERIOD_MS 1
+#define pdMS_TO_TICKS(ms)  ((TickType_t)(ms))
+
+typedef struct {
+  volatile int locked;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED { 0 }
+
+static inline void hostMuxEnter(portMUX_TYPE* mux) {
+  while (__atomic_exchange_n(&mux->locked, 1, __ATOMIC_ACQUIRE) != 0) {
+    sched_yield();
+  }
+}
+
+static inline void hostMuxExit(portMUX_TYPE* mux) {
+  __atomic_store_n(&mux->locked, 0, __ATOMIC_RELEASE);
+}
+
+#define portENTER_CRITICAL(mux)        hostMuxEnter(mux)
+#define portEXIT_CRITICAL(mux)         hostMuxExit(mux)
+#define portENTER_CRITICAL_ISR(mux)    hostMuxEnter(mux)
+#define portEXIT_CRITICAL_ISR(mux)     hostMuxExit(mux)
+#define portENTER_CRITICAL_SAFE(mux)   hostMuxEnter(mux)
+#define portEXIT_CRITICAL_SAFE(mux)    hostMuxExit(mux)
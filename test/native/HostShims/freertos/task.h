@@ -0,0 +1,26 @@
+#pragma once
+
+#include "FreeRTOS.h"
+
+typedef struct HostTask* TaskHandle_t;
+typedef void (*TaskFunction_t)(void*);
+
+/**
+ * @brief Start a task as a detached pthread (stack size, priority and core
+ *        are ignored).
+ */
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t code, const char* name, uint32_t stackDepth,
+                                   void* param, UBaseType_t priority, TaskHandle_t* created,
+                                   BaseType_t core);
+
+/**
+ * @brief Handle of the calling task (the main thread has one too).
+ */
+TaskHandle_t xTaskGetCurrentTaskHandle();
+
+void vTaskDelay(TickType_t ticks);
+
+/**
+ * @brief Only vTaskDelete(nullptr) (the calling task ends) is supported.
+ */
+void vTaskDelete(TaskHandle_t task);
@@ -0,0 +1,18 @@
+#pragma once
+
+// Host stand-in for the ESP32 ROM CRC routines (the subset lib/ uses)
+
+#include <stdint.h>
+
+// CRC-32 as in zlib (little-endian, polynomial 0xEDB88320); pass the previous
+// result to continue over several buffers
+static inline uint32_t crc32_le(uint32_t crc, const uint8_t* buf, uint32_t len) {
+  crc = ~crc;
+  for (uint32_t i = 0; i < len; i++) {
+    crc ^= buf[i];
+    for (int bit = 0; bit < 8; bit++) {
+      crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1u)));
+    }
+  }
+  return ~crc;
+}
@@ -0,0 +1,365 @@
+#include "TlsProxy.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <openssl/err.h>
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/ssl.h>
+#include <openssl/x509v3.h>
+
+struct TlsProxy::Impl {
+  std::mutex mutex;
+  std::thread acceptThread;
+  std::vector<std::thread> relays;
+  std::vector<int> openFds;
+  std::atomic<bool> running{false};
+  int listenFd = -1;
+  uint16_t listenPort = 0;
+  uint16_t backendPort = 0;
+
+  EVP_PKEY* caKey = nullptr;
+  X509* caCert = nullptr;
+  EVP_PKEY* serverKey = nullptr;
+  X509* serverCert = nullptr;
+  std::string caPem;
+
+  SSL_CTX* ctx = nullptr;      // replaced by forgetSessions()
+  bool sessionCache = true;
+  bool tickets = true;
+
+  std::atomic<uint32_t> handshakes{0};
+  std::atomic<uint32_t> resumed{0};
+
+  bool makeCertificates(const char* serverName);
+  SSL_CTX* newContext();
+  void acceptLoop();
+  void relay(int clientFd);
+  void track(int fd);
+  void untrack(int fd);
+};
+
+// ============================
+// Certificates
+// ============================
+static const long YEAR_S = 365L * 24 * 3600;
+
+static X509* makeCert(EVP_PKEY* key, const char* commonName, X509* issuer, EVP_PKEY* issuerKey,
+                      long serial, const char* extensions[][2]) {
+  X509* cert = X509_new();
+  X509_set_version(cert, 2);
+  ASN1_INTEGER_set(X509_get_serialNumber(cert), serial);
+  // mbedTLS checks validity against the real time() of the host
+  X509_gmtime_adj(X509_getm_notBefore(cert), -2 * YEAR_S);
+  X509_gmtime_adj(X509_getm_notAfter(cert), 10 * YEAR_S);
+  X509_set_pubkey(cert, key);
+
+  X509_NAME* name = X509_get_subject_name(cert);
+  X509_NAME_add_entry_by_txt(name, "O", MBSTRING_ASC, (const unsigned char*)"Host tests", -1, -1, 0);
+  X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, (const unsigned char*)commonName, -1, -1, 0);
+  X509_set_issuer_name(cert, issuer ? X509_get_subject_name(issuer) : name);
+
+  X509V3_CTX v3;
+  X509V3_set_ctx(&v3, issuer ? issuer : cert, cert, nullptr, nullptr, 0);
+  for (size_t i = 0; extensions[i][0] != nullptr; i++) {
+    X509_EXTENSION* ext = X509V3_EXT_conf(nullptr, &v3, extensions[i][0], extensions[i][1]);
+    if (ext != nullptr) {
+      X509_add_ext(cert, ext, -1);
+      X509_EXTENSION_free(ext);
+    }
+  }
+
+  if (X509_sign(cert, issuerKey, EVP_sha256()) == 0) {
+    X509_free(cert);
+    return nullptr;
+  }
+  return cert;
+}
+
+bool TlsProxy::Impl::makeCertificates(const char* serverName) {
+  // A new CA each time: a second proxy is a broker this client must not trust
+  caKey = EVP_EC_gen("P-256");
+  serverKey = EVP_EC_gen("P-256");
+  if (caKey == nullptr || serverKey == nullptr) {
+    return false;
+  }
+
+  const char* caExt[][2] = {
+    { "basicConstraints", "critical,CA:TRUE" },
+    { "keyUsage", "critical,keyCertSign,cRLSign" },
+    { "subjectKeyIdentifier", "hash" },
+    { nullptr, nullptr }
+  };
+  caCert = makeCert(caKey, "Host test CA", nullptr, caKey, 1, caExt);
+
+  std::string san = std::string("DNS:") + serverName;
+  const char* serverExt[][2] = {
+    { "basicConstraints", "critical,CA:FALSE" },
+    { "keyUsage", "critical,digitalSignature" },
+    { "extendedKeyUsage", "serverAuth" },
+    { "subjectAltName", san.c_str() },
+    { nullptr, nullptr }
+  };
+  if (caCert == nullptr) {
+    return false;
+  }
+  serverCert = makeCert(serverKey, serverName, caCert, caKey, 2, serverExt);
+  if (serverCert == nullptr) {
+    return false;
+  }
+
+  BIO* bio = BIO_new(BIO_s_mem());
+  PEM_write_bio_X509(bio, caCert);
+  char* data = nullptr;
+  long len = BIO_get_mem_data(bio, &data);
+  caPem.assign(data, len);
+  BIO_free(bio);
+  return true;
+}
+
+// ============================
+// TLS context
+// ============================
+SSL_CTX* TlsProxy::Impl::newContext() {
+  SSL_CTX* c = SSL_CTX_new(TLS_server_method());
+  if (c == nullptr) {
+    return nullptr;
+  }
+  // The device speaks TLS 1.2 (mbedTLS 2.x)
+  SSL_CTX_set_max_proto_version(c, TLS1_2_VERSION);
+  SSL_CTX_use_certificate(c, serverCert);
+  SSL_CTX_use_PrivateKey(c, serverKey);
+
+  static const unsigned char SID_CTX[] = "tls-proxy";
+  SSL_CTX_set_session_id_context(c, SID_CTX, sizeof(SID_CTX) - 1);
+  SSL_CTX_set_session_cache_mode(c, sessionCache ? SSL_SESS_CACHE_SERVER : SSL_SESS_CACHE_OFF);
+  if (!tickets) {
+    SSL_CTX_set_options(c, SSL_OP_NO_TICKET);
+  }
+  return c;
+}
+
+// ============================
+// Lifecycle
+// ============================
+TlsProxy::TlsProxy() : impl(new Impl()) {
+}
+
+TlsProxy::~TlsProxy() {
+  stop();
+  SSL_CTX_free(impl->ctx);
+  X509_free(impl->caCert);
+  X509_free(impl->serverCert);
+  EVP_PKEY_free(impl->caKey);
+  EVP_PKEY_free(impl->serverKey);
+  delete impl;
+}
+
+bool TlsProxy::start(uint16_t backendPort, const char* serverName, uint16_t loopbackPort) {
+  if (impl->running.load()) {
+    return true;
+  }
+  if (impl->ctx == nullptr) {
+    if (!impl->makeCertificates(serverName) || (impl->ctx = impl->newContext()) == nullptr) {
+      ERR_print_errors_fp(stderr);
+      return false;
+    }
+  }
+  impl->backendPort = backendPort;
+  // OpenSSL writes with write(): a client gone mid-record would raise SIGPIPE
+  signal(SIGPIPE, SIG_IGN);
+
+  impl->listenFd = socket(AF_INET, SOCK_STREAM, 0);
+  if (impl->listenFd < 0) {
+    return false;
+  }
+  int one = 1;
+  setsockopt(impl->listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(loopbackPort);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t len = sizeof(addr);
+  if (bind(impl->listenFd, (struct sockaddr*)&addr, sizeof(addr)) != 0 ||
+      listen(impl->listenFd, 64) != 0 ||
+      getsockname(impl->listenFd, (struct sockaddr*)&addr, &len) != 0) {
+    ::close(impl->listenFd);
+    impl->listenFd = -1;
+    return false;
+  }
+  impl->listenPort = ntohs(addr.sin_port);
+
+  impl->running.store(true);
+  impl->acceptThread = std::thread(&Impl::acceptLoop, impl);
+  return true;
+}
+
+void TlsProxy::stop() {
+  if (!impl->running.exchange(false)) {
+    return;
+  }
+  // shutdown() wakes the threads blocked in accept()/poll()/SSL_accept()
+  shutdown(impl->listenFd, SHUT_RDWR);
+  impl->acceptThread.join();
+  ::close(impl->listenFd);
+  impl->listenFd = -1;
+
+  std::vector<std::thread> relays;
+  {
+    std::lock_guard<std::mutex> lock(impl->mutex);
+    for (int fd : impl->openFds) {
+      shutdown(fd, SHUT_RDWR);
+    }
+    relays.swap(impl->relays);
+  }
+  for (std::thread& t : relays) {
+    t.join();
+  }
+}
+
+uint16_t TlsProxy::port() const {
+  return impl->listenPort;
+}
+
+void TlsProxy::attach(uint32_t ip, uint16_t port) {
+  Host::attachTcp(ip, port, impl->listenPort);
+}
+
+const char* TlsProxy::caPem() const {
+  return impl->caPem.c_str();
+}
+
+// ============================
+// Sessions
+// ============================
+void TlsProxy::setSessionCache(bool on) {
+  std::lock_guard<std::mutex> lock(impl->mutex);
+  impl->sessionCache = on;
+  SSL_CTX_set_session_cache_mode(impl->ctx, on ? SSL_SESS_CACHE_SERVER : SSL_SESS_CACHE_OFF);
+}
+
+void TlsProxy::setTickets(bool on) {
+  std::lock_guard<std::mutex> lock(impl->mutex);
+  impl->tickets = on;
+  if (on) {
+    SSL_CTX_clear_options(impl->ctx, SSL_OP_NO_TICKET);
+  } else {
+    SSL_CTX_set_options(impl->ctx, SSL_OP_NO_TICKET);
+  }
+}
+
+void TlsProxy::forgetSessions() {
+  // A new context has an empty cache and new ticket keys, like a restarted broker
+  SSL_CTX* fresh = impl->newContext();
+  std::lock_guard<std::mutex> lock(impl->mutex);
+  SSL_CTX* old = impl->ctx;
+  impl->ctx = fresh;
+  SSL_CTX_free(old);   // reference counted: live connections keep theirs
+}
+
+uint32_t TlsProxy::handshakes() const {
+  return impl->handshakes.load();
+}
+
+uint32_t TlsProxy::resumedHandshakes() const {
+  return impl->resumed.load();
+}
+
+// ============================
+// Connections
+// ============================
+void TlsProxy::Impl::track(int fd) {
+  std::lock_guard<std::mutex> lock(mutex);
+  openFds.push_back(fd);
+}
+
+void TlsProxy::Impl::untrack(int fd) {
+  std::lock_guard<std::mutex> lock(mutex);
+  for (size_t i = 0; i < openFds.size(); i++) {
+    if (openFds[i] == fd) {
+      openFds.erase(openFds.begin() + i);
+      break;
+    }
+  }
+}
+
+void TlsProxy::Impl::acceptLoop() {
+  while (running.load()) {
+    int fd = ::accept(listenFd, nullptr, nullptr);
+    if (fd < 0) {
+      continue;   // woken by stop()
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!running.load()) {
+      ::close(fd);
+      break;
+    }
+    openFds.push_back(fd);
+    relays.emplace_back(&Impl::relay, this, fd);
+  }
+}
+
+void TlsProxy::Impl::relay(int clientFd) {
+  SSL* ssl;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    ssl = SSL_new(ctx);
+  }
+  SSL_set_fd(ssl, clientFd);
+
+  int backendFd = -1;
+  if (SSL_accept(ssl) == 1) {
+    handshakes++;
+    if (SSL_session_reused(ssl)) {
+      resumed++;
+    }
+
+    backendFd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(backendPort);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (backendFd >= 0 && ::connect(backendFd, (struct sockaddr*)&addr, sizeof(addr)) == 0) {
+      track(backendFd);
+    } else if (backendFd >= 0) {
+      ::close(backendFd);
+      backendFd = -1;
+    }
+  }
+
+  // Plaintext both ways until either side closes
+  char buf[4096];
+  bool open = backendFd >= 0;
+  while (open && running.load()) {
+    struct pollfd fds[2] = { { clientFd, POLLIN, 0 }, { backendFd, POLLIN, 0 } };
+    if (SSL_pending(ssl) == 0 && poll(fds, 2, 200) <= 0) {
+      continue;
+    }
+    if (SSL_pending(ssl) > 0 || (fds[0].revents & (POLLIN | POLLHUP | POLLERR))) {
+      int n = SSL_read(ssl, buf, sizeof(buf));
+      open = n > 0 && ::send(backendFd, buf, n, MSG_NOSIGNAL) == n;
+    }
+    if (open && (fds[1].revents & (POLLIN | POLLHUP | POLLERR))) {
+      ssize_t n = ::recv(backendFd, buf, sizeof(buf), 0);
+      open = n > 0 && SSL_write(ssl, buf, (int)n) == n;
+    }
+  }
+
+  SSL_shutdown(ssl);
+  SSL_free(ssl);
+  if (backendFd >= 0) {
+    untrack(backendFd);
+    ::close(backendFd);
+  }
+  untrack(clientFd);
+  ::close(clientFd);
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <Host.h>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @class TlsProxy
+ * @brief TLS front end for a loopback server (FakeBroker), on OpenSSL.
+ *
+ * Terminates TLS 1.2 on its own loopback port and relays the plaintext to
+ * 127.0.0.1:backendPort, one thread per connection. start() makes a fresh
+ * test CA and a server certificate for the given name, so nothing secret
+ * is kept in the tree.
+ *
+ * Resumption works as on a broker: session IDs from the server cache and
+ * session tickets, each of which can be switched off, and forgetSessions()
+ * makes every cached session and issued ticket unusable (a broker restart).
+ *
+ * A separate library from HostShims: only suites that include it need
+ * OpenSSL (env:native-tls).
+ */
+class TlsProxy {
+public:
+  TlsProxy();
+  ~TlsProxy();
+
+  /**
+   * @brief Make the certificates, listen on 127.0.0.1 (0 = any free port).
+   *
+   * @param serverName Certificate CN and DNS name (what the client checks)
+   */
+  bool start(uint16_t backendPort, const char* serverName, uint16_t loopbackPort = 0);
+  void stop();
+  uint16_t port() const;
+
+  /**
+   * @brief Reachable from the device at ip:port.
+   */
+  void attach(uint32_t ip, uint16_t port);
+
+  /**
+   * @brief The test CA (PEM) for the client's trust store.
+   */
+  const char* caPem() const;
+
+  void setSessionCache(bool on);
+  void setTickets(bool on);
+  void forgetSessions();
+
+  uint32_t handshakes() const;
+  uint32_t resumedHandshakes() const;
+
+private:
+  struct Impl;
+  Impl* impl;
+};
@@ -0,0 +1,185 @@
+// Calendar: civil-date arithmetic, the compile-time DST table and the daily
+// rollover across DST changes. env:native builds for CET (EU rule),
+// env:native-us for Eastern time (US rule).
+
+#include <unity.h>
+#include <Calendar.h>
+#include <config_common.h>
+
+static const int32_t DAY = 86400;
+
+static time_t utc(int y, int m, int d, int hh, int mm = 0, int ss = 0) {
+  return (time_t)Calendar::daysFromCivil(y, m, d) * DAY + hh * 3600 + mm * 60 + ss;
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+// ============================
+// Civil dates
+// ============================
+static void test_epoch_and_known_dates(void) {
+  TEST_ASSERT_EQUAL_INT32(0, Calendar::daysFromCivil(1970, 1, 1));
+  TEST_ASSERT_EQUAL_INT32(20454, Calendar::daysFromCivil(2026, 1, 1));
+  TEST_ASSERT_EQUAL_INT32(-1, Calendar::daysFromCivil(1969, 12, 31));
+  TEST_ASSERT_EQUAL(4, Calendar::weekday(0));                                   // Thursday
+  TEST_ASSERT_EQUAL(0, Calendar::weekday(Calendar::daysFromCivil(2026, 10, 18))); // Sunday
+  TEST_ASSERT_EQUAL(3, Calendar::weekday(-1));                                  // Wednesday
+  TEST_ASSERT_EQUAL(20260122, Calendar::yyyymmdd(Calendar::daysFromCivil(2026, 1, 22)));
+}
+
+static void test_leap_years(void) {
+  // 2024: leap; 2100: not (century); 2000: leap (400)
+  TEST_ASSERT_EQUAL_INT32(2, Calendar::daysFromCivil(2024, 3, 1) - Calendar::daysFromCivil(2024, 2, 28));
+  TEST_ASSERT_EQUAL_INT32(1, Calendar::daysFromCivil(2100, 3, 1) - Calendar::daysFromCivil(2100, 2, 28));
+  TEST_ASSERT_EQUAL_INT32(2, Calendar::daysFromCivil(2000, 3, 1) - Calendar::daysFromCivil(2000, 2, 28));
+  TEST_ASSERT_EQUAL_INT32(366, Calendar::daysFromCivil(2025, 1, 1) - Calendar::daysFromCivil(2024, 1, 1));
+  TEST_ASSERT_EQUAL_INT32(365, Calendar::daysFromCivil(2101, 1, 1) - Calendar::daysFromCivil(2100, 1, 1));
+
+  Calendar::Date d = Calendar::civilFromDays(Calendar::daysFromCivil(2024, 2, 29));
+  TEST_ASSERT_EQUAL(2024, d.year);
+  TEST_ASSERT_EQUAL(2, d.month);
+  TEST_ASSERT_EQUAL(29, d.day);
+}
+
+static void test_civil_round_trip(void) {
+  // Every day from 1900 to 2200: inverse functions, consecutive dates
+  int32_t first = Calendar::daysFromCivil(1900, 1, 1);
+  int32_t last = Calendar::daysFromCivil(2200, 12, 31);
+  Calendar::Date prev = Calendar::civilFromDays(first - 1);
+  for (int32_t z = first; z <= last; z++) {
+    Calendar::Date d = Calendar::civilFromDays(z);
+    TEST_ASSERT_EQUAL_INT32(z, Calendar::daysFromCivil(d.year, d.month, d.day));
+    bool nextDay = d.year == prev.year && d.month == prev.month && d.day == prev.day + 1;
+    bool nextMonth = d.day == 1 && ((d.year == prev.year && d.month == prev.month + 1) ||
+                                    (d.year == prev.year + 1 && d.month == 1 && prev.month == 12));
+    TEST_ASSERT_TRUE(nextDay || nextMonth);
+    prev = d;
+  }
+}
+
+static void test_floor_div(void) {
+  TEST_ASSERT_EQUAL_INT64(0, Calendar::floorDiv(0, DAY));
+  TEST_ASSERT_EQUAL_INT64(0, Calendar::floorDiv(DAY - 1, DAY));
+  TEST_ASSERT_EQUAL_INT64(1, Calendar::floorDiv(DAY, DAY));
+  TEST_ASSERT_EQUAL_INT64(-1, Calendar::floorDiv(-1, DAY));
+  TEST_ASSERT_EQUAL_INT64(-1, Calendar::floorDiv(-DAY, DAY));
+  TEST_ASSERT_EQUAL_INT64(-2, Calendar::floorDiv(-DAY - 1, DAY));
+}
+
+// ============================
+// DST transitions
+// ============================
+static void assertTransition(time_t at, bool dstAfter) {
+  TEST_ASSERT_EQUAL(!dstAfter, Calendar::isDst(at - 1));
+  TEST_ASSERT_EQUAL(dstAfter, Calendar::isDst(at));
+  TEST_ASSERT_EQUAL_INT32(TZ_STD_OFFSET_MIN * 60 + (dstAfter ? 0 : 3600), Calendar::utcOffset(at - 1));
+  TEST_ASSERT_EQUAL_INT32(TZ_STD_OFFSET_MIN * 60 + (dstAfter ? 3600 : 0), Calendar::utcOffset(at));
+}
+
+#if TZ_DST_RULE == TZ_DST_EU
+static void test_dst_edges(void) {
+  // Last Sunday of March / October, 01:00 UTC
+  assertTransition(1585443600, true);    // 2020-03-29, first table entry
+  assertTransition(1603587600, false);   // 2020-10-25
+  assertTransition(1774746000, true);    // 2026-03-29
+  assertTransition(1792890000, false);   // 2026-10-25
+  assertTransition(4078429200, true);    // 2099-03-29, last year in the table
+  assertTransition(4096573200, false);   // 2099-10-25
+  TEST_ASSERT_EQUAL_INT64(utc(2026, 3, 29, 1), 1774746000);
+}
+#elif TZ_DST_RULE == TZ_DST_US
+static void test_dst_edges(void) {
+  // Second Sunday of March 02:00 local standard, first Sunday of November
+  // 02:00 local daylight time
+  const int32_t std = -TZ_STD_OFFSET_MIN * 60;
+  assertTransition(utc(2020, 3, 8, 2) + std, true);
+  assertTransition(utc(2020, 11, 1, 1) + std, false);
+  assertTransition(1772953200, true);    // 2026-03-08 07:00 UTC (EST)
+  assertTransition(1793512800, false);   // 2026-11-01 06:00 UTC (EDT)
+  assertTransition(utc(2099, 3, 8, 2) + std, true);
+  assertTransition(utc(2099, 11, 1, 1) + std, false);
+}
+#else
+#error "test_calendar needs a DST rule (build_flags of env:native / env:native-us)"
+#endif
+
+static void test_standard_time_outside_table(void) {
+  TEST_ASSERT_FALSE(Calendar::isDst(utc(Calendar::FIRST_YEAR - 1, 7, 1, 12)));
+  TEST_ASSERT_FALSE(Calendar::isDst(utc(Calendar::LAST_YEAR + 1, 7, 1, 12)));
+  TEST_ASSERT_TRUE(Calendar::isDst(utc(Calendar::FIRST_YEAR, 7, 1, 12)));
+  TEST_ASSERT_TRUE(Calendar::isDst(utc(Calendar::LAST_YEAR, 7, 1, 12)));
+  TEST_ASSERT_FALSE(Calendar::isDst(0));
+}
+
+static void test_two_transitions_per_year(void) {
+  // Hourly through every table year: DST starts once and ends once
+  for (int y = Calendar::FIRST_YEAR; y <= Calendar::LAST_YEAR; y++) {
+    int changes = 0;
+    bool prev = Calendar::isDst(utc(y, 1, 1, 0));
+    TEST_ASSERT_FALSE(prev);
+    for (time_t t = utc(y, 1, 1, 1); t < utc(y + 1, 1, 1, 0); t += 3600) {
+      bool now = Calendar::isDst(t);
+      changes += now != prev;
+      prev = now;
+    }
+    TEST_ASSERT_EQUAL(2, changes);
+  }
+}
+
+// ============================
+// Local days and rollover
+// ============================
+static void test_local_day_at_midnight(void) {
+  // Local midnight in winter and summer (offset differs by the DST hour)
+  const int32_t winter = TZ_STD_OFFSET_MIN * 60;
+  const int32_t summer = winter + 3600;
+  int32_t jan15 = Calendar::daysFromCivil(2026, 1, 15);
+  int32_t jul15 = Calendar::daysFromCivil(2026, 7, 15);
+  TEST_ASSERT_EQUAL_INT32(jan15 - 1, Calendar::localDay(utc(2026, 1, 15, 0) - winter - 1));
+  TEST_ASSERT_EQUAL_INT32(jan15, Calendar::localDay(utc(2026, 1, 15, 0) - winter));
+  TEST_ASSERT_EQUAL_INT32(jul15 - 1, Calendar::localDay(utc(2026, 7, 15, 0) - summer - 1));
+  TEST_ASSERT_EQUAL_INT32(jul15, Calendar::localDay(utc(2026, 7, 15, 0) - summer));
+}
+
+static void test_rollover_at_local_time_across_dst(void) {
+  // Minute by minute through 2026: the day
+  // number grows by one per day, always at MINMAX_ROLLOVER_MIN local time
+  int increments = 0;
+  int32_t prev = Calendar::rolloverDay(utc(2026, 1, 1, 0));
+  for (time_t t = utc(2026, 1, 1, 0) + 60; t <= utc(2027, 1, 1, 0); t += 60) {
+    int32_t day = Calendar::rolloverDay(t);
+    if (day != prev) {
+      TEST_ASSERT_EQUAL_INT32(prev + 1, day);
+      int32_t localSecond = (int32_t)(((int64_t)t + Calendar::utcOffset(t)) % DAY);
+      TEST_ASSERT_EQUAL_INT32(MINMAX_ROLLOVER_MIN * 60, localSecond);
+      increments++;
+    }
+    prev = day;
+  }
+  TEST_ASSERT_EQUAL(365, increments);
+}
+
+static void test_rollover_day_is_the_date_it_started(void) {
+  // Just after the rollover the day is today's date, just before it is yesterday's
+  time_t reset = utc(2026, 7, 15, 0) - Calendar::utcOffset(utc(2026, 7, 15, 12)) + MINMAX_ROLLOVER_MIN * 60;
+  TEST_ASSERT_EQUAL(20260715, Calendar::yyyymmdd(Calendar::rolloverDay(reset)));
+  TEST_ASSERT_EQUAL(20260714, Calendar::yyyymmdd(Calendar::rolloverDay(reset - 1)));
+}
+
+int main(int argc, char** argv) {
+  (void)argc;
+  (void)argv;
+  UNITY_BEGIN();
+  RUN_TEST(test_epoch_and_known_dates);
+  RUN_TEST(test_leap_years);
+  RUN_TEST(test_civil_round_trip);
+  RUN_TEST(test_floor_div);
+  RUN_TEST(test_dst_edges);
+  RUN_TEST(test_standard_time_outside_table);
+  RUN_TEST(test_two_transitions_per_year);
+  RUN_TEST(test_local_day_at_midnight);
+  RUN_TEST(test_rollover_at_local_time_across_dst);
+  RUN_TEST(test_rollover_day_is_the_date_it_started);
+  return UNITY_END();
+}
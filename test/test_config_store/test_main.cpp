@@ -0,0 +1,339 @@
+// ConfigStore over the simulated NVS partition: schema migration and the
+// prefix blob, validation of "set" changes, staging until the next wake,
+// the broker trial and its rollback, and the RTC cache that keeps timer
+// wakes off the flash.
+
+#include <unity.h>
+#include <Host.h>
+#include <Preferences.h>
+#include <ConfigStore.h>
+#include <config_common.h>
+
+typedef ConfigStore::Config Config;
+
+// Timer wake: RTC memory kept
+static void wake() {
+  Host::deepSleep(300ULL * 1000000);
+  ConfigStore::begin();
+}
+
+// Battery swap: RTC memory lost, NVS kept
+static void coldBoot() {
+  Host::powerCycle();
+  ConfigStore::begin();
+}
+
+static void writeBlob(uint16_t version, const void* blob, size_t len) {
+  Preferences prefs;
+  prefs.begin("config", false);
+  prefs.putUShort("ver", version);
+  prefs.putBytes("cfg", blob, len);
+  prefs.end();
+}
+
+void setUp(void) {
+  Host::quiet(true);
+  Host::useVirtualClock(true);
+  Host::nvsErase();
+  Host::powerCycle();
+}
+
+void tearDown(void) {}
+
+// ============================
+// Schema
+// ============================
+static void test_first_boot_stores_defaults(void) {
+  ConfigStore::begin();
+  const Config& c = ConfigStore::get();
+  TEST_ASSERT_EQUAL_FLOAT(DEFAULT_TEMP_LOW_C, c.lowC);
+  TEST_ASSERT_EQUAL_FLOAT(DEFAULT_TEMP_HIGH_C, c.highC);
+  TEST_ASSERT_EQUAL_UINT16(DEFAULT_SLEEP_MINUTES, c.sleepMinutes);
+  TEST_ASSERT_EQUAL_UINT16(MQTT_PORT, c.mqttPort);
+  TEST_ASSERT_EQUAL_STRING(MQTT_HOST, c.mqttHost);
+  TEST_ASSERT_EQUAL_UINT8(0, c.mode);
+
+  Preferences prefs;
+  TEST_ASSERT_TRUE(prefs.begin("config", true));
+  TEST_ASSERT_EQUAL_UINT16(ConfigStore::SCHEMA_VERSION, prefs.getUShort("ver", 0));
+  TEST_ASSERT_EQUAL_UINT32(sizeof(Config), prefs.getBytesLength("cfg"));
+  prefs.end();
+}
+
+static void test_v0_migrates_legacy_mode_key(void) {
+  // Before ConfigStore, RuntimeMode kept only the power mode
+  Preferences prefs;
+  prefs.begin("runtime", false);
+  prefs.putUChar("mode", 1);
+  prefs.end();
+
+  ConfigStore::begin();
+  TEST_ASSERT_EQUAL_UINT8(1, ConfigStore::get().mode);
+  TEST_ASSERT_EQUAL_UINT16(DEFAULT_SLEEP_MINUTES, ConfigStore::get().sleepMinutes);
+
+  prefs.begin("runtime", true);
+  TEST_ASSERT_FALSE(prefs.isKey("mode"));   // moved, not copied
+  prefs.end();
+
+  coldBoot();   // from the v1 blob now
+  TEST_ASSERT_EQUAL_UINT8(1, ConfigStore::get().mode);
+}
+
+static void test_migrate_is_pure(void) {
+  Config cfg = ConfigStore::defaults();
+  cfg.sleepMinutes = 42;
+  ConfigStore::migrate(ConfigStore::SCHEMA_VERSION, 1, cfg);
+  TEST_ASSERT_EQUAL_UINT16(42, cfg.sleepMinutes);   // current version: unchanged
+  TEST_ASSERT_EQUAL_UINT8(0, cfg.mode);
+
+  ConfigStore::migrate(0, 1, cfg);
+  TEST_ASSERT_EQUAL_UINT16(DEFAULT_SLEEP_MINUTES, cfg.sleepMinutes);
+  TEST_ASSERT_EQUAL_UINT8(1, cfg.mode);
+}
+
+static void test_shorter_blob_is_a_prefix(void) {
+  // A blob written before fields were appended: the missing tail keeps its defaults
+  Config old = ConfigStore::defaults();
+  old.lowC = 4.5f;
+  old.highC = 26.0f;
+  old.sleepMinutes = 15;
+  writeBlob(1, &old, offsetof(Config, mqttHost));
+
+  ConfigStore::begin();
+  TEST_ASSERT_EQUAL_FLOAT(4.5f, ConfigStore::get().lowC);
+  TEST_ASSERT_EQUAL_FLOAT(26.0f, ConfigStore::get().highC);
+  TEST_ASSERT_EQUAL_UINT16(15, ConfigStore::get().sleepMinutes);
+  TEST_ASSERT_EQUAL_STRING(MQTT_HOST, ConfigStore::get().mqttHost);
+}
+
+static void test_longer_blob_is_ignored(void) {
+  uint8_t blob[sizeof(Config) + 8];
+  Config cfg = ConfigStore::defaults();
+  cfg.sleepMinutes = 15;
+  memcpy(blob, &cfg, sizeof(cfg));
+  writeBlob(1, blob, sizeof(blob));
+
+  ConfigStore::begin();
+  TEST_ASSERT_EQUAL_UINT16(DEFAULT_SLEEP_MINUTES, ConfigStore::get().sleepMinutes);
+}
+
+static void test_newer_schema_runs_on_defaults(void) {
+  // Downgraded firmware: defaults, and the newer NVS is left for the upgrade
+  Config cfg = ConfigStore::defaults();
+  cfg.sleepMinutes = 15;
+  writeBlob(ConfigStore::SCHEMA_VERSION + 1, &cfg, sizeof(cfg));
+
+  ConfigStore::begin();
+  TEST_ASSERT_EQUAL_UINT16(DEFAULT_SLEEP_MINUTES, ConfigStore::get().sleepMinutes);
+
+  Preferences prefs;
+  prefs.begin("config", true);
+  TEST_ASSERT_EQUAL_UINT16(ConfigStore::SCHEMA_VERSION + 1, prefs.getUShort("ver", 0));
+  prefs.end();
+}
+
+static void test_invalid_stored_config_falls_back(void) {
+  Config cfg = ConfigStore::defaults();
+  cfg.lowC = 30.0f;
+  cfg.highC = 10.0f;
+  writeBlob(1, &cfg, sizeof(cfg));
+
+  ConfigStore::begin();
+  TEST_ASSERT_EQUAL_FLOAT(DEFAULT_TEMP_LOW_C, ConfigStore::get().lowC);
+}
+
+// ============================
+// Changes
+// ============================
+static void test_rejected_changes(void) {
+  ConfigStore::begin();
+  TEST_ASSERT_EQUAL_STRING("expected key=value", ConfigStore::stage("low_c"));
+  TEST_ASSERT_EQUAL_STRING("expected key=value", ConfigStore::stage("=5"));
+  TEST_ASSERT_EQUAL_STRING("expected key=value", ConfigStore::stage("low_c="));
+  TEST_ASSERT_EQUAL_STRING("unknown key", ConfigStore::stage("low=5"));
+  TEST_ASSERT_EQUAL_STRING("invalid value", ConfigStore::stage("low_c=abc"));
+  TEST_ASSERT_EQUAL_STRING("invalid value", ConfigStore::stage("high_c=25x"));
+  TEST_ASSERT_EQUAL_STRING("sleep_min out of range", ConfigStore::stage("sleep_min=0"));
+  TEST_ASSERT_EQUAL_STRING("sleep_min out of range", ConfigStore::stage("sleep_min=1441"));
+  TEST_ASSERT_EQUAL_STRING("mqtt_port out of range", ConfigStore::stage("mqtt_port=70000"));
+  TEST_ASSERT_EQUAL_STRING("threshold out of range", ConfigStore::stage("high_c=100"));
+  TEST_ASSERT_EQUAL_STRING("low_c must be below high_c", ConfigStore::stage("low_c=35"));
+
+  char host[80];
+  memset(host, 'a', sizeof(host));
+  memcpy(host, "mqtt_host=", 10);
+  host[sizeof(host) - 1] = '\0';
+  TEST_ASSERT_EQUAL_STRING("mqtt_host too long", ConfigStore::stage(host));
+
+  TEST_ASSERT_FALSE(ConfigStore::hasStaged());
+}
+
+static void test_staged_until_next_wake(void) {
+  ConfigStore::begin();
+  TEST_ASSERT_NULL(ConfigStore::stage("sleep_min=10"));
+  TEST_ASSERT_NULL(ConfigStore::stage("low_c=5"));   // stacks on the first
+  TEST_ASSERT_TRUE(ConfigStore::hasStaged());
+  TEST_ASSERT_EQUAL_UINT16(DEFAULT_SLEEP_MINUTES, ConfigStore::get().sleepMinutes);
+
+  wake();
+  TEST_ASSERT_FALSE(ConfigStore::hasStaged());
+  TEST_ASSERT_EQUAL_UINT16(10, ConfigStore::get().sleepMinutes);
+  TEST_ASSERT_EQUAL_FLOAT(5.0f, ConfigStore::get().lowC);
+
+  coldBoot();   // and stored
+  TEST_ASSERT_EQUAL_UINT16(10, ConfigStore::get().sleepMinutes);
+}
+
+static void test_staged_change_survives_power_loss(void) {
+  ConfigStore::begin();
+  TEST_ASSERT_NULL(ConfigStore::stage("high_c=28.5"));
+  coldBoot();
+  TEST_ASSERT_EQUAL_FLOAT(28.5f, ConfigStore::get().highC);
+  TEST_ASSERT_FALSE(ConfigStore::hasStaged());
+}
+
+static void test_mode_stored_at_once_and_kept_by_staged_change(void) {
+  ConfigStore::begin();
+  TEST_ASSERT_NULL(ConfigStore::stage("sleep_min=20"));
+  TEST_ASSERT_TRUE(ConfigStore::setMode(1));
+  TEST_ASSERT_EQUAL_UINT8(1, ConfigStore::get().mode);
+
+  wake();   // the staged copy still has mode 0
+  TEST_ASSERT_EQUAL_UINT8(1, ConfigStore::get().mode);
+  TEST_ASSERT_EQUAL_UINT16(20, ConfigStore::get().sleepMinutes);
+  coldBoot();
+  TEST_ASSERT_EQUAL_UINT8(1, ConfigStore::get().mode);
+}
+
+static void test_store_failure_is_reported(void) {
+  ConfigStore::begin();
+  Host::nvsFailWrites(true);
+  TEST_ASSERT_EQUAL_STRING("store failed", ConfigStore::stage("sleep_min=10"));
+  TEST_ASSERT_FALSE(ConfigStore::setMode(1));
+  TEST_ASSERT_EQUAL_UINT8(0, ConfigStore::get().mode);
+  TEST_ASSERT_FALSE(ConfigStore::hasStaged());
+}
+
+// ============================
+// Broker trial
+// ============================
+static void test_broker_change_rolled_back_after_failed_connects(void) {
+  ConfigStore::begin();
+  TEST_ASSERT_NULL(ConfigStore::stage("mqtt_host=10.0.0.9"));
+  wake();
+  TEST_ASSERT_EQUAL_STRING("10.0.0.9", ConfigStore::get().mqttHost);
+
+  for (int i = 1; i < CONFIG_TRIAL_CONNECTS; i++) {
+    ConfigStore::reportConnect(false);
+    wake();
+    TEST_ASSERT_EQUAL_STRING("10.0.0.9", ConfigStore::get().mqttHost);
+  }
+  ConfigStore::reportConnect(false);
+  TEST_ASSERT_EQUAL_STRING(MQTT_HOST, ConfigStore::get().mqttHost);
+
+  coldBoot();   // rolled back in NVS too, and no longer on trial
+  TEST_ASSERT_EQUAL_STRING(MQTT_HOST, ConfigStore::get().mqttHost);
+  char json[256];
+  ConfigStore::formatJson(json, sizeof(json));
+  TEST_ASSERT_NOT_NULL(strstr(json, "\"trial\":0}"));
+}
+
+static void test_broker_change_confirmed_by_connect(void) {
+  ConfigStore::begin();
+  TEST_ASSERT_NULL(ConfigStore::stage("mqtt_port=8883"));
+  wake();
+  ConfigStore::reportConnect(false);
+  ConfigStore::reportConnect(true);
+  for (int i = 0; i < CONFIG_TRIAL_CONNECTS; i++) {
+    ConfigStore::reportConnect(false);   // the broker itself is fine now
+  }
+  TEST_ASSERT_EQUAL_UINT16(8883, ConfigStore::get().mqttPort);
+}
+
+static void test_trial_survives_power_loss(void) {
+  ConfigStore::begin();
+  TEST_ASSERT_NULL(ConfigStore::stage("mqtt_host=broker.invalid"));
+  wake();
+  coldBoot();
+  char json[256];
+  ConfigStore::formatJson(json, sizeof(json));
+  TEST_ASSERT_NOT_NULL(strstr(json, "\"trial\":1}"));
+  for (int i = 0; i < CONFIG_TRIAL_CONNECTS; i++) {
+    ConfigStore::reportConnect(false);
+  }
+  TEST_ASSERT_EQUAL_STRING(MQTT_HOST, ConfigStore::get().mqttHost);
+}
+
+// ============================
+// RTC cache
+// ============================
+static void test_timer_wakes_do_not_open_nvs(void) {
+  ConfigStore::begin();
+  uint32_t opens = Host::nvsOpens();
+  for (int i = 0; i < 100; i++) {
+    wake();
+  }
+  TEST_ASSERT_EQUAL_UINT32(opens, Host::nvsOpens());
+
+  coldBoot();
+  TEST_ASSERT_GREATER_THAN_UINT32(opens, Host::nvsOpens());
+}
+
+static void test_corrupt_cache_reloads_from_nvs(void) {
+  ConfigStore::begin();
+  TEST_ASSERT_NULL(ConfigStore::stage("sleep_min=30"));
+  wake();
+
+  // A bit flip in RTC memory (brown-out during sleep)
+  size_t size = Host::rtcSize();
+  uint8_t* image = (uint8_t*)malloc(size);
+  Host::rtcSave(image);
+  image[size / 2] ^= 0x10;
+  Host::rtcLoad(image);
+  free(image);
+
+  uint32_t opens = Host::nvsOpens();
+  wake();
+  TEST_ASSERT_GREATER_THAN_UINT32(opens, Host::nvsOpens());
+  TEST_ASSERT_EQUAL_UINT16(30, ConfigStore::get().sleepMinutes);
+}
+
+static void test_format_json(void) {
+  ConfigStore::begin();
+  char json[256];
+  int n = ConfigStore::formatJson(json, sizeof(json));
+  TEST_ASSERT_EQUAL_INT((int)strlen(json), n);
+  char expected[256];
+  snprintf(expected, sizeof(expected),
+           "{\"ver\":%u,\"low_c\":%.1f,\"high_c\":%.1f,\"sleep_min\":%u,"
+           "\"mqtt_host\":\"%s\",\"mqtt_port\":%u,\"staged\":0,\"trial\":0}",
+           ConfigStore::SCHEMA_VERSION, DEFAULT_TEMP_LOW_C, DEFAULT_TEMP_HIGH_C,
+           DEFAULT_SLEEP_MINUTES, MQTT_HOST, MQTT_PORT);
+  TEST_ASSERT_EQUAL_STRING(expected, json);
+  TEST_ASSERT_EQUAL_INT(0, ConfigStore::formatJson(json, 20));   // does not fit
+}
+
+int main(int argc, char** argv) {
+  (void)argc;
+  (void)argv;
+  UNITY_BEGIN();
+  RUN_TEST(test_first_boot_stores_defaults);
+  RUN_TEST(test_v0_migrates_legacy_mode_key);
+  RUN_TEST(test_migrate_is_pure);
+  RUN_TEST(test_shorter_blob_is_a_prefix);
+  RUN_TEST(test_longer_blob_is_ignored);
+  RUN_TEST(test_newer_schema_runs_on_defaults);
+  RUN_TEST(test_invalid_stored_config_falls_back);
+  RUN_TEST(test_rejected_changes);
+  RUN_TEST(test_staged_until_next_wake);
+  RUN_TEST(test_staged_change_survives_power_loss);
+  RUN_TEST(test_mode_stored_at_once_and_kept_by_staged_change);
+  RUN_TEST(test_store_failure_is_reported);
+  RUN_TEST(test_broker_change_rolled_back_after_failed_connects);
+  RUN_TEST(test_broker_change_confirmed_by_connect);
+  RUN_TEST(test_trial_survives_power_loss);
+  RUN_TEST(test_timer_wakes_do_not_open_nvs);
+  RUN_TEST(test_corrupt_cache_reloads_from_nvs);
+  RUN_TEST(test_format_json);
+  return UNITY_END();
+}
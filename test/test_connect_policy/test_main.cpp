@@ -0,0 +1,166 @@
+// ConnectPolicy: cross-wake backoff sequence and learned connect deadlines.
+
+#include <unity.h>
+#include <string.h>
+#include <ConnectPolicy.h>
+#include <config_common.h>
+
+static ConnectPolicy::State state;
+
+void setUp(void) {
+  memset(&state, 0, sizeof(state));
+}
+
+void tearDown(void) {}
+
+// One wake while the broker stays down: true if it used the radio
+static bool failingWake() {
+  if (!ConnectPolicy::attempt(state)) {
+    return false;
+  }
+  ConnectPolicy::report(state, false);
+  return true;
+}
+
+static void recordWifiMany(uint32_t ms, int n) {
+  for (int i = 0; i < n; i++) {
+    ConnectPolicy::recordWifi(state, ms);
+  }
+}
+
+// ============================
+// Backoff
+// ============================
+static void test_backoff_sequence(void) {
+  // Wakes skipped between attempts: 0 after the first failure, then 1, 2, 4, ... capped
+  const uint32_t expected[] = { 0, 1, 2, 4, 8, 16, 16, 16, 16 };
+  const size_t gaps = sizeof(expected) / sizeof(expected[0]);
+
+  TEST_ASSERT_TRUE(failingWake());
+  for (size_t i = 0; i < gaps; i++) {
+    uint32_t skipped = 0;
+    while (!failingWake()) {
+      skipped++;
+      TEST_ASSERT_LESS_OR_EQUAL_UINT32(CONNECT_BACKOFF_MAX_SKIPS, skipped);
+    }
+    TEST_ASSERT_EQUAL_UINT32(expected[i], skipped);
+  }
+}
+
+static void test_backoff_state_while_skipping(void) {
+  ConnectPolicy::report(state, false);
+  TEST_ASSERT_FALSE(ConnectPolicy::backingOff(state));   // first failure: retry next wake
+  ConnectPolicy::report(state, false);
+  TEST_ASSERT_TRUE(ConnectPolicy::backingOff(state));
+  TEST_ASSERT_FALSE(ConnectPolicy::attempt(state));
+  TEST_ASSERT_FALSE(ConnectPolicy::backingOff(state));
+  TEST_ASSERT_TRUE(ConnectPolicy::attempt(state));
+  TEST_ASSERT_EQUAL_UINT16(3, state.offlineWakes);        // two failed, one skipped
+}
+
+static void test_success_ends_outage(void) {
+  for (int i = 0; i < 10; i++) {
+    failingWake();
+  }
+  uint16_t offline = state.offlineWakes;
+  TEST_ASSERT_EQUAL_UINT16(10, offline);
+
+  // Next attempt after the backoff succeeds
+  while (!ConnectPolicy::attempt(state)) {
+  }
+  ConnectPolicy::report(state, true);
+  TEST_ASSERT_EQUAL_UINT8(0, state.failures);
+  TEST_ASSERT_FALSE(ConnectPolicy::backingOff(state));
+  TEST_ASSERT_GREATER_THAN(offline, state.lastOutageWakes);
+
+  // A success without an outage keeps the last outage
+  uint16_t last = state.lastOutageWakes;
+  ConnectPolicy::report(state, true);
+  TEST_ASSERT_EQUAL_UINT16(last, state.lastOutageWakes);
+}
+
+static void test_long_outage_saturates(void) {
+  // Weeks offline: failures and the shift stay in range, skips stay capped
+  for (int i = 0; i < 5000; i++) {
+    failingWake();
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(CONNECT_BACKOFF_MAX_SKIPS, state.skipsLeft);
+  }
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(16, state.failures);
+  TEST_ASSERT_EQUAL_UINT16(5000, state.offlineWakes);
+}
+
+// ============================
+// Deadlines
+// ============================
+static void test_no_deadline_before_enough_samples(void) {
+  recordWifiMany(300, CONNECT_LEARN_MIN_SAMPLES - 1);
+  TEST_ASSERT_EQUAL_UINT32(0, ConnectPolicy::deadlines(state).wifiMs);
+  ConnectPolicy::recordWifi(state, 300);
+  TEST_ASSERT_NOT_EQUAL(0, ConnectPolicy::deadlines(state).wifiMs);
+  TEST_ASSERT_EQUAL_UINT32(0, ConnectPolicy::deadlines(state).mqttMs);
+}
+
+static void test_deadline_is_percentile_bucket_plus_margin(void) {
+  // 300 ms is in [256, 512): bound 512 + margin
+  recordWifiMany(300, 19);
+  ConnectPolicy::recordWifi(state, 5000);   // 1 of 20 above the 95th percentile
+  TEST_ASSERT_EQUAL_UINT32(512 + CONNECT_DEADLINE_MARGIN_MS, ConnectPolicy::deadlines(state).wifiMs);
+
+  // 2 of 21 slow: the percentile moves to 5000 ms, in [4096, 8192)
+  ConnectPolicy::recordWifi(state, 5000);
+  TEST_ASSERT_EQUAL_UINT32(8192 + CONNECT_DEADLINE_MARGIN_MS, ConnectPolicy::deadlines(state).wifiMs);
+}
+
+static void test_deadline_minimum(void) {
+  for (int i = 0; i < 20; i++) {
+    ConnectPolicy::recordMqtt(state, 40);
+  }
+  TEST_ASSERT_EQUAL_UINT32(CONNECT_DEADLINE_MIN_MS, ConnectPolicy::deadlines(state).mqttMs);
+}
+
+static void test_no_deadlines_after_failure(void) {
+  recordWifiMany(300, 20);
+  ConnectPolicy::report(state, false);
+  TEST_ASSERT_EQUAL_UINT32(0, ConnectPolicy::deadlines(state).wifiMs);
+  ConnectPolicy::report(state, true);
+  TEST_ASSERT_EQUAL_UINT32(512 + CONNECT_DEADLINE_MARGIN_MS, ConnectPolicy::deadlines(state).wifiMs);
+}
+
+static void test_histogram_halves_instead_of_overflowing(void) {
+  recordWifiMany(300, 70000);
+  recordWifiMany(5000, 1000);
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(UINT16_MAX, state.wifiHist[8]);
+  TEST_ASSERT_GREATER_THAN_UINT32(UINT16_MAX / 4, state.wifiHist[8]);
+  // Shape kept: the slow samples are still under 5 % of the total
+  TEST_ASSERT_EQUAL_UINT32(512 + CONNECT_DEADLINE_MARGIN_MS, ConnectPolicy::deadlines(state).wifiMs);
+
+  // Very long times land in the last bucket
+  ConnectPolicy::recordMqtt(state, 200000);
+  TEST_ASSERT_EQUAL_UINT16(1, state.mqttHist[ConnectPolicy::LATENCY_BUCKETS - 1]);
+}
+
+static void test_status_fields(void) {
+  recordWifiMany(300, 8);
+  state.lastOutageWakes = 12;
+  char buf[96];
+  int n = ConnectPolicy::formatStatusFields(state, buf, sizeof(buf));
+  TEST_ASSERT_EQUAL_STRING("\"conn\":{\"wifi_dl\":1012,\"mqtt_dl\":0,\"outage\":12}", buf);
+  TEST_ASSERT_EQUAL((int)strlen(buf), n);
+}
+
+int main(int argc, char** argv) {
+  (void)argc;
+  (void)argv;
+  UNITY_BEGIN();
+  RUN_TEST(test_backoff_sequence);
+  RUN_TEST(test_backoff_state_while_skipping);
+  RUN_TEST(test_success_ends_outage);
+  RUN_TEST(test_long_outage_saturates);
+  RUN_TEST(test_no_deadline_before_enough_samples);
+  RUN_TEST(test_deadline_is_percentile_bucket_plus_margin);
+  RUN_TEST(test_deadline_minimum);
+  RUN_TEST(test_no_deadlines_after_failure);
+  RUN_TEST(test_histogram_halves_instead_of_overflowing);
+  RUN_TEST(test_status_fields);
+  return UNITY_END();
+}
@@ -0,0 +1,193 @@
+// EnergyModel in virtual time: phase charges at the ENERGY_MA_* currents,
+// deep sleep charged for the time actually slept, totals kept across deep
+// sleep and reset by a power cycle, and the status fields.
+
+#include <unity.h>
+#include <Host.h>
+#include <sys/time.h>
+#include <EnergyModel.h>
+#include <config_common.h>
+
+typedef EnergyModel::Phase Phase;
+
+// The SPEC.md example wake: boot, sensor, WiFi, MQTT, TX, flush (ms)
+static const uint32_t EXAMPLE_MS[6] = { 120, 40, 1350, 410, 300, 90 };
+static const uint32_t EXAMPLE_WAKE_MS = 2310;
+
+static double exampleWakeMah() {
+  const float ma[6] = { ENERGY_MA_BOOT, ENERGY_MA_SENSOR, ENERGY_MA_WIFI_ASSOC,
+                        ENERGY_MA_MQTT, ENERGY_MA_TX, ENERGY_MA_FLUSH };
+  double mah = 0.0;
+  for (int i = 0; i < 6; i++) {
+    mah += ma[i] * EXAMPLE_MS[i] / 3600000.0;
+  }
+  return mah;
+}
+
+// One wake through all phases, as main marks them
+static void runWake(const uint32_t ms[6]) {
+  EnergyModel::beginWake();
+  for (uint8_t i = 0; i < 6; i++) {
+    EnergyModel::mark((Phase)i);
+    Host::advance(ms[i]);
+  }
+  EnergyModel::endWake();
+}
+
+static void sleepMs(uint32_t ms) {
+  Host::deepSleep((uint64_t)ms * 1000);
+}
+
+void setUp(void) {
+  Host::quiet(true);
+  Host::useVirtualClock(true);
+  Host::powerCycle();
+  Host::setTime(1767225600);
+}
+
+void tearDown(void) {}
+
+// ============================
+// Wake
+// ============================
+static void test_unknown_before_first_cycle(void) {
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, EnergyModel::mAhPerDay());
+  TEST_ASSERT_EQUAL_FLOAT(-1.0f, EnergyModel::daysRemaining());
+
+  char buf[200];
+  EnergyModel::formatStatusFields(buf, sizeof(buf));
+  TEST_ASSERT_EQUAL_STRING("\"energy\":{\"wake_ms\":0,\"wake_mah\":0.0000,\"mah_day\":0.00,"
+                           "\"days_left\":-1,\"phase_ms\":[0,0,0,0,0,0]}", buf);
+}
+
+static void test_phases_charged_at_their_currents(void) {
+  runWake(EXAMPLE_MS);
+
+  char buf[200];
+  EnergyModel::formatStatusFields(buf, sizeof(buf));
+  char expected[200];
+  snprintf(expected, sizeof(expected),
+           "\"energy\":{\"wake_ms\":2310,\"wake_mah\":%.4f,", exampleWakeMah());
+  TEST_ASSERT_EQUAL_STRING_LEN(expected, buf, strlen(expected));
+  TEST_ASSERT_NOT_NULL(strstr(buf, "\"phase_ms\":[120,40,1350,410,300,90]}"));
+  TEST_ASSERT_NOT_NULL(strstr(buf, "\"wake_mah\":0.0729,"));   // as in SPEC.md
+}
+
+static void test_mark_same_phase_is_a_no_op(void) {
+  EnergyModel::beginWake();
+  Host::advance(100);
+  EnergyModel::mark(Phase::Boot);
+  EnergyModel::mark(Phase::Count);   // not a phase: ignored
+  Host::advance(100);
+  EnergyModel::mark(Phase::Tx);      // phases may be skipped
+  Host::advance(50);
+  EnergyModel::endWake();
+
+  char buf[200];
+  EnergyModel::formatStatusFields(buf, sizeof(buf));
+  TEST_ASSERT_NOT_NULL(strstr(buf, "\"wake_ms\":250,"));
+  TEST_ASSERT_NOT_NULL(strstr(buf, "\"phase_ms\":[200,0,0,0,50,0]}"));
+}
+
+// ============================
+// Sleep
+// ============================
+static void test_sleep_charged_on_next_wake(void) {
+  // 5 min cycle: the example wake, then sleep for the rest
+  runWake(EXAMPLE_MS);
+  sleepMs(300000 - EXAMPLE_WAKE_MS);
+  EnergyModel::beginWake();
+
+  double mah = exampleWakeMah() + ENERGY_MA_SLEEP * (300000 - EXAMPLE_WAKE_MS) / 3600000.0;
+  double perDay = mah * 288;
+  TEST_ASSERT_FLOAT_WITHIN(0.001f, (float)perDay, EnergyModel::mAhPerDay());
+  TEST_ASSERT_FLOAT_WITHIN(0.1f, (float)((BATTERY_CAPACITY_MAH - mah) / perDay),
+                           EnergyModel::daysRemaining());
+}
+
+static void test_early_input_wake_charges_actual_sleep(void) {
+  // Planned 5 min, woken by an input after 40 s
+  runWake(EXAMPLE_MS);
+  sleepMs(40000);
+  EnergyModel::beginWake();
+
+  double mah = exampleWakeMah() + ENERGY_MA_SLEEP * 40000 / 3600000.0;
+  double hours = (EXAMPLE_WAKE_MS + 40000) / 3600000.0;
+  TEST_ASSERT_FLOAT_WITHIN(0.01f, (float)(mah / hours * 24), EnergyModel::mAhPerDay());
+}
+
+static void test_clock_stepped_back_charges_no_sleep(void) {
+  // SNTP moved system time back by an hour while asleep: the sleep is unknown
+  runWake(EXAMPLE_MS);
+  double wakeOnly = EnergyModel::mAhPerDay();
+  sleepMs(600000);
+  struct timeval tv;
+  gettimeofday(&tv, nullptr);
+  tv.tv_sec -= 3600;
+  settimeofday(&tv, nullptr);
+  EnergyModel::beginWake();
+  TEST_ASSERT_EQUAL_FLOAT((float)wakeOnly, EnergyModel::mAhPerDay());
+}
+
+static void test_simulated_day(void) {
+  // 288 wakes at 5 min: matches the hand calculation
+  for (int i = 0; i < 288; i++) {
+    runWake(EXAMPLE_MS);
+    sleepMs(300000 - EXAMPLE_WAKE_MS);
+  }
+  EnergyModel::beginWake();
+
+  double awakeH = 288 * EXAMPLE_WAKE_MS / 3600000.0;
+  double perDay = 288 * exampleWakeMah() + ENERGY_MA_SLEEP * (24.0 - awakeH);
+  TEST_ASSERT_FLOAT_WITHIN(0.01f, (float)perDay, EnergyModel::mAhPerDay());
+  TEST_ASSERT_FLOAT_WITHIN(1.0f, (float)(BATTERY_CAPACITY_MAH / perDay - 1.0),
+                           EnergyModel::daysRemaining());
+}
+
+// ============================
+// Totals
+// ============================
+static void test_battery_used_up(void) {
+  const uint32_t longTx[6] = { 0, 0, 0, 0, 20UL * 3600 * 1000, 0 };   // 2600 mAh
+  runWake(longTx);
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, EnergyModel::daysRemaining());
+}
+
+static void test_power_cycle_resets_totals(void) {
+  runWake(EXAMPLE_MS);
+  sleepMs(300000);
+  EnergyModel::beginWake();
+  TEST_ASSERT_GREATER_THAN(0, (int)(EnergyModel::mAhPerDay() * 100));
+
+  Host::powerCycle();
+  EnergyModel::beginWake();   // system time 0 and no sleep recorded
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, EnergyModel::mAhPerDay());
+  TEST_ASSERT_EQUAL_FLOAT(-1.0f, EnergyModel::daysRemaining());
+}
+
+static void test_status_fits_or_truncates(void) {
+  runWake(EXAMPLE_MS);
+  char buf[32];
+  memset(buf, 'x', sizeof(buf));
+  int used = EnergyModel::formatStatusFields(buf, 20);
+  TEST_ASSERT_GREATER_OR_EQUAL(20, used);
+  TEST_ASSERT_EQUAL_INT('\0', buf[19]);
+  TEST_ASSERT_EQUAL_INT('x', buf[20]);
+}
+
+int main(int argc, char** argv) {
+  (void)argc;
+  (void)argv;
+  UNITY_BEGIN();
+  RUN_TEST(test_unknown_before_first_cycle);
+  RUN_TEST(test_phases_charged_at_their_currents);
+  RUN_TEST(test_mark_same_phase_is_a_no_op);
+  RUN_TEST(test_sleep_charged_on_next_wake);
+  RUN_TEST(test_early_input_wake_charges_actual_sleep);
+  RUN_TEST(test_clock_stepped_back_charges_no_sleep);
+  RUN_TEST(test_simulated_day);
+  RUN_TEST(test_battery_used_up);
+  RUN_TEST(test_power_cycle_resets_totals);
+  RUN_TEST(test_status_fits_or_truncates);
+  return UNITY_END();
+}
@@ -0,0 +1,339 @@
+// HistoryReplay through the real ConnectionManager and Comms against a
+// FakeBroker on loopback: the "history" command, size-bounded chunks that
+// together carry every record once, the resume token across a dropped
+// connection and deep sleep, and the replay throughput in records/s.
+
+#include <unity.h>
+#include <Host.h>
+#include <FakeBroker.h>
+#include <WiFi.h>
+#include <ConfigStore.h>
+#include <ConnectionManager.h>
+#include <Comms.h>
+#include <HistoryReplay.h>
+#include <ReadingHistory.h>
+#include <config_common.h>
+#include <vector>
+
+static const time_t T0 = 1767225600;   // 2026-01-01
+static const uint64_t US = 1000000;
+static const uint32_t CONNECT_TIMEOUT_MS = 5000;
+static const uint32_t REPLAY_TIMEOUT_MS = 10000;
+
+struct Chunk {
+  unsigned seq;
+  unsigned long since;
+  unsigned long until;
+  unsigned long resume;
+  unsigned skip;
+  int done;
+  std::vector<unsigned long> epochs;
+  size_t recordBytes;
+};
+
+static FakeBroker broker;
+static ConnectionManager cm;
+static Comms comms;
+static HistoryReplay replay;
+
+// ============================
+// Helpers
+// ============================
+static bool parseChunk(const std::string& payload, Chunk& c) {
+  int n = 0;
+  if (sscanf(payload.c_str(),
+             "{\"seq\":%u,\"since\":%lu,\"until\":%lu,\"resume\":%lu,\"skip\":%u,\"done\":%d,\"r\":[%n",
+             &c.seq, &c.since, &c.until, &c.resume, &c.skip, &c.done, &n) != 6 || n == 0) {
+    return false;
+  }
+  const char* p = payload.c_str() + n;
+  const char* end = payload.c_str() + payload.size() - 2;   // "]}"
+  if (strcmp(end, "]}") != 0) {
+    return false;
+  }
+  c.recordBytes = (size_t)(end - p);
+  c.epochs.clear();
+  while (p < end) {
+    unsigned long epoch;
+    int temp;
+    unsigned hum;
+    int used = 0;
+    if (sscanf(p, "%*[,][%lu,%d,%u]%n", &epoch, &temp, &hum, &used) != 3 &&
+        sscanf(p, "[%lu,%d,%u]%n", &epoch, &temp, &hum, &used) != 3) {
+      return false;
+    }
+    c.epochs.push_back(epoch);
+    p += used;
+  }
+  return true;
+}
+
+static std::vector<Chunk> chunks() {
+  std::vector<Chunk> out;
+  for (const FakeBroker::Message& m : broker.messages(MQTT_TOPIC_HISTORY)) {
+    Chunk c;
+    TEST_ASSERT_TRUE_MESSAGE(parseChunk(m.payload, c), m.payload.c_str());
+    out.push_back(c);
+  }
+  return out;
+}
+
+static bool lastChunkDone() {
+  std::vector<FakeBroker::Message> log = broker.messages(MQTT_TOPIC_HISTORY);
+  return !log.empty() && log.back().payload.find("\"done\":1") != std::string::npos;
+}
+
+// Run the firmware's network loop until pred holds (broker thread in parallel)
+template <typename Pred>
+static bool serviceUntil(Pred pred, uint32_t timeoutMs) {
+  uint32_t start = millis();
+  while (!pred()) {
+    if (millis() - start >= timeoutMs) {
+      return false;
+    }
+    cm.loop();
+  }
+  return true;
+}
+
+// A wake up to the MQTT session, as in setup()
+static void startWake() {
+  ConfigStore::begin();
+  cm.begin();
+  comms.begin(cm);
+  replay.begin(comms);
+  cm.setComms(&comms);
+  cm.setHistoryReplay(&replay);
+  TEST_ASSERT_TRUE(serviceUntil([] { return cm.mqttConnected(); }, CONNECT_TIMEOUT_MS));
+
+  // Commands sent from here on reach the node (or its session)
+  TEST_ASSERT_TRUE(serviceUntil([] { return broker.subscribed(MQTT_TOPIC_CMD); }, CONNECT_TIMEOUT_MS));
+}
+
+static void sendCommand(const char* cmd) {
+  broker.publish(MQTT_TOPIC_CMD, cmd, 1);
+}
+
+static std::string lastResponse() {
+  std::vector<FakeBroker::Message> log = broker.messages(MQTT_TOPIC_RESP);
+  return log.empty() ? "" : log.back().payload;
+}
+
+// perEpoch records per second from T0 (a batch wake stores several at once)
+static void storeReadings(uint16_t n, uint16_t perEpoch = 1) {
+  for (uint16_t i = 0; i < n; i++) {
+    ReadingHistory::append(T0 + i / perEpoch, 20.0f + i * 0.01f, 50.0f);
+  }
+}
+
+void setUp(void) {
+  Host::quiet(true);
+  Host::useVirtualClock(false);
+  Host::nvsErase();
+  Host::powerCycle();   // empty history, no replay in RTC memory
+  Host::setWifi(true);
+
+  broker.dropClients();
+  broker.clearLog();
+  startWake();
+}
+
+void tearDown(void) {}
+
+// ============================
+// Command
+// ============================
+static void test_command_starts_replay(void) {
+  storeReadings(10);
+  sendCommand("history since=1767225602 until=1767225605");
+
+  TEST_ASSERT_TRUE(serviceUntil(lastChunkDone, REPLAY_TIMEOUT_MS));
+  std::string resp = lastResponse();
+  TEST_ASSERT_EQUAL_STRING("history: started", resp.c_str());
+
+  std::vector<Chunk> got = chunks();
+  TEST_ASSERT_EQUAL(1, got.size());
+  TEST_ASSERT_EQUAL_UINT(0, got[0].seq);
+  TEST_ASSERT_EQUAL_UINT32(T0 + 2, got[0].since);
+  TEST_ASSERT_EQUAL_UINT32(T0 + 5, got[0].until);
+  TEST_ASSERT_EQUAL(4, got[0].epochs.size());
+  TEST_ASSERT_EQUAL_UINT32(T0 + 2, got[0].epochs.front());
+  TEST_ASSERT_EQUAL_UINT32(T0 + 5, got[0].epochs.back());
+  TEST_ASSERT_EQUAL_UINT32(T0 + 5, got[0].resume);
+  TEST_ASSERT_EQUAL_UINT(1, got[0].skip);
+  TEST_ASSERT_FALSE(replay.active());
+}
+
+static void test_rejected_range(void) {
+  storeReadings(10);
+  sendCommand("history since=1767225605 until=1767225602");
+
+  TEST_ASSERT_TRUE(serviceUntil([] { return !lastResponse().empty(); }, REPLAY_TIMEOUT_MS));
+  std::string resp = lastResponse();
+  TEST_ASSERT_EQUAL_STRING("history: rejected", resp.c_str());
+  TEST_ASSERT_FALSE(replay.active());
+  TEST_ASSERT_EQUAL(0, broker.count(MQTT_TOPIC_HISTORY));
+}
+
+// ============================
+// Chunks
+// ============================
+static void test_chunks_bounded_and_complete(void) {
+  storeReadings(HISTORY_CAPACITY);
+  sendCommand("history since=0");
+
+  TEST_ASSERT_TRUE(serviceUntil(lastChunkDone, REPLAY_TIMEOUT_MS));
+  std::vector<Chunk> got = chunks();
+  TEST_ASSERT_TRUE(got.size() > 1);
+
+  std::vector<unsigned long> all;
+  for (size_t i = 0; i < got.size(); i++) {
+    TEST_ASSERT_EQUAL_UINT(i, got[i].seq);
+    TEST_ASSERT_EQUAL_INT(i + 1 == got.size() ? 1 : 0, got[i].done);
+    TEST_ASSERT_TRUE(got[i].recordBytes <= HISTORY_CHUNK_MAX_BYTES);
+    all.insert(all.end(), got[i].epochs.begin(), got[i].epochs.end());
+  }
+  TEST_ASSERT_EQUAL(HISTORY_CAPACITY, all.size());
+  for (size_t i = 0; i < all.size(); i++) {
+    TEST_ASSERT_EQUAL_UINT32(T0 + i, all[i]);
+  }
+}
+
+static void test_ring_keeps_newest(void) {
+  storeReadings(HISTORY_CAPACITY + 10);
+  sendCommand("history since=0");
+
+  TEST_ASSERT_TRUE(serviceUntil(lastChunkDone, REPLAY_TIMEOUT_MS));
+  std::vector<Chunk> got = chunks();
+  TEST_ASSERT_EQUAL_UINT32(T0 + 10, got.front().epochs.front());
+  TEST_ASSERT_EQUAL_UINT32(T0 + HISTORY_CAPACITY + 9, got.back().epochs.back());
+}
+
+// ============================
+// Batch uplink
+// ============================
+static void test_batch_range_queued_once(void) {
+  storeReadings(10);
+
+  // Two wakes that could not connect ask for the same range
+  replay.enqueue(T0 + 1, 0xFFFFFFFF);
+  replay.enqueue(T0 + 1, 0xFFFFFFFF);
+
+  TEST_ASSERT_TRUE(serviceUntil(lastChunkDone, REPLAY_TIMEOUT_MS));
+  cm.loop();
+  TEST_ASSERT_FALSE(replay.active());
+  std::vector<Chunk> got = chunks();
+  TEST_ASSERT_EQUAL(1, got.size());
+  TEST_ASSERT_EQUAL(9, got[0].epochs.size());
+}
+
+// ============================
+// Resume
+// ============================
+static void test_continues_on_next_wake(void) {
+  storeReadings(HISTORY_CAPACITY);
+  sendCommand("history since=0");
+
+  // The loop that handles the command sends the first chunk
+  TEST_ASSERT_TRUE(serviceUntil([] { return replay.active(); }, REPLAY_TIMEOUT_MS));
+  TEST_ASSERT_TRUE(broker.waitFor(MQTT_TOPIC_HISTORY, 1, REPLAY_TIMEOUT_MS));
+  TEST_ASSERT_EQUAL(1, broker.count(MQTT_TOPIC_HISTORY));
+
+  // Asleep mid-transfer: the replay state is in RTC memory
+  broker.dropClients();
+  Host::deepSleep(60 * US);
+  startWake();
+
+  TEST_ASSERT_TRUE(serviceUntil(lastChunkDone, REPLAY_TIMEOUT_MS));
+  std::vector<Chunk> got = chunks();
+  std::vector<unsigned long> all;
+  for (size_t i = 0; i < got.size(); i++) {
+    TEST_ASSERT_EQUAL_UINT(i, got[i].seq);
+    all.insert(all.end(), got[i].epochs.begin(), got[i].epochs.end());
+  }
+  TEST_ASSERT_EQUAL(HISTORY_CAPACITY, all.size());
+  for (size_t i = 0; i < all.size(); i++) {
+    TEST_ASSERT_EQUAL_UINT32(T0 + i, all[i]);
+  }
+}
+
+static void test_resume_token_with_batched_epochs(void) {
+  // Four records per second: chunk boundaries fall inside an epoch
+  storeReadings(HISTORY_CAPACITY, 4);
+  sendCommand("history since=0");
+  TEST_ASSERT_TRUE(serviceUntil([] { return replay.active(); }, REPLAY_TIMEOUT_MS));
+  TEST_ASSERT_TRUE(broker.waitFor(MQTT_TOPIC_HISTORY, 1, REPLAY_TIMEOUT_MS));
+  Chunk first = chunks().front();
+  TEST_ASSERT_EQUAL_INT(0, first.done);
+  TEST_ASSERT_TRUE(first.skip > 0);
+
+  // The server lost the rest and asks again with the token of the first
+  // chunk: the new request replaces the transfer in progress
+  char cmd[96];
+  snprintf(cmd, sizeof(cmd), "history since=%lu skip=%u until=%lu", first.resume, first.skip, first.until);
+  broker.clearLog();
+  sendCommand(cmd);
+  TEST_ASSERT_TRUE(serviceUntil(lastChunkDone, REPLAY_TIMEOUT_MS));
+
+  // A chunk of the old transfer may still go out before the command is read
+  std::vector<unsigned long> all = first.epochs;
+  for (const Chunk& c : chunks()) {
+    if (c.since == first.resume) {
+      all.insert(all.end(), c.epochs.begin(), c.epochs.end());
+    }
+  }
+  TEST_ASSERT_EQUAL(HISTORY_CAPACITY, all.size());
+  for (size_t i = 0; i < all.size(); i++) {
+    TEST_ASSERT_EQUAL_UINT32(T0 + i / 4, all[i]);
+  }
+}
+
+// ============================
+// Throughput
+// ============================
+static void test_throughput(void) {
+  storeReadings(HISTORY_CAPACITY);
+  sendCommand("history since=0");
+  TEST_ASSERT_TRUE(serviceUntil([] { return replay.active(); }, REPLAY_TIMEOUT_MS));
+
+  uint32_t start = micros();
+  TEST_ASSERT_TRUE(serviceUntil([] { return !replay.active(); }, REPLAY_TIMEOUT_MS));
+  uint32_t sentUs = micros() - start;
+  TEST_ASSERT_TRUE(serviceUntil(lastChunkDone, REPLAY_TIMEOUT_MS));
+  uint32_t receivedUs = micros() - start;
+
+  size_t bytes = 0;
+  for (const FakeBroker::Message& m : broker.messages(MQTT_TOPIC_HISTORY)) {
+    bytes += m.payload.size();
+  }
+  char msg[128];
+  snprintf(msg, sizeof(msg), "%u records, %u chunks, %u bytes: %.0f records/s (%.0f sent)",
+           (unsigned)HISTORY_CAPACITY, (unsigned)broker.count(MQTT_TOPIC_HISTORY), (unsigned)bytes,
+           HISTORY_CAPACITY * 1e6 / receivedUs, HISTORY_CAPACITY * 1e6 / sentUs);
+  TEST_MESSAGE(msg);
+
+  // Loose floor: a regression that stalls the stream, not a benchmark gate
+  TEST_ASSERT_TRUE(HISTORY_CAPACITY * 1e6 / receivedUs > 200);
+}
+
+int main(int argc, char** argv) {
+  (void)argc;
+  (void)argv;
+  if (!broker.start()) {
+    return 1;
+  }
+  broker.attach(IPAddress(192, 168, 0, 20), MQTT_PORT);
+
+  UNITY_BEGIN();
+  RUN_TEST(test_command_starts_replay);
+  RUN_TEST(test_rejected_range);
+  RUN_TEST(test_chunks_bounded_and_complete);
+  RUN_TEST(test_ring_keeps_newest);
+  RUN_TEST(test_batch_range_queued_once);
+  RUN_TEST(test_continues_on_next_wake);
+  RUN_TEST(test_resume_token_with_batched_epochs);
+  RUN_TEST(test_throughput);
+  int failures = UNITY_END();
+  broker.stop();
+  return failures;
+}
@@ -0,0 +1,196 @@
+// MinMaxTracker: daily windows at the local rollover time (CET/EU in
+// env:native), extreme times, NaN and untimed readings, the float and
+// fixed-point (int16_t) storage, and layout checks on state left in RTC memory.
+
+#include <unity.h>
+#include <Host.h>
+#include <Calendar.h>
+#include <MinMaxTracker.h>
+
+typedef MinMaxTracker<float, 2> FloatTracker;
+typedef MinMaxTracker<int16_t, 2> FixedTracker;
+
+RTC_DATA_ATTR static FloatTracker rtcTracker;
+
+static FloatTracker floats;
+static FixedTracker fixed;
+
+// UTC epoch of a local (CET/CEST) wall-clock time
+static time_t local(int y, int m, int d, int hh, int mm = 0) {
+  time_t guess = (time_t)Calendar::daysFromCivil(y, m, d) * 86400 + hh * 3600 + mm * 60;
+  return guess - Calendar::utcOffset(guess - TZ_STD_OFFSET_MIN * 60);
+}
+
+void setUp(void) {
+  Host::quiet(true);
+  memset((void*)&floats, 0, sizeof(floats));   // as found in RTC memory after power-on
+  memset((void*)&fixed, 0, sizeof(fixed));
+}
+
+void tearDown(void) {}
+
+// ============================
+// Window
+// ============================
+static void test_empty_until_first_reading(void) {
+  TEST_ASSERT_TRUE(isnan(floats.getMin(0)));
+  TEST_ASSERT_TRUE(isnan(floats.getMax(1)));
+  TEST_ASSERT_EQUAL_INT(0, floats.getStats().date_yyyymmdd);
+  TEST_ASSERT_TRUE(isnan(floats.getChannel(5).min));
+}
+
+static void test_tracks_extremes_and_their_times(void) {
+  time_t t0 = local(2026, 7, 15, 11);
+  floats.update({ 20.0f, 60.0f }, t0);
+  floats.update({ 25.5f, 55.0f }, t0 + 600);
+  floats.update({ 18.25f, 70.0f }, t0 + 1200);
+  floats.update({ 22.0f, 65.0f }, t0 + 1800);
+
+  MinMaxWindow::ChannelStats temp = floats.getChannel(0);
+  TEST_ASSERT_EQUAL_FLOAT(18.25f, temp.min);
+  TEST_ASSERT_EQUAL_FLOAT(25.5f, temp.max);
+  TEST_ASSERT_EQUAL_INT64(t0 + 1200, temp.min_time);
+  TEST_ASSERT_EQUAL_INT64(t0 + 600, temp.max_time);
+
+  MinMaxWindow::ChannelStats hum = floats.getChannel(1);
+  TEST_ASSERT_EQUAL_FLOAT(55.0f, hum.min);
+  TEST_ASSERT_EQUAL_FLOAT(70.0f, hum.max);
+  TEST_ASSERT_EQUAL_INT64(t0, floats.getStats().reset_time);
+  TEST_ASSERT_EQUAL_INT(20260715, floats.getStats().date_yyyymmdd);
+}
+
+static void test_nan_leaves_channel_unchanged(void) {
+  time_t t0 = local(2026, 7, 15, 11);
+  floats.update({ NAN, 50.0f }, t0);
+  TEST_ASSERT_TRUE(isnan(floats.getMin(0)));
+  floats.update({ 21.0f, NAN }, t0 + 60);
+  TEST_ASSERT_EQUAL_FLOAT(21.0f, floats.getMin(0));
+  TEST_ASSERT_EQUAL_FLOAT(50.0f, floats.getMax(1));
+}
+
+static void test_rollover_at_local_time(void) {
+  floats.update({ 20.0f, 50.0f }, local(2026, 1, 14, 12));
+  floats.update({ 5.0f, 90.0f }, local(2026, 1, 15, 9, 59));   // same window
+  TEST_ASSERT_EQUAL_FLOAT(5.0f, floats.getMin(0));
+  TEST_ASSERT_EQUAL_INT(20260114, floats.getStats().date_yyyymmdd);
+
+  TEST_ASSERT_TRUE(floats.isNewDay(local(2026, 1, 15, 10)));
+  floats.update({ 12.0f, 60.0f }, local(2026, 1, 15, 10));
+  TEST_ASSERT_EQUAL_FLOAT(12.0f, floats.getMin(0));
+  TEST_ASSERT_EQUAL_FLOAT(12.0f, floats.getMax(0));
+  TEST_ASSERT_EQUAL_INT(20260115, floats.getStats().date_yyyymmdd);
+  TEST_ASSERT_TRUE(floats.wasResetToday(local(2026, 1, 16, 9)));
+}
+
+static void test_rollover_on_dst_days(void) {
+  // Spring forward (2026-03-29): 10:00 CEST is 08:00 UTC
+  floats.update({ 10.0f, 50.0f }, local(2026, 3, 28, 12));
+  time_t utc0759 = (time_t)Calendar::daysFromCivil(2026, 3, 29) * 86400 + 7 * 3600 + 59 * 60;
+  floats.update({ 1.0f, 50.0f }, utc0759);
+  TEST_ASSERT_EQUAL_INT(20260328, floats.getStats().date_yyyymmdd);
+  floats.update({ 3.0f, 50.0f }, utc0759 + 60);
+  TEST_ASSERT_EQUAL_INT(20260329, floats.getStats().date_yyyymmdd);
+  TEST_ASSERT_EQUAL_FLOAT(3.0f, floats.getMin(0));
+
+  // Fall back (2026-10-25): 10:00 CET is 09:00 UTC
+  time_t utc0859 = (time_t)Calendar::daysFromCivil(2026, 10, 25) * 86400 + 8 * 3600 + 59 * 60;
+  floats.update({ 1.0f, 50.0f }, utc0859);
+  TEST_ASSERT_EQUAL_INT(20261024, floats.getStats().date_yyyymmdd);
+  floats.update({ 4.0f, 50.0f }, utc0859 + 60);
+  TEST_ASSERT_EQUAL_INT(20261025, floats.getStats().date_yyyymmdd);
+}
+
+static void test_days_without_readings(void) {
+  // Window starts with the first reading after the gap, not at 10:00
+  floats.update({ 20.0f, 50.0f }, local(2026, 5, 1, 12));
+  time_t later = local(2026, 5, 4, 17, 30);
+  floats.update({ 30.0f, 40.0f }, later);
+  TEST_ASSERT_EQUAL_INT64(later, floats.getStats().reset_time);
+  TEST_ASSERT_EQUAL_INT(20260504, floats.getStats().date_yyyymmdd);
+  TEST_ASSERT_EQUAL_FLOAT(30.0f, floats.getMin(0));
+}
+
+static void test_untimed_readings(void) {
+  // No window yet: dropped
+  floats.updateUntimed({ 20.0f, 50.0f });
+  TEST_ASSERT_TRUE(isnan(floats.getMin(0)));
+  floats.update({ 20.0f, 50.0f }, 0);   // time 0 = RTC unavailable
+  TEST_ASSERT_TRUE(isnan(floats.getMin(0)));
+
+  // Window open: folded with an unknown time
+  floats.update({ 20.0f, 50.0f }, local(2026, 7, 15, 11));
+  floats.update({ 15.0f, 50.0f }, 0);
+  TEST_ASSERT_EQUAL_FLOAT(15.0f, floats.getMin(0));
+  TEST_ASSERT_EQUAL_INT64(0, floats.getChannel(0).min_time);
+  TEST_ASSERT_EQUAL_INT(20260715, floats.getStats().date_yyyymmdd);
+}
+
+// ============================
+// Fixed point
+// ============================
+static void test_fixed_point_hundredths(void) {
+  time_t t0 = local(2026, 7, 15, 11);
+  fixed.update({ 21.346f, -4.004f }, t0);
+  fixed.update({ 21.2f, -4.1f }, t0 + 60);
+  TEST_ASSERT_FLOAT_WITHIN(0.0001f, 21.2f, fixed.getMin(0));
+  TEST_ASSERT_FLOAT_WITHIN(0.0001f, 21.35f, fixed.getMax(0));
+  TEST_ASSERT_FLOAT_WITHIN(0.0001f, -4.1f, fixed.getMin(1));
+  TEST_ASSERT_FLOAT_WITHIN(0.0001f, -4.0f, fixed.getMax(1));
+  TEST_ASSERT_EQUAL_INT64(t0 + 60, fixed.getChannel(1).min_time);
+}
+
+static void test_fixed_point_clamps(void) {
+  TEST_ASSERT_EQUAL_INT16(INT16_MAX, FixedTracker::Codec::encode(500.0f));
+  TEST_ASSERT_EQUAL_INT16(-INT16_MAX, FixedTracker::Codec::encode(-500.0f));   // INT16_MIN = empty
+  TEST_ASSERT_TRUE(isnan(FixedTracker::Codec::decode(INT16_MIN)));
+
+  fixed.update({ -500.0f, 500.0f }, local(2026, 7, 15, 11));
+  TEST_ASSERT_FLOAT_WITHIN(0.0001f, -327.67f, fixed.getMin(0));
+  TEST_ASSERT_FLOAT_WITHIN(0.0001f, 327.67f, fixed.getMax(1));
+}
+
+static void test_fixed_point_is_smaller(void) {
+  TEST_ASSERT_LESS_THAN(sizeof(FloatTracker), sizeof(FixedTracker));
+}
+
+// ============================
+// RTC memory
+// ============================
+static void test_state_from_another_layout_is_discarded(void) {
+  // A float build's window, read back by a fixed-point build after an update
+  floats.update({ 20.0f, 50.0f }, local(2026, 7, 15, 11));
+  memcpy((void*)&fixed, (const void*)&floats, sizeof(fixed));
+  TEST_ASSERT_TRUE(isnan(fixed.getMin(0)));
+  fixed.update({ 10.0f, 40.0f }, local(2026, 7, 15, 12));
+  TEST_ASSERT_FLOAT_WITHIN(0.0001f, 10.0f, fixed.getMax(0));
+  TEST_ASSERT_EQUAL_INT64(local(2026, 7, 15, 12), fixed.getStats().reset_time);
+}
+
+static void test_kept_across_deep_sleep_lost_on_power_cycle(void) {
+  rtcTracker.update({ 20.0f, 50.0f }, local(2026, 7, 15, 11));
+  Host::deepSleep(300ULL * 1000000);
+  TEST_ASSERT_EQUAL_FLOAT(20.0f, rtcTracker.getMin(0));
+
+  Host::powerCycle();
+  TEST_ASSERT_TRUE(isnan(rtcTracker.getMin(0)));
+  TEST_ASSERT_EQUAL_INT(0, rtcTracker.getStats().date_yyyymmdd);
+}
+
+int main(int argc, char** argv) {
+  (void)argc;
+  (void)argv;
+  UNITY_BEGIN();
+  RUN_TEST(test_empty_until_first_reading);
+  RUN_TEST(test_tracks_extremes_and_their_times);
+  RUN_TEST(test_nan_leaves_channel_unchanged);
+  RUN_TEST(test_rollover_at_local_time);
+  RUN_TEST(test_rollover_on_dst_days);
+  RUN_TEST(test_days_without_readings);
+  RUN_TEST(test_untimed_readings);
+  RUN_TEST(test_fixed_point_hundredths);
+  RUN_TEST(test_fixed_point_clamps);
+  RUN_TEST(test_fixed_point_is_smaller);
+  RUN_TEST(test_state_from_another_layout_is_discarded);
+  RUN_TEST(test_kept_across_deep_sleep_lost_on_power_cycle);
+  return UNITY_END();
+}
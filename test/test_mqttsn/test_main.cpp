@@ -0,0 +1,256 @@
+// ConnectionManager/Comms over MQTT-SN against a FakeMqttSnGateway on the
+// simulated network: telemetry as one QoS -1 datagram, alarms with QoS 1
+// (acknowledged, retried, given up on), and commands buffered by the gateway
+// for the sleeping node and collected with PINGREQ on the next wake; history
+// replay refused. Needs env:native-sn (-DENABLE_MQTTSN).
+
+#include <unity.h>
+#include <Host.h>
+#include <FakeMqttSnGateway.h>
+#include <ConfigStore.h>
+#include <ConnectionManager.h>
+#include <Comms.h>
+#include <HealthCounters.h>
+#include <HistoryReplay.h>
+#include <ReadingHistory.h>
+#include <config_common.h>
+#include <string>
+
+static const uint32_t TIMEOUT_MS = 5000;
+static const uint32_t DRAIN_MAX_MS = 1000;
+static const uint32_t DRAIN_QUIET_MS = 200;
+static const uint64_t SLEEP_US = 300ULL * 1000000ULL;
+static const char* STATUS = "{\"t\":21.5,\"h\":48.0,\"bat\":3.91}";
+
+static FakeMqttSnGateway gateway(IPAddress(192, 168, 0, 20), MQTTSN_GATEWAY_PORT);
+
+// A fresh node per wake, as after a deep sleep reset
+struct Node {
+  ConnectionManager cm;
+  Comms comms;
+  HistoryReplay history;
+};
+static Node* node = nullptr;
+
+// ============================
+// Helpers
+// ============================
+static std::string clientId() {
+  char id[64];
+  uint64_t mac = Host::mac();
+  snprintf(id, sizeof(id), "%s-%04X%08X",
+           DEVICE_NAME, (unsigned)(uint16_t)(mac >> 32), (unsigned)(uint32_t)mac);
+  return id;
+}
+
+static void startWake() {
+  delete node;
+  node = new Node();
+  ConfigStore::begin();
+  node->cm.begin();
+  node->comms.begin(node->cm);
+  node->cm.setComms(&node->comms);
+  node->history.begin(node->comms);
+  node->cm.setHistoryReplay(&node->history);
+
+  uint32_t start = millis();
+  while (!node->cm.mqttConnected()) {
+    TEST_ASSERT_TRUE(millis() - start < TIMEOUT_MS);
+    node->cm.loop();
+    delay(10);
+  }
+}
+
+static void sleepAndWake() {
+  Host::deepSleep(SLEEP_US);
+  startWake();
+}
+
+void setUp(void) {
+  Host::quiet(true);
+  Host::useVirtualClock(true);
+  Host::nvsErase();
+  Host::powerCycle();
+  Host::setWifi(true);
+
+  gateway.setSilent(false);
+  gateway.setLatency(20);
+  gateway.dropAcks(0);
+  gateway.forgetClients();
+  gateway.clearLog();
+  startWake();
+}
+
+void tearDown(void) {}
+
+// ============================
+// Telemetry
+// ============================
+static void test_telemetry_one_datagram(void) {
+  uint32_t datagrams = gateway.datagramsIn();
+  uint32_t bytes = gateway.bytesIn();
+
+  TEST_ASSERT_TRUE(node->comms.publishStatus(STATUS));
+
+  TEST_ASSERT_EQUAL_UINT32(datagrams + 1, gateway.datagramsIn());
+  TEST_ASSERT_EQUAL_UINT32(0, gateway.connects());
+  std::vector<FakeMqttSnGateway::Message> log = gateway.messages(MQTTSN_TOPIC_ID_STATUS);
+  TEST_ASSERT_EQUAL(1, log.size());
+  TEST_ASSERT_EQUAL_INT8(-1, log[0].qos);
+  TEST_ASSERT_EQUAL_STRING("", log[0].clientId.c_str());
+  TEST_ASSERT_EQUAL_STRING(STATUS, log[0].payload.c_str());
+
+  // The same message over MQTT: PUBLISH (topic name) alone, before CONNECT
+  size_t mqttBytes = 2 + 2 + strlen(MQTT_TOPIC_STATUS) + strlen(STATUS);
+  char line[96];
+  snprintf(line, sizeof(line), "status: %u bytes over MQTT-SN, %u in the MQTT PUBLISH alone",
+           (unsigned)(gateway.bytesIn() - bytes), (unsigned)mqttBytes);
+  TEST_MESSAGE(line);
+  TEST_ASSERT_TRUE(gateway.bytesIn() - bytes < mqttBytes);
+}
+
+static void test_topic_without_id_dropped(void) {
+  uint32_t datagrams = gateway.datagramsIn();
+  uint32_t fails = HealthCounters::get(HealthCounters::Counter::PublishFail);
+
+  TEST_ASSERT_FALSE(node->comms.publishOtaRequest("{\"offset\":0}"));
+
+  TEST_ASSERT_EQUAL_UINT32(datagrams, gateway.datagramsIn());
+  TEST_ASSERT_EQUAL_UINT32(fails + 1, HealthCounters::get(HealthCounters::Counter::PublishFail));
+}
+
+// ============================
+// Alarms (QoS 1)
+// ============================
+static void test_alarm_acknowledged(void) {
+  TEST_ASSERT_TRUE(node->comms.publishAlarm("{\"alarm\":\"door\"}"));
+
+  std::vector<FakeMqttSnGateway::Message> log = gateway.messages(MQTTSN_TOPIC_ID_EVENTS);
+  TEST_ASSERT_EQUAL(1, log.size());
+  TEST_ASSERT_EQUAL_INT8(1, log[0].qos);
+  std::string id = clientId();
+  TEST_ASSERT_EQUAL_STRING(id.c_str(), log[0].clientId.c_str());
+  TEST_ASSERT_EQUAL_UINT32(1, gateway.connects());
+
+  // Back to sleeping at the gateway, so commands are buffered again
+  TEST_ASSERT_TRUE(gateway.asleep(id));
+  TEST_ASSERT_EQUAL_UINT16(MQTTSN_SLEEP_DURATION_S, gateway.sleepDurationS(id));
+}
+
+static void test_alarm_retried_on_lost_ack(void) {
+  gateway.dropAcks(1);
+  uint32_t start = millis();
+
+  TEST_ASSERT_TRUE(node->comms.publishAlarm("{\"alarm\":\"door\"}"));
+
+  TEST_ASSERT_TRUE(millis() - start >= MQTTSN_ACK_TIMEOUT_MS);
+  std::vector<FakeMqttSnGateway::Message> log = gateway.messages(MQTTSN_TOPIC_ID_EVENTS);
+  TEST_ASSERT_EQUAL(2, log.size());
+  TEST_ASSERT_FALSE(log[0].dup);
+  TEST_ASSERT_TRUE(log[1].dup);
+  TEST_ASSERT_EQUAL_STRING(log[0].payload.c_str(), log[1].payload.c_str());
+}
+
+static void test_alarm_fails_without_gateway(void) {
+  gateway.setSilent(true);
+  uint32_t start = millis();
+
+  TEST_ASSERT_FALSE(node->comms.publishAlarm("{\"alarm\":\"door\"}"));
+
+  // Every CONNECT retry waited for its CONNACK
+  TEST_ASSERT_TRUE(millis() - start >= MQTTSN_RETRIES * MQTTSN_ACK_TIMEOUT_MS);
+  TEST_ASSERT_EQUAL(0, gateway.messages().size());
+}
+
+// ============================
+// Commands (sleeping client)
+// ============================
+static void test_commands_buffered_while_asleep(void) {
+  std::string id = clientId();
+  node->cm.drainMailbox(DRAIN_MAX_MS, DRAIN_QUIET_MS);
+  TEST_ASSERT_TRUE(gateway.asleep(id));
+  TEST_ASSERT_TRUE(gateway.subscribed(id, MQTTSN_TOPIC_ID_CMD));
+
+  gateway.publish(MQTTSN_TOPIC_ID_CMD, "ping");
+  TEST_ASSERT_EQUAL(1, gateway.buffered(id));
+
+  sleepAndWake();
+  uint32_t connects = gateway.connects();
+  TEST_ASSERT_EQUAL_UINT16(1, node->cm.drainMailbox(DRAIN_MAX_MS, DRAIN_QUIET_MS));
+
+  // Collected with PINGREQ (no new connection), acknowledged, answered
+  TEST_ASSERT_EQUAL_UINT32(connects, gateway.connects());
+  TEST_ASSERT_EQUAL(0, gateway.buffered(id));
+  TEST_ASSERT_TRUE(gateway.asleep(id));
+  std::vector<FakeMqttSnGateway::Message> resp = gateway.messages(MQTTSN_TOPIC_ID_RESP);
+  TEST_ASSERT_EQUAL(1, resp.size());
+  TEST_ASSERT_EQUAL_STRING("pong", resp[0].payload.c_str());
+}
+
+static void test_empty_mailbox(void) {
+  node->cm.drainMailbox(DRAIN_MAX_MS, DRAIN_QUIET_MS);
+  sleepAndWake();
+
+  uint32_t start = millis();
+  TEST_ASSERT_EQUAL_UINT16(0, node->cm.drainMailbox(DRAIN_MAX_MS, DRAIN_QUIET_MS));
+  // PINGRESP ends the drain, not the timeout
+  TEST_ASSERT_TRUE(millis() - start < DRAIN_MAX_MS);
+}
+
+static void test_gateway_restart_reregisters(void) {
+  std::string id = clientId();
+  node->cm.drainMailbox(DRAIN_MAX_MS, DRAIN_QUIET_MS);
+  uint32_t connects = gateway.connects();
+
+  gateway.forgetClients();
+  sleepAndWake();
+  node->cm.drainMailbox(DRAIN_MAX_MS, DRAIN_QUIET_MS);
+
+  // No PINGRESP: registered again, so commands are buffered from here on
+  TEST_ASSERT_EQUAL_UINT32(connects + 1, gateway.connects());
+  TEST_ASSERT_TRUE(gateway.asleep(id));
+  TEST_ASSERT_TRUE(gateway.subscribed(id, MQTTSN_TOPIC_ID_CMD));
+}
+
+// ============================
+// History replay (not over MQTT-SN)
+// ============================
+static void test_history_refused(void) {
+  std::string id = clientId();
+  ReadingHistory::append(1700000000, 21.5f, 48.0f);
+  node->cm.drainMailbox(DRAIN_MAX_MS, DRAIN_QUIET_MS);
+
+  gateway.publish(MQTTSN_TOPIC_ID_CMD, "history since=0");
+  TEST_ASSERT_EQUAL(1, gateway.buffered(id));
+  sleepAndWake();
+  TEST_ASSERT_EQUAL_UINT16(1, node->cm.drainMailbox(DRAIN_MAX_MS, DRAIN_QUIET_MS));
+
+  // Refused up front: nothing left to resume on the next wake
+  std::vector<FakeMqttSnGateway::Message> resp = gateway.messages(MQTTSN_TOPIC_ID_RESP);
+  TEST_ASSERT_EQUAL(1, resp.size());
+  TEST_ASSERT_EQUAL_STRING("history: not available over MQTT-SN", resp[0].payload.c_str());
+  TEST_ASSERT_FALSE(node->history.active());
+  node->cm.loop();
+  TEST_ASSERT_EQUAL(0, gateway.messages(MQTTSN_TOPIC_ID_HISTORY).size());
+}
+
+int main(int argc, char** argv) {
+  (void)argc;
+  (void)argv;
+  gateway.attach();
+
+  UNITY_BEGIN();
+  RUN_TEST(test_telemetry_one_datagram);
+  RUN_TEST(test_topic_without_id_dropped);
+  RUN_TEST(test_alarm_acknowledged);
+  RUN_TEST(test_alarm_retried_on_lost_ack);
+  RUN_TEST(test_alarm_fails_without_gateway);
+  RUN_TEST(test_commands_buffered_while_asleep);
+  RUN_TEST(test_empty_mailbox);
+  RUN_TEST(test_gateway_restart_reregisters);
+  RUN_TEST(test_history_refused);
+  int failures = UNITY_END();
+
+  delete node;
+  return failures;
+}
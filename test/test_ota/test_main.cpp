@@ -0,0 +1,393 @@
+// OtaUpdater through the real ConnectionManager and Comms against a
+// FakeBroker on loopback, with a broker hook as the update server (answers
+// each chunk request from the image): a transfer spread over wakes and the
+// reboot into it, CRC and image checks, a lost chunk requested again, and
+// the trial of the new image (confirmed, rolled back after unconfirmed
+// wakes, rolled back after a crash loop) with its status report.
+
+#include <unity.h>
+#include <Host.h>
+#include <FakeBroker.h>
+#include <WiFi.h>
+#include <ConfigStore.h>
+#include <ConnectionManager.h>
+#include <Comms.h>
+#include <OtaUpdater.h>
+#include <esp_ota_ops.h>
+#include <rom/crc.h>
+#include <config_common.h>
+#include <atomic>
+#include <memory>
+#include <string>
+
+static const uint32_t CONNECT_TIMEOUT_MS = 5000;
+static const uint64_t SLEEP_US = 60ULL * 1000000ULL;
+static const uint32_t IMAGE_SIZE = 40 * 1024;     // 80 chunks: three wakes
+static const uint8_t IMAGE_MAGIC = 0xE9;
+
+static FakeBroker broker;
+static std::atomic<int> requestsToDrop{0};
+
+// A fresh node per wake, as after a deep sleep or a reset
+struct Node {
+  ConnectionManager cm;
+  Comms comms;
+  OtaUpdater ota;
+};
+static Node* node = nullptr;
+
+// ============================
+// Update server
+// ============================
+static std::string makeImage(uint32_t size, bool bootable = true) {
+  std::string image(size, '\0');
+  uint32_t x = 2463534242u;
+  for (uint32_t i = 0; i < size; i++) {
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    image[i] = (char)x;
+  }
+  image[0] = (char)(bootable ? IMAGE_MAGIC : 0x00);
+  return image;
+}
+
+static uint32_t crcOf(const std::string& image) {
+  return crc32_le(0, (const uint8_t*)image.data(), (uint32_t)image.size());
+}
+
+// Answers {"device":..,"offset":N,"len":L} on the broker thread
+static void serve(const std::string& image) {
+  std::shared_ptr<const std::string> served = std::make_shared<const std::string>(image);
+  broker.setHook([served](FakeBroker& b, const FakeBroker::Message& m) {
+    if (m.topic != MQTT_TOPIC_OTA_REQ) {
+      return;
+    }
+    const char* offsetField = strstr(m.payload.c_str(), "\"offset\":");
+    const char* lenField = strstr(m.payload.c_str(), "\"len\":");
+    if (offsetField == nullptr || lenField == nullptr) {
+      return;
+    }
+    uint32_t offset = strtoul(offsetField + 9, nullptr, 10);
+    uint32_t len = strtoul(lenField + 6, nullptr, 10);
+    if (offset >= served->size()) {
+      return;
+    }
+    if (requestsToDrop.load() > 0) {
+      requestsToDrop--;
+      return;
+    }
+
+    std::string chunk;
+    chunk.push_back((char)offset);
+    chunk.push_back((char)(offset >> 8));
+    chunk.push_back((char)(offset >> 16));
+    chunk.push_back((char)(offset >> 24));
+    chunk.append(*served, offset, len);
+    b.publish(MQTT_TOPIC_OTA_DATA, chunk);
+  });
+}
+
+static size_t requestsFor(uint32_t offset) {
+  char field[32];
+  snprintf(field, sizeof(field), "\"offset\":%lu,", (unsigned long)offset);
+  size_t n = 0;
+  for (const FakeBroker::Message& m : broker.messages(MQTT_TOPIC_OTA_REQ)) {
+    n += m.payload.find(field) != std::string::npos;
+  }
+  return n;
+}
+
+// ============================
+// Helpers
+// ============================
+template <typename Pred>
+static bool serviceUntil(Pred pred, uint32_t timeoutMs) {
+  uint32_t start = millis();
+  while (!pred()) {
+    if (millis() - start >= timeoutMs) {
+      return false;
+    }
+    node->cm.loop();
+    delay(1);
+  }
+  return true;
+}
+
+// esp_restart() throws: the reset that follows is the test's to do
+template <typename F>
+static bool restarts(F f) {
+  try {
+    f();
+  } catch (const Host::Restart&) {
+    return true;
+  }
+  return false;
+}
+
+// A wake as in setup(): boot trial, MQTT session, wake trial. False if the
+// node rolled back (and was reset) on the way.
+static bool startWake() {
+  if (restarts(OtaUpdater::beginBoot)) {
+    Host::reset(ESP_RST_SW);
+    return false;
+  }
+
+  delete node;
+  node = new Node();
+  uint64_t connects = broker.stats().connects;
+  ConfigStore::begin();
+  node->cm.begin();
+  node->comms.begin(node->cm);
+  node->ota.begin(node->comms);
+  node->cm.setComms(&node->comms);
+  node->cm.setOtaUpdater(&node->ota);
+  TEST_ASSERT_TRUE(serviceUntil([&] { return broker.stats().connects > connects && node->cm.mqttConnected(); },
+                                CONNECT_TIMEOUT_MS));
+  TEST_ASSERT_TRUE(serviceUntil([] { return broker.subscribed(MQTT_TOPIC_CMD); }, CONNECT_TIMEOUT_MS));
+
+  if (restarts(OtaUpdater::trialWake)) {
+    Host::reset(ESP_RST_SW);
+    return false;
+  }
+  return true;
+}
+
+static void sleepAndWake() {
+  Host::deepSleep(SLEEP_US);
+  TEST_ASSERT_TRUE(startWake());
+}
+
+// WakeCycle's serviceOta() and the reboot setup() does on Next::Restart
+static bool serviceOta() {
+  uint32_t t0 = millis();
+  while (node->ota.active() && !node->ota.wakeDone() && millis() - t0 < OTA_WAKE_WINDOW_MS) {
+    node->cm.loop();
+    delay(1);
+  }
+  if (!node->ota.rebootPending()) {
+    return false;
+  }
+  TEST_ASSERT_TRUE(restarts([] { ESP.restart(); }));
+  Host::reset(ESP_RST_SW);
+  return true;
+}
+
+static std::string lastResponse() {
+  std::vector<FakeBroker::Message> log = broker.messages(MQTT_TOPIC_RESP);
+  return log.empty() ? "" : log.back().payload;
+}
+
+static void sendCommand(const char* cmd) {
+  size_t before = broker.count(MQTT_TOPIC_RESP);
+  broker.publish(MQTT_TOPIC_CMD, cmd, 1);
+  TEST_ASSERT_TRUE(serviceUntil([&] { return broker.count(MQTT_TOPIC_RESP) > before; }, CONNECT_TIMEOUT_MS));
+}
+
+static void startTransfer(const std::string& image, uint32_t crc) {
+  serve(image);
+  char cmd[64];
+  snprintf(cmd, sizeof(cmd), "ota size=%lu crc=%08lx", (unsigned long)image.size(), (unsigned long)crc);
+  sendCommand(cmd);
+  std::string resp = lastResponse();
+  TEST_ASSERT_EQUAL_STRING("ota: started", resp.c_str());
+}
+
+// Transfer over as many wakes as it takes; returns the wakes used
+static int install(const std::string& image) {
+  startTransfer(image, crcOf(image));
+  int wakes = 1;
+  while (!serviceOta()) {
+    TEST_ASSERT_TRUE(node->ota.active());
+    TEST_ASSERT_TRUE(wakes < 10);
+    sleepAndWake();
+    wakes++;
+  }
+  return wakes;
+}
+
+static std::string readSlot(const char* label, size_t len) {
+  esp_partition_iterator_t it = esp_partition_find(ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_ANY, label);
+  const esp_partition_t* part = esp_partition_get(it);
+  esp_partition_iterator_release(it);
+  TEST_ASSERT_NOT_NULL(part);
+  std::string out(len, '\0');
+  TEST_ASSERT_EQUAL(ESP_OK, esp_partition_read(part, 0, &out[0], len));
+  return out;
+}
+
+static std::string statusFields() {
+  char buf[64];
+  node->ota.formatStatusFields(buf, sizeof(buf));
+  return buf;
+}
+
+void setUp(void) {
+  Host::quiet(true);
+  Host::useVirtualClock(false);
+  Host::nvsErase();
+  Host::flashReset();
+  Host::powerCycle();
+  Host::setWifi(true);
+
+  requestsToDrop.store(0);
+  broker.setHook(nullptr);
+  broker.dropClients();
+  broker.clearLog();
+  TEST_ASSERT_TRUE(startWake());
+}
+
+void tearDown(void) {}
+
+// ============================
+// Transfer
+// ============================
+static void test_transfer_across_wakes(void) {
+  std::string image = makeImage(IMAGE_SIZE);
+  startTransfer(image, crcOf(image));
+
+  // One wake's quota, then the rest on the next wakes
+  TEST_ASSERT_FALSE(serviceOta());
+  std::string progress = statusFields();
+  char expected[64];
+  snprintf(expected, sizeof(expected), "\"ota\":{\"offset\":%u,\"size\":%u}",
+           (unsigned)(OTA_CHUNKS_PER_WAKE * OTA_CHUNK_SIZE), (unsigned)IMAGE_SIZE);
+  TEST_ASSERT_EQUAL_STRING(expected, progress.c_str());
+
+  int wakes = 1;
+  do {
+    sleepAndWake();
+    wakes++;
+  } while (!serviceOta() && wakes < 10);
+
+  TEST_ASSERT_EQUAL_INT((IMAGE_SIZE / OTA_CHUNK_SIZE + OTA_CHUNKS_PER_WAKE - 1) / OTA_CHUNKS_PER_WAKE, wakes);
+  TEST_ASSERT_EQUAL(IMAGE_SIZE / OTA_CHUNK_SIZE, broker.count(MQTT_TOPIC_OTA_REQ));
+  std::string resp = lastResponse();
+  TEST_ASSERT_EQUAL_STRING("ota: verified, rebooting", resp.c_str());
+
+  // Rebooted into the new image
+  std::string written = readSlot("app1", IMAGE_SIZE);
+  TEST_ASSERT_TRUE(written == image);
+  TEST_ASSERT_EQUAL_STRING("app1", Host::runningPartition());
+  TEST_ASSERT_TRUE(startWake());
+}
+
+static void test_crc_mismatch(void) {
+  std::string image = makeImage(4 * OTA_CHUNK_SIZE);
+  startTransfer(image, crcOf(image) ^ 1);
+
+  TEST_ASSERT_FALSE(serviceOta());
+  std::string resp = lastResponse();
+  TEST_ASSERT_EQUAL_STRING("ota: failed (crc mismatch)", resp.c_str());
+  TEST_ASSERT_FALSE(node->ota.active());
+  TEST_ASSERT_EQUAL_STRING("app0", esp_ota_get_boot_partition()->label);
+}
+
+static void test_image_rejected(void) {
+  std::string image = makeImage(4 * OTA_CHUNK_SIZE, false);
+  startTransfer(image, crcOf(image));
+
+  TEST_ASSERT_FALSE(serviceOta());
+  std::string resp = lastResponse();
+  TEST_ASSERT_EQUAL_STRING("ota: failed (image rejected)", resp.c_str());
+  TEST_ASSERT_EQUAL_STRING("app0", esp_ota_get_boot_partition()->label);
+}
+
+static void test_lost_chunk_requested_again(void) {
+  std::string image = makeImage(4 * OTA_CHUNK_SIZE);
+  requestsToDrop.store(1);
+  uint32_t start = millis();
+
+  TEST_ASSERT_EQUAL_INT(1, install(image));
+
+  TEST_ASSERT_TRUE(millis() - start >= OTA_CHUNK_TIMEOUT_MS);
+  TEST_ASSERT_EQUAL(2, requestsFor(0));
+  TEST_ASSERT_EQUAL(1, requestsFor(OTA_CHUNK_SIZE));
+  TEST_ASSERT_EQUAL_STRING("app1", Host::runningPartition());
+}
+
+// ============================
+// Trial of the new image
+// ============================
+static void test_trial_confirmed(void) {
+  install(makeImage(4 * OTA_CHUNK_SIZE));
+  TEST_ASSERT_TRUE(startWake());
+  OtaUpdater::confirmBoot();
+
+  // Neither unpublished wakes nor resets send it back now
+  for (int i = 0; i <= OTA_TRIAL_WAKES; i++) {
+    sleepAndWake();
+  }
+  for (int i = 0; i <= OTA_TRIAL_BOOTS; i++) {
+    Host::reset(ESP_RST_PANIC);
+    TEST_ASSERT_TRUE(startWake());
+  }
+  TEST_ASSERT_EQUAL_STRING("app1", Host::runningPartition());
+  std::string report = statusFields();
+  TEST_ASSERT_EQUAL_STRING("", report.c_str());
+}
+
+static void test_rollback_after_unconfirmed_wakes(void) {
+  install(makeImage(4 * OTA_CHUNK_SIZE));
+
+  // Connected wakes that never publish status
+  TEST_ASSERT_TRUE(startWake());
+  for (int i = 1; i < OTA_TRIAL_WAKES; i++) {
+    sleepAndWake();
+  }
+  TEST_ASSERT_EQUAL_STRING("app1", Host::runningPartition());
+
+  Host::deepSleep(SLEEP_US);
+  TEST_ASSERT_FALSE(startWake());
+  TEST_ASSERT_EQUAL_STRING("app0", Host::runningPartition());
+
+  // The previous image reports it
+  TEST_ASSERT_TRUE(startWake());
+  std::string report = statusFields();
+  TEST_ASSERT_EQUAL_STRING("\"ota\":{\"rolled_back\":1}", report.c_str());
+  OtaUpdater::clearReport();
+  report = statusFields();
+  TEST_ASSERT_EQUAL_STRING("", report.c_str());
+}
+
+static void test_rollback_after_crash_loop(void) {
+  install(makeImage(4 * OTA_CHUNK_SIZE));
+  TEST_ASSERT_TRUE(startWake());   // the reboot into it is the first boot
+
+  // Panics before the status publish
+  for (int i = 1; i < OTA_TRIAL_BOOTS; i++) {
+    Host::reset(ESP_RST_PANIC);
+    TEST_ASSERT_TRUE(startWake());
+    TEST_ASSERT_EQUAL_STRING("app1", Host::runningPartition());
+  }
+  Host::reset(ESP_RST_PANIC);
+  TEST_ASSERT_FALSE(startWake());
+  TEST_ASSERT_EQUAL_STRING("app0", Host::runningPartition());
+
+  TEST_ASSERT_TRUE(startWake());
+  std::string report = statusFields();
+  TEST_ASSERT_EQUAL_STRING("\"ota\":{\"rolled_back\":1}", report.c_str());
+}
+
+int main(int argc, char** argv) {
+  (void)argc;
+  (void)argv;
+  if (!broker.start()) {
+    return 1;
+  }
+  broker.attach(IPAddress(192, 168, 0, 20), MQTT_PORT);
+
+  UNITY_BEGIN();
+  RUN_TEST(test_transfer_across_wakes);
+  RUN_TEST(test_crc_mismatch);
+  RUN_TEST(test_image_rejected);
+  RUN_TEST(test_lost_chunk_requested_again);
+  RUN_TEST(test_trial_confirmed);
+  RUN_TEST(test_rollback_after_unconfirmed_wakes);
+  RUN_TEST(test_rollback_after_crash_loop);
+  int failures = UNITY_END();
+
+  delete node;
+  broker.stop();
+  return failures;
+}
@@ -0,0 +1,248 @@
+// Pipeline on the host FreeRTOS shim (tasks are pthreads): the sensing job
+// finishes while WiFi is still associating, its messages reach a FakeBroker
+// in order once MQTT is up, commands queued while asleep are drained, a
+// second producer is refused, and a full outbox makes enqueue wait then drop.
+//
+// The tests run in order on one pipeline: its network task never returns
+// (as on the device), so the first test starts it and the others reuse it.
+
+#include <unity.h>
+#include <Host.h>
+#include <FakeBroker.h>
+#include <WiFi.h>
+#include <ConfigStore.h>
+#include <ConnectionManager.h>
+#include <Comms.h>
+#include <HealthCounters.h>
+#include <Pipeline.h>
+#include <config_common.h>
+#include <atomic>
+#include <string>
+
+static const uint64_t US = 1000000;
+static const uint32_t ASSOCIATE_MS = 300;
+static const uint32_t TIMEOUT_MS = 8000;    // above MQTT_RETRY_INTERVAL
+
+static FakeBroker broker;
+static ConnectionManager cm;
+static Comms comms;
+static Pipeline pipeline;
+
+static std::atomic<uint32_t> hookCalls{0};
+static std::atomic<int> wifiAtJobEnd{-1};
+static std::atomic<bool> jobRelease{false};
+static std::atomic<uint16_t> jobAccepted{0};
+static std::atomic<uint32_t> jobRefusedAfterMs{0};
+
+// ============================
+// Helpers
+// ============================
+static void countHook() {
+  hookCalls++;
+}
+
+template <typename Pred>
+static bool waitUntil(Pred pred, uint32_t timeoutMs) {
+  uint32_t start = millis();
+  while (!pred()) {
+    if (millis() - start >= timeoutMs) {
+      return false;
+    }
+    delay(2);
+  }
+  return true;
+}
+
+static bool logged(const char* topic, const char* payload) {
+  for (const FakeBroker::Message& m : broker.messages(topic)) {
+    if (m.payload == payload) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// ============================
+// Sensing jobs
+// ============================
+static void wakeJob() {
+  comms.publishBoot("{\"boot\":1}");
+  comms.publishStatus("{\"status\":2}");
+  comms.publishEvents("{\"events\":3}");
+  comms.publishLog("log 4");
+  comms.publishLog("log 5");
+  wifiAtJobEnd.store(WiFi.status());
+
+  // As status: encoded once the mailbox is drained, with its command count
+  char cmds[16];
+  snprintf(cmds, sizeof(cmds), "cmds %u", pipeline.waitForMailbox(TIMEOUT_MS));
+  comms.publishLog(cmds);
+}
+
+static void blockedJob() {
+  while (!jobRelease.load()) {
+    delay(1);
+  }
+  comms.publishLog("from sensing");
+}
+
+// Fills the outbox while MQTT is down: numbered messages until one is refused
+static void floodJob() {
+  char payload[400];
+  for (uint16_t i = 0;; i++) {
+    memset(payload, 'x', sizeof(payload) - 1);
+    payload[sizeof(payload) - 1] = '\0';
+    snprintf(payload, 8, "%05u", i);
+    payload[5] = ':';
+
+    uint32_t start = millis();
+    if (!comms.publishLog(payload)) {
+      jobRefusedAfterMs.store(millis() - start);
+      return;
+    }
+    jobAccepted++;
+  }
+}
+
+void setUp(void) {
+  broker.clearLog();
+}
+
+void tearDown(void) {}
+
+// ============================
+// Tests
+// ============================
+static void test_sensing_overlaps_association(void) {
+  Host::quiet(true);
+  Host::useVirtualClock(false);
+  Host::nvsErase();
+  Host::powerCycle();
+  Host::setWifi(true);
+
+  // A previous wake left a persistent session with a command queued in it
+  ConfigStore::begin();
+  cm.begin();
+  comms.begin(cm);
+  cm.setComms(&comms);
+  TEST_ASSERT_TRUE(waitUntil([] { cm.loop(); return broker.subscribed(MQTT_TOPIC_CMD); }, TIMEOUT_MS));
+  broker.dropClients();
+  broker.publish(MQTT_TOPIC_CMD, "ping", 1);
+
+  // This wake: association takes a while, sensing starts right away
+  Host::deepSleep(60 * US);
+  Host::setWifi(true, ASSOCIATE_MS);
+  broker.clearLog();
+  ConfigStore::begin();
+  cm.begin();
+  int64_t wakeStartUs = Host::worldTimeUs() - (int64_t)millis() * 1000;
+  TEST_ASSERT_FALSE(pipeline.started());
+  pipeline.begin(cm, comms, countHook);
+  TEST_ASSERT_TRUE(pipeline.started());
+  TEST_ASSERT_TRUE(pipeline.runSensing(wakeJob));
+
+  TEST_ASSERT_TRUE(pipeline.waitUntilFlushed(TIMEOUT_MS));
+  TEST_ASSERT_EQUAL_INT(WL_DISCONNECTED, wifiAtJobEnd.load());
+  TEST_ASSERT_TRUE(pipeline.connected());
+  TEST_ASSERT_TRUE(hookCalls.load() > 0);
+
+  // The job's messages in the order it queued them, the drained command, then
+  // the message that waited for the drain
+  TEST_ASSERT_TRUE(broker.waitFor(MQTT_TOPIC_LOG, 4, TIMEOUT_MS));
+  std::vector<FakeBroker::Message> sent = broker.messages();
+  std::vector<std::string> order;
+  for (const FakeBroker::Message& m : sent) {
+    if (m.topic != MQTT_TOPIC_STATUS || m.payload != "online") {
+      order.push_back(m.payload);
+    }
+  }
+  TEST_ASSERT_TRUE(order.size() >= 7);
+  TEST_ASSERT_EQUAL_STRING("{\"boot\":1}", order[0].c_str());
+  TEST_ASSERT_EQUAL_STRING("{\"status\":2}", order[1].c_str());
+  TEST_ASSERT_EQUAL_STRING("{\"events\":3}", order[2].c_str());
+  TEST_ASSERT_EQUAL_STRING("log 4", order[3].c_str());
+  TEST_ASSERT_EQUAL_STRING("log 5", order[4].c_str());
+  TEST_ASSERT_EQUAL_STRING("pong", order[5].c_str());
+  TEST_ASSERT_EQUAL_STRING("cmds 1", order.back().c_str());
+  TEST_ASSERT_EQUAL_UINT16(1, pipeline.waitForMailbox(0));
+  TEST_ASSERT_TRUE(sent.front().atUs - wakeStartUs >= (int64_t)ASSOCIATE_MS * 1000);
+}
+
+static void test_second_producer_refused(void) {
+  jobRelease.store(false);
+  TEST_ASSERT_TRUE(pipeline.runSensing(blockedJob));
+  delay(20);
+
+  // The sensing job is the only producer while it runs
+  TEST_ASSERT_FALSE(comms.publishLog("from main"));
+  jobRelease.store(true);
+  TEST_ASSERT_TRUE(pipeline.waitUntilFlushed(TIMEOUT_MS));
+
+  // After it, the task that waited for it may queue
+  TEST_ASSERT_TRUE(comms.publishLog("after the job"));
+  TEST_ASSERT_TRUE(broker.waitFor(MQTT_TOPIC_LOG, 2, TIMEOUT_MS));
+  TEST_ASSERT_TRUE(logged(MQTT_TOPIC_LOG, "from sensing"));
+  TEST_ASSERT_TRUE(logged(MQTT_TOPIC_LOG, "after the job"));
+  TEST_ASSERT_FALSE(logged(MQTT_TOPIC_LOG, "from main"));
+}
+
+static void test_oversized_message_refused(void) {
+  std::string big(MQTT_BUFFER_SIZE, 'x');
+  uint32_t fails = HealthCounters::get(HealthCounters::Counter::PublishFail);
+
+  uint32_t start = millis();
+  TEST_ASSERT_FALSE(pipeline.enqueue(MQTT_TOPIC_LOG, big.c_str(), false));
+  TEST_ASSERT_TRUE(millis() - start < PIPELINE_ENQUEUE_WAIT_MS);
+
+  // Through Comms it counts as a failed publish
+  TEST_ASSERT_FALSE(comms.publishLog(big.c_str()));
+  TEST_ASSERT_EQUAL_UINT32(fails + 1, HealthCounters::get(HealthCounters::Counter::PublishFail));
+}
+
+static void test_full_outbox_waits_then_drops(void) {
+  // Broker gone: the network task cannot send
+  broker.refuseConnections(3);
+  broker.dropClients();
+  TEST_ASSERT_TRUE(waitUntil([] { return !pipeline.connected(); }, TIMEOUT_MS));
+
+  jobAccepted.store(0);
+  TEST_ASSERT_TRUE(pipeline.runSensing(floodJob));
+  TEST_ASSERT_TRUE(waitUntil([] { return jobRefusedAfterMs.load() > 0; }, TIMEOUT_MS));
+
+  // Held as many records as fit, then waited the full time for space
+  uint16_t accepted = jobAccepted.load();
+  TEST_ASSERT_EQUAL_UINT16(PIPELINE_OUTBOX_BYTES / (2 + strlen(MQTT_TOPIC_LOG) + 1 + 399), accepted);
+  TEST_ASSERT_TRUE(jobRefusedAfterMs.load() >= PIPELINE_ENQUEUE_WAIT_MS);
+
+  // Broker back: what was held goes out in order
+  broker.refuseConnections(0);
+  TEST_ASSERT_TRUE(pipeline.waitUntilFlushed(TIMEOUT_MS));
+  TEST_ASSERT_TRUE(broker.waitFor(MQTT_TOPIC_LOG, accepted, TIMEOUT_MS));
+  std::vector<FakeBroker::Message> sent = broker.messages(MQTT_TOPIC_LOG);
+  TEST_ASSERT_EQUAL(accepted, sent.size());
+  for (uint16_t i = 0; i < accepted; i++) {
+    char prefix[8];
+    snprintf(prefix, sizeof(prefix), "%05u:", i);
+    TEST_ASSERT_EQUAL(399, sent[i].payload.size());
+    TEST_ASSERT_EQUAL_INT(0, sent[i].payload.compare(0, 6, prefix));
+  }
+}
+
+int main(int argc, char** argv) {
+  (void)argc;
+  (void)argv;
+  if (!broker.start()) {
+    return 1;
+  }
+  broker.attach(IPAddress(192, 168, 0, 20), MQTT_PORT);
+
+  UNITY_BEGIN();
+  RUN_TEST(test_sensing_overlaps_association);
+  RUN_TEST(test_second_producer_refused);
+  RUN_TEST(test_oversized_message_refused);
+  RUN_TEST(test_full_outbox_waits_then_drops);
+  int failures = UNITY_END();
+  // The network task is still running: leave without destructors
+  fflush(stdout);
+  _Exit(failures);
+}
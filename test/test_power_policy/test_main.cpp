@@ -0,0 +1,148 @@
+// PowerPolicy: level thresholds, hysteresis on recovery and the actions per level.
+
+#include <unity.h>
+#include <PowerPolicy.h>
+#include <config_common.h>
+
+typedef PowerPolicy::Level Level;
+
+static PowerPolicy::State state;
+
+void setUp(void) {
+  state.level = Level::Normal;
+  state.wakesSinceUplink = 0;
+}
+
+void tearDown(void) {}
+
+// ============================
+// Levels
+// ============================
+static void test_falling_follows_immediately(void) {
+  TEST_ASSERT_EQUAL(Level::Normal, PowerPolicy::nextLevel(Level::Normal, POWER_CONSERVE_MV));
+  TEST_ASSERT_EQUAL(Level::Conserve, PowerPolicy::nextLevel(Level::Normal, POWER_CONSERVE_MV - 1));
+  TEST_ASSERT_EQUAL(Level::Low, PowerPolicy::nextLevel(Level::Normal, POWER_LOW_MV - 1));
+  TEST_ASSERT_EQUAL(Level::Critical, PowerPolicy::nextLevel(Level::Normal, POWER_CRITICAL_MV - 1));
+  TEST_ASSERT_EQUAL(Level::Critical, PowerPolicy::nextLevel(Level::Conserve, 2800));
+}
+
+static void test_recovery_needs_hysteresis(void) {
+  // Back above the threshold, but not by the margin: stay
+  TEST_ASSERT_EQUAL(Level::Conserve, PowerPolicy::nextLevel(Level::Conserve, POWER_CONSERVE_MV));
+  TEST_ASSERT_EQUAL(Level::Conserve,
+                    PowerPolicy::nextLevel(Level::Conserve, POWER_CONSERVE_MV + POWER_HYSTERESIS_MV - 1));
+  TEST_ASSERT_EQUAL(Level::Normal,
+                    PowerPolicy::nextLevel(Level::Conserve, POWER_CONSERVE_MV + POWER_HYSTERESIS_MV));
+
+  TEST_ASSERT_EQUAL(Level::Critical,
+                    PowerPolicy::nextLevel(Level::Critical, POWER_CRITICAL_MV + POWER_HYSTERESIS_MV - 1));
+  TEST_ASSERT_EQUAL(Level::Low,
+                    PowerPolicy::nextLevel(Level::Critical, POWER_CRITICAL_MV + POWER_HYSTERESIS_MV));
+
+  // Recovery may skip levels once they are all cleared
+  TEST_ASSERT_EQUAL(Level::Normal, PowerPolicy::nextLevel(Level::Critical, 4100));
+}
+
+static void test_unknown_voltage_keeps_level(void) {
+  TEST_ASSERT_EQUAL(Level::Low, PowerPolicy::nextLevel(Level::Low, 0));
+  TEST_ASSERT_EQUAL(Level::Normal, PowerPolicy::nextLevel(Level::Normal, 0));
+}
+
+static void test_no_flapping_on_a_resting_cell(void) {
+  // Voltage sagging under load and recovering at rest around the threshold
+  const uint16_t trace[] = { 3610, 3595, 3640, 3590, 3660, 3598, 3670 };
+  int changes = 0;
+  Level prev = state.level;
+  for (uint16_t mv : trace) {
+    PowerPolicy::decide(state, mv);
+    changes += state.level != prev;
+    prev = state.level;
+  }
+  TEST_ASSERT_EQUAL(1, changes);
+  TEST_ASSERT_EQUAL(Level::Conserve, state.level);
+
+  PowerPolicy::decide(state, POWER_CONSERVE_MV + POWER_HYSTERESIS_MV);
+  TEST_ASSERT_EQUAL(Level::Normal, state.level);
+}
+
+// ============================
+// Actions
+// ============================
+static void test_actions_per_level(void) {
+  PowerPolicy::Actions a = PowerPolicy::decide(state, 4000);
+  TEST_ASSERT_EQUAL(1, a.intervalMultiplier);
+  TEST_ASSERT_TRUE(a.logs && a.discovery && a.uplink);
+  TEST_ASSERT_FALSE(a.batch || a.alarmOnly);
+
+  a = PowerPolicy::decide(state, POWER_CONSERVE_MV - 1);
+  TEST_ASSERT_EQUAL(Level::Conserve, a.level);
+  TEST_ASSERT_EQUAL(2, a.intervalMultiplier);
+  TEST_ASSERT_TRUE(a.uplink);
+  TEST_ASSERT_FALSE(a.logs || a.discovery || a.batch || a.alarmOnly);
+
+  a = PowerPolicy::decide(state, POWER_LOW_MV - 1);
+  TEST_ASSERT_EQUAL(Level::Low, a.level);
+  TEST_ASSERT_EQUAL(4, a.intervalMultiplier);
+  TEST_ASSERT_TRUE(a.batch);
+  TEST_ASSERT_FALSE(a.logs || a.discovery || a.alarmOnly);
+
+  a = PowerPolicy::decide(state, POWER_CRITICAL_MV - 1);
+  TEST_ASSERT_EQUAL(Level::Critical, a.level);
+  TEST_ASSERT_EQUAL(8, a.intervalMultiplier);
+  TEST_ASSERT_TRUE(a.alarmOnly);
+  TEST_ASSERT_FALSE(a.uplink || a.logs || a.discovery);
+}
+
+static void test_low_uplinks_every_n_wakes(void) {
+  // Wakes since the last uplink (at Normal) count towards the first Low uplink
+  PowerPolicy::decide(state, 4000);
+  int uplinks = 0;
+  for (int wake = 1; wake <= 4 * POWER_LOW_UPLINK_EVERY; wake++) {
+    PowerPolicy::Actions a = PowerPolicy::decide(state, POWER_LOW_MV - 1);
+    TEST_ASSERT_EQUAL(wake % POWER_LOW_UPLINK_EVERY == 0, a.uplink);
+    uplinks += a.uplink;
+  }
+  TEST_ASSERT_EQUAL(4, uplinks);
+}
+
+static void test_critical_counts_wakes_without_uplink(void) {
+  for (int i = 0; i < 300; i++) {
+    PowerPolicy::decide(state, POWER_CRITICAL_MV - 1);
+  }
+  TEST_ASSERT_EQUAL_UINT8(UINT8_MAX, state.wakesSinceUplink);
+
+  // First Low wake after a long critical spell uplinks (batch replay)
+  PowerPolicy::Actions a = PowerPolicy::decide(state, POWER_CRITICAL_MV + POWER_HYSTERESIS_MV);
+  TEST_ASSERT_EQUAL(Level::Low, a.level);
+  TEST_ASSERT_TRUE(a.uplink && a.batch);
+}
+
+static void test_corrupt_state_resets(void) {
+  state.level = (Level)0xA5;
+  PowerPolicy::Actions a = PowerPolicy::decide(state, 4000);
+  TEST_ASSERT_EQUAL(Level::Normal, a.level);
+}
+
+static void test_names(void) {
+  TEST_ASSERT_EQUAL_STRING("normal", PowerPolicy::name(Level::Normal));
+  TEST_ASSERT_EQUAL_STRING("conserve", PowerPolicy::name(Level::Conserve));
+  TEST_ASSERT_EQUAL_STRING("low", PowerPolicy::name(Level::Low));
+  TEST_ASSERT_EQUAL_STRING("critical", PowerPolicy::name(Level::Critical));
+  TEST_ASSERT_EQUAL_STRING("unknown", PowerPolicy::name((Level)9));
+}
+
+int main(int argc, char** argv) {
+  (void)argc;
+  (void)argv;
+  UNITY_BEGIN();
+  RUN_TEST(test_falling_follows_immediately);
+  RUN_TEST(test_recovery_needs_hysteresis);
+  RUN_TEST(test_unknown_voltage_keeps_level);
+  RUN_TEST(test_no_flapping_on_a_resting_cell);
+  RUN_TEST(test_actions_per_level);
+  RUN_TEST(test_low_uplinks_every_n_wakes);
+  RUN_TEST(test_critical_counts_wakes_without_uplink);
+  RUN_TEST(test_corrupt_state_resets);
+  RUN_TEST(test_names);
+  return UNITY_END();
+}
@@ -0,0 +1,130 @@
+// PulseAccumulator: folding the free-running ULP counter into the 64-bit total
+// across 32-bit wraps, and the rate windows between samples.
+
+#include <unity.h>
+#include <PulseAccumulator.h>
+
+static PulseAccumulator acc;
+
+void setUp(void) {
+  acc = PulseAccumulator();   // zero-initialized, as in RTC memory after power-on
+}
+
+void tearDown(void) {}
+
+// ============================
+// Total
+// ============================
+static void test_counts_from_reset_value(void) {
+  acc.reset(1000);
+  acc.fold(1000);
+  TEST_ASSERT_EQUAL_UINT64(0, acc.total);
+  acc.fold(1017);
+  acc.fold(1020);
+  TEST_ASSERT_EQUAL_UINT64(20, acc.total);
+  TEST_ASSERT_EQUAL_UINT32(1020, acc.lastRaw);
+}
+
+static void test_raw_counter_wrap(void) {
+  acc.reset(0xFFFFFFF0u);
+  acc.fold(0x00000010u);   // 32 pulses across the wrap
+  TEST_ASSERT_EQUAL_UINT64(32, acc.total);
+  acc.fold(0x00000010u);
+  TEST_ASSERT_EQUAL_UINT64(32, acc.total);
+}
+
+static void test_total_goes_past_32_bits(void) {
+  // Folded at least once per counter lap, the total keeps counting
+  acc.reset(0);
+  uint32_t raw = 0;
+  for (int i = 0; i < 10; i++) {
+    raw += 0x80000000u;
+    acc.fold(raw);
+  }
+  TEST_ASSERT_EQUAL_UINT64(10ULL * 0x80000000ULL, acc.total);
+  TEST_ASSERT_EQUAL_UINT32(0, acc.lastRaw);
+}
+
+// ============================
+// Windows
+// ============================
+static void test_first_sample_only_opens_a_window(void) {
+  acc.reset(0);
+  acc.fold(50);
+  uint32_t counts = 99;
+  uint32_t elapsed = 99;
+  TEST_ASSERT_FALSE(acc.sample(1767225600, counts, elapsed));
+  TEST_ASSERT_EQUAL_UINT32(99, counts);   // outputs untouched
+  TEST_ASSERT_EQUAL_UINT64(50, acc.windowStart);
+
+  acc.fold(80);
+  TEST_ASSERT_TRUE(acc.sample(1767225600 + 300, counts, elapsed));
+  TEST_ASSERT_EQUAL_UINT32(30, counts);
+  TEST_ASSERT_EQUAL_UINT32(300, elapsed);
+}
+
+static void test_unknown_time_keeps_window_open(void) {
+  // A wake without a time base folds into the open window: the next timed
+  // sample covers both wakes
+  acc.reset(0);
+  uint32_t counts = 0;
+  uint32_t elapsed = 0;
+  acc.sample(1767225600, counts, elapsed);
+  acc.fold(10);
+  TEST_ASSERT_FALSE(acc.sample(0, counts, elapsed));
+  acc.fold(25);
+  TEST_ASSERT_TRUE(acc.sample(1767225600 + 600, counts, elapsed));
+  TEST_ASSERT_EQUAL_UINT32(25, counts);
+  TEST_ASSERT_EQUAL_UINT32(600, elapsed);
+}
+
+static void test_clock_stepped_back_restarts_window(void) {
+  acc.reset(0);
+  uint32_t counts = 0;
+  uint32_t elapsed = 0;
+  acc.sample(1767225600, counts, elapsed);
+  acc.fold(40);
+  TEST_ASSERT_FALSE(acc.sample(1767225600 - 5, counts, elapsed));   // SNTP correction
+  TEST_ASSERT_FALSE(acc.sample(1767225600 - 5, counts, elapsed));   // zero length
+  acc.fold(52);
+  TEST_ASSERT_TRUE(acc.sample(1767225600 + 55, counts, elapsed));
+  TEST_ASSERT_EQUAL_UINT32(12, counts);
+  TEST_ASSERT_EQUAL_UINT32(60, elapsed);
+}
+
+static void test_window_across_counter_wrap(void) {
+  acc.reset(0xFFFFFF00u);
+  uint32_t counts = 0;
+  uint32_t elapsed = 0;
+  acc.sample(1767225600, counts, elapsed);
+  acc.fold(0x00000100u);
+  TEST_ASSERT_TRUE(acc.sample(1767225600 + 3600, counts, elapsed));
+  TEST_ASSERT_EQUAL_UINT32(512, counts);
+}
+
+// ============================
+// Rate
+// ============================
+static void test_rate(void) {
+  // Tipping bucket, 0.2794 mm per tip: 10 tips in 15 min = 11.176 mm/h
+  TEST_ASSERT_FLOAT_WITHIN(0.001f, 11.176f, PulseAccumulator::rate(10, 900, 0.2794f, 3600));
+  // Flow meter, 1/450 L per pulse: 900 pulses in 60 s = 2 L/min
+  TEST_ASSERT_FLOAT_WITHIN(0.0001f, 2.0f, PulseAccumulator::rate(900, 60, 1.0f / 450, 60));
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, PulseAccumulator::rate(0, 900, 0.2794f, 3600));
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, PulseAccumulator::rate(10, 0, 0.2794f, 3600));
+}
+
+int main(int argc, char** argv) {
+  (void)argc;
+  (void)argv;
+  UNITY_BEGIN();
+  RUN_TEST(test_counts_from_reset_value);
+  RUN_TEST(test_raw_counter_wrap);
+  RUN_TEST(test_total_goes_past_32_bits);
+  RUN_TEST(test_first_sample_only_opens_a_window);
+  RUN_TEST(test_unknown_time_keeps_window_open);
+  RUN_TEST(test_clock_stepped_back_restarts_window);
+  RUN_TEST(test_window_across_counter_wrap);
+  RUN_TEST(test_rate);
+  return UNITY_END();
+}
@@ -0,0 +1,234 @@
+// I2CBus and the DS3231 driver against a simulated chip (FakeDS3231) on the
+// host Wire bus: probing, bursts, error counters, stuck-bus recovery, BCD
+// time with the century bit and 12-hour mode, drift and the aging offset.
+//
+// I2CBus and RTC keep "started"/"initialized" for the whole process (a wake
+// on the device), so the missing-chip case runs first.
+
+#include <unity.h>
+#include <Host.h>
+#include <FakeDS3231.h>
+#include <I2CBus.h>
+#include <RTC.h>
+#include <HealthCounters.h>
+#include <config_common.h>
+
+static const int64_t US = 1000000;
+
+static FakeDS3231 chip(I2C_SDA_PIN, I2C_SCL_PIN);
+
+static int64_t epochOf(time_t t) {
+  return (int64_t)t * US;
+}
+
+void setUp(void) {
+  Host::quiet(true);
+  Host::useVirtualClock(true);
+  Host::setPin(I2C_SDA_PIN, HIGH);   // pull-ups
+  Host::setPin(I2C_SCL_PIN, HIGH);
+  chip.setPpm(0.0f);
+  chip.use12h(false);
+}
+
+void tearDown(void) {}
+
+// ============================
+// Bus
+// ============================
+static void test_missing_chip_counted(void) {
+  TEST_ASSERT_FALSE(RTC::begin());
+  TEST_ASSERT_EQUAL_UINT32(1, HealthCounters::get(HealthCounters::Counter::RtcFail));
+
+  const I2CBus::DeviceStats* s = I2CBus::getStats(DS3231_I2C_ADDR);
+  TEST_ASSERT_NOT_NULL(s);
+  TEST_ASSERT_EQUAL_UINT32(1, s->errors);
+  TEST_ASSERT_EQUAL_UINT8(2, s->lastError);   // address NACK
+
+  time_t t;
+  TEST_ASSERT_FALSE(RTC::getTime(t));
+}
+
+static void test_probe_and_slowest_clock(void) {
+  chip.attach();
+  TEST_ASSERT_EQUAL_UINT32(I2C_FREQ_HZ, Host::i2cClock());
+  TEST_ASSERT_TRUE(I2CBus::addDevice(DS3231_I2C_ADDR, 400000));
+  TEST_ASSERT_TRUE(I2CBus::probe(DS3231_I2C_ADDR));
+
+  // A slower device lowers the bus for everyone, even if it is absent now
+  TEST_ASSERT_FALSE(I2CBus::addDevice(0x57, 100000));
+  TEST_ASSERT_EQUAL_UINT32(100000, Host::i2cClock());
+  TEST_ASSERT_TRUE(I2CBus::addDevice(DS3231_I2C_ADDR, 400000));
+  TEST_ASSERT_EQUAL_UINT32(100000, Host::i2cClock());
+}
+
+static void test_register_bursts(void) {
+  const uint8_t data[2] = { 0x05, 0x1C };
+  TEST_ASSERT_TRUE(I2CBus::writeRegs(DS3231_I2C_ADDR, 0x0D, data, 2));   // alarm 2 day, control
+  uint8_t back[2] = { 0, 0 };
+  TEST_ASSERT_TRUE(I2CBus::readRegs(DS3231_I2C_ADDR, 0x0D, back, 2));
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(data, back, 2);
+
+  uint8_t v = 0;
+  TEST_ASSERT_TRUE(I2CBus::readReg(DS3231_I2C_ADDR, 0x11, v));
+  TEST_ASSERT_EQUAL_UINT8(25, v);   // temperature MSB
+
+  TEST_ASSERT_FALSE(I2CBus::readRegs(DS3231_I2C_ADDR, 0x00, back, 0));
+  uint8_t big[256];
+  TEST_ASSERT_FALSE(I2CBus::readRegs(DS3231_I2C_ADDR, 0x00, big, sizeof(big)));
+}
+
+static void test_nack_counted_without_recovery(void) {
+  const I2CBus::DeviceStats* s = I2CBus::getStats(DS3231_I2C_ADDR);
+  uint32_t errors = s->errors;
+  uint32_t recoveries = I2CBus::getRecoveryCount();
+
+  Host::failI2C(3, 1);
+  TEST_ASSERT_FALSE(I2CBus::writeReg(DS3231_I2C_ADDR, 0x07, 0));
+  TEST_ASSERT_EQUAL_UINT32(errors + 1, s->errors);
+  TEST_ASSERT_EQUAL_UINT8(3, s->lastError);
+  TEST_ASSERT_EQUAL_UINT32(recoveries, I2CBus::getRecoveryCount());
+
+  char buf[160];
+  TEST_ASSERT_GREATER_THAN(0, I2CBus::formatStatusFields(buf, sizeof(buf)));
+  TEST_ASSERT_EQUAL_STRING_LEN("\"i2c\":{\"recov\":0,\"dev\":[{\"addr\":104,", buf, 36);
+  TEST_ASSERT_NOT_NULL(strstr(buf, "\"last\":3}"));
+
+  // Never a cut-off object
+  TEST_ASSERT_EQUAL_INT(0, I2CBus::formatStatusFields(buf, 30));
+  TEST_ASSERT_EQUAL_STRING("", buf);
+}
+
+static void test_timeout_recovers_stuck_bus(void) {
+  // The chip was reset mid-read and holds SDA for 3 more clocks
+  uint32_t recoveries = I2CBus::getRecoveryCount();
+  chip.holdSda(3);
+  uint8_t v = 0;
+  TEST_ASSERT_FALSE(I2CBus::readReg(DS3231_I2C_ADDR, 0x0E, v));
+  TEST_ASSERT_EQUAL_UINT8(5, I2CBus::getStats(DS3231_I2C_ADDR)->lastError);
+
+  // The timeout restarted the bus, which clocked the chip free
+  TEST_ASSERT_EQUAL_UINT32(recoveries + 1, I2CBus::getRecoveryCount());
+  TEST_ASSERT_EQUAL_UINT32(3, chip.sclPulses());
+  TEST_ASSERT_TRUE(I2CBus::readReg(DS3231_I2C_ADDR, 0x0E, v));
+  TEST_ASSERT_EQUAL_HEX8(0x1C, v);
+}
+
+static void test_recovery_gives_up_after_nine_clocks(void) {
+  chip.holdSda(255);
+  TEST_ASSERT_FALSE(I2CBus::recover());
+  TEST_ASSERT_EQUAL_UINT32(9 + 1, chip.sclPulses());   // the STOP clocks once more
+  chip.holdSda(0);
+  TEST_ASSERT_TRUE(I2CBus::recover());
+}
+
+// ============================
+// DS3231
+// ============================
+static void test_set_time_clears_osf(void) {
+  TEST_ASSERT_TRUE(RTC::begin());
+  TEST_ASSERT_TRUE(chip.oscillatorStopped());
+
+  TEST_ASSERT_TRUE(RTC::setTime(1767225600 + 45296));   // 2026-01-01 12:34:56
+  TEST_ASSERT_FALSE(chip.oscillatorStopped());
+  TEST_ASSERT_EQUAL_HEX8(0x12, chip.reg(0x02));
+  TEST_ASSERT_EQUAL_HEX8(0x05, chip.reg(0x03));   // Thursday (1 = Sunday)
+
+  time_t t = 0;
+  TEST_ASSERT_TRUE(RTC::getTime(t));
+  TEST_ASSERT_EQUAL_INT64(1767225600 + 45296, t);
+  Host::advance(2500);
+  TEST_ASSERT_TRUE(RTC::getTime(t));
+  TEST_ASSERT_EQUAL_INT64(1767225600 + 45298, t);
+}
+
+static void test_century_and_leap_day(void) {
+  TEST_ASSERT_TRUE(RTC::setTime(4102444799));   // 2099-12-31 23:59:59
+  Host::advance(1000);
+  time_t t = 0;
+  TEST_ASSERT_TRUE(RTC::getTime(t));
+  TEST_ASSERT_EQUAL_INT64(4102444800, t);         // 2100-01-01
+  TEST_ASSERT_EQUAL_HEX8(0x81, chip.reg(0x05));   // century bit + January
+
+  TEST_ASSERT_TRUE(RTC::setTime(1835395200));     // 2028-02-29
+  int y, mo, d, h, mi, s;
+  TEST_ASSERT_TRUE(RTC::getDateTime(y, mo, d, h, mi, s));
+  TEST_ASSERT_EQUAL_INT(2028, y);
+  TEST_ASSERT_EQUAL_INT(2, mo);
+  TEST_ASSERT_EQUAL_INT(29, d);
+}
+
+static void test_12_hour_mode(void) {
+  // Set by another tool in 12-hour mode
+  chip.use12h(true);
+  const struct { time_t t; int hour; } cases[] = {
+    { 1767225600 + 23 * 3600, 23 },   // 11 PM
+    { 1767225600 + 1800, 0 },         // 12:30 AM
+    { 1767225600 + 12 * 3600, 12 },   // 12 PM
+    { 1767225600 + 7 * 3600, 7 },
+  };
+  for (const auto& c : cases) {
+    chip.setTime(epochOf(c.t));
+    int y, mo, d, h, mi, s;
+    TEST_ASSERT_TRUE(RTC::getDateTime(y, mo, d, h, mi, s));
+    TEST_ASSERT_EQUAL_INT(c.hour, h);
+  }
+}
+
+static void test_drift_and_aging_offset(void) {
+  chip.setTime(Host::worldTimeUs());
+  chip.setPpm(20.0f);
+  Host::deepSleep(86400ULL * US);
+  TEST_ASSERT_INT_WITHIN(2, 1728000, (int)(chip.timeUs() - Host::worldTimeUs()));   // 1.728 s fast
+  time_t t = 0;
+  TEST_ASSERT_TRUE(RTC::getTime(t));
+  TEST_ASSERT_EQUAL_INT64(chip.timeUs() / US, t);
+
+  // +50 LSB = 5 ppm slower, from the conversion the driver forces
+  uint32_t conversions = chip.conversions();
+  TEST_ASSERT_TRUE(RTC::setAgingOffset(50));
+  TEST_ASSERT_EQUAL_UINT32(conversions + 1, chip.conversions());
+  int8_t offset = 0;
+  TEST_ASSERT_TRUE(RTC::getAgingOffset(offset));
+  TEST_ASSERT_EQUAL_INT8(50, offset);
+
+  chip.setTime(Host::worldTimeUs());
+  Host::deepSleep(86400ULL * US);
+  TEST_ASSERT_INT_WITHIN(2, 1296000, (int)(chip.timeUs() - Host::worldTimeUs()));
+  TEST_ASSERT_TRUE(RTC::setAgingOffset(-12));
+  TEST_ASSERT_TRUE(RTC::getAgingOffset(offset));
+  TEST_ASSERT_EQUAL_INT8(-12, offset);
+  RTC::setAgingOffset(0);
+}
+
+static void test_wait_second_edge(void) {
+  // Next tick 600 ms away
+  const time_t T = 1767225600;
+  chip.setTime(epochOf(T) + 400000);
+  time_t t = 0;
+  TEST_ASSERT_FALSE(RTC::waitSecondEdge(t, 100));
+
+  chip.setTime(epochOf(T) + 400000);
+  uint32_t start = millis();
+  TEST_ASSERT_TRUE(RTC::waitSecondEdge(t, 1500));
+  TEST_ASSERT_EQUAL_INT64(T + 1, t);
+  uint32_t waited = millis() - start;
+  TEST_ASSERT_UINT32_WITHIN(2, 600, waited);   // returned within a poll of the edge
+}
+
+int main(int argc, char** argv) {
+  (void)argc;
+  (void)argv;
+  UNITY_BEGIN();
+  RUN_TEST(test_missing_chip_counted);
+  RUN_TEST(test_probe_and_slowest_clock);
+  RUN_TEST(test_register_bursts);
+  RUN_TEST(test_nack_counted_without_recovery);
+  RUN_TEST(test_timeout_recovers_stuck_bus);
+  RUN_TEST(test_recovery_gives_up_after_nine_clocks);
+  RUN_TEST(test_set_time_clears_osf);
+  RUN_TEST(test_century_and_leap_day);
+  RUN_TEST(test_12_hour_mode);
+  RUN_TEST(test_drift_and_aging_offset);
+  RUN_TEST(test_wait_second_edge);
+  return UNITY_END();
+}
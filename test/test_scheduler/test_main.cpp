@@ -0,0 +1,187 @@
+// Scheduler in virtual time: the clock is a variable the test moves, the main
+// loop is simulated by running due jobs and then "blocking" for the returned
+// wait, as continuous mode does.
+
+#include <unity.h>
+#include <Scheduler.h>
+
+static uint32_t nowMs;
+static Scheduler scheduler;
+
+static unsigned long virtualClock() {
+  return nowMs;
+}
+
+static uint32_t runsA;
+static uint32_t runsB;
+static uint32_t runsC;
+static uint32_t lastRunA;
+static uint32_t jobCostMs;   // time job A takes
+
+static void jobA() {
+  runsA++;
+  lastRunA = nowMs;
+  nowMs += jobCostMs;
+}
+
+static void jobB() {
+  runsB++;
+}
+
+static void jobC() {
+  runsC++;
+}
+
+// Main loop until the clock passes endMs; returns the number of passes
+static uint32_t runUntil(uint32_t endMs, uint32_t lateMs = 0) {
+  uint32_t passes = 0;
+  while ((int32_t)(nowMs - endMs) < 0) {
+    uint32_t wait = scheduler.runDue();
+    passes++;
+    if (wait == Scheduler::IDLE_FOREVER) {
+      break;
+    }
+    nowMs += wait + lateMs;
+  }
+  return passes;
+}
+
+void setUp(void) {
+  nowMs = 0;
+  runsA = runsB = runsC = 0;
+  lastRunA = 0;
+  jobCostMs = 0;
+  scheduler.begin(virtualClock);
+}
+
+void tearDown(void) {}
+
+// ============================
+// Registration
+// ============================
+static void test_run_now_or_after_one_period(void) {
+  scheduler.every(1000, jobA, true);
+  scheduler.every(1000, jobB);
+  TEST_ASSERT_EQUAL_UINT32(0, scheduler.msUntilNext());
+  TEST_ASSERT_EQUAL_UINT32(1000, scheduler.runDue());
+  TEST_ASSERT_EQUAL_UINT32(1, runsA);
+  TEST_ASSERT_EQUAL_UINT32(0, runsB);
+
+  nowMs = 999;
+  TEST_ASSERT_EQUAL_UINT32(1, scheduler.runDue());
+  nowMs = 1000;
+  scheduler.runDue();
+  TEST_ASSERT_EQUAL_UINT32(2, runsA);
+  TEST_ASSERT_EQUAL_UINT32(1, runsB);
+}
+
+static void test_slots_and_invalid_jobs(void) {
+  TEST_ASSERT_EQUAL_UINT32(Scheduler::IDLE_FOREVER, scheduler.msUntilNext());
+  TEST_ASSERT_EQUAL_INT8(-1, scheduler.every(0, jobA));
+  TEST_ASSERT_EQUAL_INT8(-1, scheduler.every(1000, nullptr));
+  for (uint8_t i = 0; i < Scheduler::MAX_JOBS; i++) {
+    TEST_ASSERT_EQUAL_INT8(i, scheduler.every(1000 + i, jobB));
+  }
+  TEST_ASSERT_EQUAL_INT8(-1, scheduler.every(1000, jobB));
+
+  Scheduler unclocked;
+  TEST_ASSERT_EQUAL_INT8(-1, unclocked.every(1000, jobA));
+  TEST_ASSERT_EQUAL_UINT32(Scheduler::IDLE_FOREVER, unclocked.runDue());
+}
+
+static void test_set_period_reschedules_from_now(void) {
+  int8_t id = scheduler.every(60000, jobA);
+  nowMs = 50000;
+  scheduler.setPeriod(id, 5000);
+  TEST_ASSERT_EQUAL_UINT32(5000, scheduler.msUntilNext());
+  runUntil(50000 + 5 * 5000 + 1);
+  TEST_ASSERT_EQUAL_UINT32(5, runsA);
+
+  scheduler.runDue();
+  nowMs += 1200;
+  scheduler.setPeriod(id, 0);      // ignored
+  scheduler.setPeriod(7, 1000);    // no such job
+  TEST_ASSERT_EQUAL_UINT32(3800, scheduler.msUntilNext());
+}
+
+// ============================
+// Cadence
+// ============================
+static void test_late_loop_keeps_cadence(void) {
+  // The loop wakes 3 ms late every time: runs stay on the 1 s grid (no drift)
+  scheduler.every(1000, jobA);
+  runUntil(1000 * 1000 + 500, 3);
+  TEST_ASSERT_EQUAL_UINT32(1000, runsA);
+  TEST_ASSERT_EQUAL_UINT32(1000 * 1000 + 3, lastRunA);
+}
+
+static void test_overrun_does_not_burst(void) {
+  // A run that takes 2.5 periods: one run, then rescheduled from now
+  scheduler.every(1000, jobA);
+  jobCostMs = 2500;
+  nowMs = 1000;
+  TEST_ASSERT_EQUAL_UINT32(1000, scheduler.runDue());
+  TEST_ASSERT_EQUAL_UINT32(1, runsA);
+  TEST_ASSERT_EQUAL_UINT32(3500, nowMs);
+
+  jobCostMs = 0;
+  nowMs = 4499;
+  scheduler.runDue();
+  TEST_ASSERT_EQUAL_UINT32(1, runsA);
+  nowMs = 4500;
+  scheduler.runDue();
+  TEST_ASSERT_EQUAL_UINT32(2, runsA);
+}
+
+static void test_slightly_late_keeps_due_time(void) {
+  // Less than a period late: the next run is one period after the due time
+  scheduler.every(1000, jobA);
+  nowMs = 1400;
+  TEST_ASSERT_EQUAL_UINT32(600, scheduler.runDue());
+}
+
+static void test_millis_wrap(void) {
+  // 2^32 ms after boot (continuous mode for 49.7 days)
+  const uint32_t start = 0xFFFFFFFFUL - 10500;
+  nowMs = start;
+  scheduler.every(1000, jobA);
+  scheduler.every(7000, jobB);
+  runUntil(start + 60000 + 1);
+  TEST_ASSERT_EQUAL_UINT32(60, runsA);
+  TEST_ASSERT_EQUAL_UINT32(8, runsB);
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(1000, scheduler.msUntilNext());
+}
+
+// ============================
+// Simulated day
+// ============================
+static void test_simulated_day(void) {
+  // Continuous mode over 24 h: sensor every 60 s, heartbeat every 5 min,
+  // housekeeping hourly. The loop passes only when a job is due.
+  scheduler.every(60000, jobA, true);
+  scheduler.every(300000, jobB);
+  scheduler.every(3600000, jobC);
+  jobCostMs = 35;
+  uint32_t passes = runUntil(86400000UL + 1);
+
+  TEST_ASSERT_EQUAL_UINT32(1441, runsA);
+  TEST_ASSERT_EQUAL_UINT32(288, runsB);
+  TEST_ASSERT_EQUAL_UINT32(24, runsC);
+  // B and C are due in passes that run A anyway: no extra wakeups
+  TEST_ASSERT_EQUAL_UINT32(runsA, passes);
+}
+
+int main(int argc, char** argv) {
+  (void)argc;
+  (void)argv;
+  UNITY_BEGIN();
+  RUN_TEST(test_run_now_or_after_one_period);
+  RUN_TEST(test_slots_and_invalid_jobs);
+  RUN_TEST(test_set_period_reschedules_from_now);
+  RUN_TEST(test_late_loop_keeps_cadence);
+  RUN_TEST(test_overrun_does_not_burst);
+  RUN_TEST(test_slightly_late_keeps_due_time);
+  RUN_TEST(test_millis_wrap);
+  RUN_TEST(test_simulated_day);
+  return UNITY_END();
+}
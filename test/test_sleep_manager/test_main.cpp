@@ -0,0 +1,167 @@
+// SleepManager: wake cause classification, EXT0/EXT1 assignment for event
+// inputs, and the timer schedule that input wakes leave in place (pure
+// functions, then begin()/sleep() on the simulated device).
+
+#include <unity.h>
+#include <Host.h>
+#include <SleepManager.h>
+
+typedef SleepManager::WakeCause WakeCause;
+
+static const uint64_t MIN_US = 60ULL * 1000000ULL;
+static const uint64_t INTERVAL_US = 30 * MIN_US;
+static const uint64_t PIN_0 = 1ULL << 0;
+static const uint64_t PIN_27 = 1ULL << 27;
+static const uint64_t PIN_33 = 1ULL << 33;
+
+static SleepManager sleepMgr;
+
+// Run sleep() up to esp_deep_sleep_start(); returns the timer armed
+static uint64_t enterSleep() {
+  try {
+    sleepMgr.sleep();
+    TEST_FAIL_MESSAGE("sleep() returned");
+  } catch (const Host::DeepSleep&) {
+  }
+  return Host::wakeSources().timerUs;
+}
+
+void setUp(void) {
+  Host::quiet(true);
+  Host::useVirtualClock(true);
+  Host::powerCycle();
+  Host::setTime(1767225600);
+}
+
+void tearDown(void) {}
+
+// ============================
+// Wake cause
+// ============================
+static void test_classify_wake(void) {
+  TEST_ASSERT_EQUAL(WakeCause::ColdBoot, SleepManager::classifyWake(ESP_SLEEP_WAKEUP_UNDEFINED));
+  TEST_ASSERT_EQUAL(WakeCause::Timer, SleepManager::classifyWake(ESP_SLEEP_WAKEUP_TIMER));
+  TEST_ASSERT_EQUAL(WakeCause::Input, SleepManager::classifyWake(ESP_SLEEP_WAKEUP_EXT0));
+  TEST_ASSERT_EQUAL(WakeCause::Input, SleepManager::classifyWake(ESP_SLEEP_WAKEUP_EXT1));
+  TEST_ASSERT_EQUAL(WakeCause::Other, SleepManager::classifyWake(ESP_SLEEP_WAKEUP_ULP));
+  TEST_ASSERT_EQUAL(WakeCause::Other, SleepManager::classifyWake(ESP_SLEEP_WAKEUP_TOUCHPAD));
+}
+
+// ============================
+// Input wake sources
+// ============================
+static void test_low_inputs_share_ext1(void) {
+  SleepManager::InputWakePlan plan = SleepManager::planInputWake(PIN_0 | PIN_27, PIN_0 | PIN_27);
+  TEST_ASSERT_EQUAL_UINT64(PIN_0 | PIN_27, plan.ext1Mask);
+  TEST_ASSERT_EQUAL(ESP_EXT1_WAKEUP_ANY_HIGH, plan.ext1Mode);
+  TEST_ASSERT_EQUAL(-1, plan.ext0Pin);
+  TEST_ASSERT_EQUAL_UINT64(0, plan.uncovered);
+}
+
+static void test_two_idle_high_inputs_both_wake(void) {
+  // Active-low inputs at rest: EXT0 for the first, EXT1 (all low) for the second
+  SleepManager::InputWakePlan plan = SleepManager::planInputWake(PIN_0 | PIN_27, 0);
+  TEST_ASSERT_EQUAL(0, plan.ext0Pin);
+  TEST_ASSERT_EQUAL_UINT64(PIN_27, plan.ext1Mask);
+  TEST_ASSERT_EQUAL(ESP_EXT1_WAKEUP_ALL_LOW, plan.ext1Mode);
+  TEST_ASSERT_EQUAL_UINT64(0, plan.uncovered);
+}
+
+static void test_one_high_one_low(void) {
+  SleepManager::InputWakePlan plan = SleepManager::planInputWake(PIN_0 | PIN_27, PIN_0);
+  TEST_ASSERT_EQUAL(27, plan.ext0Pin);
+  TEST_ASSERT_EQUAL_UINT64(PIN_0, plan.ext1Mask);
+  TEST_ASSERT_EQUAL(ESP_EXT1_WAKEUP_ANY_HIGH, plan.ext1Mode);
+  TEST_ASSERT_EQUAL_UINT64(0, plan.uncovered);
+}
+
+static void test_third_high_input_uncovered(void) {
+  SleepManager::InputWakePlan plan = SleepManager::planInputWake(PIN_0 | PIN_27 | PIN_33, 0);
+  TEST_ASSERT_EQUAL(0, plan.ext0Pin);
+  TEST_ASSERT_EQUAL_UINT64(PIN_27, plan.ext1Mask);
+  TEST_ASSERT_EQUAL_UINT64(PIN_33, plan.uncovered);
+
+  // EXT1 taken by a low input: only EXT0 left for the high ones
+  plan = SleepManager::planInputWake(PIN_0 | PIN_27 | PIN_33, PIN_33);
+  TEST_ASSERT_EQUAL(0, plan.ext0Pin);
+  TEST_ASSERT_EQUAL_UINT64(PIN_33, plan.ext1Mask);
+  TEST_ASSERT_EQUAL(ESP_EXT1_WAKEUP_ANY_HIGH, plan.ext1Mode);
+  TEST_ASSERT_EQUAL_UINT64(PIN_27, plan.uncovered);
+}
+
+static void test_no_event_inputs(void) {
+  SleepManager::InputWakePlan plan = SleepManager::planInputWake(0, PIN_0);
+  TEST_ASSERT_EQUAL_UINT64(0, plan.ext1Mask);
+  TEST_ASSERT_EQUAL(-1, plan.ext0Pin);
+}
+
+// ============================
+// Timer schedule
+// ============================
+static void test_input_wake_keeps_schedule(void) {
+  int64_t next = 0;
+  int64_t now = 1000 * (int64_t)MIN_US;
+  TEST_ASSERT_EQUAL_UINT64(INTERVAL_US, SleepManager::sleepDurationUs(WakeCause::Timer, now, INTERVAL_US, next));
+  TEST_ASSERT_EQUAL_INT64(now + (int64_t)INTERVAL_US, next);
+
+  // Input 10 min in: the remaining 20 min, schedule unchanged
+  int64_t scheduled = next;
+  now += 10 * MIN_US;
+  TEST_ASSERT_EQUAL_UINT64(20 * MIN_US, SleepManager::sleepDurationUs(WakeCause::Input, now, INTERVAL_US, next));
+  TEST_ASSERT_EQUAL_INT64(scheduled, next);
+
+  // Other causes start a new interval
+  TEST_ASSERT_EQUAL_UINT64(INTERVAL_US, SleepManager::sleepDurationUs(WakeCause::Other, now, INTERVAL_US, next));
+  TEST_ASSERT_EQUAL_INT64(now + (int64_t)INTERVAL_US, next);
+}
+
+static void test_input_wake_after_missed_schedule(void) {
+  // Past due (the input wake ran over), or further out than one interval
+  // (system time set backwards): a new interval
+  int64_t now = 1000 * (int64_t)MIN_US;
+  int64_t next = now - 1;
+  TEST_ASSERT_EQUAL_UINT64(INTERVAL_US, SleepManager::sleepDurationUs(WakeCause::Input, now, INTERVAL_US, next));
+  TEST_ASSERT_EQUAL_INT64(now + (int64_t)INTERVAL_US, next);
+
+  next = now + (int64_t)INTERVAL_US + 1;
+  TEST_ASSERT_EQUAL_UINT64(INTERVAL_US, SleepManager::sleepDurationUs(WakeCause::Input, now, INTERVAL_US, next));
+  TEST_ASSERT_EQUAL_INT64(now + (int64_t)INTERVAL_US, next);
+}
+
+static void test_schedule_across_wakes(void) {
+  sleepMgr.begin(30);
+  TEST_ASSERT_EQUAL(WakeCause::ColdBoot, sleepMgr.getWakeCause());
+  TEST_ASSERT_EQUAL_UINT64(INTERVAL_US, enterSleep());
+
+  // Input wake 12 min in, then 1 min awake
+  Host::deepSleep(12 * MIN_US, ESP_SLEEP_WAKEUP_EXT1, PIN_27);
+  sleepMgr.begin(30);
+  TEST_ASSERT_EQUAL(WakeCause::Input, sleepMgr.getWakeCause());
+  TEST_ASSERT_EQUAL_UINT64(PIN_27, sleepMgr.getWakePinMask());
+  Host::advance(60 * 1000);
+  TEST_ASSERT_EQUAL_UINT64(17 * MIN_US, enterSleep());
+
+  // The timer wake lands on the original schedule and starts a new interval
+  Host::deepSleep(17 * MIN_US);
+  sleepMgr.begin(30);
+  TEST_ASSERT_EQUAL(WakeCause::Timer, sleepMgr.getWakeCause());
+  TEST_ASSERT_EQUAL_UINT64(0, sleepMgr.getWakePinMask());
+  TEST_ASSERT_EQUAL_UINT64(INTERVAL_US, enterSleep());
+  TEST_ASSERT_EQUAL_UINT64(3, sleepMgr.getWakeCount());
+}
+
+int main(int argc, char** argv) {
+  (void)argc;
+  (void)argv;
+  UNITY_BEGIN();
+  RUN_TEST(test_classify_wake);
+  RUN_TEST(test_low_inputs_share_ext1);
+  RUN_TEST(test_two_idle_high_inputs_both_wake);
+  RUN_TEST(test_one_high_one_low);
+  RUN_TEST(test_third_high_input_uncovered);
+  RUN_TEST(test_no_event_inputs);
+  RUN_TEST(test_input_wake_keeps_schedule);
+  RUN_TEST(test_input_wake_after_missed_schedule);
+  RUN_TEST(test_schedule_across_wakes);
+  return UNITY_END();
+}
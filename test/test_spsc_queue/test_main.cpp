@@ -0,0 +1,357 @@
+// SpscQueue and SpscByteQueue: capacity, wrap-around, in-place access, and a
+// producer thread racing the consumer (the ISR -> task case).
+
+#include <unity.h>
+#include <Arduino.h>
+#include <SpscQueue.h>
+#include <atomic>
+#include <thread>
+
+struct Event {
+  uint32_t seq;
+  uint32_t check;   // ~seq: catches torn items
+};
+
+static SpscQueue<uint32_t, 8> small;
+typedef SpscByteQueue<64> ByteQueue;
+
+void setUp(void) {
+  uint32_t v;
+  while (small.pop(v)) {
+  }
+}
+
+void tearDown(void) {}
+
+// ============================
+// Single thread
+// ============================
+static void test_holds_capacity_minus_one(void) {
+  TEST_ASSERT_TRUE(small.empty());
+  for (uint32_t i = 0; i < 7; i++) {
+    TEST_ASSERT_TRUE(small.push(i));
+  }
+  TEST_ASSERT_FALSE(small.push(99));   // full: dropped
+
+  uint32_t v;
+  for (uint32_t i = 0; i < 7; i++) {
+    TEST_ASSERT_TRUE(small.pop(v));
+    TEST_ASSERT_EQUAL_UINT32(i, v);
+  }
+  TEST_ASSERT_FALSE(small.pop(v));
+  TEST_ASSERT_TRUE(small.empty());
+}
+
+static void test_wraps_around(void) {
+  // Many laps with a varying fill level
+  uint32_t next = 0;
+  uint32_t expect = 0;
+  for (int lap = 0; lap < 1000; lap++) {
+    int n = 1 + lap % 7;
+    for (int i = 0; i < n; i++) {
+      TEST_ASSERT_TRUE(small.push(next++));
+    }
+    uint32_t v;
+    for (int i = 0; i < n; i++) {
+      TEST_ASSERT_TRUE(small.pop(v));
+      TEST_ASSERT_EQUAL_UINT32(expect++, v);
+    }
+  }
+  TEST_ASSERT_TRUE(small.empty());
+}
+
+static void test_full_after_wrap(void) {
+  uint32_t v;
+  for (uint32_t i = 0; i < 5; i++) {
+    small.push(i);
+    small.pop(v);
+  }
+  for (uint32_t i = 0; i < 7; i++) {
+    TEST_ASSERT_TRUE(small.push(100 + i));
+  }
+  TEST_ASSERT_FALSE(small.push(0));
+  TEST_ASSERT_TRUE(small.pop(v));
+  TEST_ASSERT_EQUAL_UINT32(100, v);
+  TEST_ASSERT_TRUE(small.push(107));   // one slot free again
+}
+
+static void test_peek_and_pop_front(void) {
+  TEST_ASSERT_NULL(small.front());
+  TEST_ASSERT_NULL(small.peek(0));
+  for (uint32_t i = 0; i < 5; i++) {
+    small.push(10 + i);
+  }
+  TEST_ASSERT_EQUAL_UINT32(10, *small.front());
+  TEST_ASSERT_EQUAL_UINT32(14, *small.peek(4));
+  TEST_ASSERT_NULL(small.peek(5));
+
+  // Items stay until released: peeking twice sees the same ones
+  TEST_ASSERT_EQUAL_UINT32(12, *small.peek(2));
+  small.popFront(3);
+  TEST_ASSERT_EQUAL_UINT32(13, *small.front());
+  TEST_ASSERT_NULL(small.peek(2));
+
+  // In place: the consumer may update the item before releasing it
+  *small.front() = 42;
+  uint32_t v;
+  TEST_ASSERT_TRUE(small.pop(v));
+  TEST_ASSERT_EQUAL_UINT32(42, v);
+  small.popFront();
+  TEST_ASSERT_TRUE(small.empty());
+}
+
+static void test_peek_across_the_wrap(void) {
+  uint32_t v;
+  for (uint32_t i = 0; i < 6; i++) {
+    small.push(i);
+    small.pop(v);
+  }
+  for (uint32_t i = 0; i < 7; i++) {
+    small.push(200 + i);   // slots 6, 7, 0, 1, ...
+  }
+  for (uint16_t i = 0; i < 7; i++) {
+    TEST_ASSERT_EQUAL_UINT32(200 + i, *small.peek(i));
+  }
+  small.popFront(7);
+  TEST_ASSERT_TRUE(small.empty());
+}
+
+// ============================
+// Variable-length records
+// ============================
+
+static bool putRecord(ByteQueue& bytes, uint16_t len, uint8_t fill) {
+  uint8_t* p = bytes.reserve(len);
+  if (p == nullptr) {
+    return false;
+  }
+  memset(p, fill, len);
+  bytes.commit(len);
+  return true;
+}
+
+static void expectRecord(ByteQueue& bytes, uint16_t len, uint8_t fill) {
+  uint16_t got = 0;
+  const uint8_t* p = bytes.front(got);
+  TEST_ASSERT_NOT_NULL(p);
+  TEST_ASSERT_EQUAL_UINT16(len, got);
+  for (uint16_t i = 0; i < len; i++) {
+    TEST_ASSERT_EQUAL_HEX8(fill, p[i]);
+  }
+  bytes.popFront();
+}
+
+static void test_records_in_order(void) {
+  ByteQueue bytes;
+  uint16_t len;
+  TEST_ASSERT_NULL(bytes.front(len));
+  TEST_ASSERT_TRUE(putRecord(bytes, 1, 0x11));
+  TEST_ASSERT_TRUE(putRecord(bytes, 7, 0x22));
+  TEST_ASSERT_TRUE(putRecord(bytes, 0, 0x00));   // empty records are allowed
+  expectRecord(bytes, 1, 0x11);
+  expectRecord(bytes, 7, 0x22);
+  expectRecord(bytes, 0, 0x00);
+  TEST_ASSERT_TRUE(bytes.empty());
+}
+
+static void test_record_full_and_too_big(void) {
+  // 20 bytes each with the header: three fit, a fourth does not
+  ByteQueue bytes;
+  TEST_ASSERT_NULL(bytes.reserve(61));
+  TEST_ASSERT_TRUE(putRecord(bytes, 16, 1));
+  TEST_ASSERT_TRUE(putRecord(bytes, 16, 2));
+  TEST_ASSERT_TRUE(putRecord(bytes, 16, 3));
+  TEST_ASSERT_NULL(bytes.reserve(1));
+  expectRecord(bytes, 16, 1);
+  TEST_ASSERT_TRUE(putRecord(bytes, 12, 4));   // room again, at the front
+  expectRecord(bytes, 16, 2);
+  expectRecord(bytes, 16, 3);
+  expectRecord(bytes, 12, 4);
+  TEST_ASSERT_TRUE(bytes.empty());
+}
+
+static void test_commit_shorter_than_reserved(void) {
+  ByteQueue bytes;
+  uint8_t* p = bytes.reserve(40);
+  TEST_ASSERT_NOT_NULL(p);
+  memcpy(p, "abc", 3);
+  bytes.commit(3);   // 8 bytes used, not 44
+  TEST_ASSERT_TRUE(putRecord(bytes, 40, 5));
+  uint16_t len = 0;
+  TEST_ASSERT_EQUAL_MEMORY("abc", bytes.front(len), 3);
+  TEST_ASSERT_EQUAL_UINT16(3, len);
+  bytes.popFront();
+  expectRecord(bytes, 40, 5);
+}
+
+static void test_record_wraps_with_skip_marker(void) {
+  // Two 24-byte records leave 16 bytes at the end: a third starts again at
+  // the front once the first is released
+  ByteQueue bytes;
+  TEST_ASSERT_TRUE(putRecord(bytes, 20, 1));
+  TEST_ASSERT_TRUE(putRecord(bytes, 20, 2));
+  TEST_ASSERT_NULL(bytes.reserve(20));   // tail end too short, front in use
+  expectRecord(bytes, 20, 1);
+  TEST_ASSERT_TRUE(putRecord(bytes, 20, 3));
+  TEST_ASSERT_NULL(bytes.reserve(0));    // the skipped 16 bytes count as used
+  expectRecord(bytes, 20, 2);
+  expectRecord(bytes, 20, 3);            // past the skip marker
+  TEST_ASSERT_TRUE(bytes.empty());
+
+  // Many laps with sizes that do not divide the buffer evenly; two records
+  // and both skips fit in the worst case
+  for (int i = 0; i < 1000; i++) {
+    uint16_t a = (uint16_t)(i % 16);
+    uint16_t b = (uint16_t)((i * 7) % 12);
+    TEST_ASSERT_TRUE(putRecord(bytes, a, (uint8_t)i));
+    TEST_ASSERT_TRUE(putRecord(bytes, b, (uint8_t)~i));
+    expectRecord(bytes, a, (uint8_t)i);
+    expectRecord(bytes, b, (uint8_t)~i);
+  }
+  TEST_ASSERT_TRUE(bytes.empty());
+}
+
+// ============================
+// Producer thread
+// ============================
+static SpscQueue<Event, 64> events;
+static SpscByteQueue<256> records;
+static std::atomic<bool> producerDone;
+
+static void test_threaded_producer_drops_when_full(void) {
+  // The producer never waits (an ISR cannot): a full queue drops the event,
+  // as Interrupts counts an EdgeDrop. The consumer sees an increasing, untorn
+  // sequence and exactly the events that were accepted.
+  const uint32_t TOTAL = 2000000;
+  uint32_t pushed = 0;
+  producerDone = false;
+  std::thread producer([&pushed, TOTAL]() {
+    for (uint32_t seq = 0; seq < TOTAL; seq++) {
+      if (events.push(Event{ seq, ~seq })) {
+        pushed++;
+      }
+      if ((seq & 63) == 0) {
+        yield();   // let the consumer in on a single core
+      }
+    }
+    producerDone = true;
+  });
+
+  uint32_t received = 0;
+  int64_t last = -1;
+  bool ordered = true;
+  bool intact = true;
+  for (;;) {
+    bool done = producerDone;   // read before the last drain
+    Event e;
+    while (events.pop(e)) {
+      ordered = ordered && (int64_t)e.seq > last;
+      intact = intact && e.check == ~e.seq;
+      last = e.seq;
+      received++;
+    }
+    if (done) {
+      break;
+    }
+    yield();
+  }
+  producer.join();
+
+  TEST_ASSERT_TRUE(ordered);
+  TEST_ASSERT_TRUE(intact);
+  TEST_ASSERT_EQUAL_UINT32(pushed, received);
+  TEST_ASSERT_GREATER_THAN_UINT32(0, received);
+}
+
+static void test_threaded_batch_consumer(void) {
+  // The consumer works on up to 8 events in place and releases them together
+  // (the pin-event path: popped only once published)
+  const uint32_t TOTAL = 1000000;
+  std::thread producer([TOTAL]() {
+    for (uint32_t seq = 0; seq < TOTAL; seq++) {
+      while (!events.push(Event{ seq, ~seq })) {
+        yield();   // lossless here: wait for room
+      }
+    }
+  });
+
+  uint32_t expect = 0;
+  bool ok = true;
+  while (expect < TOTAL) {
+    uint16_t n = 0;
+    Event* e;
+    while (n < 8 && (e = events.peek(n)) != nullptr) {
+      ok = ok && e->seq == expect + n && e->check == ~e->seq;
+      n++;
+    }
+    if (n == 0) {
+      yield();
+      continue;
+    }
+    events.popFront(n);
+    expect += n;
+  }
+  producer.join();
+
+  TEST_ASSERT_TRUE(ok);
+  TEST_ASSERT_EQUAL_UINT32(TOTAL, expect);
+  TEST_ASSERT_TRUE(events.empty());
+}
+
+static void test_threaded_records(void) {
+  // Record i is (i % 61) bytes, each byte (uint8_t)(i + offset)
+  const uint32_t TOTAL = 500000;
+  std::thread producer([TOTAL]() {
+    for (uint32_t i = 0; i < TOTAL; i++) {
+      uint16_t len = (uint16_t)(i % 61);
+      uint8_t* p;
+      while ((p = records.reserve(len)) == nullptr) {
+        yield();
+      }
+      for (uint16_t k = 0; k < len; k++) {
+        p[k] = (uint8_t)(i + k);
+      }
+      records.commit(len);
+    }
+  });
+
+  uint32_t i = 0;
+  bool ok = true;
+  while (i < TOTAL) {
+    uint16_t len = 0;
+    const uint8_t* p = records.front(len);
+    if (p == nullptr) {
+      yield();
+      continue;
+    }
+    ok = ok && len == i % 61;
+    for (uint16_t k = 0; k < len; k++) {
+      ok = ok && p[k] == (uint8_t)(i + k);
+    }
+    records.popFront();
+    i++;
+  }
+  producer.join();
+
+  TEST_ASSERT_TRUE(ok);
+  TEST_ASSERT_TRUE(records.empty());
+}
+
+int main(int argc, char** argv) {
+  (void)argc;
+  (void)argv;
+  UNITY_BEGIN();
+  RUN_TEST(test_holds_capacity_minus_one);
+  RUN_TEST(test_wraps_around);
+  RUN_TEST(test_full_after_wrap);
+  RUN_TEST(test_peek_and_pop_front);
+  RUN_TEST(test_peek_across_the_wrap);
+  RUN_TEST(test_records_in_order);
+  RUN_TEST(test_record_full_and_too_big);
+  RUN_TEST(test_commit_shorter_than_reserved);
+  RUN_TEST(test_record_wraps_with_skip_marker);
+  RUN_TEST(test_threaded_producer_drops_when_full);
+  RUN_TEST(test_threaded_batch_consumer);
+  RUN_TEST(test_threaded_records);
+  return UNITY_END();
+}
@@ -0,0 +1,251 @@
+// Comms streaming publish against a FakeBroker on loopback: payloads larger
+// than the MQTT packet buffer, the byte count contract, the retained HA
+// discovery documents, and a benchmark of heap in use and throughput
+// against the buffered path (PubSubClient::publish with a buffer that fits).
+
+#include <unity.h>
+#include <Host.h>
+#include <FakeBroker.h>
+#include <WiFi.h>
+#include <ConfigStore.h>
+#include <ConnectionManager.h>
+#include <Comms.h>
+#include <config_common.h>
+#include <malloc.h>
+#include <string>
+
+static const uint32_t TIMEOUT_MS = 5000;
+static const size_t FRAGMENT = 64;            // what an encoder prints at a time
+static const size_t BENCH_MESSAGES = 200;
+
+static FakeBroker broker;
+static ConnectionManager cm;
+static Comms comms;
+
+// ============================
+// Helpers
+// ============================
+template <typename Pred>
+static bool serviceUntil(Pred pred, uint32_t timeoutMs) {
+  uint32_t start = millis();
+  while (!pred()) {
+    if (millis() - start >= timeoutMs) {
+      return false;
+    }
+    cm.loop();
+  }
+  return true;
+}
+
+// Byte i of a test document (recognisable at any offset)
+static char docByte(size_t i) {
+  return (char)('a' + (i * 7 + i / 26) % 26);
+}
+
+static std::string document(size_t len) {
+  std::string s(len, ' ');
+  for (size_t i = 0; i < len; i++) {
+    s[i] = docByte(i);
+  }
+  return s;
+}
+
+// Streams a document in encoder-sized fragments, never holding all of it
+static bool streamDocument(const char* topic, size_t len) {
+  if (!comms.beginPublish(topic, len)) {
+    return false;
+  }
+  char fragment[FRAGMENT];
+  for (size_t pos = 0; pos < len; pos += FRAGMENT) {
+    size_t n = std::min(FRAGMENT, len - pos);
+    for (size_t i = 0; i < n; i++) {
+      fragment[i] = docByte(pos + i);
+    }
+    comms.write((const uint8_t*)fragment, n);
+  }
+  return comms.endPublish();
+}
+
+static size_t heapInUse() {
+  return mallinfo2().uordblks;
+}
+
+void setUp(void) {
+  Host::quiet(true);
+  Host::useVirtualClock(false);
+  Host::nvsErase();
+  Host::powerCycle();
+  Host::setWifi(true);
+
+  // A fresh session (the node notices the drop only once it reads the socket)
+  uint64_t connects = broker.stats().connects;
+  broker.dropClients();
+
+  ConfigStore::begin();
+  cm.begin();
+  comms.begin(cm);
+  cm.setComms(&comms);
+  cm.getMqttClient()->setBufferSize(MQTT_BUFFER_SIZE);
+  TEST_ASSERT_TRUE(serviceUntil([&] { return broker.stats().connects > connects && cm.mqttConnected(); },
+                                TIMEOUT_MS));
+  broker.clearLog();
+}
+
+void tearDown(void) {
+  comms.endPublish();   // a stream a failed test left open
+}
+
+// ============================
+// Contract
+// ============================
+static void test_larger_than_packet_buffer(void) {
+  const size_t len = 8 * MQTT_BUFFER_SIZE;
+  TEST_ASSERT_TRUE(len > comms.maxPayloadSize(MQTT_TOPIC_LOG));
+
+  // Buffered: does not fit
+  std::string doc = document(len);
+  TEST_ASSERT_FALSE(comms.publishLog(doc.c_str()));
+
+  // Streamed: arrives whole, the packet buffer untouched
+  TEST_ASSERT_TRUE(streamDocument(MQTT_TOPIC_LOG, len));
+  TEST_ASSERT_EQUAL_UINT16(MQTT_BUFFER_SIZE, cm.getMqttClient()->getBufferSize());
+  TEST_ASSERT_TRUE(broker.waitFor(MQTT_TOPIC_LOG, 1, TIMEOUT_MS));
+  std::vector<FakeBroker::Message> got = broker.messages(MQTT_TOPIC_LOG);
+  TEST_ASSERT_EQUAL(1, got.size());
+  TEST_ASSERT_TRUE(got[0].payload == doc);
+
+  // The session is still usable
+  TEST_ASSERT_TRUE(comms.publishLog("after"));
+  TEST_ASSERT_TRUE(broker.waitFor(MQTT_TOPIC_LOG, 2, TIMEOUT_MS));
+}
+
+static void test_short_stream_drops_session(void) {
+  TEST_ASSERT_TRUE(comms.beginPublish(MQTT_TOPIC_LOG, 100));
+  TEST_ASSERT_EQUAL(40, comms.write((const uint8_t*)document(40).data(), 40));
+  TEST_ASSERT_FALSE(comms.endPublish());
+
+  // The broker never sees a message cut short; the node reconnects
+  TEST_ASSERT_FALSE(cm.mqttConnected());
+  TEST_ASSERT_TRUE(serviceUntil([] { return cm.mqttConnected(); }, TIMEOUT_MS));
+  TEST_ASSERT_TRUE(comms.publishLog("after"));
+  TEST_ASSERT_TRUE(broker.waitFor(MQTT_TOPIC_LOG, 1, TIMEOUT_MS));
+  TEST_ASSERT_EQUAL(1, broker.count(MQTT_TOPIC_LOG));
+}
+
+static void test_long_stream_capped(void) {
+  std::string doc = document(100);
+  TEST_ASSERT_TRUE(comms.beginPublish(MQTT_TOPIC_LOG, 60));
+  TEST_ASSERT_EQUAL(60, comms.write((const uint8_t*)doc.data(), doc.size()));
+  TEST_ASSERT_EQUAL(0, comms.write((const uint8_t*)doc.data(), 1));
+  TEST_ASSERT_TRUE(comms.endPublish());
+
+  TEST_ASSERT_TRUE(broker.waitFor(MQTT_TOPIC_LOG, 1, TIMEOUT_MS));
+  TEST_ASSERT_TRUE(broker.messages(MQTT_TOPIC_LOG)[0].payload == doc.substr(0, 60));
+}
+
+static void test_one_stream_at_a_time(void) {
+  TEST_ASSERT_FALSE(comms.endPublish());
+  TEST_ASSERT_EQUAL(0, comms.write((const uint8_t*)"x", 1));
+
+  TEST_ASSERT_TRUE(comms.beginPublish(MQTT_TOPIC_LOG, 1));
+  TEST_ASSERT_FALSE(comms.beginPublish(MQTT_TOPIC_LOG, 1));
+  comms.write((const uint8_t*)"x", 1);
+  TEST_ASSERT_TRUE(comms.endPublish());
+}
+
+static void test_ha_discovery_streamed_retained(void) {
+  TEST_ASSERT_TRUE(comms.publishHAConfig(true));
+  TEST_ASSERT_TRUE(broker.waitFor("homeassistant/#", 2, TIMEOUT_MS));
+
+  for (const FakeBroker::Message& m : broker.messages("homeassistant/#")) {
+    TEST_ASSERT_TRUE(m.retained);
+    TEST_ASSERT_EQUAL('{', m.payload.front());
+    TEST_ASSERT_EQUAL('}', m.payload.back());
+    TEST_ASSERT_TRUE(m.payload.find("\"availability_topic\"") != std::string::npos);
+  }
+}
+
+// ============================
+// Benchmark
+// ============================
+struct BenchResult {
+  size_t heapPeak;     // heap in use above the baseline, at the path's peak
+  double msgsPerS;
+  double mbPerS;
+};
+
+static BenchResult benchBuffered(size_t len) {
+  PubSubClient* mqtt = cm.getMqttClient();
+  size_t base = heapInUse();
+
+  // The whole document in RAM, and a packet buffer it fits in
+  std::string doc = document(len);
+  TEST_ASSERT_TRUE(mqtt->setBufferSize((uint16_t)std::min<size_t>(len + 64, 0xFFFF)));
+  size_t peak = heapInUse() - base;
+
+  broker.clearLog();
+  uint32_t start = micros();
+  for (size_t i = 0; i < BENCH_MESSAGES; i++) {
+    TEST_ASSERT_TRUE(comms.publishLog(doc.c_str()));
+  }
+  TEST_ASSERT_TRUE(broker.waitFor(MQTT_TOPIC_LOG, BENCH_MESSAGES, TIMEOUT_MS * 4));
+  uint32_t us = micros() - start;
+
+  mqtt->setBufferSize(MQTT_BUFFER_SIZE);
+  return { peak, BENCH_MESSAGES * 1e6 / us, BENCH_MESSAGES * len / (double)us };
+}
+
+static BenchResult benchStreamed(size_t len) {
+  size_t base = heapInUse();
+
+  broker.clearLog();
+  uint32_t start = micros();
+  for (size_t i = 0; i < BENCH_MESSAGES; i++) {
+    TEST_ASSERT_TRUE(streamDocument(MQTT_TOPIC_LOG, len));
+  }
+  size_t peak = heapInUse() > base ? heapInUse() - base : 0;
+  TEST_ASSERT_TRUE(broker.waitFor(MQTT_TOPIC_LOG, BENCH_MESSAGES, TIMEOUT_MS * 4));
+  uint32_t us = micros() - start;
+
+  return { peak, BENCH_MESSAGES * 1e6 / us, BENCH_MESSAGES * len / (double)us };
+}
+
+static void test_benchmark_buffered_vs_streamed(void) {
+  // Heap numbers are glibc's view of this process (meaningless under ASan);
+  // on the device the buffered path also needs the buffer as contiguous heap
+  broker.setLogging(true);
+  const size_t sizes[] = { 512, 2048, 8192, 32768 };
+  for (size_t len : sizes) {
+    BenchResult b = benchBuffered(len);
+    BenchResult s = benchStreamed(len);
+
+    char msg[160];
+    snprintf(msg, sizeof(msg),
+             "%5u B: buffered heap +%u B %.0f msg/s %.1f MB/s | streamed heap +%u B %.0f msg/s %.1f MB/s",
+             (unsigned)len, (unsigned)b.heapPeak, b.msgsPerS, b.mbPerS,
+             (unsigned)s.heapPeak, s.msgsPerS, s.mbPerS);
+    TEST_MESSAGE(msg);
+
+    TEST_ASSERT_TRUE(s.msgsPerS > 0 && b.msgsPerS > 0);
+  }
+}
+
+int main(int argc, char** argv) {
+  (void)argc;
+  (void)argv;
+  if (!broker.start()) {
+    return 1;
+  }
+  broker.attach(IPAddress(192, 168, 0, 20), MQTT_PORT);
+
+  UNITY_BEGIN();
+  RUN_TEST(test_larger_than_packet_buffer);
+  RUN_TEST(test_short_stream_drops_session);
+  RUN_TEST(test_long_stream_capped);
+  RUN_TEST(test_one_stream_at_a_time);
+  RUN_TEST(test_ha_discovery_streamed_retained);
+  RUN_TEST(test_benchmark_buffered_vs_streamed);
+  int failures = UNITY_END();
+  broker.stop();
+  return failures;
+}
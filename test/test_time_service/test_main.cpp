@@ -0,0 +1,328 @@
+// TimeService: the drift model (sign, rounding, averaging, limits), the sync
+// schedule with its failure backoff and the residual correction, then whole
+// syncs against a FakeDS3231 and a FakeSntpServer in virtual time.
+
+#include <unity.h>
+#include <Host.h>
+#include <FakeDS3231.h>
+#include <FakeSntpServer.h>
+#include <WiFi.h>
+#include <Preferences.h>
+#include <RTC.h>
+#include <TimeService.h>
+#include <stddef.h>
+#include <config_common.h>
+
+typedef TimeService::DriftState DriftState;
+
+static const int64_t US = 1000000;
+static const time_t T0 = 1767225600;            // 2026-01-01
+static const time_t CLOCK_LOST = 946684800;     // 2000-01-01, a DS3231 after OSF
+static const int64_t GIGA_MS = 1000000000LL;    // errorMs / 1000 = ppm over this interval
+static const time_t DAY = 86400;
+
+static FakeDS3231 chip(I2C_SDA_PIN, I2C_SCL_PIN);
+static FakeSntpServer ntp(IPAddress(10, 0, 0, 123));
+
+static void wakeAfter(uint64_t seconds) {
+  Host::deepSleep(seconds * US);
+  WiFi.begin("test-ap", "secret");
+}
+
+static const char* summary() {
+  static char buf[64];
+  TimeService::formatSyncSummary(buf, sizeof(buf));
+  return buf;
+}
+
+void setUp(void) {
+  Host::quiet(true);
+  Host::useVirtualClock(true);
+  Host::setPin(I2C_SDA_PIN, HIGH);
+  Host::setPin(I2C_SCL_PIN, HIGH);
+  Host::nvsErase();
+  Host::powerCycle();   // no drift model in RTC memory
+
+  chip.attach();
+  chip.setPpm(0.0f);
+  TEST_ASSERT_TRUE(RTC::begin());
+  RTC::setAgingOffset(0);
+
+  ntp.attach();
+  ntp.setErrorMs(0);
+  ntp.setLatency(20, 20);
+  ntp.setStratum(2);
+  ntp.setSilent(false);
+  Host::addHost(NTP_SERVER, IPAddress(10, 0, 0, 123));
+  Host::setWifi(true);
+  WiFi.begin("test-ap", "secret");
+
+  TimeService::begin();
+}
+
+void tearDown(void) {}
+
+// ============================
+// Drift model
+// ============================
+static void test_first_and_short_intervals_not_measured(void) {
+  DriftState s = {};
+  TEST_ASSERT_FALSE(TimeService::updateDrift(s, T0 * 1000LL, 5000));
+  TEST_ASSERT_EQUAL_INT64(T0 * 1000LL, s.lastSyncMs);
+
+  int64_t later = T0 * 1000LL + (int64_t)(TIME_DRIFT_MIN_HOURS - 1) * 3600000;
+  TEST_ASSERT_FALSE(TimeService::updateDrift(s, later, 100));
+  TEST_ASSERT_EQUAL_INT64(later, s.lastSyncMs);
+  TEST_ASSERT_EQUAL_UINT8(0, s.samples);
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, TimeService::residualPpm(s));
+}
+
+static void test_sign_and_rounding(void) {
+  // Fast clock, positive offset; slow clock, negative; nearest LSB
+  const struct { int64_t errorMs; int8_t aging; } cases[] = {
+    { 2360, 24 }, { 2340, 23 }, { -1260, -13 }, { 40, 0 }, { -60, -1 },
+  };
+  for (const auto& c : cases) {
+    DriftState s = {};
+    s.lastSyncMs = T0 * 1000LL;
+    TEST_ASSERT_EQUAL(c.aging != 0, TimeService::updateDrift(s, s.lastSyncMs + GIGA_MS, c.errorMs));
+    TEST_ASSERT_FLOAT_WITHIN(0.0001f, c.errorMs / 1000.0f, s.intrinsicPpm);
+    TEST_ASSERT_EQUAL_INT8(c.aging, s.aging);
+    TEST_ASSERT_EQUAL_UINT8(1, s.samples);
+  }
+
+  DriftState s = {};
+  s.lastSyncMs = T0 * 1000LL;
+  TimeService::updateDrift(s, s.lastSyncMs + GIGA_MS, 2360);
+  TEST_ASSERT_FLOAT_WITHIN(0.0001f, -0.04f, TimeService::residualPpm(s));
+}
+
+static void test_averaged_with_aging_in_effect(void) {
+  DriftState s = {};
+  s.lastSyncMs = T0 * 1000LL;
+  TEST_ASSERT_TRUE(TimeService::updateDrift(s, T0 * 1000LL + GIGA_MS, 2000));
+  TEST_ASSERT_EQUAL_INT8(20, s.aging);
+
+  // Trimmed by 2.0 ppm and still 0.4 ppm fast: 2.4 intrinsic, averaged to 2.2
+  TEST_ASSERT_TRUE(TimeService::updateDrift(s, T0 * 1000LL + 2 * GIGA_MS, 400));
+  TEST_ASSERT_FLOAT_WITHIN(0.0001f, 2.2f, s.intrinsicPpm);
+  TEST_ASSERT_EQUAL_INT8(22, s.aging);
+  TEST_ASSERT_EQUAL_UINT8(2, s.samples);
+
+  // Clock set by hand in between: not a drift, but the interval restarts
+  TEST_ASSERT_FALSE(TimeService::updateDrift(s, T0 * 1000LL + 3 * GIGA_MS, 500000));
+  TEST_ASSERT_FLOAT_WITHIN(0.0001f, 2.2f, s.intrinsicPpm);
+  TEST_ASSERT_EQUAL_UINT8(2, s.samples);
+  TEST_ASSERT_EQUAL_INT64(T0 * 1000LL + 3 * GIGA_MS, s.lastSyncMs);
+}
+
+static void test_aging_clamped(void) {
+  DriftState s = {};
+  s.lastSyncMs = T0 * 1000LL;
+  TEST_ASSERT_TRUE(TimeService::updateDrift(s, T0 * 1000LL + GIGA_MS, -20000));
+  TEST_ASSERT_EQUAL_INT8(-127, s.aging);
+  TEST_ASSERT_FLOAT_WITHIN(0.0001f, -7.3f, TimeService::residualPpm(s));
+}
+
+// ============================
+// Schedule
+// ============================
+static void test_sync_due(void) {
+  DriftState s = {};
+  TEST_ASSERT_TRUE(TimeService::syncDue(s, T0));   // never synced
+
+  s.lastSyncMs = T0 * 1000LL;
+  TEST_ASSERT_FALSE(TimeService::syncDue(s, T0 + TIME_SYNC_INTERVAL_DAYS * DAY - 1));
+  TEST_ASSERT_TRUE(TimeService::syncDue(s, T0 + TIME_SYNC_INTERVAL_DAYS * DAY));
+  TEST_ASSERT_TRUE(TimeService::syncDue(s, CLOCK_LOST));
+}
+
+static void test_failure_backoff_doubles_to_cap(void) {
+  DriftState s = {};
+  s.lastSyncMs = T0 * 1000LL;
+  time_t t = T0 + TIME_SYNC_INTERVAL_DAYS * DAY;
+
+  uint32_t waitMin = TIME_SYNC_RETRY_MIN;
+  for (int failure = 1; failure <= 20; failure++) {
+    TimeService::syncFailed(s, t);
+    TEST_ASSERT_FALSE(TimeService::syncDue(s, t + (time_t)waitMin * 60 - 1));
+    t += (time_t)waitMin * 60;
+    TEST_ASSERT_TRUE(TimeService::syncDue(s, t));
+    waitMin = waitMin * 2 < TIME_SYNC_RETRY_MAX ? waitMin * 2 : TIME_SYNC_RETRY_MAX;
+  }
+  TEST_ASSERT_EQUAL_UINT8(16, s.syncFailures);
+
+  // Clock went back past the last attempt: retry now
+  TEST_ASSERT_TRUE(TimeService::syncDue(s, (time_t)s.lastAttempt - 10));
+}
+
+static void test_correct_removes_residual(void) {
+  DriftState s = {};
+  TEST_ASSERT_EQUAL_INT64(T0 + 1000, TimeService::correct(s, T0 + 1000));   // never synced
+
+  s.lastSyncMs = T0 * 1000LL;
+  s.intrinsicPpm = 5.0f;
+  s.samples = 1;
+  TEST_ASSERT_EQUAL_INT64(T0 + 7 * DAY - 3, TimeService::correct(s, T0 + 7 * DAY));   // 3.024 s fast
+  s.aging = 30;
+  TEST_ASSERT_EQUAL_INT64(T0 + 7 * DAY - 1, TimeService::correct(s, T0 + 7 * DAY));   // 2 ppm left
+  s.intrinsicPpm = -5.0f;
+  s.aging = 0;
+  TEST_ASSERT_EQUAL_INT64(T0 + 7 * DAY + 3, TimeService::correct(s, T0 + 7 * DAY));
+  TEST_ASSERT_EQUAL_INT64(T0 - 100, TimeService::correct(s, T0 - 100));   // before the sync
+
+  s.samples = 0;   // no measurement yet
+  TEST_ASSERT_EQUAL_INT64(T0 + 7 * DAY, TimeService::correct(s, T0 + 7 * DAY));
+}
+
+// ============================
+// Sync over SNTP
+// ============================
+static void test_first_sync_sets_clock(void) {
+  chip.setTime(CLOCK_LOST * US);
+  uint32_t requests = ntp.requests();
+  TEST_ASSERT_TRUE(TimeService::syncIfDue());
+  TEST_ASSERT_EQUAL_UINT32(requests + 1, ntp.requests());
+
+  // Set on a second boundary from a symmetric round trip: within a poll
+  TEST_ASSERT_INT_WITHIN(5000, 0, (int)(chip.timeUs() - Host::worldTimeUs()));
+  time_t t = 0;
+  TEST_ASSERT_TRUE(TimeService::now(t));
+  TEST_ASSERT_INT_WITHIN(1, 0, (int)(t - Host::worldTime()));
+
+  TEST_ASSERT_FALSE(TimeService::syncIfDue());
+  TEST_ASSERT_EQUAL_UINT32(requests + 1, ntp.requests());
+}
+
+static void test_drift_trimmed_with_aging_offset(void) {
+  chip.setTime(CLOCK_LOST * US);
+  TEST_ASSERT_TRUE(TimeService::syncIfDue());
+
+  // 3.5 ppm fast for a week: 2.117 s ahead
+  chip.setPpm(3.5f);
+  wakeAfter(TIME_SYNC_INTERVAL_DAYS * DAY);
+  uint32_t conversions = chip.conversions();
+  TEST_ASSERT_TRUE(TimeService::syncIfDue());
+  TEST_ASSERT_EQUAL_STRING_LEN("offset_ms=211", summary(), 13);
+  TEST_ASSERT_NOT_NULL(strstr(summary(), " ppm=3.50 aging=35"));
+  TEST_ASSERT_EQUAL_INT8(35, (int8_t)chip.reg(0x10));
+  TEST_ASSERT_EQUAL_UINT32(conversions + 1, chip.conversions());
+  TEST_ASSERT_INT_WITHIN(5000, 0, (int)(chip.timeUs() - Host::worldTimeUs()));
+
+  // Trimmed: the next week ends within a few ms, the offset is kept
+  wakeAfter(TIME_SYNC_INTERVAL_DAYS * DAY);
+  TEST_ASSERT_INT_WITHIN(5000, 0, (int)(chip.timeUs() - Host::worldTimeUs()));
+  TEST_ASSERT_TRUE(TimeService::syncIfDue());
+  TEST_ASSERT_EQUAL_INT8(35, (int8_t)chip.reg(0x10));
+  TEST_ASSERT_EQUAL_UINT32(conversions + 1, chip.conversions());
+}
+
+static void test_asymmetric_path_biases_estimate(void) {
+  // The reply is assumed to have taken half the round trip: a slow request
+  // path makes the clock half the difference fast
+  chip.setTime(CLOCK_LOST * US);
+  ntp.setLatency(100, 0);
+  TEST_ASSERT_TRUE(TimeService::syncIfDue());
+  TEST_ASSERT_INT_WITHIN(5000, 50000, (int)(chip.timeUs() - Host::worldTimeUs()));
+}
+
+static void test_failed_syncs_back_off(void) {
+  chip.setTime(CLOCK_LOST * US);
+  TEST_ASSERT_TRUE(TimeService::syncIfDue());
+  wakeAfter(TIME_SYNC_INTERVAL_DAYS * DAY);
+
+  ntp.setSilent(true);
+  uint32_t requests = ntp.requests();
+  TEST_ASSERT_FALSE(TimeService::syncIfDue());
+  TEST_ASSERT_EQUAL_UINT32(requests + 1, ntp.requests());
+
+  // Not on every wake: after 15 min, then 30
+  TEST_ASSERT_FALSE(TimeService::syncIfDue());
+  wakeAfter(14 * 60);
+  TEST_ASSERT_FALSE(TimeService::syncIfDue());
+  TEST_ASSERT_EQUAL_UINT32(requests + 1, ntp.requests());
+  wakeAfter(60);
+  TEST_ASSERT_FALSE(TimeService::syncIfDue());
+  TEST_ASSERT_EQUAL_UINT32(requests + 2, ntp.requests());
+
+  wakeAfter(29 * 60);
+  TEST_ASSERT_FALSE(TimeService::syncIfDue());
+  TEST_ASSERT_EQUAL_UINT32(requests + 2, ntp.requests());
+
+  // A kiss-o'-death is a failure too
+  ntp.setSilent(false);
+  ntp.setStratum(0);
+  wakeAfter(2 * 60);
+  TEST_ASSERT_FALSE(TimeService::syncIfDue());
+  TEST_ASSERT_EQUAL_UINT32(requests + 3, ntp.requests());
+
+  ntp.setStratum(2);
+  wakeAfter(60 * 60);
+  TEST_ASSERT_TRUE(TimeService::syncIfDue());
+
+  // Reset by the success: the next failure waits 15 min again
+  wakeAfter(TIME_SYNC_INTERVAL_DAYS * DAY);
+  Host::dropUdp(1);
+  TEST_ASSERT_FALSE(TimeService::syncIfDue());
+  wakeAfter(15 * 60);
+  TEST_ASSERT_TRUE(TimeService::syncIfDue());
+}
+
+static void test_no_sync_without_network(void) {
+  chip.setTime(CLOCK_LOST * US);
+  Host::setWifi(false);
+  WiFi.begin("test-ap", "secret");
+  uint32_t requests = ntp.requests();
+  TEST_ASSERT_FALSE(TimeService::syncIfDue());
+  TEST_ASSERT_EQUAL_UINT32(requests, ntp.requests());
+}
+
+// ============================
+// Persistence
+// ============================
+static void test_model_survives_power_cycle(void) {
+  chip.setTime(CLOCK_LOST * US);
+  TEST_ASSERT_TRUE(TimeService::syncIfDue());
+  chip.setPpm(3.5f);
+  wakeAfter(TIME_SYNC_INTERVAL_DAYS * DAY);
+  TEST_ASSERT_TRUE(TimeService::syncIfDue());
+
+  Host::powerCycle();
+  TimeService::begin();
+  TEST_ASSERT_NOT_NULL(strstr(summary(), " ppm=3.50 aging=35"));
+
+  // A drift blob from before the backoff fields were appended
+  DriftState old = {};
+  old.lastSyncMs = T0 * 1000LL;
+  old.intrinsicPpm = 1.2f;
+  old.samples = 3;
+  old.aging = 12;
+  Preferences prefs;
+  TEST_ASSERT_TRUE(prefs.begin("time", false));
+  prefs.putBytes("drift", &old, offsetof(DriftState, syncFailures));
+  prefs.end();
+
+  Host::powerCycle();
+  TimeService::begin();
+  TEST_ASSERT_NOT_NULL(strstr(summary(), " ppm=1.20 aging=12"));
+}
+
+int main(int argc, char** argv) {
+  (void)argc;
+  (void)argv;
+  UNITY_BEGIN();
+  RUN_TEST(test_first_and_short_intervals_not_measured);
+  RUN_TEST(test_sign_and_rounding);
+  RUN_TEST(test_averaged_with_aging_in_effect);
+  RUN_TEST(test_aging_clamped);
+  RUN_TEST(test_sync_due);
+  RUN_TEST(test_failure_backoff_doubles_to_cap);
+  RUN_TEST(test_correct_removes_residual);
+  RUN_TEST(test_first_sync_sets_clock);
+  RUN_TEST(test_drift_trimmed_with_aging_offset);
+  RUN_TEST(test_asymmetric_path_biases_estimate);
+  RUN_TEST(test_failed_syncs_back_off);
+  RUN_TEST(test_no_sync_without_network);
+  RUN_TEST(test_model_survives_power_cycle);
+  return UNITY_END();
+}
@@ -0,0 +1,237 @@
+// TlsClient against a TLS front end (OpenSSL) to a FakeBroker on loopback:
+// full handshake on the first wake, resumption after deep sleep with session
+// IDs and with tickets, a broker that forgot the session, the cache lost on
+// power cycle, a broker signed by another CA or under another name, and the
+// handshake times of both kinds. Needs env:native-tls (see test/README).
+
+#include <unity.h>
+#include <Host.h>
+#include <FakeBroker.h>
+#include <TlsProxy.h>
+#include <WiFi.h>
+#include <TlsClient.h>
+#include <PubSubClient.h>
+#include <string>
+
+static const uint32_t TIMEOUT_MS = 5000;
+static const char* BROKER_NAME = "broker.test";
+static const uint16_t TLS_PORT = 8883;
+static const char* TOPIC = "tls/test";
+static const int TIMING_ROUNDS = 10;
+
+static FakeBroker broker;
+static TlsProxy proxy;
+static TlsProxy stranger;      // same name, its own CA
+static WiFiClient tcp;
+static TlsClient tls(tcp);
+static PubSubClient mqtt(tls);
+
+// ============================
+// Helpers
+// ============================
+static bool joinWifi() {
+  WiFi.begin("ssid", "pass");
+  uint32_t start = millis();
+  while (WiFi.status() != WL_CONNECTED) {
+    if (millis() - start >= TIMEOUT_MS) {
+      return false;
+    }
+    delay(1);
+  }
+  return true;
+}
+
+// One wake: TLS + MQTT connect, one message through, clean disconnect
+static bool wake(const char* host = BROKER_NAME) {
+  if (!joinWifi()) {
+    return false;
+  }
+  size_t before = broker.count(TOPIC);
+  mqtt.setServer(host, TLS_PORT);
+  if (!mqtt.connect("tls-node")) {
+    return false;
+  }
+  bool delivered = mqtt.publish(TOPIC, "hello") && broker.waitFor(TOPIC, before + 1, TIMEOUT_MS);
+  mqtt.disconnect();
+  return delivered;
+}
+
+static void sleepAndWake() {
+  Host::deepSleep(60ULL * 1000000ULL);
+  TEST_ASSERT_TRUE(wake());
+}
+
+void setUp(void) {
+  Host::quiet(true);
+  Host::useVirtualClock(false);
+  Host::powerCycle();
+  Host::setWifi(true);
+
+  proxy.setSessionCache(true);
+  proxy.setTickets(true);
+  proxy.forgetSessions();
+  tls.setCACert(proxy.caPem());
+}
+
+void tearDown(void) {
+  mqtt.disconnect();
+}
+
+// ============================
+// Resumption
+// ============================
+static void test_first_wake_full_handshake(void) {
+  uint32_t handshakes = proxy.handshakes();
+  uint32_t resumed = proxy.resumedHandshakes();
+
+  TEST_ASSERT_TRUE(wake());
+  TEST_ASSERT_EQUAL_UINT32(1, TlsClient::getFullCount());
+  TEST_ASSERT_EQUAL_UINT32(0, TlsClient::getResumedCount());
+  TEST_ASSERT_FALSE(TlsClient::lastHandshakeResumed());
+  TEST_ASSERT_EQUAL_UINT32(handshakes + 1, proxy.handshakes());
+  TEST_ASSERT_EQUAL_UINT32(resumed, proxy.resumedHandshakes());
+}
+
+// The client's count must agree with the broker's on every wake
+static void checkResumesAfterSleep(void) {
+  TEST_ASSERT_TRUE(wake());
+  uint32_t resumed = proxy.resumedHandshakes();
+
+  for (uint32_t i = 1; i <= 3; i++) {
+    sleepAndWake();
+    TEST_ASSERT_TRUE(TlsClient::lastHandshakeResumed());
+    TEST_ASSERT_EQUAL_UINT32(1, TlsClient::getFullCount());
+    TEST_ASSERT_EQUAL_UINT32(i, TlsClient::getResumedCount());
+    TEST_ASSERT_EQUAL_UINT32(resumed + i, proxy.resumedHandshakes());
+  }
+}
+
+static void test_resumed_with_session_id(void) {
+  proxy.setTickets(false);
+  checkResumesAfterSleep();
+}
+
+static void test_resumed_with_ticket(void) {
+  proxy.setSessionCache(false);
+  checkResumesAfterSleep();
+}
+
+static void test_forgotten_session_full_handshake(void) {
+  TEST_ASSERT_TRUE(wake());
+  proxy.forgetSessions();            // broker restarted while the node slept
+  uint32_t resumed = proxy.resumedHandshakes();
+
+  sleepAndWake();
+  TEST_ASSERT_FALSE(TlsClient::lastHandshakeResumed());
+  TEST_ASSERT_EQUAL_UINT32(2, TlsClient::getFullCount());
+  TEST_ASSERT_EQUAL_UINT32(0, TlsClient::getResumedCount());
+  TEST_ASSERT_EQUAL_UINT32(resumed, proxy.resumedHandshakes());
+
+  // The new session is cached in turn
+  sleepAndWake();
+  TEST_ASSERT_TRUE(TlsClient::lastHandshakeResumed());
+}
+
+static void test_power_cycle_clears_session(void) {
+  TEST_ASSERT_TRUE(wake());
+  sleepAndWake();
+  TEST_ASSERT_EQUAL_UINT32(1, TlsClient::getResumedCount());
+  uint32_t resumed = proxy.resumedHandshakes();
+
+  Host::powerCycle();
+  TEST_ASSERT_EQUAL_UINT32(0, TlsClient::getFullCount());
+  TEST_ASSERT_EQUAL_UINT32(0, TlsClient::getResumedCount());
+
+  TEST_ASSERT_TRUE(wake());
+  TEST_ASSERT_FALSE(TlsClient::lastHandshakeResumed());
+  TEST_ASSERT_EQUAL_UINT32(1, TlsClient::getFullCount());
+  TEST_ASSERT_EQUAL_UINT32(resumed, proxy.resumedHandshakes());
+}
+
+// ============================
+// Verification
+// ============================
+static void test_untrusted_ca_refused(void) {
+  Host::attachTcp(IPAddress(192, 168, 0, 21), TLS_PORT, stranger.port());
+  Host::addHost("stranger.test", IPAddress(192, 168, 0, 21));
+  size_t before = broker.count(TOPIC);
+
+  TEST_ASSERT_FALSE(wake("stranger.test"));
+  TEST_ASSERT_FALSE(mqtt.connected());
+  TEST_ASSERT_EQUAL_UINT32(0, TlsClient::getFullCount());
+  TEST_ASSERT_EQUAL(before, broker.count(TOPIC));
+}
+
+static void test_wrong_name_refused(void) {
+  // The right broker under a name its certificate does not carry
+  Host::addHost("other.test", IPAddress(192, 168, 0, 20));
+
+  TEST_ASSERT_FALSE(wake("other.test"));
+  TEST_ASSERT_EQUAL_UINT32(0, TlsClient::getFullCount());
+
+  TEST_ASSERT_TRUE(wake());
+}
+
+static void test_no_ca_refused(void) {
+  TlsClient bare(tcp);
+  TEST_ASSERT_TRUE(joinWifi());
+  TEST_ASSERT_EQUAL(0, bare.connect(BROKER_NAME, TLS_PORT));
+}
+
+// ============================
+// Handshake time
+// ============================
+static uint32_t timedConnect() {
+  uint32_t start = micros();
+  TEST_ASSERT_EQUAL(1, tls.connect(BROKER_NAME, TLS_PORT));
+  uint32_t us = micros() - start;
+  tls.stop();
+  return us;
+}
+
+static void test_handshake_times(void) {
+  TEST_ASSERT_TRUE(joinWifi());
+
+  uint64_t fullUs = 0;
+  for (int i = 0; i < TIMING_ROUNDS; i++) {
+    TlsClient::clearSession();
+    fullUs += timedConnect();
+  }
+  uint64_t resumedUs = 0;
+  for (int i = 0; i < TIMING_ROUNDS; i++) {
+    resumedUs += timedConnect();
+    TEST_ASSERT_TRUE(TlsClient::lastHandshakeResumed());
+  }
+
+  char line[96];
+  snprintf(line, sizeof(line), "handshake: full %.2f ms, resumed %.2f ms (mean of %d)",
+           fullUs / 1000.0 / TIMING_ROUNDS, resumedUs / 1000.0 / TIMING_ROUNDS, TIMING_ROUNDS);
+  TEST_MESSAGE(line);
+  TEST_ASSERT_TRUE(resumedUs < fullUs);
+}
+
+int main(int argc, char** argv) {
+  Host::useVirtualClock(false);
+  broker.start();
+  proxy.start(broker.port(), BROKER_NAME);
+  stranger.start(broker.port(), BROKER_NAME);
+  proxy.attach(IPAddress(192, 168, 0, 20), TLS_PORT);
+  Host::addHost(BROKER_NAME, IPAddress(192, 168, 0, 20));
+
+  UNITY_BEGIN();
+  RUN_TEST(test_first_wake_full_handshake);
+  RUN_TEST(test_resumed_with_session_id);
+  RUN_TEST(test_resumed_with_ticket);
+  RUN_TEST(test_forgotten_session_full_handshake);
+  RUN_TEST(test_power_cycle_clears_session);
+  RUN_TEST(test_untrusted_ca_refused);
+  RUN_TEST(test_wrong_name_refused);
+  RUN_TEST(test_no_ca_refused);
+  RUN_TEST(test_handshake_times);
+  int failures = UNITY_END();
+
+  stranger.stop();
+  proxy.stop();
+  broker.stop();
+  return failures;
+}
@@ -0,0 +1,526 @@
+// Wake traces (the "trace" command, SPEC.md) replayed through the firmware's
+// own modules on the host, the output diffed against golden files. Each
+// record's external inputs go back in: wake cause, battery voltage (into
+// PowerPolicy), RTC epoch and DHT22 values, whether and when WiFi and the
+// broker came up, and the commands received (queued at the broker before the
+// wake, drained from the node's session). The wake itself is WakeCycle, the
+// same run() setup() in src/main.cpp calls, against FakeBroker with
+// EnergyModel charging each phase; only the sensors, RTC and battery come
+// from the record (WakeCycle::Hooks). A Scheduler on the simulated clock
+// runs the wakes at the recorded times (or after the node's own interval
+// when a record has no RTC time) and closes each replayed day.
+//
+// Golden files (golden/<trace>.txt): per wake a header line, the MQTT
+// messages the broker received in order, and the wake's energy fields
+// (phase_ms); the multi-month trace is kept as one digest line per day.
+// After an intended change, rewrite them and review the diff:
+//
+//   UPDATE_GOLDEN=1 pio test -e native -f test_wake_replay
+//
+// Wakes run on the virtual clock, so months of wakes replay in seconds.
+
+#include <unity.h>
+#include <Host.h>
+#include <FakeBroker.h>
+#include <WiFi.h>
+#include <WakeCycle.h>
+#include <PowerPolicy.h>
+#include <EnergyModel.h>
+#include <Scheduler.h>
+#include <WakeTrace.h>
+#include <WakeWatchdog.h>
+#include <config_common.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+static const uint32_t SETTLE_MS = 200;              // Serial.begin() delay in setup()
+static const uint32_t DAY_MS = 86400000UL;
+static const uint8_t CAUSE_COLD_BOOT = 0;           // SleepManager::WakeCause
+static const uint8_t CAUSE_INPUT = 2;
+static const uint8_t CONNACK_UNAVAILABLE = 3;
+static const int SEASON_DAYS = 92;
+
+struct Record {
+  uint32_t seq;
+  uint8_t cause;
+  uint8_t flags;
+  uint32_t epoch;
+  int16_t tempCenti;
+  uint16_t humCenti;
+  uint16_t batteryMv;
+  uint32_t wifiMs;
+  uint32_t mqttMs;
+  std::vector<std::string> commands;
+};
+
+// ============================================================================
+// Replay state
+// ============================================================================
+
+static FakeBroker broker;
+static Scheduler scheduler;
+static int64_t replayStartUs = 0;
+
+static const std::vector<Record>* replayTrace = nullptr;
+static size_t replayNext = 0;
+static bool perWake = true;                  // false: day digests only
+static std::vector<std::string> output;
+
+// The wake that just ran, for scheduling the next one
+static uint32_t lastSleepS = 0;
+
+// Current day (digest)
+struct Day {
+  uint32_t wakes;
+  uint32_t uplinks;
+  uint32_t msgs;
+  uint64_t payloadBytes;
+  uint32_t crc;
+};
+static Day day = {};
+static uint32_t dayNumber = 0;
+static PowerPolicy::Level lastLevel = PowerPolicy::Level::Normal;
+
+// ============================================================================
+// Trace
+// ============================================================================
+
+// Integer value of "key": in a JSON line (false if absent)
+static bool jsonInt(const char* line, const char* key, long& out) {
+  char pattern[32];
+  snprintf(pattern, sizeof(pattern), "\"%s\":", key);
+  const char* p = strstr(line, pattern);
+  if (p == nullptr) {
+    return false;
+  }
+  out = strtol(p + strlen(pattern), nullptr, 10);
+  return true;
+}
+
+// "cmds":["a","b"] (the trace leaves out commands with '"' or '\')
+static void jsonCommands(const char* line, std::vector<std::string>& out) {
+  const char* p = strstr(line, "\"cmds\":[");
+  if (p == nullptr) {
+    return;
+  }
+  p += strlen("\"cmds\":[");
+  while (*p == '"') {
+    const char* end = strchr(p + 1, '"');
+    if (end == nullptr) {
+      return;
+    }
+    out.push_back(std::string(p + 1, end - p - 1));
+    p = (end[1] == ',') ? end + 2 : end + 1;
+  }
+}
+
+static bool parseRecord(const char* line, Record& rec) {
+  long seq, cause, flags, epoch, t, h, mv, wifi, mqtt;
+  if (!jsonInt(line, "seq", seq) || !jsonInt(line, "cause", cause) ||
+      !jsonInt(line, "flags", flags) || !jsonInt(line, "epoch", epoch) ||
+      !jsonInt(line, "t", t) || !jsonInt(line, "h", h) || !jsonInt(line, "mv", mv) ||
+      !jsonInt(line, "wifi_ms", wifi) || !jsonInt(line, "mqtt_ms", mqtt)) {
+    return false;
+  }
+  rec = Record{ (uint32_t)seq, (uint8_t)cause, (uint8_t)flags, (uint32_t)epoch, (int16_t)t,
+                (uint16_t)h, (uint16_t)mv, (uint32_t)wifi, (uint32_t)mqtt, {} };
+  jsonCommands(line, rec.commands);
+  return true;
+}
+
+static std::string suiteDir() {
+  std::string file = __FILE__;
+  size_t slash = file.find_last_of('/');
+  return slash == std::string::npos ? "." : file.substr(0, slash);
+}
+
+static std::vector<Record> loadTrace(const char* name) {
+  std::vector<Record> trace;
+  std::string path = suiteDir() + "/traces/" + name + ".jsonl";
+  FILE* f = fopen(path.c_str(), "r");
+  TEST_ASSERT_NOT_NULL_MESSAGE(f, path.c_str());
+
+  char line[512];
+  Record rec;
+  while (fgets(line, sizeof(line), f) != nullptr) {
+    if (parseRecord(line, rec)) {
+      trace.push_back(rec);
+    }
+  }
+  fclose(f);
+  return trace;
+}
+
+// Months of a greenhouse every 10 min: a day/night swing, a battery running
+// down slowly, an AP outage every ten days and a ping once a week
+static std::vector<Record> seasonTrace(int days) {
+  const uint32_t start = 1767225600;   // 2026-01-01
+  const uint32_t stepS = 600;
+  const uint32_t perDay = 86400 / stepS;
+  uint32_t rng = 12345;
+  auto next = [&rng]() {
+    rng = rng * 1103515245u + 12345u;
+    return (rng >> 8) & 0xFFFF;
+  };
+
+  std::vector<Record> trace;
+  for (uint32_t i = 0; i < (uint32_t)days * perDay; i++) {
+    uint32_t d = i / perDay;
+    float frac = (float)(i % perDay) / perDay;
+    Record rec = {};
+    rec.seq = i + 1;
+    rec.cause = (i == 0) ? CAUSE_COLD_BOOT : 1;
+    rec.flags = WakeTrace::FLAG_READING | WakeTrace::FLAG_RTC_OK | WakeTrace::FLAG_DHT_OK;
+    rec.epoch = start + i * stepS;
+    rec.tempCenti = (int16_t)(1800 + 700 * sinf(2.0f * (float)M_PI * (frac - 0.3f)) + next() % 40);
+    rec.humCenti = (uint16_t)(5500 - 1500 * sinf(2.0f * (float)M_PI * (frac - 0.3f)) + next() % 100);
+    rec.batteryMv = (uint16_t)(4150 - 5 * d - next() % 8);
+    bool outage = (d % 10 == 9) && (i % perDay) >= 60 && (i % perDay) < 66;
+    rec.wifiMs = outage ? 0 : 700 + next() % 600;
+    rec.mqttMs = outage ? 0 : rec.wifiMs + 300 + next() % 200;
+    if (d % 7 == 3 && (i % perDay) == 72) {
+      rec.commands.push_back("ping");
+    }
+    trace.push_back(rec);
+  }
+  return trace;
+}
+
+// ============================================================================
+// Output
+// ============================================================================
+
+static void emit(const char* fmt, ...) {
+  char line[1024];
+  va_list args;
+  va_start(args, fmt);
+  vsnprintf(line, sizeof(line), fmt, args);
+  va_end(args);
+  if (perWake) {
+    output.push_back(line);
+  }
+}
+
+// FNV-1a, chained over a day's messages
+static uint32_t fnv1a(uint32_t hash, const std::string& text) {
+  for (unsigned char c : text) {
+    hash ^= c;
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+// Everything the node published, once the broker has read its closed socket
+static void collectMessages() {
+  auto start = std::chrono::steady_clock::now();
+  while (broker.clientsConnected() > 0 &&
+         std::chrono::steady_clock::now() - start < std::chrono::seconds(5)) {
+    std::this_thread::sleep_for(std::chrono::microseconds(50));
+  }
+  for (const FakeBroker::Message& m : broker.messages()) {
+    std::string line = "> " + m.topic + (m.retained ? " (retained) " : " ") + m.payload;
+    emit("%s", line.c_str());
+    day.msgs++;
+    day.payloadBytes += m.payload.size();
+    day.crc = fnv1a(day.crc, line);
+  }
+  broker.clearLog();
+}
+
+static void closeDay() {
+  dayNumber++;
+  char line[160];
+  snprintf(line, sizeof(line),
+           "day %u wakes %u uplinks %u msgs %u bytes %llu crc %08x power %s mah_day %.2f",
+           dayNumber, day.wakes, day.uplinks, day.msgs, (unsigned long long)day.payloadBytes,
+           day.crc, PowerPolicy::name(lastLevel), EnergyModel::mAhPerDay());
+  if (!perWake) {
+    output.push_back(line);
+  }
+  day = {};
+  day.crc = 2166136261u;
+}
+
+// ============================================================================
+// One wake (setup() in src/main.cpp)
+// ============================================================================
+
+// The record the hooks read from
+static const Record* wakeRecord = nullptr;
+
+static const WakeCycle::Hooks replayHooks = {
+  // readBatteryMv
+  []() -> uint16_t { return wakeRecord->batteryMv; },
+  // beginSensors
+  nullptr,
+  // readClock
+  [](time_t& nowEpoch) {
+    bool rtcOk = (wakeRecord->flags & WakeTrace::FLAG_RTC_OK) != 0;
+    nowEpoch = rtcOk ? (time_t)wakeRecord->epoch : 0;
+    return rtcOk;
+  },
+  // readSensor
+  [](float& tempC, float& humPct) {
+    if ((wakeRecord->flags & WakeTrace::FLAG_DHT_OK) == 0) {
+      return false;
+    }
+    tempC = wakeRecord->tempCenti / 100.0f;
+    humPct = wakeRecord->humCenti / 100.0f;
+    return true;
+  },
+  // syncClock: the trace has no SNTP server
+  nullptr,
+  // beginInputs, serviceInputs, formatPulseFields: no inputs on the profile
+  nullptr,
+  nullptr,
+  nullptr,
+};
+
+static const char* pathName(WakeCycle::Path path) {
+  switch (path) {
+    case WakeCycle::Path::Input:   return "input";
+    case WakeCycle::Path::Offline: return "offline";
+    case WakeCycle::Path::Backoff: return "backoff";
+    case WakeCycle::Path::Uplink:  return "uplink";
+  }
+  return "?";
+}
+
+static void runWake(const Record& rec) {
+  if (rec.cause == CAUSE_COLD_BOOT) {
+    Host::powerCycle();
+  }
+
+  char when[32] = "no-rtc";
+  if (rec.flags & WakeTrace::FLAG_RTC_OK) {
+    time_t t = (time_t)rec.epoch;
+    strftime(when, sizeof(when), "%Y-%m-%dT%H:%M:%SZ", gmtime(&t));
+  }
+  if (rec.cause == CAUSE_INPUT) {
+    // Event-only path: needs the profile's inputs, not part of the trace
+    emit("wake %lu %s cause=%u %umV input (not replayed)", (unsigned long)rec.seq, when,
+         rec.cause, rec.batteryMv);
+    return;
+  }
+
+  // The recorded link: WiFi up after wifiMs (or never), broker accepting or not
+  Host::setWifi(rec.wifiMs > 0, rec.wifiMs);
+  broker.refuseConnections(rec.mqttMs > 0 ? 0 : CONNACK_UNAVAILABLE);
+
+  // The commands this wake received, queued in the node's session meanwhile
+  for (const std::string& cmd : rec.commands) {
+    broker.publish(MQTT_TOPIC_CMD, cmd, 1);
+  }
+  wakeRecord = &rec;
+
+  EnergyModel::beginWake();
+  WakeWatchdog::begin(WAKE_BUDGET_MS, nullptr);
+  delay(SETTLE_MS);
+
+  // Scope of the wake: the socket closes when the node goes to sleep
+  WakeCycle::Outcome outcome;
+  PowerPolicy::Actions power;
+  {
+    WakeCycle node(replayHooks);
+    outcome = node.run();
+    power = node.getPower();
+    try {
+      node.sleep();
+    } catch (const Host::DeepSleep&) {
+    }
+  }
+  lastLevel = power.level;
+  lastSleepS = (uint32_t)(Host::wakeSources().timerUs / 1000000ULL);
+
+  emit("wake %lu %s cause=%u %umV %s x%u %s", (unsigned long)rec.seq, when, rec.cause,
+       rec.batteryMv, PowerPolicy::name(power.level), power.intervalMultiplier,
+       pathName(outcome.path));
+  for (const std::string& cmd : rec.commands) {
+    emit("  cmd %s", cmd.c_str());
+  }
+  if (outcome.radioStartMs != 0) {
+    emit("  link wifi=%lu mqtt=%lu%s", (unsigned long)outcome.wifiUpMs,
+         (unsigned long)outcome.mqttUpMs, outcome.mqttUpMs != 0 ? "" : " timeout");
+  }
+  if (outcome.path == WakeCycle::Path::Uplink && outcome.mqttUpMs != 0) {
+    day.uplinks++;
+  }
+
+  collectMessages();
+  day.wakes++;
+
+  char energyFields[160];
+  EnergyModel::formatStatusFields(energyFields, sizeof(energyFields));
+  emit("  %s", energyFields);
+}
+
+// ============================================================================
+// Driver
+// ============================================================================
+
+static unsigned long replayClock() {
+  return (unsigned long)((Host::worldTimeUs() - replayStartUs) / 1000);
+}
+
+static void wakeJob() {
+  runWake((*replayTrace)[replayNext++]);
+}
+
+static void dayJob() {
+  closeDay();
+}
+
+// To the next record's RTC time, else the node's own sleep
+static uint32_t msToNextWake() {
+  const Record& next = (*replayTrace)[replayNext];
+  int64_t nowMs = Host::worldTimeUs() / 1000;
+  if ((next.flags & WakeTrace::FLAG_RTC_OK) && (int64_t)next.epoch * 1000 > nowMs) {
+    return (uint32_t)((int64_t)next.epoch * 1000 - nowMs);
+  }
+  return lastSleepS * 1000UL;
+}
+
+static void replay(const std::vector<Record>& trace, bool wakeLines) {
+  TEST_ASSERT_FALSE(trace.empty());
+  replayTrace = &trace;
+  replayNext = 0;
+  perWake = wakeLines;
+  output.clear();
+  day = {};
+  day.crc = 2166136261u;
+  dayNumber = 0;
+
+  Host::setTime(trace[0].epoch > 0 ? (time_t)trace[0].epoch : 1767225600);
+  replayStartUs = Host::worldTimeUs();
+  // Days first: a wake right on the boundary opens the next day
+  scheduler.begin(replayClock);
+  scheduler.every(DAY_MS, dayJob);
+  int8_t wakeId = scheduler.every(1, wakeJob, true);
+
+  while (replayNext < trace.size()) {
+    size_t before = replayNext;
+    uint32_t waitMs = scheduler.runDue();
+    if (replayNext == trace.size()) {
+      break;
+    }
+    if (replayNext != before) {
+      scheduler.setPeriod(wakeId, msToNextWake());
+      waitMs = scheduler.msUntilNext();
+    }
+    Host::deepSleep((uint64_t)waitMs * 1000ULL);
+  }
+  if (day.wakes > 0) {
+    closeDay();
+  }
+}
+
+// ============================================================================
+// Golden files
+// ============================================================================
+
+static void checkGolden(const char* name) {
+  std::string path = suiteDir() + "/golden/" + name + ".txt";
+
+  if (getenv("UPDATE_GOLDEN") != nullptr) {
+    FILE* f = fopen(path.c_str(), "w");
+    TEST_ASSERT_NOT_NULL_MESSAGE(f, path.c_str());
+    for (const std::string& line : output) {
+      fprintf(f, "%s\n", line.c_str());
+    }
+    fclose(f);
+    TEST_IGNORE_MESSAGE("golden file rewritten");
+  }
+
+  FILE* f = fopen(path.c_str(), "r");
+  TEST_ASSERT_NOT_NULL_MESSAGE(f, path.c_str());
+  std::vector<std::string> golden;
+  char line[1024];
+  while (fgets(line, sizeof(line), f) != nullptr) {
+    line[strcspn(line, "\n")] = '\0';
+    golden.push_back(line);
+  }
+  fclose(f);
+
+  // First difference, with the golden and replayed lines
+  size_t n = std::max(golden.size(), output.size());
+  for (size_t i = 0; i < n; i++) {
+    std::string want = i < golden.size() ? golden[i] : "(end of file)";
+    std::string got = i < output.size() ? output[i] : "(end of replay)";
+    if (want != got) {
+      char msg[2400];
+      snprintf(msg, sizeof(msg), "%s:%u differs\n  golden: %s\n  replay: %s",
+               path.c_str(), (unsigned)(i + 1), want.c_str(), got.c_str());
+      TEST_FAIL_MESSAGE(msg);
+    }
+  }
+}
+
+// ============================================================================
+// Tests
+// ============================================================================
+
+void setUp(void) {
+  Host::quiet(true);
+  Host::useVirtualClock(true);
+  Host::nvsErase();
+  Host::powerCycle();
+  broker.refuseConnections(0);
+  broker.clearLog();
+}
+
+void tearDown(void) {}
+
+// AP outage into backoff and batch replay, broker down, commands, a staged
+// interval change, sensor and RTC faults, an alarm, a local midnight
+static void test_outage_and_commands(void) {
+  std::vector<Record> trace = loadTrace("outage");
+  replay(trace, true);
+  checkGolden("outage");
+}
+
+// Every PowerPolicy level on the way down and back up
+static void test_battery_sag(void) {
+  std::vector<Record> trace = loadTrace("battery_sag");
+  replay(trace, true);
+  checkGolden("battery_sag");
+}
+
+static void test_season_digest(void) {
+  std::vector<Record> trace = seasonTrace(SEASON_DAYS);
+  auto start = std::chrono::steady_clock::now();
+  replay(trace, false);
+  double hostS = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  char line[96];
+  snprintf(line, sizeof(line), "season: %u wakes (%d days) replayed in %.1f s",
+           (unsigned)trace.size(), SEASON_DAYS, hostS);
+  TEST_MESSAGE(line);
+  TEST_ASSERT_EQUAL_UINT32(SEASON_DAYS, dayNumber);
+  checkGolden("season");
+}
+
+int main(int argc, char** argv) {
+  (void)argc;
+  (void)argv;
+  if (!broker.start()) {
+    return 1;
+  }
+  broker.attach(IPAddress(192, 168, 0, 20), MQTT_PORT);
+
+  UNITY_BEGIN();
+  RUN_TEST(test_outage_and_commands);
+  RUN_TEST(test_battery_sag);
+  RUN_TEST(test_season_digest);
+  int failures = UNITY_END();
+
+  broker.stop();
+  return failures;
+}
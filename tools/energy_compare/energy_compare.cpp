@@ -0,0 +1,324 @@
+// Purpose: Energy comparison of firmware configurations on the host
+// (env:energy-compare). Replays a wake trace through the firmware's own
+// EnergyModel for each configuration and prints mAh/day and battery life, so
+// an energy regression shows up before a configuration is deployed.
+//
+//   pio run -e energy-compare
+//   .pio/build/energy-compare/program [trace.jsonl] [config ...]
+//
+// trace.jsonl: the responses to the "trace" command, one JSON object per line
+// (e.g. mosquitto_sub -t test/esp32/resp > trace.jsonl; other lines are
+// skipped). Readings and link times come from the trace, the phase currents
+// from ENERGY_MA_*. Without a trace, SIM_DAYS of a simulated greenhouse are
+// used.
+//
+// config: comma-separated key=value, e.g. interval=10,batch=4
+//   interval=M   wake every M minutes (the sleep_min setting)
+//   batch=N      uplink on every Nth wake; readings kept in between go with it
+//   deadband=D   uplink only when the temperature moved D °C from the last
+//                value sent, or N wakes have passed (readings in between are
+//                not sent)
+//   tx_ms=T      extra TX time per kept reading sent with a batch
+// Without configs, a few around the defaults are compared.
+
+#include <Arduino.h>
+#include <Host.h>
+#include <EnergyModel.h>
+#include <config_common.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+typedef EnergyModel::Phase Phase;
+
+static const uint32_t BOOT_MS = 120;        // setup() up to the sensors (SPEC.md example)
+static const uint32_t FLUSH_MS = 250;       // MQTT_FLUSH_MS in src/main.cpp
+static const uint32_t OFFLINE_AWAKE_MS = 160;
+static const int SIM_DAYS = 7;
+
+struct Reading {
+  uint32_t epoch;
+  float tempC;
+};
+
+struct Link {
+  uint32_t wifiMs;    // wake start to WiFi up
+  uint32_t mqttMs;    // wake start to MQTT up
+  uint32_t awakeMs;   // wake start to sleep
+};
+
+struct Trace {
+  std::vector<Reading> readings;
+  std::vector<Link> links;          // wakes that connected
+  uint32_t offlineAwakeMs;          // boot + sensor on a wake without radio
+};
+
+struct Config {
+  char name[64];
+  uint32_t intervalMin;
+  uint32_t batch;
+  float deadbandC;
+  uint32_t txMsPerReading;
+};
+
+struct Result {
+  uint32_t wakes;
+  uint32_t uplinks;
+  float mahPerDay;
+};
+
+// ============================================================================
+// Trace
+// ============================================================================
+
+// Integer value of "key": in a JSON line (false if absent)
+static bool jsonInt(const char* line, const char* key, long& out) {
+  char pattern[32];
+  snprintf(pattern, sizeof(pattern), "\"%s\":", key);
+  const char* p = strstr(line, pattern);
+  if (p == nullptr) {
+    return false;
+  }
+  out = strtol(p + strlen(pattern), nullptr, 10);
+  return true;
+}
+
+static bool loadTrace(const char* path, Trace& trace) {
+  FILE* f = fopen(path, "r");
+  if (f == nullptr) {
+    fprintf(stderr, "[Energy] Cannot open %s\n", path);
+    return false;
+  }
+
+  std::vector<uint32_t> offline;
+  char line[512];
+  while (fgets(line, sizeof(line), f) != nullptr) {
+    long seq, flags, cause, epoch, t, wifi, mqtt, awake;
+    if (!jsonInt(line, "seq", seq) || !jsonInt(line, "flags", flags) ||
+        !jsonInt(line, "cause", cause) || !jsonInt(line, "epoch", epoch) ||
+        !jsonInt(line, "t", t) || !jsonInt(line, "wifi_ms", wifi) ||
+        !jsonInt(line, "mqtt_ms", mqtt) || !jsonInt(line, "awake_ms", awake)) {
+      continue;
+    }
+
+    // Readings with a valid time and DHT22 values (RTC_OK | DHT_OK | READING)
+    if ((flags & 0x07) == 0x07) {
+      trace.readings.push_back({ (uint32_t)epoch, t / 100.0f });
+    }
+    // Timer wakes only: input wakes take the event-only path
+    if (cause == 2 || awake == 0) {
+      continue;
+    }
+    if (mqtt > 0 && wifi > 0 && mqtt >= wifi && awake >= mqtt) {
+      trace.links.push_back({ (uint32_t)wifi, (uint32_t)mqtt, (uint32_t)awake });
+    } else if (wifi == 0) {
+      offline.push_back((uint32_t)awake);
+    }
+  }
+  fclose(f);
+
+  std::sort(trace.readings.begin(), trace.readings.end(),
+            [](const Reading& a, const Reading& b) { return a.epoch < b.epoch; });
+  trace.offlineAwakeMs = OFFLINE_AWAKE_MS;
+  if (!offline.empty()) {
+    std::sort(offline.begin(), offline.end());
+    trace.offlineAwakeMs = offline[offline.size() / 2];
+  }
+
+  printf("[Energy] %s: %u readings, %u connected wakes, offline wake %lu ms\n", path,
+         (unsigned)trace.readings.size(), (unsigned)trace.links.size(),
+         (unsigned long)trace.offlineAwakeMs);
+  return true;
+}
+
+// Deterministic greenhouse: a day/night swing with noise, one reading a
+// minute, and link times around the SPEC.md example wake
+static void simulateTrace(Trace& trace) {
+  const uint32_t start = 1767225600;   // 2026-01-01
+  uint32_t rng = 12345;
+  auto next = [&rng]() {
+    rng = rng * 1103515245u + 12345u;
+    return (float)((rng >> 8) & 0xFFFF) / 65535.0f;
+  };
+
+  for (uint32_t m = 0; m < (uint32_t)SIM_DAYS * 1440; m++) {
+    float day = (float)(m % 1440) / 1440.0f;
+    float temp = 18.0f + 7.0f * sinf(2.0f * (float)M_PI * (day - 0.3f)) + (next() - 0.5f) * 0.4f;
+    trace.readings.push_back({ start + m * 60, temp });
+  }
+  for (int i = 0; i < 256; i++) {
+    uint32_t wifi = 1200 + (uint32_t)(next() * 600);
+    uint32_t mqtt = wifi + 300 + (uint32_t)(next() * 250);
+    trace.links.push_back({ wifi, mqtt, mqtt + 300 + FLUSH_MS });
+  }
+  trace.offlineAwakeMs = OFFLINE_AWAKE_MS;
+  printf("[Energy] Simulated trace: %d days\n", SIM_DAYS);
+}
+
+// Latest reading at or before epoch (the first one before the trace starts)
+static float readingAt(const Trace& trace, uint32_t epoch, size_t& cursor) {
+  while (cursor + 1 < trace.readings.size() && trace.readings[cursor + 1].epoch <= epoch) {
+    cursor++;
+  }
+  return trace.readings[cursor].tempC;
+}
+
+// ============================================================================
+// Replay
+// ============================================================================
+
+static void runPhase(Phase phase, uint32_t ms) {
+  EnergyModel::mark(phase);
+  Host::advance(ms);
+}
+
+static Result replay(const Trace& trace, const Config& cfg) {
+  Result result = { 0, 0, 0.0f };
+  uint32_t start = trace.readings.front().epoch;
+  uint32_t end = trace.readings.back().epoch;
+  uint32_t intervalMs = cfg.intervalMin * 60000;
+
+  // Fresh battery: RTC totals back to zero
+  Host::powerCycle();
+  Host::setTime(start);
+
+  size_t cursor = 0;
+  size_t linkIndex = 0;
+  uint32_t sinceUplink = 0;
+  float lastSentC = NAN;
+  for (uint32_t t = start; t <= end; t += cfg.intervalMin * 60) {
+    EnergyModel::beginWake();
+    float tempC = readingAt(trace, t, cursor);
+    sinceUplink++;
+
+    bool uplink = sinceUplink >= cfg.batch;
+    if (cfg.deadbandC > 0.0f) {
+      uplink = uplink || isnan(lastSentC) || fabsf(tempC - lastSentC) >= cfg.deadbandC;
+    }
+
+    uint32_t awakeMs;
+    if (uplink) {
+      // Phases as main marks them, timed by the next connected wake of the trace
+      const Link& link = trace.links[linkIndex++ % trace.links.size()];
+      uint32_t sensorMs = trace.offlineAwakeMs > BOOT_MS ? trace.offlineAwakeMs - BOOT_MS : 0;
+      uint32_t kept = cfg.deadbandC > 0.0f ? 0 : sinceUplink - 1;
+      uint32_t txMs = link.awakeMs - link.mqttMs > FLUSH_MS ? link.awakeMs - link.mqttMs - FLUSH_MS : 0;
+
+      runPhase(Phase::Boot, BOOT_MS);
+      runPhase(Phase::Sensor, sensorMs);
+      runPhase(Phase::WifiAssoc, link.wifiMs > BOOT_MS + sensorMs ? link.wifiMs - BOOT_MS - sensorMs : 0);
+      runPhase(Phase::Mqtt, link.mqttMs - link.wifiMs);
+      runPhase(Phase::Tx, txMs + kept * cfg.txMsPerReading);
+      runPhase(Phase::Flush, FLUSH_MS);
+      result.uplinks++;
+      sinceUplink = 0;
+      lastSentC = tempC;
+    } else {
+      runPhase(Phase::Boot, BOOT_MS);
+      runPhase(Phase::Sensor, trace.offlineAwakeMs > BOOT_MS ? trace.offlineAwakeMs - BOOT_MS : 0);
+    }
+    awakeMs = millis();
+    EnergyModel::endWake();
+    result.wakes++;
+
+    // Next wake on the interval grid
+    Host::deepSleep((uint64_t)(intervalMs > awakeMs ? intervalMs - awakeMs : 0) * 1000);
+  }
+
+  // Charge the last sleep
+  EnergyModel::beginWake();
+  result.mahPerDay = EnergyModel::mAhPerDay();
+  return result;
+}
+
+// ============================================================================
+// Configurations
+// ============================================================================
+
+static bool parseConfig(const char* text, Config& cfg) {
+  cfg.intervalMin = DEFAULT_SLEEP_MINUTES;
+  cfg.batch = 1;
+  cfg.deadbandC = 0.0f;
+  cfg.txMsPerReading = 15;
+  snprintf(cfg.name, sizeof(cfg.name), "%s", text);
+
+  char copy[128];
+  snprintf(copy, sizeof(copy), "%s", text);
+  for (char* item = strtok(copy, ","); item != nullptr; item = strtok(nullptr, ",")) {
+    char* eq = strchr(item, '=');
+    if (eq == nullptr) {
+      return false;
+    }
+    *eq = '\0';
+    double value = atof(eq + 1);
+    if (strcmp(item, "interval") == 0 && value >= 1) {
+      cfg.intervalMin = (uint32_t)value;
+    } else if (strcmp(item, "batch") == 0 && value >= 1) {
+      cfg.batch = (uint32_t)value;
+    } else if (strcmp(item, "deadband") == 0 && value >= 0) {
+      cfg.deadbandC = (float)value;
+    } else if (strcmp(item, "tx_ms") == 0 && value >= 0) {
+      cfg.txMsPerReading = (uint32_t)value;
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+int main(int argc, char** argv) {
+  Host::quiet(true);   // EnergyModel logs every wake
+  Host::useVirtualClock(true);
+
+  Trace trace;
+  int first = 1;
+  if (argc > 1 && strchr(argv[1], '=') == nullptr) {
+    if (!loadTrace(argv[1], trace)) {
+      return 1;
+    }
+    first = 2;
+  } else {
+    simulateTrace(trace);
+  }
+  if (trace.readings.size() < 2 || trace.links.empty()) {
+    fprintf(stderr, "[Energy] Trace needs timed readings and at least one connected wake\n");
+    return 1;
+  }
+
+  std::vector<Config> configs;
+  static const char* const DEFAULTS[] = {
+    "interval=5", "interval=10", "interval=5,batch=4", "interval=5,deadband=0.3,batch=12"
+  };
+  if (first < argc) {
+    for (int i = first; i < argc; i++) {
+      Config cfg;
+      if (!parseConfig(argv[i], cfg)) {
+        fprintf(stderr, "[Energy] Bad config '%s'\n", argv[i]);
+        return 1;
+      }
+      configs.push_back(cfg);
+    }
+  } else {
+    for (const char* text : DEFAULTS) {
+      Config cfg;
+      parseConfig(text, cfg);
+      configs.push_back(cfg);
+    }
+  }
+
+  printf("%-36s %7s %8s %9s %10s %8s\n", "config", "wakes", "uplinks", "mAh/day", "life_days", "vs_first");
+  float baseline = 0.0f;
+  for (const Config& cfg : configs) {
+    Result r = replay(trace, cfg);
+    if (baseline == 0.0f) {
+      baseline = r.mahPerDay;
+    }
+    printf("%-36s %7lu %8lu %9.2f %10.0f %+7.1f%%\n", cfg.name, (unsigned long)r.wakes,
+           (unsigned long)r.uplinks, r.mahPerDay, BATTERY_CAPACITY_MAH / r.mahPerDay,
+           (r.mahPerDay / baseline - 1.0f) * 100.0f);
+  }
+  return 0;
+}
@@ -0,0 +1,408 @@
+// Purpose: Broker load of a fleet of nodes, on the host (env:fleet-sim).
+// Runs the firmware's own ConnectionManager, Comms and MQTTPublisher for
+// thousands of virtual nodes against FakeBroker, each with its own MAC
+// (client ID, broker session) and RTC memory, waking on its interval with
+// jitter. Reports the broker's message rate, bytes per node per day (per
+// topic too) and connect latency percentiles, so a protocol change that
+// costs the broker shows up before it reaches a fleet.
+//
+//   pio run -e fleet-sim
+//   .pio/build/fleet-sim/program [key=value ...]
+//
+//   nodes=N      virtual nodes (1000)
+//   hours=H      simulated time (6)
+//   interval=M   minutes between wakes (DEFAULT_SLEEP_MINUTES)
+//   jitter=S     each sleep is up to S seconds shorter or longer (20)
+//   assoc=MS     WiFi association time, drawn from [MS/2, 3*MS/2] (1500)
+//   storm=1      all nodes power on in the same second (after an outage);
+//                by default power-on is spread over the first interval
+//   seed=N       random seed (1)
+//
+// A wake is the connected path of setup() in src/main.cpp: boot message, HA
+// availability and (every HA_CONFIG_REFRESH_WAKES) discovery, HA state,
+// status with the same fields, health, min/max, log line, then the flush.
+// Keep wake() in step with it. The socket is dropped without DISCONNECT, as
+// by deep sleep, so the broker publishes the will.
+//
+// Wakes run one at a time in simulated-time order on the virtual clock: the
+// times are what the nodes see (association, the firmware's own delays),
+// not the host's, and the broker never has two nodes connected at once.
+
+#include <Arduino.h>
+#include <Host.h>
+#include <FakeBroker.h>
+#include <WiFi.h>
+#include <ConfigStore.h>
+#include <ConnectionManager.h>
+#include <Comms.h>
+#include <MQTTPublisher.h>
+#include <MinMaxTracker.h>
+#include <ConnectPolicy.h>
+#include <EnergyModel.h>
+#include <HealthCounters.h>
+#include <TrafficStats.h>
+#include <config_common.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <vector>
+
+static const uint32_t CONNECT_TIMEOUT_MS = 15000;   // src/main.cpp
+static const uint32_t MQTT_FLUSH_MS = 250;          // src/main.cpp
+static const uint64_t NODE_MAC_BASE = 0x24A160000000ULL;
+static const uint32_t SECONDS_PER_DAY = 86400;
+
+struct Options {
+  uint32_t nodes;
+  double hours;
+  uint32_t intervalMin;
+  uint32_t jitterS;
+  uint32_t assocMs;
+  bool storm;
+  uint32_t seed;
+};
+
+struct Node {
+  uint64_t mac;
+  bool powered;          // false until its first wake (power-on)
+};
+
+struct Wake {
+  uint32_t atS;          // simulated seconds from the start
+  uint32_t node;
+  bool operator>(const Wake& other) const {
+    return atS != other.atS ? atS > other.atS : node > other.node;
+  }
+};
+
+struct TopicLoad {
+  uint64_t msgs;
+  uint64_t payloadBytes;
+  uint64_t retained;
+};
+
+// ============================================================================
+// Node state (RTC memory, swapped per node with Host::rtcSave()/rtcLoad())
+// ============================================================================
+
+RTC_DATA_ATTR static uint32_t rtc_ha_config_age = 0;
+RTC_DATA_ATTR static bool rtc_ha_config_sent = false;
+enum MinMaxChannel : uint8_t { MINMAX_TEMP, MINMAX_HUM, MINMAX_CHANNELS };
+static const char* const MINMAX_NAMES[MINMAX_CHANNELS] = { "temp_c", "hum_pct" };
+RTC_DATA_ATTR static MinMaxTracker<float, MINMAX_CHANNELS> minMaxTracker;
+RTC_DATA_ATTR static ConnectPolicy::State rtc_connect;
+RTC_DATA_ATTR static uint64_t rtc_wake_count = 0;
+
+// ============================================================================
+// Broker side
+// ============================================================================
+
+static FakeBroker broker;
+static std::mutex topicMutex;
+static std::map<std::string, TopicLoad> topics;
+
+// Every client PUBLISH, on the broker thread
+static void countTopic(FakeBroker&, const FakeBroker::Message& m) {
+  std::lock_guard<std::mutex> lock(topicMutex);
+  TopicLoad& load = topics[m.topic];
+  load.msgs++;
+  load.payloadBytes += m.payload.size();
+  load.retained += m.retained ? 1 : 0;
+}
+
+// ============================================================================
+// One wake
+// ============================================================================
+
+static uint32_t rng = 1;
+
+static uint32_t random32() {
+  rng ^= rng << 13;
+  rng ^= rng >> 17;
+  rng ^= rng << 5;
+  return rng;
+}
+
+static uint32_t randomBetween(uint32_t lo, uint32_t hi) {
+  return hi > lo ? lo + random32() % (hi - lo + 1) : lo;
+}
+
+// As in src/main.cpp
+static int appendStatusField(char* buf, size_t len, int used, const char* fmt, ...) {
+  if (used < 0 || (size_t)used + 1 >= len) {
+    return used;
+  }
+  if (used > 0) {
+    buf[used++] = ',';
+    buf[used] = '\0';
+  }
+
+  va_list args;
+  va_start(args, fmt);
+  int n = vsnprintf(buf + used, len - used, fmt, args);
+  va_end(args);
+
+  return n < 0 ? used : used + n;
+}
+
+// Connected wake of src/main.cpp; returns the wake-to-MQTT time (0 if it
+// did not connect)
+static uint32_t wake(const Options& opt) {
+  EnergyModel::beginWake();
+  EnergyModel::mark(EnergyModel::Phase::Boot);
+  ConfigStore::begin();
+  TrafficStats::beginWake();
+  rtc_wake_count++;
+
+  ConnectionManager cm;
+  Comms comms;
+  MQTTPublisher mqttPublisher;
+  cm.begin();
+  comms.begin(cm);
+  cm.setComms(&comms);
+  mqttPublisher.begin(comms);
+
+  EnergyModel::mark(EnergyModel::Phase::WifiAssoc);
+  Host::setWifi(true, randomBetween(opt.assocMs / 2, opt.assocMs * 3 / 2));
+  uint32_t start = millis();
+  while (!cm.mqttConnected() && millis() - start < CONNECT_TIMEOUT_MS) {
+    cm.loop();
+    delay(1);
+  }
+  bool connected = cm.mqttConnected();
+  ConnectPolicy::report(rtc_connect, connected);
+  if (!connected) {
+    HealthCounters::increment(HealthCounters::Counter::LinkTimeout);
+    EnergyModel::endWake();
+    return 0;
+  }
+  uint32_t connectMs = millis();
+  ConnectPolicy::recordMqtt(rtc_connect, connectMs);
+
+  EnergyModel::mark(EnergyModel::Phase::Tx);
+  cm.drainMailbox(MAILBOX_DRAIN_MAX_MS, MAILBOX_QUIET_MS);
+
+  // publishBootOnce()
+  char bootMsg[128];
+  snprintf(bootMsg, sizeof(bootMsg), "{\"device\":\"%s\",\"version\":\"%s\",\"status\":\"online\"}",
+           DEVICE_NAME, FW_VERSION);
+  comms.publishBoot(bootMsg);
+  comms.publishHAAvailability("online", true);
+  if (!rtc_ha_config_sent || ++rtc_ha_config_age >= HA_CONFIG_REFRESH_WAKES) {
+    rtc_ha_config_sent = comms.publishHAConfig(true);
+    rtc_ha_config_age = 0;
+  }
+
+  // publishReadingAndStatus(): a greenhouse reading, the node's own clock
+  time_t nowEpoch = Host::worldTime();
+  float tempC = 15.0f + (float)(random32() % 1500) / 100.0f;
+  float humPct = 40.0f + (float)(random32() % 4000) / 100.0f;
+  comms.publishHAState(tempC, humPct, nowEpoch);
+  const float values[MINMAX_CHANNELS] = { tempC, humPct };
+  minMaxTracker.update(values, nowEpoch);
+
+  char extraFields[512];
+  extraFields[0] = '\0';
+  int used = appendStatusField(extraFields, sizeof(extraFields), 0, "\"cmds\":%u", cm.getCommandCount());
+  char energyFields[160];
+  EnergyModel::formatStatusFields(energyFields, sizeof(energyFields));
+  used = appendStatusField(extraFields, sizeof(extraFields), used, "%s", energyFields);
+  char trafficFields[192];
+  TrafficStats::formatStatusFields(trafficFields, sizeof(trafficFields));
+  used = appendStatusField(extraFields, sizeof(extraFields), used, "%s", trafficFields);
+  char connFields[80];
+  ConnectPolicy::formatStatusFields(rtc_connect, connFields, sizeof(connFields));
+  used = appendStatusField(extraFields, sizeof(extraFields), used, "%s", connFields);
+
+  bool statusOk = mqttPublisher.publishStatus(DEVICE_NAME, FW_VERSION, nowEpoch, tempC, humPct,
+                                              rtc_wake_count, extraFields);
+  if (statusOk) {
+    bool withHealth = false;
+    if (HealthCounters::due()) {
+      char healthFields[HealthCounters::FIELDS_SIZE];
+      HealthCounters::formatStatusFields(healthFields, sizeof(healthFields));
+      withHealth = mqttPublisher.publishHealth(DEVICE_NAME, nowEpoch, healthFields);
+    }
+    HealthCounters::statusSent(withHealth);
+  }
+  mqttPublisher.publishMinMax(DEVICE_NAME, nowEpoch, minMaxTracker, MINMAX_NAMES);
+  char logMsg[96];
+  snprintf(logMsg, sizeof(logMsg), "Temp=%.1fC Hum=%.1f%%", tempC, humPct);
+  comms.publishLog(logMsg);
+
+  // flushMqttBriefly(), then deep sleep: cm goes out of scope, the socket closes
+  EnergyModel::mark(EnergyModel::Phase::Flush);
+  uint32_t t0 = millis();
+  while (millis() - t0 < MQTT_FLUSH_MS) {
+    cm.loop();
+    delay(1);
+  }
+  EnergyModel::endWake();
+  return connectMs;
+}
+
+// ============================================================================
+// Report
+// ============================================================================
+
+static uint32_t percentile(std::vector<uint32_t>& sorted, uint32_t percent) {
+  if (sorted.empty()) {
+    return 0;
+  }
+  size_t i = (sorted.size() * percent + 99) / 100;
+  return sorted[i > 0 ? i - 1 : 0];
+}
+
+static void report(const Options& opt, uint32_t simulatedS, uint64_t wakes, std::vector<uint32_t>& connectMs,
+                   const std::vector<uint32_t>& msgsPerMinute, double hostS) {
+  // Wills and the last PUBLISHes are handled once every socket is closed
+  Host::useVirtualClock(false);
+  uint32_t waitStart = millis();
+  while (broker.clientsConnected() > 0 && millis() - waitStart < 5000) {
+    delay(10);
+  }
+  FakeBroker::Stats s = broker.stats();
+  double days = (double)simulatedS / SECONDS_PER_DAY;
+  double nodeDays = days * opt.nodes;
+  std::sort(connectMs.begin(), connectMs.end());
+  uint32_t peak = msgsPerMinute.empty() ? 0 : *std::max_element(msgsPerMinute.begin(), msgsPerMinute.end());
+
+  printf("[Fleet] %u nodes, %.1f h, wake every %u min +/- %u s, association ~%u ms%s\n",
+         opt.nodes, simulatedS / 3600.0, opt.intervalMin, opt.jitterS, opt.assocMs,
+         opt.storm ? ", storm" : "");
+  printf("wakes            %llu (%llu connected)\n", (unsigned long long)wakes,
+         (unsigned long long)connectMs.size());
+  printf("broker in        %llu msgs, %.2f/s mean, %.2f/s in the busiest minute\n",
+         (unsigned long long)s.publishesIn, s.publishesIn / (double)simulatedS, peak / 60.0);
+  printf("broker out       %llu msgs\n", (unsigned long long)s.publishesOut);
+  printf("connects         %llu accepted, %llu refused, %.2f/s\n", (unsigned long long)s.connects,
+         (unsigned long long)s.refused, s.connects / (double)simulatedS);
+  printf("per node per day %.0f msgs, %.0f bytes in, %.0f bytes out (MQTT packets)\n",
+         s.publishesIn / nodeDays, s.bytesIn / nodeDays, s.bytesOut / nodeDays);
+  printf("connect latency  p50 %u ms, p90 %u ms, p99 %u ms, max %u ms (wake to MQTT up)\n",
+         percentile(connectMs, 50), percentile(connectMs, 90), percentile(connectMs, 99),
+         connectMs.empty() ? 0 : connectMs.back());
+
+  printf("\n%-58s %12s %14s %9s\n", "topic", "msgs/node/d", "payload B/n/d", "retained");
+  std::lock_guard<std::mutex> lock(topicMutex);
+  for (const auto& entry : topics) {
+    printf("%-58s %12.1f %14.0f %9llu\n", entry.first.c_str(), entry.second.msgs / nodeDays,
+           entry.second.payloadBytes / nodeDays, (unsigned long long)entry.second.retained);
+  }
+  printf("\nhost: %.1f s, %.0f wakes/s\n", hostS, hostS > 0 ? wakes / hostS : 0.0);
+}
+
+// ============================================================================
+// Options
+// ============================================================================
+
+static bool parseOption(const char* text, Options& opt) {
+  const char* eq = strchr(text, '=');
+  if (eq == nullptr) {
+    return false;
+  }
+  std::string key(text, eq - text);
+  double value = atof(eq + 1);
+  if (key == "nodes" && value >= 1) {
+    opt.nodes = (uint32_t)value;
+  } else if (key == "hours" && value > 0) {
+    opt.hours = value;
+  } else if (key == "interval" && value >= 1) {
+    opt.intervalMin = (uint32_t)value;
+  } else if (key == "jitter" && value >= 0) {
+    opt.jitterS = (uint32_t)value;
+  } else if (key == "assoc" && value >= 0) {
+    opt.assocMs = (uint32_t)value;
+  } else if (key == "storm") {
+    opt.storm = value != 0;
+  } else if (key == "seed" && value >= 1) {
+    opt.seed = (uint32_t)value;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+int main(int argc, char** argv) {
+  Options opt = { 1000, 6.0, DEFAULT_SLEEP_MINUTES, 20, 1500, false, 1 };
+  for (int i = 1; i < argc; i++) {
+    if (!parseOption(argv[i], opt)) {
+      fprintf(stderr, "[Fleet] Bad option '%s' (usage in tools/fleet_sim/fleet_sim.cpp)\n", argv[i]);
+      return 1;
+    }
+  }
+  rng = opt.seed;
+
+  Host::quiet(true);
+  Host::useVirtualClock(true);
+  Host::nvsErase();
+  if (!broker.start()) {
+    fprintf(stderr, "[Fleet] Broker failed to start\n");
+    return 1;
+  }
+  broker.attach(IPAddress(192, 168, 0, 20), MQTT_PORT);
+  broker.setLogging(false);
+  broker.setHook(countTopic);
+
+  // Every node starts from the image's RTC memory
+  const size_t rtcSize = Host::rtcSize();
+  std::vector<uint8_t> rtc((size_t)opt.nodes * rtcSize);
+  std::vector<Node> nodes(opt.nodes);
+  std::priority_queue<Wake, std::vector<Wake>, std::greater<Wake>> due;
+  const uint32_t intervalS = opt.intervalMin * 60;
+  for (uint32_t i = 0; i < opt.nodes; i++) {
+    nodes[i] = Node{ NODE_MAC_BASE + i, false };
+    due.push(Wake{ opt.storm ? 0 : randomBetween(0, intervalS - 1), i });
+  }
+
+  const time_t startEpoch = Host::worldTime();
+  const uint32_t endS = (uint32_t)(opt.hours * 3600.0);
+  std::vector<uint32_t> connectMs;
+  std::vector<uint32_t> msgsPerMinute(endS / 60 + 1, 0);
+  uint64_t wakes = 0;
+  auto hostStart = std::chrono::steady_clock::now();
+
+  while (!due.empty() && due.top().atS < endS) {
+    Wake w = due.top();
+    due.pop();
+    Node& node = nodes[w.node];
+    uint8_t* image = rtc.data() + (size_t)w.node * rtcSize;
+
+    // Power-on or deep sleep wake of this node at its own time
+    Host::setMac(node.mac);
+    if (node.powered) {
+      Host::rtcLoad(image);
+      Host::deepSleep(0);
+    } else {
+      Host::powerCycle();
+      node.powered = true;
+    }
+    Host::setTime(startEpoch + w.atS);
+
+    uint64_t before = broker.stats().publishesIn;
+    uint32_t ms = wake(opt);
+    if (ms > 0) {
+      connectMs.push_back(ms);
+    }
+    Host::rtcSave(image);
+    wakes++;
+
+    // Counted when the node is done; the broker thread may still be reading
+    msgsPerMinute[w.atS / 60] += (uint32_t)(broker.stats().publishesIn - before);
+
+    uint32_t sleepS = randomBetween(intervalS - std::min(intervalS - 1, opt.jitterS), intervalS + opt.jitterS);
+    due.push(Wake{ w.atS + sleepS, w.node });
+  }
+
+  double hostS = std::chrono::duration<double>(std::chrono::steady_clock::now() - hostStart).count();
+  report(opt, endS, wakes, connectMs, msgsPerMinute, hostS);
+  broker.stop();
+  return 0;
+}